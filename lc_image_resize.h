@@ -62,13 +62,14 @@ typedef enum lc_filter {
     LC_FILTER_SINC_BLACKMAN,
     LC_FILTER_GAUSSIAN,
     LC_FILTER_BESSEL_BLACKMAN,
+    LC_FILTER_KAISER,
     LC_FILTER_MAX
 } lc_filter;
 
 struct lc_filter_args {
     float support;  /* support radius */
-    float b;        /* b value */
-    float c;        /* c value */
+    float b;        /* b value, alpha for kaiser */
+    float c;        /* c value, stretch for kaiser */
 
     /* consider these private */
     float q0, q1, q2, q3;
@@ -83,10 +84,95 @@ void lc_image_resize_float(int src_width, int src_height, int src_row_stride, co
                            int dst_wdith, int dst_height, int dst_row_stride, float* p_dst_data,
                            unsigned int channel_count, lc_filter filter, const lc_filter_args* p_filter_args);
 
+/*
+ dispatch must call task(i, p_task_data) once for every i in [0, task_count), on any threads
+ and in any order, and return after all of them have finished. p_dispatch_data is passed
+ through untouched, e.g. for the caller's job system.
+*/
+typedef void (*lc_task_fn)(unsigned int task_index, void* p_task_data);
+typedef void (*lc_dispatch_fn)(lc_task_fn task, void* p_task_data, unsigned int task_count, void* p_dispatch_data);
+
+/*
+ Same result as lc_image_resize_uint8 with the dst rows split into band_count bands, one
+ task each. The weight tables are built once and shared, each band has its own line
+ buffers - source rows at the edge of a band are filtered by both bands that use them.
+ A NULL dispatch runs the bands in order on the calling thread.
+*/
+void lc_image_resize_uint8_threaded(int src_width, int src_height, int src_row_stride, const unsigned char* p_src_data,
+                                    int dst_wdith, int dst_height, int dst_row_stride, unsigned char* p_dst_data,
+                                    unsigned int channel_count, lc_filter filter, const lc_filter_args* p_filter_args,
+                                    unsigned int band_count, lc_dispatch_fn dispatch, void* p_dispatch_data);
+
+/* Where a mip level lives in the caller's staging memory, strides and offsets are in bytes */
+typedef struct lc_mip_level {
+    int     width;
+    int     height;
+    int     row_stride;
+    size_t  offset;
+} lc_mip_level;
+
+/*
+ Fills p_levels with a tightly packed chain that halves down from width x height, each
+ level starting on a multiple of alignment. Returns the total size in bytes.
+*/
+size_t lc_image_mip_layout(int width, int height, unsigned int pixel_size, unsigned int alignment,
+                           unsigned int level_count, lc_mip_level* p_levels);
+
+/*
+ Writes level_count levels into p_dst_data at the offsets in p_levels. Level 0 is copied
+ from the source (or resized if it's a different size), every level after that is filtered
+ from the one before it. LC_FILTER_BOX and LC_FILTER_KAISER are the usual choices, box
+ levels that halve exactly take a 2x2 average that matches what the resize produces.
+*/
+void lc_image_generate_mips_uint8(int src_width, int src_height, int src_row_stride, const unsigned char* p_src_data,
+                                  unsigned int level_count, const lc_mip_level* p_levels, unsigned char* p_dst_data,
+                                  unsigned int channel_count, lc_filter filter, const lc_filter_args* p_filter_args);
+
+void lc_image_generate_mips_float(int src_width, int src_height, int src_row_stride, const float* p_src_data,
+                                  unsigned int level_count, const lc_mip_level* p_levels, float* p_dst_data,
+                                  unsigned int channel_count, lc_filter filter, const lc_filter_args* p_filter_args);
+
+/*
+ 4 channel images are filtered with all channels at once, using SSE4.1 or AVX2 when the CPU
+ has them. The results match the scalar code bit for bit - for float that assumes the
+ compiler doesn't contract multiplies and adds into FMAs (-ffp-contract=off).
+ LC_IMAGE_RESIZE_NO_SIMD leaves only the scalar kernels.
+*/
+typedef enum lc_simd {
+    LC_SIMD_SCALAR = 0,
+    LC_SIMD_SSE41,
+    LC_SIMD_AVX2
+} lc_simd;
+
+/* Returns the kernels resizes use, the best the CPU supports up to the limit below */
+lc_simd lc_image_resize_get_simd();
+
+/* Caps the kernels resizes use, e.g. LC_SIMD_SCALAR to compare against. Not thread safe. */
+void lc_image_resize_set_simd_limit(lc_simd limit);
+
 
 
 #if defined(LC_IMAGE_RESIZE_IMPLEMENTATION)
 
+#if ! defined(LC_IMAGE_RESIZE_NO_SIMD) && (defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86))
+    #define LC_IMAGE_RESIZE_X86
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+    #else
+        #include <cpuid.h>
+    #endif
+    #include <immintrin.h>
+
+    /* MSVC takes the intrinsics anywhere, GCC and Clang need the target per function */
+    #if defined(_MSC_VER) && ! defined(__clang__)
+        #define LC_TARGET_SSE41
+        #define LC_TARGET_AVX2
+    #else
+        #define LC_TARGET_SSE41 __attribute__((target("sse4.1")))
+        #define LC_TARGET_AVX2  __attribute__((target("avx2")))
+    #endif
+#endif
+
 #if defined(__cplusplus)  
     #define LC_DECLARE_ZERO(type, var) \
             type var = {};                        
@@ -349,6 +435,177 @@ float lc_filter_bessel_blackman(float x, const lc_filter_args* p_params)
     return v * ( 0.42f + 0.50f * cos( 3.14159265358979323846f * x ) + 0.08f * cos( 6.2831853071795862f * x ) );
 }
 
+/* Modified Bessel function of the first kind, order 0 - the series converges quickly for the alphas used here */
+float lc_bessel_i0(float x)
+{
+    float sum = 1.0f;
+    float term = 1.0f;
+    float half_x = 0.5f * x;
+    for (int k = 1; k < 32; ++k) {
+        float t = half_x / (float)k;
+        term *= t * t;
+        sum += term;
+        if (term < (sum * 1.0e-8f)) {
+            break;
+        }
+    }
+    return sum;
+}
+
+/* Sinc filter, windowed by Kaiser - b is the window's alpha and c stretches the sinc */
+void  lc_filter_kaiser_init(lc_filter_args* p_params)
+{
+    p_params->support = 3.0f;
+    p_params->b = 4.0f;
+    p_params->c = 1.0f;
+}
+
+float lc_filter_kaiser(float x, const lc_filter_args* p_params)
+{
+    float t = x / p_params->support;
+    float r = 1.0f - t * t;
+    if ( r <= 0.0f ) return 0.0f;
+    float s = x * p_params->c;
+    float v( ( s == 0.0f ) ? 1.0f : sin( 3.14159265358979323846f * s ) / ( 3.14159265358979323846f * s ) );
+    return v * lc_bessel_i0( p_params->b * sqrt( r ) ) / lc_bessel_i0( p_params->b );
+}
+
+/* Returns the filter function, p_args gets p_filter_args or the filter's defaults if that's NULL */
+lc_filter_fn lc_get_filter(lc_filter filter, const lc_filter_args* p_filter_args, lc_filter_args* p_args)
+{
+    lc_filter_fn filter_fn = NULL;
+    switch (filter) {
+        case LC_FILTER_BOX: {
+            filter_fn = lc_filter_box;
+            if (NULL == p_filter_args) {lc_filter_box_init(p_args);}
+        }
+        break;
+        case LC_FILTER_TRIANGLE: {
+            filter_fn = lc_filter_triangle;
+            if (NULL == p_filter_args) {lc_filter_triangle_init(p_args);}
+        }
+        break;
+        case LC_FILTER_QUADRATIC: {
+            filter_fn = lc_filter_quadratic;
+            if (NULL == p_filter_args) {lc_filter_quadratic_init(p_args);}
+        }
+        break;
+        case LC_FILTER_CUBIC: {
+            filter_fn = lc_filter_cubic;
+            if (NULL == p_filter_args) {lc_filter_cubic_init(p_args);}
+        }
+        break;
+        case LC_FILTER_CATMUL_ROM: {
+            filter_fn = lc_filter_catmull_rom;
+            if (NULL == p_filter_args) {lc_filter_catmull_rom_init(p_args);}
+        }
+        break;
+        case LC_FILTER_MITCHELL: {
+            filter_fn = lc_filter_mitchell;
+            if (NULL == p_filter_args) {lc_filter_mitchell_init(p_args);}
+        }
+        break;
+        case LC_FILTER_SINC_BLACKMAN: {
+            filter_fn = lc_filter_sinc_blackman;
+            if (NULL == p_filter_args) {lc_filter_sinc_blackman_init(p_args);}
+        }
+        break;
+        case LC_FILTER_GAUSSIAN: {
+            filter_fn = lc_filter_gassian;
+            if (NULL == p_filter_args) {lc_filter_gassian_init(p_args);}
+        }
+        break;
+        case LC_FILTER_BESSEL_BLACKMAN: {
+            filter_fn = lc_filter_bessel_blackman;
+            if (NULL == p_filter_args) {lc_filter_bessel_blackman_init(p_args);}
+        }
+        break;
+        case LC_FILTER_KAISER: {
+            filter_fn = lc_filter_kaiser;
+            if (NULL == p_filter_args) {lc_filter_kaiser_init(p_args);}
+        }
+        break;
+
+        default: break;
+    }
+    assert(NULL != filter_fn);
+
+    if (NULL != p_filter_args) {
+        memcpy(p_args, p_filter_args, sizeof(*p_filter_args));
+    }
+
+    return filter_fn;
+}
+
+/**************************************************************************************************/
+/* SIMD                                                                                           */
+/**************************************************************************************************/
+#if defined(LC_IMAGE_RESIZE_X86)
+void lc_cpuid(unsigned int leaf, unsigned int sub_leaf, unsigned int* p_regs)
+{
+#if defined(_MSC_VER)
+    __cpuidex((int*)p_regs, (int)leaf, (int)sub_leaf);
+#else
+    __cpuid_count(leaf, sub_leaf, p_regs[0], p_regs[1], p_regs[2], p_regs[3]);
+#endif
+}
+
+unsigned long long lc_xgetbv()
+{
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    unsigned int lo = 0;
+    unsigned int hi = 0;
+    __asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((unsigned long long)hi << 32) | lo;
+#endif
+}
+#endif
+
+lc_simd lc_detect_simd()
+{
+    lc_simd result = LC_SIMD_SCALAR;
+#if defined(LC_IMAGE_RESIZE_X86)
+    unsigned int regs[4] = { 0 };
+    lc_cpuid(0, 0, regs);
+    const unsigned int max_leaf = regs[0];
+
+    lc_cpuid(1, 0, regs);
+    const bool sse41   = (0 != (regs[2] & (1u << 19)));
+    const bool osxsave = (0 != (regs[2] & (1u << 27)));
+    const bool avx     = (0 != (regs[2] & (1u << 28)));
+    if (sse41) {
+        result = LC_SIMD_SSE41;
+    }
+
+    /* AVX2 also needs the OS to save the YMM registers */
+    if (sse41 && osxsave && avx && (max_leaf >= 7) && (0x6 == (lc_xgetbv() & 0x6))) {
+        lc_cpuid(7, 0, regs);
+        if (0 != (regs[1] & (1u << 5))) {
+            result = LC_SIMD_AVX2;
+        }
+    }
+#endif
+    return result;
+}
+
+static int     g_lc_simd_detected = -1;
+static lc_simd g_lc_simd_limit    = LC_SIMD_AVX2;
+
+lc_simd lc_image_resize_get_simd()
+{
+    if (g_lc_simd_detected < 0) {
+        g_lc_simd_detected = (int)lc_detect_simd();
+    }
+    return (lc_simd)LC_MATH_MIN(g_lc_simd_detected, (int)g_lc_simd_limit);
+}
+
+void lc_image_resize_set_simd_limit(lc_simd limit)
+{
+    g_lc_simd_limit = limit;
+}
+
 /**************************************************************************************************/
 /* uint8                                                                                          */
 /**************************************************************************************************/
@@ -398,6 +655,181 @@ void lc_uint8_scanline_filter_channel_to_buffer(lc_uint8_weight_table* weights,
     }   
 }
 
+/* 
+ RGBA kernels: line buffers and accumulators hold the four channels of a pixel next to each
+ other. The sums are the same integer sums as the per channel code, only the order of the
+ additions changes, so the results are identical.
+*/
+void lc_uint8_scanline_filter_rgba_to_buffer(const lc_uint8_weight_table* weights, 
+                                             const lc_uint8_data_t* src_line, 
+                                             lc_uint8_sum_t* line_buffer, int width)
+{
+    for (int b = 0; b < width; ++b) {
+        lc_uint8_sum_t sum0 = 1 << 7;
+        lc_uint8_sum_t sum1 = 1 << 7;
+        lc_uint8_sum_t sum2 = 1 << 7;
+        lc_uint8_sum_t sum3 = 1 << 7;
+        const lc_uint8_data_t* src = src_line + (weights->start * 4);
+        const lc_uint8_sum_t* wp = weights->weight;
+        for (int af = weights->start; af < weights->end; ++af) {
+            lc_uint8_sum_t w = *wp++;
+            sum0 += w * src[0];
+            sum1 += w * src[1];
+            sum2 += w * src[2];
+            sum3 += w * src[3];
+            src += 4;
+        }
+        *line_buffer++ = lc_uint8_channel_to_buffer(sum0);
+        *line_buffer++ = lc_uint8_channel_to_buffer(sum1);
+        *line_buffer++ = lc_uint8_channel_to_buffer(sum2);
+        *line_buffer++ = lc_uint8_channel_to_buffer(sum3);
+        weights++;
+    }
+}
+
+void lc_uint8_scanline_accum_to_rgba(const lc_uint8_sum_t* accum, int width, lc_uint8_data_t* dst)
+{
+    for (int i = 0; i < 4 * width; ++i) {
+        dst[i] = lc_uint8_accum_to_channel(accum[i]);
+    }
+}
+
+#if defined(LC_IMAGE_RESIZE_X86)
+LC_TARGET_SSE41
+void lc_uint8_scanline_filter_rgba_to_buffer_sse41(const lc_uint8_weight_table* weights, 
+                                                   const lc_uint8_data_t* src_line, 
+                                                   lc_uint8_sum_t* line_buffer, int width)
+{
+    for (int b = 0; b < width; ++b) {
+        __m128i sum = _mm_set1_epi32(1 << 7);
+        const lc_uint8_data_t* src = src_line + (weights->start * 4);
+        const lc_uint8_sum_t* wp = weights->weight;
+        for (int af = weights->start; af < weights->end; ++af) {
+            int pixel;
+            memcpy(&pixel, src, sizeof(pixel));
+            __m128i p = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(pixel));
+            sum = _mm_add_epi32(sum, _mm_mullo_epi32(p, _mm_set1_epi32((int)*wp++)));
+            src += 4;
+        }
+        _mm_storeu_si128((__m128i*)line_buffer, _mm_srai_epi32(sum, 8));
+        line_buffer += 4;
+        weights++;
+    }
+}
+
+LC_TARGET_SSE41
+void lc_uint8_scanline_accumulate_sse41(lc_uint8_sum_t weight, lc_uint8_sum_t* line_buffer, 
+                                        int width, lc_uint8_sum_t* accum)
+{
+    const __m128i w = _mm_set1_epi32((int)weight);
+    int x = 0;
+    for (; (x + 4) <= width; x += 4) {
+        __m128i line = _mm_loadu_si128((const __m128i*)(line_buffer + x));
+        __m128i sum = _mm_loadu_si128((const __m128i*)(accum + x));
+        _mm_storeu_si128((__m128i*)(accum + x), _mm_add_epi32(sum, _mm_mullo_epi32(line, w)));
+    }
+    for (; x < width; ++x) {
+        accum[x] += line_buffer[x] * weight;
+    }
+}
+
+/* The saturating packs clamp to [0, 255] like lc_uint8_accum_to_channel does */
+LC_TARGET_SSE41
+void lc_uint8_scanline_accum_to_rgba_sse41(const lc_uint8_sum_t* accum, int width, lc_uint8_data_t* dst)
+{
+    const __m128i half = _mm_set1_epi32(k_lc_uint8_half_final_shift);
+    const int count = 4 * width;
+    int i = 0;
+    for (; (i + 16) <= count; i += 16) {
+        __m128i v0 = _mm_srai_epi32(_mm_add_epi32(_mm_loadu_si128((const __m128i*)(accum + i +  0)), half), k_lc_uint8_final_shift);
+        __m128i v1 = _mm_srai_epi32(_mm_add_epi32(_mm_loadu_si128((const __m128i*)(accum + i +  4)), half), k_lc_uint8_final_shift);
+        __m128i v2 = _mm_srai_epi32(_mm_add_epi32(_mm_loadu_si128((const __m128i*)(accum + i +  8)), half), k_lc_uint8_final_shift);
+        __m128i v3 = _mm_srai_epi32(_mm_add_epi32(_mm_loadu_si128((const __m128i*)(accum + i + 12)), half), k_lc_uint8_final_shift);
+        __m128i packed = _mm_packus_epi16(_mm_packs_epi32(v0, v1), _mm_packs_epi32(v2, v3));
+        _mm_storeu_si128((__m128i*)(dst + i), packed);
+    }
+    for (; i < count; ++i) {
+        dst[i] = lc_uint8_accum_to_channel(accum[i]);
+    }
+}
+
+/* Two taps per iteration, one in each 128-bit lane */
+LC_TARGET_AVX2
+void lc_uint8_scanline_filter_rgba_to_buffer_avx2(const lc_uint8_weight_table* weights, 
+                                                  const lc_uint8_data_t* src_line, 
+                                                  lc_uint8_sum_t* line_buffer, int width)
+{
+    /* puts weight 0 in the low lane and weight 1 in the high one */
+    const __m256i spread = _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1);
+    for (int b = 0; b < width; ++b) {
+        __m256i sum2 = _mm256_setzero_si256();
+        const lc_uint8_data_t* src = src_line + (weights->start * 4);
+        const lc_uint8_sum_t* wp = weights->weight;
+        int af = weights->start;
+        for (; (af + 1) < weights->end; af += 2) {
+            __m256i p = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)src));
+            __m256i w = _mm256_permutevar8x32_epi32(_mm256_castsi128_si256(_mm_loadl_epi64((const __m128i*)wp)), spread);
+            sum2 = _mm256_add_epi32(sum2, _mm256_mullo_epi32(p, w));
+            src += 8;
+            wp += 2;
+        }
+        __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(sum2), _mm256_extracti128_si256(sum2, 1));
+        sum = _mm_add_epi32(sum, _mm_set1_epi32(1 << 7));
+        if (af < weights->end) {
+            int pixel;
+            memcpy(&pixel, src, sizeof(pixel));
+            __m128i p = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(pixel));
+            sum = _mm_add_epi32(sum, _mm_mullo_epi32(p, _mm_set1_epi32((int)*wp)));
+        }
+        _mm_storeu_si128((__m128i*)line_buffer, _mm_srai_epi32(sum, 8));
+        line_buffer += 4;
+        weights++;
+    }
+}
+
+LC_TARGET_AVX2
+void lc_uint8_scanline_accumulate_avx2(lc_uint8_sum_t weight, lc_uint8_sum_t* line_buffer, 
+                                       int width, lc_uint8_sum_t* accum)
+{
+    const __m256i w = _mm256_set1_epi32((int)weight);
+    int x = 0;
+    for (; (x + 8) <= width; x += 8) {
+        __m256i line = _mm256_loadu_si256((const __m256i*)(line_buffer + x));
+        __m256i sum = _mm256_loadu_si256((const __m256i*)(accum + x));
+        _mm256_storeu_si256((__m256i*)(accum + x), _mm256_add_epi32(sum, _mm256_mullo_epi32(line, w)));
+    }
+    for (; x < width; ++x) {
+        accum[x] += line_buffer[x] * weight;
+    }
+}
+#endif
+
+typedef struct lc_uint8_kernels {
+    void (*filter_rgba_to_buffer)(const lc_uint8_weight_table* weights, const lc_uint8_data_t* src_line, lc_uint8_sum_t* line_buffer, int width);
+    void (*accumulate)(lc_uint8_sum_t weight, lc_uint8_sum_t* line_buffer, int width, lc_uint8_sum_t* accum);
+    void (*accum_to_rgba)(const lc_uint8_sum_t* accum, int width, lc_uint8_data_t* dst);
+} lc_uint8_kernels;
+
+lc_uint8_kernels lc_uint8_get_kernels(lc_simd simd)
+{
+    lc_uint8_kernels kernels;
+    kernels.filter_rgba_to_buffer = lc_uint8_scanline_filter_rgba_to_buffer;
+    kernels.accumulate            = lc_uint8_scanline_accumulate;
+    kernels.accum_to_rgba         = lc_uint8_scanline_accum_to_rgba;
+#if defined(LC_IMAGE_RESIZE_X86)
+    if (simd >= LC_SIMD_SSE41) {
+        kernels.filter_rgba_to_buffer = lc_uint8_scanline_filter_rgba_to_buffer_sse41;
+        kernels.accumulate            = lc_uint8_scanline_accumulate_sse41;
+        kernels.accum_to_rgba         = lc_uint8_scanline_accum_to_rgba_sse41;
+    }
+    if (simd >= LC_SIMD_AVX2) {
+        kernels.filter_rgba_to_buffer = lc_uint8_scanline_filter_rgba_to_buffer_avx2;
+        kernels.accumulate            = lc_uint8_scanline_accumulate_avx2;
+    }
+#endif
+    return kernels;
+}
+
 void lc_uint8_make_weight_table(int b, float cen, 
                                 lc_filter_fn filter, const lc_filter_args* p_filter_args, 
                                 const lc_filter_params *params, 
@@ -488,66 +920,115 @@ void lc_uint8_make_weight_table(int b, float cen,
     }   
 }
 
-void lc_image_resize_uint8(int src_width, int src_height, int src_row_stride, const unsigned char* p_src_data,
-                           int dst_width, int dst_height, int dst_row_stride, unsigned char* p_dst_data,
-                           unsigned int channel_count, lc_filter filter, const lc_filter_args* p_filter_args)
+/* Everything the bands share, built once before any of them run */
+typedef struct lc_uint8_resize_context {
+    const lc_uint8_data_t*  p_src_data;
+    int                     src_row_stride;
+    int                     src_offset_x;
+    int                     src_offset_y;
+    lc_uint8_data_t*        p_dst_data;
+    int                     dst_width;
+    int                     dst_height;
+    int                     dst_row_stride;
+    int                     dst_offset_x;
+    int                     dst_offset_y;
+    unsigned int            channel_count;
+    int                     pixel_stride;
+    bool                    rgba;
+    int                     line_width;
+    int                     line_count;     /* filter_params_y.width, lines in each band's ring */
+    lc_uint8_kernels        kernels;
+    lc_uint8_weight_table*  x_weights;      /* one per dst column */
+    lc_uint8_weight_table*  y_weights;      /* one per dst row */
+    unsigned int            band_count;
+} lc_uint8_resize_context;
+
+/* Resizes the dst rows of one band, with its own line buffers so bands can run concurrently */
+void lc_uint8_resize_band(unsigned int band, void* p_task_data)
 {
-    LC_DECLARE_ZERO(lc_filter_args, filter_args);
-    lc_filter_fn filter_fn = NULL;
-    switch (filter) {
-        case LC_FILTER_BOX: {
-            filter_fn = lc_filter_box;
-            if (NULL == p_filter_args) {lc_filter_box_init(&filter_args);}
-        }
-        break;
-        case LC_FILTER_TRIANGLE: {
-            filter_fn = lc_filter_triangle;
-            if (NULL == p_filter_args) {lc_filter_triangle_init(&filter_args);}
-        }
-        break;
-        case LC_FILTER_QUADRATIC: {
-            filter_fn = lc_filter_quadratic;
-            if (NULL == p_filter_args) {lc_filter_quadratic_init(&filter_args);}
-        }
-        break;
-        case LC_FILTER_CUBIC: {
-            filter_fn = lc_filter_cubic;
-            if (NULL == p_filter_args) {lc_filter_cubic_init(&filter_args);}
-        }
-        break;
-        case LC_FILTER_CATMUL_ROM: {
-            filter_fn = lc_filter_catmull_rom;
-            if (NULL == p_filter_args) {lc_filter_catmull_rom_init(&filter_args);}
-        }
-        break;
-        case LC_FILTER_MITCHELL: {
-            filter_fn = lc_filter_mitchell;
-            if (NULL == p_filter_args) {lc_filter_mitchell_init(&filter_args);}
-        }
-        break;
-        case LC_FILTER_SINC_BLACKMAN: {
-            filter_fn = lc_filter_sinc_blackman;
-            if (NULL == p_filter_args) {lc_filter_sinc_blackman_init(&filter_args);}
-        }
-        break;
-        case LC_FILTER_GAUSSIAN: {
-            filter_fn = lc_filter_gassian;
-            if (NULL == p_filter_args) {lc_filter_gassian_init(&filter_args);}
+    const lc_uint8_resize_context* ctx = (const lc_uint8_resize_context*)p_task_data;
+    const int dst_y_begin = (int)(((long long)ctx->dst_height * band) / ctx->band_count);
+    const int dst_y_end   = (int)(((long long)ctx->dst_height * (band + 1)) / ctx->band_count);
+    if (dst_y_begin >= dst_y_end) {
+        return;
+    }
+
+    lc_uint8_line_buffer* lines_buffer = (lc_uint8_line_buffer*)calloc(ctx->line_count, sizeof(*lines_buffer));
+    assert(NULL != lines_buffer);
+
+    for(int i = 0; i < ctx->line_count; i++) {
+        lines_buffer[i].first  = -1;
+        lines_buffer[i].second = (lc_uint8_sum_t*)calloc(ctx->line_width, sizeof(*lines_buffer[i].second));
+        assert(NULL != lines_buffer[i].second);
+    }
+
+    lc_uint8_sum_t* accum = (lc_uint8_sum_t*)calloc(ctx->line_width, sizeof(*accum));
+    assert(NULL != accum);
+
+    if (ctx->rgba) {
+        /* all four channels at once, so each source row is read and filtered once */
+        for (int dst_y = dst_y_begin; dst_y < dst_y_end; ++dst_y) {
+            const lc_uint8_weight_table* y_weights = &ctx->y_weights[dst_y];
+            memset(accum, 0, sizeof(*accum) * ctx->line_width);
+            for (int ayf = y_weights->start; ayf < y_weights->end; ++ayf) {
+                lc_uint8_sum_t* line = lines_buffer[ayf % ctx->line_count].second;
+                if (lines_buffer[ayf % ctx->line_count].first != ayf) {
+                    ctx->kernels.filter_rgba_to_buffer(ctx->x_weights, ctx->p_src_data + ((ctx->src_offset_y + ayf) * ctx->src_row_stride) + (ctx->src_offset_x * ctx->pixel_stride), line, ctx->dst_width);
+                    lines_buffer[ayf % ctx->line_count].first = ayf;
+                }
+                ctx->kernels.accumulate(y_weights->weight[ayf - y_weights->start], line, ctx->line_width, accum);
+            }
+            ctx->kernels.accum_to_rgba(accum, ctx->dst_width, ctx->p_dst_data + ((ctx->dst_offset_y + dst_y) * ctx->dst_row_stride) + (ctx->dst_offset_x * ctx->pixel_stride));
         }
-        break;
-        case LC_FILTER_BESSEL_BLACKMAN: {
-            filter_fn = lc_filter_bessel_blackman;
-            if (NULL == p_filter_args) {lc_filter_bessel_blackman_init(&filter_args);}
+    }
+    else {
+        for (unsigned int channel = 0; channel < ctx->channel_count; ++channel) {
+            /* buffered lines belong to the previous channel */
+            for(int i = 0; i < ctx->line_count; i++) {
+                lines_buffer[i].first = -1;
+            }
+            /* loop over dest scanlines */
+            for (int dst_y = dst_y_begin; dst_y < dst_y_end; ++dst_y) {
+                const lc_uint8_weight_table* y_weights = &ctx->y_weights[dst_y];
+                memset(accum, 0, sizeof(*accum) * ctx->dst_width);
+                /* loop over source scanlines that influence this dest scanline */
+                for (int ayf = y_weights->start; ayf < y_weights->end; ++ayf) {
+                    lc_uint8_sum_t* line = lines_buffer[ayf % ctx->line_count].second;
+                    if (lines_buffer[ayf % ctx->line_count].first != ayf) {
+                        lc_uint8_scanline_filter_channel_to_buffer(ctx->x_weights, ctx->src_offset_x, ctx->src_offset_y + ayf, ctx->pixel_stride, ctx->src_row_stride, channel, ctx->p_src_data, line, ctx->dst_width);
+                        lines_buffer[ayf % ctx->line_count].first = ayf;
+                    }
+                    ctx->kernels.accumulate(y_weights->weight[ayf - y_weights->start], line, ctx->dst_width, accum);
+                }
+                lc_uint8_scanline_shift_accum_to_channel(accum, ctx->dst_offset_x, ctx->dst_offset_y + dst_y, ctx->dst_width, ctx->pixel_stride, ctx->dst_row_stride, channel, ctx->p_dst_data);
+            }
         }
-        break;
-
-        default: break;
     }
-    assert(NULL != filter);
 
-    if (NULL != p_filter_args) {
-        memcpy(&filter_args, p_filter_args, sizeof(*p_filter_args));
+    LC_SAFE_FREE(accum);
+    for(int i = 0; i < ctx->line_count; i++) {
+        LC_SAFE_FREE(lines_buffer[i].second);
     }
+    LC_SAFE_FREE(lines_buffer);
+}
+
+void lc_image_resize_uint8(int src_width, int src_height, int src_row_stride, const unsigned char* p_src_data,
+                           int dst_width, int dst_height, int dst_row_stride, unsigned char* p_dst_data,
+                           unsigned int channel_count, lc_filter filter, const lc_filter_args* p_filter_args)
+{
+    lc_image_resize_uint8_threaded(src_width, src_height, src_row_stride, p_src_data,
+                                   dst_width, dst_height, dst_row_stride, p_dst_data,
+                                   channel_count, filter, p_filter_args,
+                                   1, NULL, NULL);
+}
+
+void lc_image_resize_uint8_threaded(int src_width, int src_height, int src_row_stride, const unsigned char* p_src_data,
+                                    int dst_width, int dst_height, int dst_row_stride, unsigned char* p_dst_data,
+                                    unsigned int channel_count, lc_filter filter, const lc_filter_args* p_filter_args,
+                                    unsigned int band_count, lc_dispatch_fn dispatch, void* p_dispatch_data)
+{
+    LC_DECLARE_ZERO(lc_filter_args, filter_args);
+    lc_filter_fn filter_fn = lc_get_filter(filter, p_filter_args, &filter_args);
 
     int src_offset_x = 0;
     int src_offset_y = 0;
@@ -582,62 +1063,67 @@ void lc_image_resize_uint8(int src_width, int src_height, int src_row_stride, co
     filter_params_y.support = LC_MATH_MAX(0.5f, filter_params_y.scale * filter_args.support);
     filter_params_y.width   = (int)ceil(2.0f * filter_params_y.support);
 
-    lc_uint8_line_buffer* lines_buffer = (lc_uint8_line_buffer*)calloc(filter_params_y.width, sizeof(*lines_buffer));
-    assert(NULL != lines_buffer);
-
-    for(int i = 0; i < filter_params_y.width; i++) {
-        lines_buffer[i].first  = -1;
-        lines_buffer[i].second = (lc_uint8_sum_t*)calloc(dst_width, sizeof(lines_buffer[i].second));
-        assert(NULL != lines_buffer[i].second);
-    }
-
     lc_uint8_weight_table* x_weights = (lc_uint8_weight_table*)calloc(dst_width, sizeof(*x_weights));
     assert(NULL != x_weights);
 
     lc_uint8_sum_t* x_weight_buffer = (lc_uint8_sum_t*)calloc(dst_width * filter_params_x.width, sizeof(*x_weight_buffer));
     assert(NULL != x_weight_buffer);
 
-    LC_DECLARE_ZERO(lc_uint8_weight_table, y_weights);
-    y_weights.weight = (lc_uint8_sum_t*)calloc(filter_params_y.width, sizeof(*y_weights.weight));
-    assert(NULL != y_weights.weight);
-
-    lc_uint8_sum_t* accum = (lc_uint8_sum_t*)calloc(dst_width, sizeof(*accum));
-    assert(NULL != accum);
-
     lc_uint8_sum_t* xWeightPtr = x_weight_buffer;
     for (int bx = 0; bx < dst_width; ++bx, xWeightPtr += filter_params_x.width) {
         x_weights[bx].weight = xWeightPtr;
         lc_uint8_make_weight_table(bx, LC_MAP(bx, m.sx, m.ux), filter_fn, &filter_args, &filter_params_x, src_width, true, &x_weights[bx]);
     }
 
-    int pixel_stride = channel_count * sizeof(lc_uint8_data_t);
-    for (unsigned int channel = 0; channel < channel_count; ++channel) {
-        /* loop over dest scanlines */
-        for (int dst_y = 0; dst_y < dst_height; ++dst_y) {
-            /* prepare a weight table for dest y position by */
-            lc_uint8_make_weight_table(dst_y, LC_MAP(dst_y, m.sy, m.uy), filter_fn, &filter_args, &filter_params_y, src_height, false, &y_weights);
-            memset(accum, 0, sizeof(*accum) * dst_width);
-            /* loop over source scanlines that influence this dest scanline */
-            for (int ayf = y_weights.start; ayf < y_weights.end; ++ayf) {
-                lc_uint8_sum_t* line = lines_buffer[ayf % filter_params_y.width].second;
-                if (lines_buffer[ayf % filter_params_y.width].first != ayf) {
-                    lc_uint8_scanline_filter_channel_to_buffer(x_weights, src_offset_x, src_offset_y + ayf, pixel_stride, src_row_stride, channel, p_src_data, line, dst_width);
-                    lines_buffer[ayf % filter_params_y.width].first = ayf;
-                }
-                lc_uint8_scanline_accumulate(y_weights.weight[ayf - y_weights.start], line, dst_width, accum);
-            }
-            lc_uint8_scanline_shift_accum_to_channel(accum, (int)clipped_dst_area.x1, (int)(clipped_dst_area.y1 + dst_y), dst_width, pixel_stride, dst_row_stride, channel, p_dst_data);
+    /* every dst row's table up front, so bands don't rebuild them */
+    lc_uint8_weight_table* y_weights = (lc_uint8_weight_table*)calloc(dst_height, sizeof(*y_weights));
+    assert(NULL != y_weights);
+
+    lc_uint8_sum_t* y_weight_buffer = (lc_uint8_sum_t*)calloc(dst_height * filter_params_y.width, sizeof(*y_weight_buffer));
+    assert(NULL != y_weight_buffer);
+
+    lc_uint8_sum_t* yWeightPtr = y_weight_buffer;
+    for (int by = 0; by < dst_height; ++by, yWeightPtr += filter_params_y.width) {
+        y_weights[by].weight = yWeightPtr;
+        lc_uint8_make_weight_table(by, LC_MAP(by, m.sy, m.uy), filter_fn, &filter_args, &filter_params_y, src_height, false, &y_weights[by]);
+    }
+
+    /* RGBA lines hold all four channels, other channel counts are filtered one at a time */
+    LC_DECLARE_ZERO(lc_uint8_resize_context, ctx);
+    ctx.p_src_data      = p_src_data;
+    ctx.src_row_stride  = src_row_stride;
+    ctx.src_offset_x    = src_offset_x;
+    ctx.src_offset_y    = src_offset_y;
+    ctx.p_dst_data      = p_dst_data;
+    ctx.dst_width       = dst_width;
+    ctx.dst_height      = dst_height;
+    ctx.dst_row_stride  = dst_row_stride;
+    ctx.dst_offset_x    = (int)clipped_dst_area.x1;
+    ctx.dst_offset_y    = (int)clipped_dst_area.y1;
+    ctx.channel_count   = channel_count;
+    ctx.pixel_stride    = channel_count * sizeof(lc_uint8_data_t);
+    ctx.rgba            = (4 == channel_count);
+    ctx.line_width      = ctx.rgba ? (4 * dst_width) : dst_width;
+    ctx.line_count      = filter_params_y.width;
+    ctx.kernels         = lc_uint8_get_kernels(lc_image_resize_get_simd());
+    ctx.x_weights       = x_weights;
+    ctx.y_weights       = y_weights;
+    /* more bands than rows would leave some with nothing to do */
+    ctx.band_count      = LC_MATH_MIN(LC_MATH_MAX(band_count, 1u), (unsigned int)dst_height);
+
+    if (NULL != dispatch) {
+        dispatch(lc_uint8_resize_band, &ctx, ctx.band_count, p_dispatch_data);
+    }
+    else {
+        for (unsigned int band = 0; band < ctx.band_count; ++band) {
+            lc_uint8_resize_band(band, &ctx);
         }
     }
 
-    LC_SAFE_FREE(accum);
-    LC_SAFE_FREE(y_weights.weight );
+    LC_SAFE_FREE(y_weight_buffer);
+    LC_SAFE_FREE(y_weights);
     LC_SAFE_FREE(x_weight_buffer);
     LC_SAFE_FREE(x_weights);
-    for(int i = 0; i < filter_params_y.width; i++) {
-        LC_SAFE_FREE(lines_buffer[i].second);
-    }
-    LC_SAFE_FREE(lines_buffer);
 }
 
 /**************************************************************************************************/
@@ -689,6 +1175,111 @@ void lc_float_scanline_filter_channel_to_buffer(lc_float_weight_table* weights,
     }   
 }
 
+/* 
+ RGBA kernels: the taps are still summed in order for each channel, which keeps the float
+ results identical to the per channel code. The horizontal pass stays at 4 wide for that
+ reason, AVX2 only widens the vertical one.
+*/
+void lc_float_scanline_filter_rgba_to_buffer(const lc_float_weight_table* weights, 
+                                             const lc_float_data_t* src_line, 
+                                             lc_float_sum_t* line_buffer, int width)
+{
+    for (int b = 0; b < width; ++b) {
+        lc_float_sum_t sum0 = 0.0f;
+        lc_float_sum_t sum1 = 0.0f;
+        lc_float_sum_t sum2 = 0.0f;
+        lc_float_sum_t sum3 = 0.0f;
+        const lc_float_data_t* src = src_line + (weights->start * 4);
+        const lc_float_sum_t* wp = weights->weight;
+        for (int af = weights->start; af < weights->end; ++af) {
+            lc_float_sum_t w = *wp++;
+            sum0 += w * src[0];
+            sum1 += w * src[1];
+            sum2 += w * src[2];
+            sum3 += w * src[3];
+            src += 4;
+        }
+        *line_buffer++ = lc_float_channel_to_buffer(sum0);
+        *line_buffer++ = lc_float_channel_to_buffer(sum1);
+        *line_buffer++ = lc_float_channel_to_buffer(sum2);
+        *line_buffer++ = lc_float_channel_to_buffer(sum3);
+        weights++;
+    }
+}
+
+#if defined(LC_IMAGE_RESIZE_X86)
+LC_TARGET_SSE41
+void lc_float_scanline_filter_rgba_to_buffer_sse41(const lc_float_weight_table* weights, 
+                                                   const lc_float_data_t* src_line, 
+                                                   lc_float_sum_t* line_buffer, int width)
+{
+    for (int b = 0; b < width; ++b) {
+        __m128 sum = _mm_setzero_ps();
+        const lc_float_data_t* src = src_line + (weights->start * 4);
+        const lc_float_sum_t* wp = weights->weight;
+        for (int af = weights->start; af < weights->end; ++af) {
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(*wp++), _mm_loadu_ps(src)));
+            src += 4;
+        }
+        _mm_storeu_ps(line_buffer, sum);
+        line_buffer += 4;
+        weights++;
+    }
+}
+
+LC_TARGET_SSE41
+void lc_float_scanline_accumulate_sse41(lc_float_sum_t weight, lc_float_sum_t* line_buffer, 
+                                        int width, lc_float_sum_t* accum)
+{
+    const __m128 w = _mm_set1_ps(weight);
+    int x = 0;
+    for (; (x + 4) <= width; x += 4) {
+        __m128 sum = _mm_add_ps(_mm_loadu_ps(accum + x), _mm_mul_ps(_mm_loadu_ps(line_buffer + x), w));
+        _mm_storeu_ps(accum + x, sum);
+    }
+    for (; x < width; ++x) {
+        accum[x] += line_buffer[x] * weight;
+    }
+}
+
+LC_TARGET_AVX2
+void lc_float_scanline_accumulate_avx2(lc_float_sum_t weight, lc_float_sum_t* line_buffer, 
+                                       int width, lc_float_sum_t* accum)
+{
+    const __m256 w = _mm256_set1_ps(weight);
+    int x = 0;
+    for (; (x + 8) <= width; x += 8) {
+        __m256 sum = _mm256_add_ps(_mm256_loadu_ps(accum + x), _mm256_mul_ps(_mm256_loadu_ps(line_buffer + x), w));
+        _mm256_storeu_ps(accum + x, sum);
+    }
+    for (; x < width; ++x) {
+        accum[x] += line_buffer[x] * weight;
+    }
+}
+#endif
+
+typedef struct lc_float_kernels {
+    void (*filter_rgba_to_buffer)(const lc_float_weight_table* weights, const lc_float_data_t* src_line, lc_float_sum_t* line_buffer, int width);
+    void (*accumulate)(lc_float_sum_t weight, lc_float_sum_t* line_buffer, int width, lc_float_sum_t* accum);
+} lc_float_kernels;
+
+lc_float_kernels lc_float_get_kernels(lc_simd simd)
+{
+    lc_float_kernels kernels;
+    kernels.filter_rgba_to_buffer = lc_float_scanline_filter_rgba_to_buffer;
+    kernels.accumulate            = lc_float_scanline_accumulate;
+#if defined(LC_IMAGE_RESIZE_X86)
+    if (simd >= LC_SIMD_SSE41) {
+        kernels.filter_rgba_to_buffer = lc_float_scanline_filter_rgba_to_buffer_sse41;
+        kernels.accumulate            = lc_float_scanline_accumulate_sse41;
+    }
+    if (simd >= LC_SIMD_AVX2) {
+        kernels.accumulate            = lc_float_scanline_accumulate_avx2;
+    }
+#endif
+    return kernels;
+}
+
 void lc_float_make_weight_table(int b, float cen, 
                                 lc_filter_fn filter, const lc_filter_args* p_filter_args, 
                                 const lc_filter_params *params, 
@@ -784,61 +1375,7 @@ void lc_image_resize_float(int src_width, int src_height, int src_row_stride, co
                            unsigned int channel_count, lc_filter filter, const lc_filter_args* p_filter_args)
 {
     LC_DECLARE_ZERO(lc_filter_args, filter_args);
-    lc_filter_fn filter_fn = NULL;
-    switch (filter) {
-        case LC_FILTER_BOX: {
-            filter_fn = lc_filter_box;
-            if (NULL == p_filter_args) {lc_filter_box_init(&filter_args);}
-        }
-        break;
-        case LC_FILTER_TRIANGLE: {
-            filter_fn = lc_filter_triangle;
-            if (NULL == p_filter_args) {lc_filter_triangle_init(&filter_args);}
-        }
-        break;
-        case LC_FILTER_QUADRATIC: {
-            filter_fn = lc_filter_quadratic;
-            if (NULL == p_filter_args) {lc_filter_quadratic_init(&filter_args);}
-        }
-        break;
-        case LC_FILTER_CUBIC: {
-            filter_fn = lc_filter_cubic;
-            if (NULL == p_filter_args) {lc_filter_cubic_init(&filter_args);}
-        }
-        break;
-        case LC_FILTER_CATMUL_ROM: {
-            filter_fn = lc_filter_catmull_rom;
-            if (NULL == p_filter_args) {lc_filter_catmull_rom_init(&filter_args);}
-        }
-        break;
-        case LC_FILTER_MITCHELL: {
-            filter_fn = lc_filter_mitchell;
-            if (NULL == p_filter_args) {lc_filter_mitchell_init(&filter_args);}
-        }
-        break;
-        case LC_FILTER_SINC_BLACKMAN: {
-            filter_fn = lc_filter_sinc_blackman;
-            if (NULL == p_filter_args) {lc_filter_sinc_blackman_init(&filter_args);}
-        }
-        break;
-        case LC_FILTER_GAUSSIAN: {
-            filter_fn = lc_filter_gassian;
-            if (NULL == p_filter_args) {lc_filter_gassian_init(&filter_args);}
-        }
-        break;
-        case LC_FILTER_BESSEL_BLACKMAN: {
-            filter_fn = lc_filter_bessel_blackman;
-            if (NULL == p_filter_args) {lc_filter_bessel_blackman_init(&filter_args);}
-        }
-        break;
-
-        default: break;
-    }
-    assert(NULL != filter);
-
-    if (NULL != p_filter_args) {
-        memcpy(&filter_args, p_filter_args, sizeof(*p_filter_args));
-    }
+    lc_filter_fn filter_fn = lc_get_filter(filter, p_filter_args, &filter_args);
 
     int src_offset_x = 0;
     int src_offset_y = 0;
@@ -876,9 +1413,14 @@ void lc_image_resize_float(int src_width, int src_height, int src_row_stride, co
     lc_float_line_buffer* lines_buffer = (lc_float_line_buffer*)calloc(filter_params_y.width, sizeof(*lines_buffer));
     assert(NULL != lines_buffer);
 
+    /* RGBA lines hold all four channels, other channel counts are filtered one at a time */
+    const bool rgba = (4 == channel_count);
+    const int line_width = rgba ? (4 * dst_width) : dst_width;
+    const lc_float_kernels kernels = lc_float_get_kernels(lc_image_resize_get_simd());
+
     for(int i = 0; i < filter_params_y.width; i++) {
         lines_buffer[i].first  = -1;
-        lines_buffer[i].second = (lc_float_sum_t*)calloc(dst_width, sizeof(lines_buffer[i].second));
+        lines_buffer[i].second = (lc_float_sum_t*)calloc(line_width, sizeof(*lines_buffer[i].second));
         assert(NULL != lines_buffer[i].second);
     }
 
@@ -892,7 +1434,7 @@ void lc_image_resize_float(int src_width, int src_height, int src_row_stride, co
     y_weights.weight = (lc_float_sum_t*)calloc(filter_params_y.width, sizeof(*y_weights.weight));
     assert(NULL != y_weights.weight);
 
-    lc_float_sum_t* accum = (lc_float_sum_t*)calloc(dst_width, sizeof(*accum));
+    lc_float_sum_t* accum = (lc_float_sum_t*)calloc(line_width, sizeof(*accum));
     assert(NULL != accum);
 
     lc_float_sum_t* xWeightPtr = x_weight_buffer;
@@ -902,22 +1444,44 @@ void lc_image_resize_float(int src_width, int src_height, int src_row_stride, co
     }
 
     int pixel_stride = channel_count * sizeof(lc_float_data_t);
-    for (unsigned int channel = 0; channel < channel_count; ++channel) {
-        /* loop over dest scanlines */
+    if (rgba) {
+        /* all four channels at once, so each source row is read and filtered once */
         for (int dst_y = 0; dst_y < dst_height; ++dst_y) {
-            /* prepare a weight table for dest y position by */
             lc_float_make_weight_table(dst_y, LC_MAP(dst_y, m.sy, m.uy), filter_fn, &filter_args, &filter_params_y, src_height, false, &y_weights);
-            memset(accum, 0, sizeof(*accum) * dst_width);
-            /* loop over source scanlines that influence this dest scanline */
+            memset(accum, 0, sizeof(*accum) * line_width);
             for (int ayf = y_weights.start; ayf < y_weights.end; ++ayf) {
                 lc_float_sum_t* line = lines_buffer[ayf % filter_params_y.width].second;
                 if (lines_buffer[ayf % filter_params_y.width].first != ayf) {
-                    lc_float_scanline_filter_channel_to_buffer(x_weights, src_offset_x, src_offset_y + ayf, pixel_stride, src_row_stride, channel, p_src_data, line, dst_width);
+                    kernels.filter_rgba_to_buffer(x_weights, (const lc_float_data_t*)((const unsigned char*)p_src_data + ((src_offset_y + ayf) * src_row_stride) + (src_offset_x * pixel_stride)), line, dst_width);
                     lines_buffer[ayf % filter_params_y.width].first = ayf;
                 }
-                lc_float_scanline_accumulate(y_weights.weight[ayf - y_weights.start], line, dst_width, accum);
+                kernels.accumulate(y_weights.weight[ayf - y_weights.start], line, line_width, accum);
+            }
+            memcpy((unsigned char*)p_dst_data + ((int)(clipped_dst_area.y1 + dst_y) * dst_row_stride) + ((int)clipped_dst_area.x1 * pixel_stride), accum, line_width * sizeof(*accum));
+        }
+    }
+    else {
+        for (unsigned int channel = 0; channel < channel_count; ++channel) {
+            /* buffered lines belong to the previous channel */
+            for(int i = 0; i < filter_params_y.width; i++) {
+                lines_buffer[i].first = -1;
+            }
+            /* loop over dest scanlines */
+            for (int dst_y = 0; dst_y < dst_height; ++dst_y) {
+                /* prepare a weight table for dest y position by */
+                lc_float_make_weight_table(dst_y, LC_MAP(dst_y, m.sy, m.uy), filter_fn, &filter_args, &filter_params_y, src_height, false, &y_weights);
+                memset(accum, 0, sizeof(*accum) * dst_width);
+                /* loop over source scanlines that influence this dest scanline */
+                for (int ayf = y_weights.start; ayf < y_weights.end; ++ayf) {
+                    lc_float_sum_t* line = lines_buffer[ayf % filter_params_y.width].second;
+                    if (lines_buffer[ayf % filter_params_y.width].first != ayf) {
+                        lc_float_scanline_filter_channel_to_buffer(x_weights, src_offset_x, src_offset_y + ayf, pixel_stride, src_row_stride, channel, p_src_data, line, dst_width);
+                        lines_buffer[ayf % filter_params_y.width].first = ayf;
+                    }
+                    kernels.accumulate(y_weights.weight[ayf - y_weights.start], line, dst_width, accum);
+                }
+                lc_float_scanline_shift_accum_to_channel(accum, (int)clipped_dst_area.x1, (int)(clipped_dst_area.y1 + dst_y), dst_width, pixel_stride, dst_row_stride, channel, p_dst_data);
             }
-            lc_float_scanline_shift_accum_to_channel(accum, (int)clipped_dst_area.x1, (int)(clipped_dst_area.y1 + dst_y), dst_width, pixel_stride, dst_row_stride, channel, p_dst_data);
         }
     }
 
@@ -931,4 +1495,146 @@ void lc_image_resize_float(int src_width, int src_height, int src_row_stride, co
     LC_SAFE_FREE(lines_buffer);
 }
 
+/**************************************************************************************************/
+/* Mip chains                                                                                     */
+/**************************************************************************************************/
+size_t lc_image_mip_layout(int width, int height, unsigned int pixel_size, unsigned int alignment,
+                           unsigned int level_count, lc_mip_level* p_levels)
+{
+    assert((width > 0) && (height > 0) && (alignment > 0));
+
+    size_t offset = 0;
+    for (unsigned int level = 0; level < level_count; ++level) {
+        offset = ((offset + alignment - 1) / alignment) * alignment;
+        p_levels[level].width      = width;
+        p_levels[level].height     = height;
+        p_levels[level].row_stride = width * pixel_size;
+        p_levels[level].offset     = offset;
+        offset += (size_t)p_levels[level].row_stride * height;
+        width  = LC_MATH_MAX(width >> 1, 1);
+        height = LC_MATH_MAX(height >> 1, 1);
+    }
+    return offset;
+}
+
+void lc_uint8_copy_rows(int width, int height, int pixel_stride,
+                        int src_row_stride, const lc_uint8_data_t* p_src_data,
+                        int dst_row_stride, lc_uint8_data_t* p_dst_data)
+{
+    for (int y = 0; y < height; ++y) {
+        memcpy(p_dst_data + (y * dst_row_stride), p_src_data + (y * src_row_stride), width * pixel_stride);
+    }
+}
+
+/* 
+ 2x2 average, the same as the box resize at exactly half size: both passes weigh each 
+ sample by half a WEIGHTONE and the rounding works out to (a + b + c + d + 2) / 4
+*/
+void lc_uint8_box_halve(int dst_width, int dst_height, unsigned int channel_count,
+                        int src_row_stride, const lc_uint8_data_t* p_src_data,
+                        int dst_row_stride, lc_uint8_data_t* p_dst_data)
+{
+    for (int y = 0; y < dst_height; ++y) {
+        const lc_uint8_data_t* src0 = p_src_data + (2 * y * src_row_stride);
+        const lc_uint8_data_t* src1 = src0 + src_row_stride;
+        lc_uint8_data_t* dst = p_dst_data + (y * dst_row_stride);
+        for (int x = 0; x < dst_width; ++x) {
+            for (unsigned int c = 0; c < channel_count; ++c) {
+                unsigned int sum = src0[c] + src0[channel_count + c] + src1[c] + src1[channel_count + c];
+                dst[c] = (lc_uint8_data_t)((sum + 2) >> 2);
+            }
+            src0 += 2 * channel_count;
+            src1 += 2 * channel_count;
+            dst += channel_count;
+        }
+    }
+}
+
+void lc_image_generate_mips_uint8(int src_width, int src_height, int src_row_stride, const unsigned char* p_src_data,
+                                  unsigned int level_count, const lc_mip_level* p_levels, unsigned char* p_dst_data,
+                                  unsigned int channel_count, lc_filter filter, const lc_filter_args* p_filter_args)
+{
+    int pixel_stride = channel_count * sizeof(lc_uint8_data_t);
+    for (unsigned int level = 0; level < level_count; ++level) {
+        const lc_mip_level* p_level = &p_levels[level];
+        lc_uint8_data_t* p_level_data = p_dst_data + p_level->offset;
+        if ((p_level->width == src_width) && (p_level->height == src_height)) {
+            lc_uint8_copy_rows(src_width, src_height, pixel_stride, src_row_stride, p_src_data, p_level->row_stride, p_level_data);
+        }
+        else if ((LC_FILTER_BOX == filter) && (NULL == p_filter_args) && ((2 * p_level->width) == src_width) && ((2 * p_level->height) == src_height)) {
+            lc_uint8_box_halve(p_level->width, p_level->height, channel_count, src_row_stride, p_src_data, p_level->row_stride, p_level_data);
+        }
+        else {
+            lc_image_resize_uint8(src_width, src_height, src_row_stride, p_src_data,
+                                  p_level->width, p_level->height, p_level->row_stride, p_level_data,
+                                  channel_count, filter, p_filter_args);
+        }
+
+        /* the next level is filtered from this one */
+        src_width      = p_level->width;
+        src_height     = p_level->height;
+        src_row_stride = p_level->row_stride;
+        p_src_data     = p_level_data;
+    }
+}
+
+void lc_float_copy_rows(int width, int height, int pixel_stride,
+                        int src_row_stride, const lc_float_data_t* p_src_data,
+                        int dst_row_stride, lc_float_data_t* p_dst_data)
+{
+    const unsigned char* src = (const unsigned char*)p_src_data;
+    unsigned char* dst = (unsigned char*)p_dst_data;
+    for (int y = 0; y < height; ++y) {
+        memcpy(dst + (y * dst_row_stride), src + (y * src_row_stride), width * pixel_stride);
+    }
+}
+
+/* 2x2 average, the weights are all powers of two so this rounds the same as the box resize */
+void lc_float_box_halve(int dst_width, int dst_height, unsigned int channel_count,
+                        int src_row_stride, const lc_float_data_t* p_src_data,
+                        int dst_row_stride, lc_float_data_t* p_dst_data)
+{
+    for (int y = 0; y < dst_height; ++y) {
+        const lc_float_data_t* src0 = (const lc_float_data_t*)((const unsigned char*)p_src_data + (2 * y * src_row_stride));
+        const lc_float_data_t* src1 = (const lc_float_data_t*)((const unsigned char*)src0 + src_row_stride);
+        lc_float_data_t* dst = (lc_float_data_t*)((unsigned char*)p_dst_data + (y * dst_row_stride));
+        for (int x = 0; x < dst_width; ++x) {
+            for (unsigned int c = 0; c < channel_count; ++c) {
+                dst[c] = ((src0[c] + src0[channel_count + c]) + (src1[c] + src1[channel_count + c])) * 0.25f;
+            }
+            src0 += 2 * channel_count;
+            src1 += 2 * channel_count;
+            dst += channel_count;
+        }
+    }
+}
+
+void lc_image_generate_mips_float(int src_width, int src_height, int src_row_stride, const float* p_src_data,
+                                  unsigned int level_count, const lc_mip_level* p_levels, float* p_dst_data,
+                                  unsigned int channel_count, lc_filter filter, const lc_filter_args* p_filter_args)
+{
+    int pixel_stride = channel_count * sizeof(lc_float_data_t);
+    for (unsigned int level = 0; level < level_count; ++level) {
+        const lc_mip_level* p_level = &p_levels[level];
+        lc_float_data_t* p_level_data = (lc_float_data_t*)((unsigned char*)p_dst_data + p_level->offset);
+        if ((p_level->width == src_width) && (p_level->height == src_height)) {
+            lc_float_copy_rows(src_width, src_height, pixel_stride, src_row_stride, p_src_data, p_level->row_stride, p_level_data);
+        }
+        else if ((LC_FILTER_BOX == filter) && (NULL == p_filter_args) && ((2 * p_level->width) == src_width) && ((2 * p_level->height) == src_height)) {
+            lc_float_box_halve(p_level->width, p_level->height, channel_count, src_row_stride, p_src_data, p_level->row_stride, p_level_data);
+        }
+        else {
+            lc_image_resize_float(src_width, src_height, src_row_stride, p_src_data,
+                                  p_level->width, p_level->height, p_level->row_stride, p_level_data,
+                                  channel_count, filter, p_filter_args);
+        }
+
+        /* the next level is filtered from this one */
+        src_width      = p_level->width;
+        src_height     = p_level->height;
+        src_row_stride = p_level->row_stride;
+        p_src_data     = p_level_data;
+    }
+}
+
 #endif /* defined(LC_IMAGE_RESIZE_IMPLEMENTATION) */
\ No newline at end of file
@@ -0,0 +1,149 @@
+#pragma once
+
+//
+// Setup shared by the Vulkan benchmarks - logging, asset loading, timing and the
+// renderer settings. Include it after tinyvk.h. The window helpers are only there
+// when GLFW's native header has been included first.
+//
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "tinyvk.h"
+
+const uint32_t      kImageCount = 3;
+#if defined(__linux__)
+const std::string   kAssetDir = "../samples/assets/";
+#elif defined(_WIN32)
+const std::string   kAssetDir = "../../samples/assets/";
+#endif
+
+tr_renderer*        m_renderer = nullptr;
+// Info and debug messages from the renderer are dropped unless this is set
+bool                m_verbose_log = true;
+
+#define LOG(STR)  { std::stringstream ss; ss << STR << std::endl; \
+                    platform_log(ss.str().c_str()); }
+
+// stderr, so stdout stays free for results
+static void platform_log(const char* s)
+{
+#if defined(_WIN32)
+  OutputDebugStringA(s);
+#else
+  fprintf(stderr, "%s", s);
+#endif
+}
+
+static void renderer_log(tr_log_type type, const char* msg, const char* component)
+{
+  switch(type) {
+    case tr_log_type_info  : if (m_verbose_log) {LOG("[INFO]" << "[" << component << "] : " << msg);} break;
+    case tr_log_type_warn  : {LOG("[WARN]"  << "[" << component << "] : " << msg);} break;
+    case tr_log_type_debug : if (m_verbose_log) {LOG("[DEBUG]" << "[" << component << "] : " << msg);} break;
+    case tr_log_type_error : {LOG("[ERROR]" << "[" << component << "] : " << msg);} break;
+    default: break;
+  }
+}
+
+static VKAPI_ATTR VkBool32 VKAPI_CALL vulkan_debug(
+    VkDebugReportFlagsEXT      flags,
+    VkDebugReportObjectTypeEXT objectType,
+    uint64_t                   object,
+    size_t                     location,
+    int32_t                    messageCode,
+    const char*                pLayerPrefix,
+    const char*                pMessage,
+    void*                      pUserData
+)
+{
+    if( flags & VK_DEBUG_REPORT_ERROR_BIT_EXT ) {
+        LOG("[ERROR]" << "[" << pLayerPrefix << "] : " << pMessage << " (" << messageCode << ")");
+    }
+    return VK_FALSE;
+}
+
+static std::vector<uint8_t> load_file(const std::string& path)
+{
+    std::ifstream is;
+    is.open(path.c_str(), std::ios::in | std::ios::binary);
+    assert(is.is_open());
+
+    is.seekg(0, std::ios::end);
+    std::vector<uint8_t> buffer(is.tellg());
+    assert(0 != buffer.size());
+
+    is.seekg(0, std::ios::beg);
+    is.read((char*)buffer.data(), buffer.size());
+
+    return buffer;
+}
+
+static double elapsed_ms(std::chrono::high_resolution_clock::time_point start)
+{
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+// Everything but the window handle or headless flag
+static tr_renderer_settings bench_renderer_settings(uint32_t width, uint32_t height)
+{
+    tr_renderer_settings settings = {0};
+    settings.width                          = width;
+    settings.height                         = height;
+    settings.swapchain.image_count          = kImageCount;
+    settings.swapchain.sample_count         = tr_sample_count_1;
+    settings.swapchain.color_format         = tr_format_b8g8r8a8_unorm;
+    settings.swapchain.depth_stencil_format = tr_format_undefined;
+    settings.log_fn                         = renderer_log;
+    settings.vk_debug_fn                    = vulkan_debug;
+    return settings;
+}
+
+#if defined(GLFW_EXPOSE_NATIVE_X11) || defined(GLFW_EXPOSE_NATIVE_WIN32)
+static void app_glfw_error(int error, const char* description)
+{
+  LOG("Error " << error << ":" << description);
+}
+
+// Hidden, the benchmarks only need it for the surface
+static GLFWwindow* create_bench_window(const char* title)
+{
+    glfwSetErrorCallback(app_glfw_error);
+    if (! glfwInit()) {
+        exit(EXIT_FAILURE);
+    }
+
+    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    return glfwCreateWindow(640, 480, title, NULL, NULL);
+}
+
+static void destroy_bench_window(GLFWwindow* window)
+{
+    glfwDestroyWindow(window);
+    glfwTerminate();
+}
+
+static void init_tiny_renderer(GLFWwindow* window, const char* app_name)
+{
+    int width = 0;
+    int height = 0;
+    glfwGetWindowSize(window, &width, &height);
+
+    tr_renderer_settings settings = bench_renderer_settings(static_cast<uint32_t>(width), static_cast<uint32_t>(height));
+#if defined(__linux__)
+    settings.handle.connection              = XGetXCBConnection(glfwGetX11Display());
+    settings.handle.window                  = glfwGetX11Window(window);
+#elif defined(_WIN32)
+    settings.handle.hinstance               = ::GetModuleHandle(NULL);
+    settings.handle.hwnd                    = glfwGetWin32Window(window);
+#endif
+    tr_create_renderer(app_name, &settings, &m_renderer);
+}
+#endif
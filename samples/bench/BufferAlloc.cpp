@@ -0,0 +1,75 @@
+#include "GLFW/glfw3.h"
+#if defined(__linux__)
+  #define GLFW_EXPOSE_NATIVE_X11
+#elif defined(_WIN32)
+  #define GLFW_EXPOSE_NATIVE_WIN32
+#endif
+#include "GLFW/glfw3native.h"
+#include <vector>
+
+#define TINY_RENDERER_IMPLEMENTATION
+#include "tinyvk.h"
+
+#include "BenchCommon.h"
+
+const uint32_t      kBufferCount = 100000;
+
+static void log_allocator(const char* label)
+{
+    LOG("  " << label << ": "
+        << m_renderer->memory_allocator->block_count << " blocks, "
+        << m_renderer->memory_allocator->allocation_count << " allocations");
+}
+
+void run_bench()
+{
+    std::vector<tr_buffer*> buffers(kBufferCount, nullptr);
+
+    // All buffers alive at once - this is what used to run into maxMemoryAllocationCount
+    LOG("Create " << kBufferCount << " buffers, then destroy them");
+    auto start = std::chrono::high_resolution_clock::now();
+    for (uint32_t i = 0; i < kBufferCount; ++i) {
+        if (i & 1) {
+            tr_create_uniform_buffer(m_renderer, 256, true, &buffers[i]);
+        }
+        else {
+            tr_create_vertex_buffer(m_renderer, 64 * (1 + (i % 16)), true, 16, &buffers[i]);
+        }
+    }
+    double create_ms = elapsed_ms(start);
+    log_allocator("after create");
+
+    start = std::chrono::high_resolution_clock::now();
+    for (uint32_t i = 0; i < kBufferCount; ++i) {
+        tr_destroy_buffer(m_renderer, buffers[i]);
+    }
+    double destroy_ms = elapsed_ms(start);
+    log_allocator("after destroy");
+    LOG("  create  : " << create_ms  << " ms (" << (1000.0 * create_ms  / kBufferCount) << " us/buffer)");
+    LOG("  destroy : " << destroy_ms << " ms (" << (1000.0 * destroy_ms / kBufferCount) << " us/buffer)");
+
+    // Create/destroy pairs, the per-frame transient buffer pattern
+    LOG("Create and immediately destroy " << kBufferCount << " buffers");
+    start = std::chrono::high_resolution_clock::now();
+    for (uint32_t i = 0; i < kBufferCount; ++i) {
+        tr_buffer* buffer = nullptr;
+        tr_create_uniform_buffer(m_renderer, 256, true, &buffer);
+        tr_destroy_buffer(m_renderer, buffer);
+    }
+    double pair_ms = elapsed_ms(start);
+    log_allocator("after pairs");
+    LOG("  create+destroy : " << pair_ms << " ms (" << (1000.0 * pair_ms / kBufferCount) << " us/buffer)");
+}
+
+int main(int argc, char **argv)
+{
+    GLFWwindow* window = create_bench_window("BufferAlloc");
+    init_tiny_renderer(window, "BufferAllocBench");
+
+    run_bench();
+
+    tr_destroy_renderer(m_renderer);
+
+    destroy_bench_window(window);
+    return EXIT_SUCCESS;
+}
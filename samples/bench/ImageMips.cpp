@@ -0,0 +1,138 @@
+#include <assert.h>
+#include <math.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#define LC_IMAGE_IMPLEMENTATION
+#include "lc_image.h"
+
+#define LC_IMAGE_RESIZE_IMPLEMENTATION
+#include "lc_image_resize.h"
+
+#if defined(__linux__)
+const std::string   kAssetDir = "../samples/assets/";
+#elif defined(_WIN32)
+const std::string   kAssetDir = "../../samples/assets/";
+#endif
+const int           kDefaultSize = 4096;
+const int           kDefaultIterations = 3;
+const unsigned int  kChannelCount = 4;
+const unsigned int  kAlignment = 16;
+
+// No window here, so the output goes to the console on every platform
+#define LOG(STR)  { std::stringstream ss; ss << STR << std::endl; \
+                    printf("%s", ss.str().c_str()); }
+
+static unsigned int calc_mip_levels(int width, int height)
+{
+    unsigned int levels = 1;
+    while ((width > 1) || (height > 1)) {
+        width  = (width  > 1) ? (width  >> 1) : 1;
+        height = (height > 1) ? (height >> 1) : 1;
+        ++levels;
+    }
+    return levels;
+}
+
+// What tr_util_update_texture_uint8 does with a resize function: every level from the source
+template <typename T, typename ResizeFn>
+static void per_level(int size, const T* p_src, const std::vector<lc_mip_level>& levels, unsigned char* p_dst, lc_filter filter, ResizeFn resize_fn)
+{
+    for (size_t i = 0; i < levels.size(); ++i) {
+        const lc_mip_level& level = levels[i];
+        resize_fn(size, size, size * kChannelCount * sizeof(T), p_src,
+                  level.width, level.height, level.row_stride, (T*)(p_dst + level.offset),
+                  kChannelCount, filter, NULL);
+    }
+}
+
+template <typename Fn>
+static double time_ms(int iterations, Fn fn)
+{
+    double best_ms = 0;
+    for (int i = 0; i < iterations; ++i) {
+        auto start = std::chrono::high_resolution_clock::now();
+        fn();
+        auto end = std::chrono::high_resolution_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(end - start).count();
+        best_ms = ((0 == i) || (ms < best_ms)) ? ms : best_ms;
+    }
+    return best_ms;
+}
+
+static const char* filter_name(lc_filter filter)
+{
+    return (LC_FILTER_BOX == filter) ? "box" : "kaiser";
+}
+
+void run_bench(int size, int iterations)
+{
+    int image_width = 0;
+    int image_height = 0;
+    int image_channels = 0;
+    unsigned char* image_data = lc_load_image((kAssetDir + "box_panel.jpg").c_str(), &image_width, &image_height, &image_channels, kChannelCount);
+    assert(NULL != image_data);
+
+    // Upscaled so the source has real content at the size being measured
+    std::vector<unsigned char> src(size * size * kChannelCount);
+    lc_image_resize_uint8(image_width, image_height, image_width * kChannelCount, image_data,
+                          size, size, size * kChannelCount, src.data(),
+                          kChannelCount, LC_FILTER_CUBIC, NULL);
+    lc_free_image(image_data);
+
+    std::vector<float> src_float(src.size());
+    for (size_t i = 0; i < src.size(); ++i) {
+        src_float[i] = src[i] / 255.0f;
+    }
+
+    const unsigned int level_count = calc_mip_levels(size, size);
+    std::vector<lc_mip_level> levels(level_count);
+    std::vector<lc_mip_level> levels_float(level_count);
+    size_t staging_size = lc_image_mip_layout(size, size, kChannelCount, kAlignment, level_count, levels.data());
+    size_t staging_size_float = lc_image_mip_layout(size, size, kChannelCount * sizeof(float), kAlignment, level_count, levels_float.data());
+    std::vector<unsigned char> staging(staging_size);
+    std::vector<unsigned char> staging_float(staging_size_float);
+
+    LOG(size << "x" << size << " RGBA, " << level_count << " levels, best of " << iterations);
+    const lc_filter filters[] = { LC_FILTER_BOX, LC_FILTER_KAISER };
+    for (lc_filter filter : filters) {
+        double per_level_ms = time_ms(iterations, [&]() {
+            per_level(size, src.data(), levels, staging.data(), filter, lc_image_resize_uint8);
+        });
+        double cascade_ms = time_ms(iterations, [&]() {
+            lc_image_generate_mips_uint8(size, size, size * kChannelCount, src.data(),
+                                         level_count, levels.data(), staging.data(),
+                                         kChannelCount, filter, NULL);
+        });
+        LOG("  uint8 " << filter_name(filter) << " : per level " << per_level_ms << " ms, cascade " << cascade_ms << " ms (" << (per_level_ms / cascade_ms) << "x)");
+
+        per_level_ms = time_ms(iterations, [&]() {
+            per_level(size, src_float.data(), levels_float, staging_float.data(), filter, lc_image_resize_float);
+        });
+        cascade_ms = time_ms(iterations, [&]() {
+            lc_image_generate_mips_float(size, size, size * kChannelCount * sizeof(float), src_float.data(),
+                                         level_count, levels_float.data(), (float*)staging_float.data(),
+                                         kChannelCount, filter, NULL);
+        });
+        LOG("  float " << filter_name(filter) << " : per level " << per_level_ms << " ms, cascade " << cascade_ms << " ms (" << (per_level_ms / cascade_ms) << "x)");
+    }
+}
+
+// Usage: ImageMips [size] [iterations]
+int main(int argc, char **argv)
+{
+    int size = (argc > 1) ? atoi(argv[1]) : kDefaultSize;
+    int iterations = (argc > 2) ? atoi(argv[2]) : kDefaultIterations;
+    if ((size <= 0) || (iterations <= 0)) {
+        LOG("Usage: ImageMips [size] [iterations]");
+        return EXIT_FAILURE;
+    }
+
+    run_bench(size, iterations);
+    return EXIT_SUCCESS;
+}
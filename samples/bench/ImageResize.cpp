@@ -0,0 +1,136 @@
+#include <assert.h>
+#include <math.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#define LC_IMAGE_IMPLEMENTATION
+#include "lc_image.h"
+
+#define LC_IMAGE_RESIZE_IMPLEMENTATION
+#include "lc_image_resize.h"
+
+#if defined(__linux__)
+const std::string   kAssetDir = "../samples/assets/";
+#elif defined(_WIN32)
+const std::string   kAssetDir = "../../samples/assets/";
+#endif
+const int           kDefaultSize = 4096;
+const int           kDefaultIterations = 3;
+const unsigned int  kChannelCount = 4;
+
+// No window here, so the output goes to the console on every platform
+#define LOG(STR)  { std::stringstream ss; ss << STR << std::endl; \
+                    printf("%s", ss.str().c_str()); }
+
+template <typename Fn>
+static double time_ms(int iterations, Fn fn)
+{
+    double best_ms = 0;
+    for (int i = 0; i < iterations; ++i) {
+        auto start = std::chrono::high_resolution_clock::now();
+        fn();
+        auto end = std::chrono::high_resolution_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(end - start).count();
+        best_ms = ((0 == i) || (ms < best_ms)) ? ms : best_ms;
+    }
+    return best_ms;
+}
+
+static const char* simd_name(lc_simd simd)
+{
+    switch (simd) {
+        case LC_SIMD_SSE41 : return "sse4.1";
+        case LC_SIMD_AVX2  : return "avx2";
+        default: break;
+    }
+    return "scalar";
+}
+
+struct Resize {
+    const char* name;
+    lc_filter   filter;
+    int         divisor;
+};
+
+void run_bench(int size, int iterations)
+{
+    int image_width = 0;
+    int image_height = 0;
+    int image_channels = 0;
+    unsigned char* image_data = lc_load_image((kAssetDir + "box_panel.jpg").c_str(), &image_width, &image_height, &image_channels, kChannelCount);
+    assert(NULL != image_data);
+
+    // Upscaled so the source has real content at the size being measured
+    std::vector<unsigned char> src(size * size * kChannelCount);
+    lc_image_resize_uint8(image_width, image_height, image_width * kChannelCount, image_data,
+                          size, size, size * kChannelCount, src.data(),
+                          kChannelCount, LC_FILTER_CUBIC, NULL);
+    lc_free_image(image_data);
+
+    std::vector<float> src_float(src.size());
+    for (size_t i = 0; i < src.size(); ++i) {
+        src_float[i] = src[i] / 255.0f;
+    }
+
+    const lc_simd best = lc_image_resize_get_simd();
+    LOG(size << "x" << size << " RGBA, best of " << iterations << ", CPU supports " << simd_name(best));
+
+    const Resize resizes[] = {
+        { "box 1/2",      LC_FILTER_BOX,     2 },
+        { "mitchell 1/4", LC_FILTER_MITCHELL, 4 },
+        { "kaiser 1/2",   LC_FILTER_KAISER,  2 },
+    };
+    for (const Resize& resize : resizes) {
+        const int dst_size = size / resize.divisor;
+        std::vector<unsigned char> dst(dst_size * dst_size * kChannelCount);
+        std::vector<unsigned char> dst_scalar(dst.size());
+        std::vector<float> dst_float(dst.size());
+        std::vector<float> dst_float_scalar(dst.size());
+
+        double scalar_ms = 0;
+        double scalar_float_ms = 0;
+        for (int simd = LC_SIMD_SCALAR; simd <= (int)best; ++simd) {
+            lc_image_resize_set_simd_limit((lc_simd)simd);
+            double ms = time_ms(iterations, [&]() {
+                lc_image_resize_uint8(size, size, size * kChannelCount, src.data(),
+                                      dst_size, dst_size, dst_size * kChannelCount, dst.data(),
+                                      kChannelCount, resize.filter, NULL);
+            });
+            double float_ms = time_ms(iterations, [&]() {
+                lc_image_resize_float(size, size, size * kChannelCount * sizeof(float), src_float.data(),
+                                      dst_size, dst_size, dst_size * kChannelCount * sizeof(float), dst_float.data(),
+                                      kChannelCount, resize.filter, NULL);
+            });
+
+            if (LC_SIMD_SCALAR == simd) {
+                scalar_ms = ms;
+                scalar_float_ms = float_ms;
+                dst_scalar = dst;
+                dst_float_scalar = dst_float;
+            }
+            bool exact = (dst == dst_scalar) && (0 == memcmp(dst_float.data(), dst_float_scalar.data(), dst_float.size() * sizeof(float)));
+            LOG("  " << resize.name << " " << simd_name((lc_simd)simd) << " : uint8 " << ms << " ms (" << (scalar_ms / ms) << "x), "
+                << "float " << float_ms << " ms (" << (scalar_float_ms / float_ms) << "x)" << (exact ? "" : " MISMATCH"));
+        }
+    }
+    lc_image_resize_set_simd_limit(LC_SIMD_AVX2);
+}
+
+// Usage: ImageResize [size] [iterations]
+int main(int argc, char **argv)
+{
+    int size = (argc > 1) ? atoi(argv[1]) : kDefaultSize;
+    int iterations = (argc > 2) ? atoi(argv[2]) : kDefaultIterations;
+    if ((size <= 0) || (iterations <= 0)) {
+        LOG("Usage: ImageResize [size] [iterations]");
+        return EXIT_FAILURE;
+    }
+
+    run_bench(size, iterations);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,131 @@
+#include <assert.h>
+#include <math.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define LC_IMAGE_IMPLEMENTATION
+#include "lc_image.h"
+
+#define LC_IMAGE_RESIZE_IMPLEMENTATION
+#include "lc_image_resize.h"
+
+#if defined(__linux__)
+const std::string   kAssetDir = "../samples/assets/";
+#elif defined(_WIN32)
+const std::string   kAssetDir = "../../samples/assets/";
+#endif
+const int           kDefaultSize = 8192;
+const int           kDefaultIterations = 3;
+const int           kMaxThreads = 32;
+const unsigned int  kChannelCount = 4;
+
+// No window here, so the output goes to the console on every platform
+#define LOG(STR)  { std::stringstream ss; ss << STR << std::endl; \
+                    printf("%s", ss.str().c_str()); }
+
+template <typename Fn>
+static double time_ms(int iterations, Fn fn)
+{
+    double best_ms = 0;
+    for (int i = 0; i < iterations; ++i) {
+        auto start = std::chrono::high_resolution_clock::now();
+        fn();
+        auto end = std::chrono::high_resolution_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(end - start).count();
+        best_ms = ((0 == i) || (ms < best_ms)) ? ms : best_ms;
+    }
+    return best_ms;
+}
+
+// Stands in for a job system: thread_count workers pull bands until there are none left
+static void dispatch_threads(lc_task_fn task, void* p_task_data, unsigned int task_count, void* p_dispatch_data)
+{
+    const int thread_count = *(const int*)p_dispatch_data;
+    std::atomic<unsigned int> next_task(0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < thread_count; ++i) {
+        threads.emplace_back([&]() {
+            for (unsigned int task_index = next_task++; task_index < task_count; task_index = next_task++) {
+                task(task_index, p_task_data);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+struct Resize {
+    const char* name;
+    lc_filter   filter;
+    int         divisor;
+};
+
+void run_bench(int size, int iterations)
+{
+    int image_width = 0;
+    int image_height = 0;
+    int image_channels = 0;
+    unsigned char* image_data = lc_load_image((kAssetDir + "box_panel.jpg").c_str(), &image_width, &image_height, &image_channels, kChannelCount);
+    assert(NULL != image_data);
+
+    // Upscaled so the source has real content at the size being measured
+    std::vector<unsigned char> src((size_t)size * size * kChannelCount);
+    lc_image_resize_uint8(image_width, image_height, image_width * kChannelCount, image_data,
+                          size, size, size * kChannelCount, src.data(),
+                          kChannelCount, LC_FILTER_CUBIC, NULL);
+    lc_free_image(image_data);
+
+    LOG(size << "x" << size << " RGBA, best of " << iterations << ", " << std::thread::hardware_concurrency() << " hardware threads");
+
+    const Resize resizes[] = {
+        { "box 1/2",      LC_FILTER_BOX,      2 },
+        { "mitchell 1/4", LC_FILTER_MITCHELL, 4 },
+        { "kaiser 1/2",   LC_FILTER_KAISER,   2 },
+    };
+    for (const Resize& resize : resizes) {
+        const int dst_size = size / resize.divisor;
+        std::vector<unsigned char> dst_serial((size_t)dst_size * dst_size * kChannelCount);
+        std::vector<unsigned char> dst(dst_serial.size());
+
+        double serial_ms = time_ms(iterations, [&]() {
+            lc_image_resize_uint8(size, size, size * kChannelCount, src.data(),
+                                  dst_size, dst_size, dst_size * kChannelCount, dst_serial.data(),
+                                  kChannelCount, resize.filter, NULL);
+        });
+        LOG("  " << resize.name << " serial : " << serial_ms << " ms");
+
+        // One band per thread, the bands share the weight tables but not their line buffers
+        for (int thread_count = 1; thread_count <= kMaxThreads; thread_count *= 2) {
+            double ms = time_ms(iterations, [&]() {
+                lc_image_resize_uint8_threaded(size, size, size * kChannelCount, src.data(),
+                                               dst_size, dst_size, dst_size * kChannelCount, dst.data(),
+                                               kChannelCount, resize.filter, NULL,
+                                               thread_count, dispatch_threads, &thread_count);
+            });
+            bool exact = (dst == dst_serial);
+            LOG("  " << resize.name << " " << thread_count << " threads : " << ms << " ms (" << (serial_ms / ms) << "x)" << (exact ? "" : " MISMATCH"));
+        }
+    }
+}
+
+// Usage: ImageResizeThreads [size] [iterations]
+int main(int argc, char **argv)
+{
+    int size = (argc > 1) ? atoi(argv[1]) : kDefaultSize;
+    int iterations = (argc > 2) ? atoi(argv[2]) : kDefaultIterations;
+    if ((size <= 0) || (iterations <= 0)) {
+        LOG("Usage: ImageResizeThreads [size] [iterations]");
+        return EXIT_FAILURE;
+    }
+
+    run_bench(size, iterations);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,107 @@
+#include "GLFW/glfw3.h"
+#if defined(__linux__)
+  #define GLFW_EXPOSE_NATIVE_X11
+#elif defined(_WIN32)
+  #define GLFW_EXPOSE_NATIVE_WIN32
+#endif
+#include "GLFW/glfw3native.h"
+#include <cstdio>
+#include <vector>
+
+#define TINY_RENDERER_IMPLEMENTATION
+#include "tinyvk.h"
+
+#include "BenchCommon.h"
+
+const char*         kCacheFile = "PipelineCache.bin";
+
+// Creates one pipeline per combination of fixed function state and returns the time it took
+double create_pipelines()
+{
+    auto vert = load_file(kAssetDir + "color.vs.spv");
+    auto frag = load_file(kAssetDir + "color.ps.spv");
+    tr_shader_program* shader = nullptr;
+    tr_create_shader_program(m_renderer,
+                             vert.size(), (uint32_t*)(vert.data()), "VSMain",
+                             frag.size(), (uint32_t*)(frag.data()), "PSMain", &shader);
+
+    tr_vertex_layout vertex_layout = {};
+    vertex_layout.attrib_count = 2;
+    vertex_layout.attribs[0].semantic = tr_semantic_position;
+    vertex_layout.attribs[0].format   = tr_format_r32g32b32a32_float;
+    vertex_layout.attribs[0].binding  = 0;
+    vertex_layout.attribs[0].location = 0;
+    vertex_layout.attribs[0].offset   = 0;
+    vertex_layout.attribs[1].semantic = tr_semantic_color;
+    vertex_layout.attribs[1].format   = tr_format_r32g32b32_float;
+    vertex_layout.attribs[1].binding  = 0;
+    vertex_layout.attribs[1].location = 1;
+    vertex_layout.attribs[1].offset   = tr_util_format_stride(tr_format_r32g32b32a32_float);
+
+    const tr_primitive_topo topos[] = { tr_primitive_topo_line_list, tr_primitive_topo_line_strip,
+                                        tr_primitive_topo_tri_list, tr_primitive_topo_tri_strip };
+    const tr_cull_mode cull_modes[] = { tr_cull_mode_none, tr_cull_mode_back, tr_cull_mode_front, tr_cull_mode_both };
+    const tr_front_face front_faces[] = { tr_front_face_ccw, tr_fornt_face_cw };
+
+    std::vector<tr_pipeline*> pipelines;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (auto topo : topos) {
+        for (auto cull_mode : cull_modes) {
+            for (auto front_face : front_faces) {
+                for (uint32_t depth = 0; depth < 3; ++depth) {
+                    tr_pipeline_settings pipeline_settings = {topo};
+                    pipeline_settings.cull_mode   = cull_mode;
+                    pipeline_settings.front_face  = front_face;
+                    pipeline_settings.depth_test  = (depth > 0);
+                    pipeline_settings.depth_write = (depth > 1);
+                    tr_pipeline* pipeline = nullptr;
+                    tr_create_pipeline(m_renderer, shader, &vertex_layout, nullptr, m_renderer->swapchain_render_targets[0], &pipeline_settings, &pipeline);
+                    pipelines.push_back(pipeline);
+                }
+            }
+        }
+    }
+    double create_ms = elapsed_ms(start);
+    LOG("  " << pipelines.size() << " pipelines : " << create_ms << " ms (" << (create_ms / pipelines.size()) << " ms/pipeline)");
+
+    for (auto pipeline : pipelines) {
+        tr_destroy_pipeline(m_renderer, pipeline);
+    }
+    tr_destroy_shader_program(m_renderer, shader);
+
+    return create_ms;
+}
+
+void run_bench(GLFWwindow* window)
+{
+    // Start cold - the driver may still have its own on-disk cache, which shrinks the difference
+    std::remove(kCacheFile);
+
+    LOG("Cold start, empty pipeline cache");
+    init_tiny_renderer(window, "PipelineCacheBench");
+    double cold_ms = create_pipelines();
+    if (! tr_save_pipeline_cache(m_renderer, kCacheFile)) {
+        LOG("  failed to save " << kCacheFile);
+    }
+    tr_destroy_renderer(m_renderer);
+
+    LOG("Warm start, pipeline cache loaded from " << kCacheFile);
+    init_tiny_renderer(window, "PipelineCacheBench");
+    if (! tr_load_pipeline_cache(m_renderer, kCacheFile)) {
+        LOG("  failed to load " << kCacheFile);
+    }
+    double warm_ms = create_pipelines();
+    tr_destroy_renderer(m_renderer);
+
+    LOG("Warm start speedup: " << (cold_ms / warm_ms) << "x");
+}
+
+int main(int argc, char **argv)
+{
+    GLFWwindow* window = create_bench_window("PipelineCache");
+
+    run_bench(window);
+
+    destroy_bench_window(window);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,1012 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#define TINY_RENDERER_IMPLEMENTATION
+#include "tinyvk.h"
+
+#include "BenchCommon.h"
+
+#define LC_IMAGE_IMPLEMENTATION
+#include "lc_image.h"
+
+//
+// Runs the scenarios from samples/src headless and writes the results as JSON:
+//
+//   Samples_VK [frame_count] [output.json|-] [scenario ...]
+//
+// Graphics scenarios render frame_count frames, compute scenarios record
+// frame_count frames with one dispatch each. The JSON goes to stdout if no
+// output file is given or it's "-". Naming scenarios runs just those.
+//
+// With SAMPLES_TRACE_DIR set each scenario also writes <name>.trace.json there,
+// a Chrome trace of its setup and frames.
+//
+
+const uint32_t      kWidth = 640;
+const uint32_t      kHeight = 480;
+const uint32_t      kDefaultFrameCount = 1000;
+const uint32_t      kWarmupFrameCount = 16;
+const uint32_t      kStaticDrawCount = 1000;
+
+#define NUM_THREADS_X  16
+#define NUM_THREADS_Y  16
+
+std::string         m_device_name;
+const char*         m_trace_dir = nullptr;
+
+// -------------------------------------------------------------------------------------------------
+// Scene objects - everything a scenario creates is destroyed before the renderer goes away
+// -------------------------------------------------------------------------------------------------
+struct Scene {
+    std::vector<tr_shader_program*>  shaders;
+    std::vector<tr_descriptor_set*>  desc_sets;
+    std::vector<tr_pipeline*>        pipelines;
+    std::vector<tr_buffer*>          buffers;
+    std::vector<tr_texture*>         textures;
+    std::vector<tr_sampler*>         samplers;
+    std::vector<tr_cmd*>             cmds;
+    tr_cmd_pool*                     cmd_pool = nullptr;
+    tr_render_graph*                 render_graph = nullptr;
+
+    tr_pipeline*        pipeline                = nullptr;
+    tr_pipeline*        pipeline_2              = nullptr;
+    tr_pipeline*        compute_pipeline        = nullptr;
+    tr_descriptor_set*  desc_set                = nullptr;
+    tr_descriptor_set*  desc_set_2              = nullptr;
+    tr_descriptor_set*  compute_desc_set        = nullptr;
+    tr_buffer*          tri_vertex_buffer       = nullptr;
+    tr_buffer*          rect_vertex_buffer      = nullptr;
+    tr_buffer*          rect_index_buffer       = nullptr;
+    tr_buffer*          uniform_buffer          = nullptr;
+    tr_buffer*          compute_dst_buffer      = nullptr;
+    tr_texture*         texture_compute_output  = nullptr;
+    uint32_t            image_width             = 0;
+    uint32_t            image_height            = 0;
+    uint32_t            image_row_stride        = 0;
+    uint32_t            frame_number            = 0;
+    uint32_t            graph_swapchain         = 0;
+};
+
+Scene m_scene;
+
+static void destroy_scene()
+{
+    if (nullptr != m_scene.render_graph) {
+        tr_destroy_render_graph(m_renderer, m_scene.render_graph);
+    }
+    for (auto p : m_scene.pipelines) { tr_destroy_pipeline(m_renderer, p); }
+    for (auto p : m_scene.desc_sets) { tr_destroy_descriptor_set(m_renderer, p); }
+    for (auto p : m_scene.shaders)   { tr_destroy_shader_program(m_renderer, p); }
+    for (auto p : m_scene.samplers)  { tr_destroy_sampler(m_renderer, p); }
+    for (auto p : m_scene.textures)  { tr_destroy_texture(m_renderer, p); }
+    for (auto p : m_scene.buffers)   { tr_destroy_buffer(m_renderer, p); }
+    for (auto p : m_scene.cmds)      { tr_destroy_cmd(m_scene.cmd_pool, p); }
+    if (nullptr != m_scene.cmd_pool) {
+        tr_destroy_cmd_pool(m_renderer, m_scene.cmd_pool);
+    }
+    m_scene = Scene();
+}
+
+static tr_shader_program* load_shader(const char* vs_file, const char* ps_file)
+{
+    auto vert = load_file(kAssetDir + vs_file);
+    auto frag = load_file(kAssetDir + ps_file);
+    tr_shader_program* shader = nullptr;
+    tr_create_shader_program(m_renderer,
+                             vert.size(), (uint32_t*)(vert.data()), "VSMain",
+                             frag.size(), (uint32_t*)(frag.data()), "PSMain", &shader);
+    m_scene.shaders.push_back(shader);
+    return shader;
+}
+
+static tr_shader_program* load_compute_shader(const char* cs_file)
+{
+    auto comp = load_file(kAssetDir + cs_file);
+    tr_shader_program* shader = nullptr;
+    tr_create_shader_program_compute(m_renderer, comp.size(), comp.data(), "main", &shader);
+    m_scene.shaders.push_back(shader);
+    return shader;
+}
+
+static tr_descriptor_set* create_desc_set(const std::vector<tr_descriptor>& descriptors)
+{
+    tr_descriptor_set* desc_set = nullptr;
+    tr_create_descriptor_set(m_renderer, descriptors.size(), descriptors.data(), &desc_set);
+    m_scene.desc_sets.push_back(desc_set);
+    return desc_set;
+}
+
+static tr_descriptor make_descriptor(tr_descriptor_type type, uint32_t binding, tr_shader_stage shader_stages)
+{
+    tr_descriptor descriptor = {};
+    descriptor.type          = type;
+    descriptor.count         = 1;
+    descriptor.binding       = binding;
+    descriptor.shader_stages = shader_stages;
+    return descriptor;
+}
+
+static tr_pipeline* create_pipeline(tr_shader_program* shader, const tr_vertex_layout& vertex_layout, tr_descriptor_set* desc_set)
+{
+    tr_pipeline_settings pipeline_settings = {tr_primitive_topo_tri_list};
+    tr_pipeline* pipeline = nullptr;
+    tr_create_pipeline(m_renderer, shader, &vertex_layout, desc_set, m_renderer->swapchain_render_targets[0], &pipeline_settings, &pipeline);
+    m_scene.pipelines.push_back(pipeline);
+    return pipeline;
+}
+
+static tr_pipeline* create_compute_pipeline(tr_shader_program* shader, tr_descriptor_set* desc_set)
+{
+    tr_pipeline_settings pipeline_settings = {};
+    tr_pipeline* pipeline = nullptr;
+    tr_create_compute_pipeline(m_renderer, shader, desc_set, &pipeline_settings, &pipeline);
+    m_scene.pipelines.push_back(pipeline);
+    return pipeline;
+}
+
+static tr_vertex_layout textured_vertex_layout()
+{
+    tr_vertex_layout vertex_layout = {};
+    vertex_layout.attrib_count = 2;
+    vertex_layout.attribs[0].semantic = tr_semantic_position;
+    vertex_layout.attribs[0].format   = tr_format_r32g32b32a32_float;
+    vertex_layout.attribs[0].binding  = 0;
+    vertex_layout.attribs[0].location = 0;
+    vertex_layout.attribs[0].offset   = 0;
+    vertex_layout.attribs[1].semantic = tr_semantic_texcoord0;
+    vertex_layout.attribs[1].format   = tr_format_r32g32_float;
+    vertex_layout.attribs[1].binding  = 0;
+    vertex_layout.attribs[1].location = 1;
+    vertex_layout.attribs[1].offset   = tr_util_format_stride(tr_format_r32g32b32a32_float);
+    return vertex_layout;
+}
+
+static tr_buffer* create_vertex_buffer(const std::vector<float>& vertex_data, uint32_t vertex_stride)
+{
+    uint64_t size = sizeof(float) * vertex_data.size();
+    tr_buffer* buffer = nullptr;
+    tr_create_vertex_buffer(m_renderer, size, true, vertex_stride, &buffer);
+    memcpy(buffer->cpu_mapped_address, vertex_data.data(), size);
+    m_scene.buffers.push_back(buffer);
+    return buffer;
+}
+
+static void create_rect_index_buffer()
+{
+    std::vector<uint16_t> index_data = {
+        0, 1, 2,
+        0, 2, 3
+    };
+    uint64_t size = sizeof(uint16_t) * index_data.size();
+    tr_create_index_buffer(m_renderer, size, true, tr_index_type_uint16, &m_scene.rect_index_buffer);
+    memcpy(m_scene.rect_index_buffer->cpu_mapped_address, index_data.data(), size);
+    m_scene.buffers.push_back(m_scene.rect_index_buffer);
+}
+
+static void create_textured_rect()
+{
+    std::vector<float> vertex_data = {
+        -0.5f,  0.5f, 0.0f, 1.0f, 0.0f, 0.0f,
+        -0.5f, -0.5f, 0.0f, 1.0f, 0.0f, 1.0f,
+         0.5f, -0.5f, 0.0f, 1.0f, 1.0f, 1.0f,
+         0.5f,  0.5f, 0.0f, 1.0f, 1.0f, 0.0f,
+    };
+    m_scene.rect_vertex_buffer = create_vertex_buffer(vertex_data, sizeof(float) * 6);
+    create_rect_index_buffer();
+}
+
+// Loads box_panel.jpg into a sampled texture, either uploaded or left for compute to fill
+static tr_texture* create_box_texture(uint32_t mip_levels, tr_texture_usage_flags usage, bool upload)
+{
+    int image_width = 0;
+    int image_height = 0;
+    int image_channels = 0;
+    unsigned char* image_data = lc_load_image((kAssetDir + "box_panel.jpg").c_str(), &image_width, &image_height, &image_channels, 4);
+    assert(NULL != image_data);
+    m_scene.image_width = image_width;
+    m_scene.image_height = image_height;
+    m_scene.image_row_stride = image_width * 4;
+
+    tr_texture* texture = nullptr;
+    tr_create_texture_2d(m_renderer, image_width, image_height, tr_sample_count_1, tr_format_r8g8b8a8_unorm, mip_levels, NULL, false, usage, &texture);
+    if (upload) {
+        tr_util_update_texture_uint8(m_renderer->graphics_queue, image_width, image_height, m_scene.image_row_stride, image_data, 4, texture, NULL, NULL);
+    }
+    else {
+        tr_util_transition_image(m_renderer->graphics_queue, texture, tr_texture_usage_undefined, tr_texture_usage_sampled_image);
+    }
+    lc_free_image(image_data);
+    m_scene.textures.push_back(texture);
+    return texture;
+}
+
+static tr_sampler* create_sampler()
+{
+    tr_sampler* sampler = nullptr;
+    tr_create_sampler(m_renderer, &sampler);
+    m_scene.samplers.push_back(sampler);
+    return sampler;
+}
+
+// Texture + sampler descriptor set and pipeline for drawing a textured rect
+static void create_textured_pipeline(const char* vs_file, const char* ps_file, tr_texture* texture)
+{
+    tr_shader_program* shader = load_shader(vs_file, ps_file);
+    m_scene.desc_set = create_desc_set({ make_descriptor(tr_descriptor_type_texture_srv, 0, tr_shader_stage_frag),
+                                         make_descriptor(tr_descriptor_type_sampler, 1, tr_shader_stage_frag) });
+    m_scene.pipeline = create_pipeline(shader, textured_vertex_layout(), m_scene.desc_set);
+    m_scene.desc_set->descriptors[0].textures[0] = texture;
+    m_scene.desc_set->descriptors[1].samplers[0] = create_sampler();
+    tr_update_descriptor_set(m_renderer, m_scene.desc_set);
+}
+
+static void begin_render(tr_cmd* cmd, tr_render_target* render_target)
+{
+    tr_cmd_render_target_transition(cmd, render_target, tr_texture_usage_present, tr_texture_usage_color_attachment);
+    tr_cmd_set_viewport(cmd, 0, 0, kWidth, kHeight, 0.0f, 1.0f);
+    tr_cmd_set_scissor(cmd, 0, 0, kWidth, kHeight);
+    tr_cmd_begin_render(cmd, render_target);
+    tr_clear_value clear_value = {0.0f, 0.0f, 0.0f, 0.0f};
+    tr_cmd_clear_color_attachment(cmd, 0, &clear_value);
+}
+
+static void end_render(tr_cmd* cmd, tr_render_target* render_target)
+{
+    tr_cmd_end_render(cmd);
+    tr_cmd_render_target_transition(cmd, render_target, tr_texture_usage_color_attachment, tr_texture_usage_present);
+}
+
+static void draw_textured_rect(tr_cmd* cmd, tr_render_target* render_target)
+{
+    begin_render(cmd, render_target);
+    tr_cmd_bind_pipeline(cmd, m_scene.pipeline);
+    tr_cmd_bind_index_buffer(cmd, m_scene.rect_index_buffer);
+    tr_cmd_bind_vertex_buffers(cmd, 1, &m_scene.rect_vertex_buffer);
+    tr_cmd_bind_descriptor_sets(cmd, m_scene.pipeline, m_scene.desc_set);
+    tr_cmd_draw_indexed(cmd, 6, 0);
+    end_render(cmd, render_target);
+}
+
+// -------------------------------------------------------------------------------------------------
+// 01_Color
+// -------------------------------------------------------------------------------------------------
+static void init_color()
+{
+    tr_shader_program* shader = load_shader("color.vs.spv", "color.ps.spv");
+
+    tr_vertex_layout vertex_layout = {};
+    vertex_layout.attrib_count = 2;
+    vertex_layout.attribs[0].semantic = tr_semantic_position;
+    vertex_layout.attribs[0].format   = tr_format_r32g32b32a32_float;
+    vertex_layout.attribs[0].binding  = 0;
+    vertex_layout.attribs[0].location = 0;
+    vertex_layout.attribs[0].offset   = 0;
+    vertex_layout.attribs[1].semantic = tr_semantic_color;
+    vertex_layout.attribs[1].format   = tr_format_r32g32b32_float;
+    vertex_layout.attribs[1].binding  = 0;
+    vertex_layout.attribs[1].location = 1;
+    vertex_layout.attribs[1].offset   = tr_util_format_stride(tr_format_r32g32b32a32_float);
+    m_scene.pipeline = create_pipeline(shader, vertex_layout, nullptr);
+
+    m_scene.tri_vertex_buffer = create_vertex_buffer({
+        -0.50f,  0.25f, 0.0f,   1.0f, 1.0f, 0.0f, 0.0f,
+        -0.75f, -0.25f, 0.0f,   1.0f, 0.0f, 1.0f, 0.0f,
+        -0.25f, -0.25f, 0.0f,   1.0f, 0.0f, 0.0f, 1.0f,
+    }, sizeof(float) * 7);
+
+    m_scene.rect_vertex_buffer = create_vertex_buffer({
+         0.25f,  0.25f, 0.0f,   1.0f, 1.0f, 0.0f, 0.0f,
+         0.25f, -0.25f, 0.0f,   1.0f, 0.0f, 1.0f, 0.0f,
+         0.75f, -0.25f, 0.0f,   1.0f, 0.0f, 0.0f, 1.0f,
+         0.75f,  0.25f, 0.0f,   1.0f, 1.0f, 1.0f, 1.0f,
+    }, sizeof(float) * 7);
+    create_rect_index_buffer();
+}
+
+static void frame_color(tr_cmd* cmd, tr_render_target* render_target)
+{
+    begin_render(cmd, render_target);
+    tr_cmd_bind_pipeline(cmd, m_scene.pipeline);
+    tr_cmd_bind_vertex_buffers(cmd, 1, &m_scene.tri_vertex_buffer);
+    tr_cmd_draw(cmd, 3, 0);
+    tr_cmd_bind_index_buffer(cmd, m_scene.rect_index_buffer);
+    tr_cmd_bind_vertex_buffers(cmd, 1, &m_scene.rect_vertex_buffer);
+    tr_cmd_draw_indexed(cmd, 6, 0);
+    end_render(cmd, render_target);
+}
+
+// -------------------------------------------------------------------------------------------------
+// 02_Texture, 09_OpaqueArgs, 10_PassingArrays - textured rect with different shaders
+// -------------------------------------------------------------------------------------------------
+static void init_texture()
+{
+    create_textured_rect();
+    tr_texture* texture = create_box_texture(tr_max_mip_levels, tr_texture_usage_sampled_image, true);
+    create_textured_pipeline("texture.vs.spv", "texture.ps.spv", texture);
+}
+
+static void init_opaque_args()
+{
+    create_textured_rect();
+    tr_texture* texture = create_box_texture(tr_max_mip_levels, tr_texture_usage_sampled_image, true);
+    create_textured_pipeline("opaque_args.vs.spv", "opaque_args.ps.spv", texture);
+}
+
+static void init_passing_arrays()
+{
+    create_textured_rect();
+    tr_texture* texture = create_box_texture(tr_max_mip_levels, tr_texture_usage_sampled_image, true);
+    create_textured_pipeline("passing_arrays.vs.spv", "passing_arrays.ps.spv", texture);
+}
+
+// -------------------------------------------------------------------------------------------------
+// 03_UniformBuffer
+// -------------------------------------------------------------------------------------------------
+static void init_uniform_buffer()
+{
+    tr_shader_program* shader = load_shader("uniformbuffer.vs.spv", "uniformbuffer.ps.spv");
+    m_scene.desc_set = create_desc_set({ make_descriptor(tr_descriptor_type_uniform_buffer_cbv, 0, tr_shader_stage_vert),
+                                         make_descriptor(tr_descriptor_type_texture_srv, 1, tr_shader_stage_frag),
+                                         make_descriptor(tr_descriptor_type_sampler, 2, tr_shader_stage_frag) });
+    m_scene.pipeline = create_pipeline(shader, textured_vertex_layout(), m_scene.desc_set);
+
+    create_textured_rect();
+    tr_texture* texture = create_box_texture(tr_max_mip_levels, tr_texture_usage_sampled_image, true);
+
+    tr_create_uniform_buffer(m_renderer, 16 * sizeof(float), true, &m_scene.uniform_buffer);
+    m_scene.buffers.push_back(m_scene.uniform_buffer);
+
+    m_scene.desc_set->descriptors[0].uniform_buffers[0] = m_scene.uniform_buffer;
+    m_scene.desc_set->descriptors[1].textures[0]        = texture;
+    m_scene.desc_set->descriptors[2].samplers[0]        = create_sampler();
+    tr_update_descriptor_set(m_renderer, m_scene.desc_set);
+}
+
+static void frame_uniform_buffer(tr_cmd* cmd, tr_render_target* render_target)
+{
+    // Fixed time step so every run writes the same matrices
+    float t = m_scene.frame_number++ / 60.0f;
+    float mvp[16] = { 0 };
+    mvp[ 0] =  cos(t);
+    mvp[ 1] =  sin(t);
+    mvp[ 4] = -sin(t);
+    mvp[ 5] =  cos(t);
+    mvp[10] =  1.0f;
+    mvp[15] =  1.0f;
+    memcpy(m_scene.uniform_buffer->cpu_mapped_address, mvp, sizeof(mvp));
+
+    draw_textured_rect(cmd, render_target);
+}
+
+// -------------------------------------------------------------------------------------------------
+// 04_SimpleCompute
+// -------------------------------------------------------------------------------------------------
+static void init_simple_compute()
+{
+    tr_shader_program* shader = load_compute_shader("simple_compute.cs.spv");
+    m_scene.compute_desc_set = create_desc_set({ make_descriptor(tr_descriptor_type_texture_srv, 0, tr_shader_stage_comp),
+                                                 make_descriptor(tr_descriptor_type_texture_uav, 1, tr_shader_stage_comp) });
+    m_scene.compute_pipeline = create_compute_pipeline(shader, m_scene.compute_desc_set);
+
+    tr_texture* texture = create_box_texture(1, tr_texture_usage_sampled_image, true);
+    m_scene.texture_compute_output = create_box_texture(1, tr_texture_usage_sampled_image | tr_texture_usage_storage_image, false);
+
+    m_scene.compute_desc_set->descriptors[0].textures[0] = texture;
+    m_scene.compute_desc_set->descriptors[1].textures[0] = m_scene.texture_compute_output;
+    tr_update_descriptor_set(m_renderer, m_scene.compute_desc_set);
+}
+
+static void frame_simple_compute(tr_cmd* cmd, tr_render_target* render_target)
+{
+    tr_cmd_image_state(cmd, m_scene.texture_compute_output, tr_texture_usage_storage_image);
+    tr_cmd_bind_pipeline(cmd, m_scene.compute_pipeline);
+    tr_cmd_bind_descriptor_sets(cmd, m_scene.compute_pipeline, m_scene.compute_desc_set);
+    tr_cmd_dispatch(cmd, m_scene.image_width / NUM_THREADS_X, m_scene.image_height / NUM_THREADS_Y, 1);
+    tr_cmd_image_state(cmd, m_scene.texture_compute_output, tr_texture_usage_sampled_image);
+}
+
+// -------------------------------------------------------------------------------------------------
+// 05_StructuredBuffer, 06_AppendConsume, 07_ByteAddressBuffer - buffer in, buffer out
+// -------------------------------------------------------------------------------------------------
+static std::vector<uint8_t> load_box_pixels()
+{
+    int image_width = 0;
+    int image_height = 0;
+    int image_channels = 0;
+    unsigned char* image_data = lc_load_image((kAssetDir + "box_panel.jpg").c_str(), &image_width, &image_height, &image_channels, 4);
+    assert(NULL != image_data);
+    m_scene.image_width = image_width;
+    m_scene.image_height = image_height;
+    m_scene.image_row_stride = image_width * 4;
+    std::vector<uint8_t> pixels(image_data, image_data + m_scene.image_row_stride * image_height);
+    lc_free_image(image_data);
+    return pixels;
+}
+
+static void init_structured_buffer()
+{
+    tr_shader_program* shader = load_compute_shader("structured_buffer.cs.spv");
+    m_scene.compute_desc_set = create_desc_set({ make_descriptor(tr_descriptor_type_storage_buffer_srv, 0, tr_shader_stage_comp),
+                                                 make_descriptor(tr_descriptor_type_storage_buffer_uav, 1, tr_shader_stage_comp) });
+    m_scene.compute_pipeline = create_compute_pipeline(shader, m_scene.compute_desc_set);
+
+    struct Input {
+      uint32_t color;
+      float    r;
+      float    g;
+      float    b;
+    };
+
+    std::vector<uint8_t> pixels = load_box_pixels();
+    std::vector<Input> input_buffer;
+    for (uint32_t i = 0; i < m_scene.image_height; ++i) {
+      for (uint32_t j = 0; j < m_scene.image_width; ++j) {
+        Input elem = {};
+        elem.color = *((uint32_t*)(pixels.data() + (i * m_scene.image_row_stride) + (j * 4)));
+        elem.r = 0.0f + (j / (float)m_scene.image_width);
+        elem.g = 0.0f + (i / (float)m_scene.image_height);
+        elem.b = 0.0f + (j / (float)m_scene.image_width) + (i / (float)m_scene.image_height);
+        input_buffer.push_back(elem);
+      }
+    }
+
+    uint64_t element_count = m_scene.image_width * m_scene.image_height;
+    tr_buffer* src_buffer = nullptr;
+    tr_create_structured_buffer(m_renderer, input_buffer.size() * sizeof(Input), 0, element_count, sizeof(Input), false, &src_buffer);
+    tr_util_update_buffer(m_renderer->graphics_queue, input_buffer.size() * sizeof(Input), input_buffer.data(), src_buffer);
+    m_scene.buffers.push_back(src_buffer);
+
+    tr_create_rw_structured_buffer(m_renderer, pixels.size(), 0, element_count, 4, false, NULL, &m_scene.compute_dst_buffer);
+    tr_util_transition_buffer(m_renderer->graphics_queue, m_scene.compute_dst_buffer, tr_buffer_usage_storage_uav, tr_buffer_usage_transfer_src);
+    m_scene.buffers.push_back(m_scene.compute_dst_buffer);
+
+    m_scene.compute_desc_set->descriptors[0].buffers[0] = src_buffer;
+    m_scene.compute_desc_set->descriptors[1].buffers[0] = m_scene.compute_dst_buffer;
+    tr_update_descriptor_set(m_renderer, m_scene.compute_desc_set);
+}
+
+static void init_append_consume()
+{
+    tr_shader_program* shader = load_compute_shader("append_consume.cs.spv");
+    // See append_consume.hlsl for the bindings
+    m_scene.compute_desc_set = create_desc_set({ make_descriptor(tr_descriptor_type_storage_buffer_uav, 0, tr_shader_stage_comp),
+                                                 make_descriptor(tr_descriptor_type_storage_buffer_uav, 1, tr_shader_stage_comp),
+                                                 make_descriptor(tr_descriptor_type_storage_buffer_uav, 2, tr_shader_stage_comp),
+                                                 make_descriptor(tr_descriptor_type_storage_buffer_uav, 3, tr_shader_stage_comp) });
+    m_scene.compute_pipeline = create_compute_pipeline(shader, m_scene.compute_desc_set);
+
+    std::vector<uint8_t> pixels = load_box_pixels();
+    uint64_t element_count = m_scene.image_width * m_scene.image_height;
+
+    // Consume buffer
+    tr_buffer* src_buffer = nullptr;
+    tr_buffer* src_counter_buffer = nullptr;
+    tr_create_rw_structured_buffer(m_renderer, pixels.size(), 0, element_count, 4, false, &src_counter_buffer, &src_buffer);
+    tr_util_update_buffer(m_renderer->graphics_queue, pixels.size(), pixels.data(), src_buffer);
+    tr_util_set_storage_buffer_count(m_renderer->graphics_queue, 0, element_count, src_counter_buffer);
+    m_scene.buffers.push_back(src_buffer);
+    m_scene.buffers.push_back(src_counter_buffer);
+
+    // Append buffer
+    tr_buffer* dst_counter_buffer = nullptr;
+    tr_create_rw_structured_buffer(m_renderer, pixels.size(), 0, element_count, 4, false, &dst_counter_buffer, &m_scene.compute_dst_buffer);
+    tr_util_set_storage_buffer_count(m_renderer->graphics_queue, 0, 0, dst_counter_buffer);
+    tr_util_transition_buffer(m_renderer->graphics_queue, m_scene.compute_dst_buffer, tr_buffer_usage_storage_uav, tr_buffer_usage_transfer_src);
+    m_scene.buffers.push_back(m_scene.compute_dst_buffer);
+    m_scene.buffers.push_back(dst_counter_buffer);
+
+    m_scene.compute_desc_set->descriptors[0].buffers[0] = src_buffer;
+    m_scene.compute_desc_set->descriptors[1].buffers[0] = src_counter_buffer;
+    m_scene.compute_desc_set->descriptors[2].buffers[0] = m_scene.compute_dst_buffer;
+    m_scene.compute_desc_set->descriptors[3].buffers[0] = dst_counter_buffer;
+    tr_update_descriptor_set(m_renderer, m_scene.compute_desc_set);
+}
+
+static void init_byte_address_buffer()
+{
+    tr_shader_program* shader = load_compute_shader("byte_address_buffer.cs.spv");
+    m_scene.compute_desc_set = create_desc_set({ make_descriptor(tr_descriptor_type_storage_buffer_srv, 0, tr_shader_stage_comp),
+                                                 make_descriptor(tr_descriptor_type_storage_buffer_uav, 1, tr_shader_stage_comp) });
+    m_scene.compute_pipeline = create_compute_pipeline(shader, m_scene.compute_desc_set);
+
+    std::vector<uint8_t> pixels = load_box_pixels();
+    uint64_t element_count = m_scene.image_width * m_scene.image_height;
+
+    tr_buffer* src_buffer = nullptr;
+    tr_create_structured_buffer(m_renderer, pixels.size(), 0, element_count, 0, true, &src_buffer);
+    tr_util_update_buffer(m_renderer->graphics_queue, pixels.size(), pixels.data(), src_buffer);
+    m_scene.buffers.push_back(src_buffer);
+
+    tr_create_rw_structured_buffer(m_renderer, pixels.size(), 0, element_count, 0, true, NULL, &m_scene.compute_dst_buffer);
+    tr_util_transition_buffer(m_renderer->graphics_queue, m_scene.compute_dst_buffer, tr_buffer_usage_storage_uav, tr_buffer_usage_transfer_dst);
+    tr_util_clear_buffer(m_renderer->graphics_queue, m_scene.compute_dst_buffer);
+    tr_util_transition_buffer(m_renderer->graphics_queue, m_scene.compute_dst_buffer, tr_buffer_usage_transfer_dst, tr_buffer_usage_transfer_src);
+    m_scene.buffers.push_back(m_scene.compute_dst_buffer);
+
+    m_scene.compute_desc_set->descriptors[0].buffers[0] = src_buffer;
+    m_scene.compute_desc_set->descriptors[1].buffers[0] = m_scene.compute_dst_buffer;
+    tr_update_descriptor_set(m_renderer, m_scene.compute_desc_set);
+}
+
+static void frame_buffer_compute(tr_cmd* cmd, tr_render_target* render_target, uint32_t group_count_x, uint32_t group_count_y)
+{
+    tr_cmd_buffer_state(cmd, m_scene.compute_dst_buffer, tr_buffer_usage_storage_uav);
+    tr_cmd_bind_pipeline(cmd, m_scene.compute_pipeline);
+    tr_cmd_bind_descriptor_sets(cmd, m_scene.compute_pipeline, m_scene.compute_desc_set);
+    tr_cmd_dispatch(cmd, group_count_x, group_count_y, 1);
+    tr_cmd_buffer_state(cmd, m_scene.compute_dst_buffer, tr_buffer_usage_transfer_src);
+}
+
+static void frame_structured_buffer(tr_cmd* cmd, tr_render_target* render_target)
+{
+    frame_buffer_compute(cmd, render_target, (uint32_t)m_scene.compute_dst_buffer->element_count, 1);
+}
+
+static void frame_append_consume(tr_cmd* cmd, tr_render_target* render_target)
+{
+    frame_buffer_compute(cmd, render_target, m_scene.image_width, m_scene.image_height);
+}
+
+// -------------------------------------------------------------------------------------------------
+// 08_ConstantBuffer
+// -------------------------------------------------------------------------------------------------
+static void init_constant_buffer()
+{
+    tr_shader_program* shader = load_shader("constant_buffer.vs.spv", "constant_buffer.ps.spv");
+
+    std::vector<tr_descriptor> descriptors = { make_descriptor(tr_descriptor_type_uniform_buffer_cbv, 0, tr_shader_stage_vert) };
+    m_scene.desc_set = create_desc_set(descriptors);
+    m_scene.desc_set_2 = create_desc_set(descriptors);
+
+    tr_vertex_layout vertex_layout = {};
+    vertex_layout.attrib_count = 1;
+    vertex_layout.attribs[0].semantic = tr_semantic_position;
+    vertex_layout.attribs[0].format   = tr_format_r32g32b32a32_float;
+    vertex_layout.attribs[0].binding  = 0;
+    vertex_layout.attribs[0].location = 0;
+    vertex_layout.attribs[0].offset   = 0;
+    m_scene.pipeline = create_pipeline(shader, vertex_layout, m_scene.desc_set);
+    m_scene.pipeline_2 = create_pipeline(shader, vertex_layout, m_scene.desc_set_2);
+
+    m_scene.tri_vertex_buffer = create_vertex_buffer({
+        -0.50f,  0.25f, 0.0f, 1.0f,
+        -0.75f, -0.25f, 0.0f, 1.0f,
+        -0.25f, -0.25f, 0.0f, 1.0f,
+    }, sizeof(float) * 4);
+
+    m_scene.rect_vertex_buffer = create_vertex_buffer({
+         0.25f,  0.25f, 0.0f, 1.0f,
+         0.25f, -0.25f, 0.0f, 1.0f,
+         0.75f, -0.25f, 0.0f, 1.0f,
+         0.75f,  0.25f, 0.0f, 1.0f,
+    }, sizeof(float) * 4);
+    create_rect_index_buffer();
+
+    const float colors[2][4] = { { 0, 1, 0, 0 }, { 0, 1, 1, 0 } };
+    tr_descriptor_set* desc_sets[2] = { m_scene.desc_set, m_scene.desc_set_2 };
+    for (uint32_t i = 0; i < 2; ++i) {
+        tr_buffer* uniform_buffer = nullptr;
+        tr_create_uniform_buffer(m_renderer, 64, true, &uniform_buffer);
+        memcpy(uniform_buffer->cpu_mapped_address, colors[i], sizeof(colors[i]));
+        m_scene.buffers.push_back(uniform_buffer);
+        desc_sets[i]->descriptors[0].uniform_buffers[0] = uniform_buffer;
+        tr_update_descriptor_set(m_renderer, desc_sets[i]);
+    }
+}
+
+static void frame_constant_buffer(tr_cmd* cmd, tr_render_target* render_target)
+{
+    begin_render(cmd, render_target);
+    tr_cmd_bind_pipeline(cmd, m_scene.pipeline);
+    tr_cmd_bind_descriptor_sets(cmd, m_scene.pipeline, m_scene.desc_set);
+    tr_cmd_bind_vertex_buffers(cmd, 1, &m_scene.tri_vertex_buffer);
+    tr_cmd_draw(cmd, 3, 0);
+    tr_cmd_bind_pipeline(cmd, m_scene.pipeline_2);
+    tr_cmd_bind_descriptor_sets(cmd, m_scene.pipeline_2, m_scene.desc_set_2);
+    tr_cmd_bind_index_buffer(cmd, m_scene.rect_index_buffer);
+    tr_cmd_bind_vertex_buffers(cmd, 1, &m_scene.rect_vertex_buffer);
+    tr_cmd_draw_indexed(cmd, 6, 0);
+    end_render(cmd, render_target);
+}
+
+// -------------------------------------------------------------------------------------------------
+// 11_StaticInline, 12_StaticSecondary - the same static chunk of draws, recorded every frame
+// or recorded once into a secondary and replayed
+// -------------------------------------------------------------------------------------------------
+static void draw_static_chunk(tr_cmd* cmd)
+{
+    tr_clear_value clear_value = {0.0f, 0.0f, 0.0f, 0.0f};
+    tr_cmd_clear_color_attachment(cmd, 0, &clear_value);
+    tr_cmd_set_viewport(cmd, 0, 0, kWidth, kHeight, 0.0f, 1.0f);
+    tr_cmd_set_scissor(cmd, 0, 0, kWidth, kHeight);
+    tr_cmd_bind_pipeline(cmd, m_scene.pipeline);
+    tr_cmd_bind_index_buffer(cmd, m_scene.rect_index_buffer);
+    for (uint32_t i = 0; i < kStaticDrawCount; ++i) {
+        tr_buffer* vertex_buffer = (i & 1) ? m_scene.rect_vertex_buffer : m_scene.tri_vertex_buffer;
+        tr_cmd_bind_vertex_buffers(cmd, 1, &vertex_buffer);
+        if (i & 1) {
+            tr_cmd_draw_indexed(cmd, 6, 0);
+        }
+        else {
+            tr_cmd_draw(cmd, 3, 0);
+        }
+    }
+}
+
+static void frame_static_inline(tr_cmd* cmd, tr_render_target* render_target)
+{
+    tr_cmd_render_target_transition(cmd, render_target, tr_texture_usage_present, tr_texture_usage_color_attachment);
+    tr_cmd_begin_render(cmd, render_target);
+    draw_static_chunk(cmd);
+    end_render(cmd, render_target);
+}
+
+static void init_static_secondary()
+{
+    init_color();
+
+    // The framebuffer isn't part of the inheritance, so one secondary serves every swapchain image
+    tr_cmd* cmd = nullptr;
+    tr_create_cmd_pool(m_renderer, m_renderer->graphics_queue, false, &m_scene.cmd_pool);
+    tr_create_cmd(m_scene.cmd_pool, true, &cmd);
+    m_scene.cmds.push_back(cmd);
+
+    tr_begin_secondary_cmd(cmd, m_renderer->swapchain_render_targets[0]);
+    draw_static_chunk(cmd);
+    tr_end_cmd(cmd);
+}
+
+static void frame_static_secondary(tr_cmd* cmd, tr_render_target* render_target)
+{
+    tr_cmd_render_target_transition(cmd, render_target, tr_texture_usage_present, tr_texture_usage_color_attachment);
+    tr_cmd_begin_render_secondary(cmd, render_target);
+    tr_cmd_execute_cmds(cmd, (uint32_t)m_scene.cmds.size(), m_scene.cmds.data());
+    end_render(cmd, render_target);
+}
+
+// -------------------------------------------------------------------------------------------------
+// 13_RenderGraph - the color scene goes through two post passes on transient render targets
+// before it's copied to the swapchain, the first and last transient share memory. A debug pass
+// that nothing reads is culled.
+// -------------------------------------------------------------------------------------------------
+static void graph_scene_pass(tr_cmd* cmd, void*)
+{
+    tr_cmd_set_viewport(cmd, 0, 0, kWidth, kHeight, 0.0f, 1.0f);
+    tr_cmd_set_scissor(cmd, 0, 0, kWidth, kHeight);
+    tr_cmd_bind_pipeline(cmd, m_scene.pipeline);
+    tr_cmd_bind_vertex_buffers(cmd, 1, &m_scene.tri_vertex_buffer);
+    tr_cmd_draw(cmd, 3, 0);
+}
+
+// user_data is the descriptor set with the previous pass's output in it
+static void graph_post_pass(tr_cmd* cmd, void* user_data)
+{
+    tr_cmd_set_viewport(cmd, 0, 0, kWidth, kHeight, 0.0f, 1.0f);
+    tr_cmd_set_scissor(cmd, 0, 0, kWidth, kHeight);
+    tr_cmd_bind_pipeline(cmd, m_scene.pipeline_2);
+    tr_cmd_bind_index_buffer(cmd, m_scene.rect_index_buffer);
+    tr_cmd_bind_vertex_buffers(cmd, 1, &m_scene.rect_vertex_buffer);
+    tr_cmd_bind_descriptor_sets(cmd, m_scene.pipeline_2, (tr_descriptor_set*)user_data);
+    tr_cmd_draw_indexed(cmd, 6, 0);
+}
+
+static void init_render_graph()
+{
+    init_color();
+    create_textured_rect();
+
+    // Transients match the swapchain's render pass, so the pipelines work for every pass
+    tr_shader_program* shader = load_shader("texture.vs.spv", "texture.ps.spv");
+    tr_descriptor_set* desc_sets[3] = {};
+    for (uint32_t i = 0; i < 3; ++i) {
+        desc_sets[i] = create_desc_set({ make_descriptor(tr_descriptor_type_texture_srv, 0, tr_shader_stage_frag),
+                                         make_descriptor(tr_descriptor_type_sampler, 1, tr_shader_stage_frag) });
+    }
+    m_scene.pipeline_2 = create_pipeline(shader, textured_vertex_layout(), desc_sets[0]);
+
+    tr_create_render_graph(m_renderer, &m_scene.render_graph);
+    tr_render_graph* graph = m_scene.render_graph;
+    m_scene.graph_swapchain = tr_render_graph_import_render_target(graph, m_renderer->swapchain_render_targets[0]);
+    uint32_t targets[4] = {};
+    for (uint32_t i = 0; i < 4; ++i) {
+        targets[i] = tr_render_graph_create_render_target(graph, kWidth, kHeight, tr_sample_count_1, m_renderer->settings.swapchain.color_format, 1, nullptr, tr_format_undefined, nullptr);
+    }
+
+    uint32_t pass = tr_render_graph_add_pass(graph, "scene", graph_scene_pass, nullptr);
+    tr_render_graph_pass_render_target(graph, pass, targets[0]);
+    pass = tr_render_graph_add_pass(graph, "debug_view", graph_post_pass, desc_sets[0]);
+    tr_render_graph_pass_read_render_target(graph, pass, targets[0]);
+    tr_render_graph_pass_render_target(graph, pass, targets[3]);
+    pass = tr_render_graph_add_pass(graph, "post_a", graph_post_pass, desc_sets[0]);
+    tr_render_graph_pass_read_render_target(graph, pass, targets[0]);
+    tr_render_graph_pass_render_target(graph, pass, targets[1]);
+    pass = tr_render_graph_add_pass(graph, "post_b", graph_post_pass, desc_sets[1]);
+    tr_render_graph_pass_read_render_target(graph, pass, targets[1]);
+    tr_render_graph_pass_render_target(graph, pass, targets[2]);
+    pass = tr_render_graph_add_pass(graph, "present", graph_post_pass, desc_sets[2]);
+    tr_render_graph_pass_read_render_target(graph, pass, targets[2]);
+    tr_render_graph_pass_render_target(graph, pass, m_scene.graph_swapchain);
+    tr_render_graph_compile(graph);
+
+    // The transients only exist once the graph is compiled
+    tr_sampler* sampler = create_sampler();
+    for (uint32_t i = 0; i < 3; ++i) {
+        desc_sets[i]->descriptors[0].textures[0] = tr_render_graph_get_render_target(graph, targets[i])->color_attachments[0];
+        desc_sets[i]->descriptors[1].samplers[0] = sampler;
+        tr_update_descriptor_set(m_renderer, desc_sets[i]);
+    }
+
+    LOG("  transient memory " << graph->transient_memory_size << " of " << graph->transient_unaliased_size << " bytes, "
+        << graph->culled_pass_count << " pass(es) culled");
+}
+
+static void frame_render_graph(tr_cmd* cmd, tr_render_target* render_target)
+{
+    tr_render_graph_bind_render_target(m_scene.render_graph, m_scene.graph_swapchain, render_target);
+    tr_render_graph_execute(m_scene.render_graph, cmd);
+}
+
+// -------------------------------------------------------------------------------------------------
+// Scenario runner
+// -------------------------------------------------------------------------------------------------
+typedef void (*PfnInit)();
+typedef void (*PfnFrame)(tr_cmd* cmd, tr_render_target* render_target);
+
+struct Scenario {
+    const char* name;
+    bool        compute;
+    PfnInit     init;
+    PfnFrame    frame;
+};
+
+const Scenario kScenarios[] = {
+    { "01_Color",             false, init_color,               frame_color             },
+    { "02_Texture",           false, init_texture,             draw_textured_rect      },
+    { "03_UniformBuffer",     false, init_uniform_buffer,      frame_uniform_buffer    },
+    { "04_SimpleCompute",     true,  init_simple_compute,      frame_simple_compute    },
+    { "05_StructuredBuffer",  true,  init_structured_buffer,   frame_structured_buffer },
+    { "06_AppendConsume",     true,  init_append_consume,      frame_append_consume    },
+    { "07_ByteAddressBuffer", true,  init_byte_address_buffer, frame_structured_buffer },
+    { "08_ConstantBuffer",    false, init_constant_buffer,     frame_constant_buffer   },
+    { "09_OpaqueArgs",        false, init_opaque_args,         draw_textured_rect      },
+    { "10_PassingArrays",     false, init_passing_arrays,      draw_textured_rect      },
+    { "11_StaticInline",      false, init_color,               frame_static_inline     },
+    { "12_StaticSecondary",   false, init_static_secondary,    frame_static_secondary  },
+    { "13_RenderGraph",       false, init_render_graph,        frame_render_graph      },
+};
+
+struct Stats {
+    double mean = 0;
+    double min  = 0;
+    double max  = 0;
+    double p50  = 0;
+    double p95  = 0;
+};
+
+static Stats calc_stats(std::vector<double> samples)
+{
+    Stats stats;
+    if (samples.empty()) {
+        return stats;
+    }
+    std::sort(samples.begin(), samples.end());
+    for (double sample : samples) {
+        stats.mean += sample;
+    }
+    stats.mean /= samples.size();
+    stats.min = samples.front();
+    stats.max = samples.back();
+    stats.p50 = samples[samples.size() / 2];
+    stats.p95 = samples[std::min(samples.size() - 1, (samples.size() * 95) / 100)];
+    return stats;
+}
+
+struct Result {
+    const char*     name;
+    bool            compute;
+    uint32_t        frame_count;
+    Stats           cpu_ms;
+    Stats           gpu_ms;
+    bool            gpu_valid;
+    tr_pipeline_statistics statistics;
+    bool            statistics_valid;
+    uint32_t        draws_per_frame;
+    uint32_t        dispatches_per_frame;
+    uint32_t        memory_allocations;
+    uint32_t        memory_blocks;
+    uint32_t        descriptor_sets;
+    uint32_t        descriptor_pools;
+    uint32_t        pipelines;
+    int64_t         frame_memory_allocations;
+    int64_t         frame_descriptor_sets;
+};
+
+static void init_tiny_renderer()
+{
+    tr_renderer_settings settings = bench_renderer_settings(kWidth, kHeight);
+    settings.headless = true;
+    tr_create_renderer("SamplesBench", &settings, &m_renderer);
+}
+
+static Result run_scenario(const Scenario& scenario, uint32_t frame_count)
+{
+    LOG(scenario.name);
+
+    init_tiny_renderer();
+    if (nullptr != m_trace_dir) {
+        tr_begin_trace(m_renderer);
+    }
+    scenario.init();
+
+    tr_query_pool* query_pool = nullptr;
+    tr_create_query_pool(m_renderer, tr_query_type_timestamp, 1, &query_pool);
+
+    Result result = {};
+    result.name        = scenario.name;
+    result.compute     = scenario.compute;
+    result.frame_count = frame_count;
+    result.gpu_valid   = (VK_NULL_HANDLE != query_pool->vk_query_pool);
+
+    // Shader invocation counts, fragment invocations over pixel count is the overdraw
+    tr_query_pool* statistics_pool = nullptr;
+    tr_create_query_pool(m_renderer, tr_query_type_pipeline_statistics, 1, &statistics_pool);
+
+    uint32_t memory_allocations = 0;
+    uint32_t descriptor_sets = 0;
+    std::vector<double> cpu_samples;
+    std::vector<double> gpu_samples;
+    uint64_t gpu_frame_number = 0;
+    cpu_samples.reserve(frame_count);
+    gpu_samples.reserve(frame_count);
+    for (uint32_t i = 0; i < kWarmupFrameCount + frame_count; ++i) {
+        bool measure = (i >= kWarmupFrameCount);
+        if (i == kWarmupFrameCount) {
+            memory_allocations = m_renderer->memory_allocator->allocation_count;
+            descriptor_sets = m_renderer->descriptor_allocator->set_count;
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+
+        tr_frame* frame = nullptr;
+        tr_begin_frame(m_renderer, &frame);
+        tr_cmd_begin_query_frame(frame->cmd, query_pool);
+        tr_cmd_begin_query_frame(frame->cmd, statistics_pool);
+        uint32_t timer = tr_cmd_begin_timer(frame->cmd, query_pool, scenario.name);
+        uint32_t query = tr_cmd_begin_query(frame->cmd, statistics_pool);
+        scenario.frame(frame->cmd, frame->render_target);
+        tr_cmd_end_query(frame->cmd, statistics_pool, query);
+        tr_cmd_end_timer(frame->cmd, query_pool, timer);
+        tr_cmd_resolve_queries(frame->cmd, statistics_pool);
+        result.draws_per_frame = frame->cmd->draw_count;
+        result.dispatches_per_frame = frame->cmd->dispatch_count;
+        tr_end_frame(m_renderer, frame);
+
+        auto end = std::chrono::high_resolution_clock::now();
+        if (measure) {
+            cpu_samples.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+        }
+        // Results lag a few frames, so the first few measured frames report warmup timings
+        double gpu_ms = 0.0;
+        if (measure && (query_pool->resolved_frame_number != gpu_frame_number) && tr_query_pool_get_timer_ms(query_pool, 0, &gpu_ms)) {
+            gpu_samples.push_back(gpu_ms);
+            gpu_frame_number = query_pool->resolved_frame_number;
+        }
+        if (measure && tr_query_pool_get_pipeline_statistics(statistics_pool, 0, &result.statistics)) {
+            result.statistics_valid = true;
+        }
+    }
+    tr_queue_wait_idle(m_renderer->graphics_queue);
+
+    result.cpu_ms                   = calc_stats(cpu_samples);
+    result.gpu_ms                   = calc_stats(gpu_samples);
+    result.memory_allocations       = m_renderer->memory_allocator->allocation_count;
+    result.memory_blocks            = m_renderer->memory_allocator->block_count;
+    result.descriptor_sets          = m_renderer->descriptor_allocator->set_count;
+    result.descriptor_pools         = m_renderer->descriptor_allocator->pool_count;
+    result.pipelines                = m_renderer->pipeline_registry->pipeline_count;
+    result.frame_memory_allocations = (int64_t)m_renderer->memory_allocator->allocation_count - memory_allocations;
+    result.frame_descriptor_sets    = (int64_t)m_renderer->descriptor_allocator->set_count - descriptor_sets;
+
+    m_device_name = m_renderer->vk_active_gpu_properties.deviceName;
+
+    if (nullptr != m_trace_dir) {
+        std::string trace_file = std::string(m_trace_dir) + "/" + scenario.name + ".trace.json";
+        if (! tr_end_trace(m_renderer, trace_file.c_str())) {
+            LOG("Failed to write " << trace_file);
+        }
+    }
+
+    tr_destroy_query_pool(m_renderer, statistics_pool);
+    tr_destroy_query_pool(m_renderer, query_pool);
+    destroy_scene();
+    tr_destroy_renderer(m_renderer);
+    m_renderer = nullptr;
+
+    return result;
+}
+
+static void write_stats(FILE* fp, const char* name, const Stats& stats)
+{
+    fprintf(fp, "      \"%s\": { \"mean\": %.4f, \"min\": %.4f, \"max\": %.4f, \"p50\": %.4f, \"p95\": %.4f },\n",
+            name, stats.mean, stats.min, stats.max, stats.p50, stats.p95);
+}
+
+static void write_json(FILE* fp, const std::string& device_name, uint32_t frame_count, const std::vector<Result>& results)
+{
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"device\": \"%s\",\n", device_name.c_str());
+    fprintf(fp, "  \"width\": %u,\n", kWidth);
+    fprintf(fp, "  \"height\": %u,\n", kHeight);
+    fprintf(fp, "  \"frame_count\": %u,\n", frame_count);
+    fprintf(fp, "  \"scenarios\": [\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& result = results[i];
+        fprintf(fp, "    {\n");
+        fprintf(fp, "      \"name\": \"%s\",\n", result.name);
+        fprintf(fp, "      \"type\": \"%s\",\n", result.compute ? "compute" : "graphics");
+        fprintf(fp, "      \"frames\": %u,\n", result.frame_count);
+        write_stats(fp, "cpu_frame_ms", result.cpu_ms);
+        if (result.gpu_valid) {
+            write_stats(fp, "gpu_frame_ms", result.gpu_ms);
+        }
+        fprintf(fp, "      \"draws_per_frame\": %u,\n", result.draws_per_frame);
+        fprintf(fp, "      \"dispatches_per_frame\": %u,\n", result.dispatches_per_frame);
+        if (result.statistics_valid) {
+            fprintf(fp, "      \"vertex_invocations\": %llu,\n", (unsigned long long)result.statistics.vertex_invocations);
+            fprintf(fp, "      \"fragment_invocations\": %llu,\n", (unsigned long long)result.statistics.fragment_invocations);
+            fprintf(fp, "      \"compute_invocations\": %llu,\n", (unsigned long long)result.statistics.compute_invocations);
+        }
+        fprintf(fp, "      \"memory_allocations\": %u,\n", result.memory_allocations);
+        fprintf(fp, "      \"memory_blocks\": %u,\n", result.memory_blocks);
+        fprintf(fp, "      \"descriptor_sets\": %u,\n", result.descriptor_sets);
+        fprintf(fp, "      \"descriptor_pools\": %u,\n", result.descriptor_pools);
+        fprintf(fp, "      \"pipelines\": %u,\n", result.pipelines);
+        fprintf(fp, "      \"frame_memory_allocations\": %lld,\n", (long long)result.frame_memory_allocations);
+        fprintf(fp, "      \"frame_descriptor_sets\": %lld\n", (long long)result.frame_descriptor_sets);
+        fprintf(fp, "    }%s\n", (i + 1 < results.size()) ? "," : "");
+    }
+    fprintf(fp, "  ]\n");
+    fprintf(fp, "}\n");
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t frame_count = kDefaultFrameCount;
+    if (argc > 1) {
+        frame_count = (uint32_t)std::max(1, atoi(argv[1]));
+    }
+    const char* output_file = ((argc > 2) && (0 != strcmp(argv[2], "-"))) ? argv[2] : nullptr;
+    m_trace_dir = getenv("SAMPLES_TRACE_DIR");
+    // Only warnings and errors, the results are what matters
+    m_verbose_log = false;
+
+    std::vector<Result> results;
+    for (const Scenario& scenario : kScenarios) {
+        bool selected = (argc <= 3);
+        for (int i = 3; i < argc; ++i) {
+            selected |= (0 == strcmp(argv[i], scenario.name));
+        }
+        if (selected) {
+            results.push_back(run_scenario(scenario, frame_count));
+        }
+    }
+
+    FILE* fp = (nullptr != output_file) ? fopen(output_file, "w") : stdout;
+    if (nullptr == fp) {
+        LOG("Failed to open " << output_file);
+        return EXIT_FAILURE;
+    }
+    write_json(fp, m_device_name, frame_count, results);
+    if (stdout != fp) {
+        fclose(fp);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -31,8 +31,6 @@ const std::string   kAssetDir = "../../samples/assets/";
 
 tr_renderer*        m_renderer = nullptr;
 tr_descriptor_set*  m_desc_set = nullptr;
-tr_cmd_pool*        m_cmd_pool = nullptr;
-tr_cmd**            m_cmds = nullptr;
 tr_shader_program*  m_shader = nullptr;
 tr_buffer*          m_rect_index_buffer = nullptr;
 tr_buffer*          m_rect_vertex_buffer = nullptr;
@@ -43,7 +41,6 @@ tr_buffer*          m_uniform_buffer = nullptr;
 
 uint32_t            s_window_width;
 uint32_t            s_window_height;
-uint64_t            s_frame_count = 0;
 
 #define LOG(STR)  { std::stringstream ss; ss << STR << std::endl; \
                     platform_log(ss.str().c_str()); }
@@ -161,9 +158,6 @@ void init_tiny_renderer(GLFWwindow* window)
 #endif
     tr_create_renderer("UniformBufferApp", &settings, &m_renderer);
 
-    tr_create_cmd_pool(m_renderer, m_renderer->graphics_queue, false, &m_cmd_pool);
-    tr_create_cmd_n(m_cmd_pool, false, kImageCount, &m_cmds);
-    
 #if defined(TINY_RENDERER_VK)
     // Uses HLSL source
     auto vert = load_file(kAssetDir + "uniformbuffer.vs.spv");
@@ -256,16 +250,10 @@ void destroy_tiny_renderer()
 
 void draw_frame()
 {
-    uint32_t frameIdx = s_frame_count % m_renderer->settings.swapchain.image_count;
-
-    tr_fence* image_acquired_fence = m_renderer->image_acquired_fences[frameIdx];
-    tr_semaphore* image_acquired_semaphore = m_renderer->image_acquired_semaphores[frameIdx];
-    tr_semaphore* render_complete_semaphores = m_renderer->render_complete_semaphores[frameIdx];
+    tr_frame* frame = nullptr;
+    tr_begin_frame(m_renderer, &frame);
 
-    tr_acquire_next_image(m_renderer, image_acquired_semaphore, image_acquired_fence);
-
-    uint32_t swapchain_image_index = m_renderer->swapchain_image_index;
-    tr_render_target* render_target = m_renderer->swapchain_render_targets[swapchain_image_index];
+    tr_render_target* render_target = frame->render_target;
 
     // No projection or view for GLFW since we don't have a math library
     float t = static_cast<float>(glfwGetTime());
@@ -279,9 +267,8 @@ void draw_frame()
     mvp[15] =  1.0f;
     memcpy(m_uniform_buffer->cpu_mapped_address, mvp.data(), mvp.size() * sizeof(float));
 
-    tr_cmd* cmd = m_cmds[frameIdx];
+    tr_cmd* cmd = frame->cmd;
 
-    tr_begin_cmd(cmd);
     tr_cmd_render_target_transition(cmd, render_target, tr_texture_usage_present, tr_texture_usage_color_attachment); 
     tr_cmd_set_viewport(cmd, 0, 0, s_window_width, s_window_height, 0.0f, 1.0f);
     tr_cmd_set_scissor(cmd, 0, 0, s_window_width, s_window_height);
@@ -295,12 +282,8 @@ void draw_frame()
     tr_cmd_draw_indexed(cmd, 6, 0);
     tr_cmd_end_render(cmd);
     tr_cmd_render_target_transition(cmd, render_target, tr_texture_usage_color_attachment, tr_texture_usage_present); 
-    tr_end_cmd(cmd);
-
-    tr_queue_submit(m_renderer->graphics_queue, 1, &cmd, 1, &image_acquired_semaphore, 1, &render_complete_semaphores);
-    tr_queue_present(m_renderer->present_queue, 1, &render_complete_semaphores);
 
-    tr_queue_wait_idle(m_renderer->graphics_queue);
+    tr_end_frame(m_renderer, frame);
 }
 
 int main(int argc, char **argv)
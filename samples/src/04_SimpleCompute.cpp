@@ -34,8 +34,6 @@ const std::string   kAssetDir = "../../samples/assets/";
 tr_renderer*        m_renderer = nullptr;
 tr_descriptor_set*  m_desc_set = nullptr;
 tr_descriptor_set*  m_compute_desc_set = nullptr;
-tr_cmd_pool*        m_cmd_pool = nullptr;
-tr_cmd**            m_cmds = nullptr;
 tr_shader_program*  m_compute_shader = nullptr;
 tr_shader_program*  m_texture_shader = nullptr;
 tr_buffer*          m_rect_index_buffer = nullptr;
@@ -48,7 +46,6 @@ tr_sampler*         m_sampler = nullptr;
 
 uint32_t            s_window_width;
 uint32_t            s_window_height;
-uint64_t            s_frame_count = 0;
 
 #define LOG(STR)  { std::stringstream ss; ss << STR << std::endl; \
                     platform_log(ss.str().c_str()); }
@@ -166,9 +163,6 @@ void init_tiny_renderer(GLFWwindow* window)
 #endif
     tr_create_renderer("SimpleCompute", &settings, &m_renderer);
 
-    tr_create_cmd_pool(m_renderer, m_renderer->graphics_queue, false, &m_cmd_pool);
-    tr_create_cmd_n(m_cmd_pool, false, kImageCount, &m_cmds);
-    
 #if defined(TINY_RENDERER_VK)
     // Uses HLSL source
     auto comp = load_file(kAssetDir + "simple_compute.cs.spv");
@@ -289,20 +283,12 @@ void destroy_tiny_renderer()
 
 void draw_frame()
 {
-    uint32_t frameIdx = s_frame_count % m_renderer->settings.swapchain.image_count;
-
-    tr_fence* image_acquired_fence = m_renderer->image_acquired_fences[frameIdx];
-    tr_semaphore* image_acquired_semaphore = m_renderer->image_acquired_semaphores[frameIdx];
-    tr_semaphore* render_complete_semaphores = m_renderer->render_complete_semaphores[frameIdx];
-
-    tr_acquire_next_image(m_renderer, image_acquired_semaphore, image_acquired_fence);
+    tr_frame* frame = nullptr;
+    tr_begin_frame(m_renderer, &frame);
 
-    uint32_t swapchain_image_index = m_renderer->swapchain_image_index;
-    tr_render_target* render_target = m_renderer->swapchain_render_targets[swapchain_image_index];
+    tr_render_target* render_target = frame->render_target;
+    tr_cmd* cmd = frame->cmd;
 
-    tr_cmd* cmd = m_cmds[frameIdx];
-
-    tr_begin_cmd(cmd);
     // Use compute to swizzle RGB -> BRG
     tr_cmd_image_transition(cmd, m_texture_compute_output, tr_texture_usage_sampled_image, tr_texture_usage_storage_image);
     tr_cmd_bind_pipeline(cmd, m_compute_pipeline);
@@ -325,12 +311,8 @@ void draw_frame()
     tr_cmd_draw_indexed(cmd, 6, 0);
     tr_cmd_end_render(cmd);
     tr_cmd_render_target_transition(cmd, render_target, tr_texture_usage_color_attachment, tr_texture_usage_present); 
-    tr_end_cmd(cmd);
-
-    tr_queue_submit(m_renderer->graphics_queue, 1, &cmd, 1, &image_acquired_semaphore, 1, &render_complete_semaphores);
-    tr_queue_present(m_renderer->present_queue, 1, &render_complete_semaphores);
 
-    tr_queue_wait_idle(m_renderer->graphics_queue);
+    tr_end_frame(m_renderer, frame);
 }
 
 int main(int argc, char **argv)
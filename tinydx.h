@@ -115,9 +115,15 @@ enum {
     tr_max_semantic_name_length      = 128,
     tr_max_descriptor_entries        = 256,
     tr_max_mip_levels                = 0xFFFFFFFF,
+    tr_max_frames_in_flight          = 8,
 };
 #endif
 
+// Frames tr_begin_frame/tr_end_frame keep in flight when the settings leave it at 0
+#if ! defined(TINY_RENDERER_DEFAULT_FRAMES_IN_FLIGHT)
+    #define TINY_RENDERER_DEFAULT_FRAMES_IN_FLIGHT 2
+#endif
+
 typedef enum tr_api {
     tr_api_d3d12 = 0,
     tr_api_vulkan
@@ -340,6 +346,8 @@ typedef struct tr_render_target tr_render_target;
 typedef struct tr_buffer tr_buffer;
 typedef struct tr_texture tr_texture;
 typedef struct tr_sampler tr_sampler;
+typedef struct tr_cmd_pool tr_cmd_pool;
+typedef struct tr_cmd tr_cmd;
 
 typedef struct tr_clear_value {
     union {
@@ -383,6 +391,7 @@ typedef struct tr_renderer_settings {
     uint32_t                            width;
     uint32_t                            height;
     tr_swapchain_settings               swapchain;
+    uint32_t                            frames_in_flight;
     tr_log_fn                           log_fn;
     D3D_FEATURE_LEVEL                   dx_feature_level;
     tr_dx_shader_target                 dx_shader_target;
@@ -404,6 +413,16 @@ typedef struct tr_queue {
     UINT64                              dx_wait_idle_fence_value;
 } tr_queue;
 
+typedef struct tr_frame {
+    uint32_t                            index;
+    tr_cmd_pool*                        cmd_pool;
+    tr_cmd*                             cmd;
+    uint32_t                            swapchain_image_index;
+    tr_render_target*                   render_target;
+    // Value of the queue's fence signaled after the frame's commands
+    UINT64                              dx_fence_value;
+} tr_frame;
+
 typedef struct tr_renderer {
     tr_api                              api;
     tr_renderer_settings                settings;
@@ -414,6 +433,9 @@ typedef struct tr_renderer {
     tr_fence**                          image_acquired_fences;
     tr_semaphore**                      image_acquired_semaphores;
     tr_semaphore**                      render_complete_semaphores;
+    uint32_t                            frame_count;
+    uint32_t                            frame_index;
+    tr_frame*                           frames;
 #if defined(_DEBUG)
     ID3D12Debug*                        dx_debug_ctrl;
 #endif
@@ -660,6 +682,11 @@ tr_api_export void tr_queue_submit(tr_queue* p_queue, uint32_t cmd_count, tr_cmd
 tr_api_export void tr_queue_present(tr_queue* p_queue, uint32_t wait_semaphore_count, tr_semaphore** pp_wait_semaphores);
 tr_api_export void tr_queue_wait_idle(tr_queue* p_queue);
 
+// Frame contexts - tr_begin_frame waits only on the frame slot being reused and resets its
+// command buffer. tr_end_frame ends, submits and presents it.
+tr_api_export void tr_begin_frame(tr_renderer* p_renderer, tr_frame** pp_frame);
+tr_api_export void tr_end_frame(tr_renderer* p_renderer, tr_frame* p_frame);
+
 tr_api_export void tr_render_target_set_color_clear_value(tr_render_target* p_render_target, uint32_t attachment_index, float r, float g, float b, float a);
 tr_api_export void tr_render_target_set_depth_stencil_clear_value(tr_render_target* p_render_target, float depth, uint8_t stencil);
 
@@ -802,6 +829,12 @@ void tr_internal_dx_queue_submit(tr_queue* p_queue, uint32_t cmd_count, tr_cmd**
 void tr_internal_dx_queue_present(tr_queue* p_queue, uint32_t wait_semaphore_count, tr_semaphore** pp_wait_semaphores);
 void tr_internal_dx_queue_wait_idle(tr_queue* p_queue);
 
+// Internal frame functions
+void tr_internal_dx_create_frames(tr_renderer* p_renderer);
+void tr_internal_dx_destroy_frames(tr_renderer* p_renderer);
+void tr_internal_dx_begin_frame(tr_renderer* p_renderer, tr_frame** pp_frame);
+void tr_internal_dx_end_frame(tr_renderer* p_renderer, tr_frame* p_frame);
+
 // Functions points for functions that need to be loaded
 PFN_D3D12_CREATE_ROOT_SIGNATURE_DESERIALIZER           fnD3D12CreateRootSignatureDeserializer          = NULL;
 PFN_D3D12_SERIALIZE_VERSIONED_ROOT_SIGNATURE           fnD3D12SerializeVersionedRootSignature          = NULL;
@@ -1110,6 +1143,9 @@ void tr_create_renderer(const char *app_name, const tr_renderer_settings* settin
             tr_create_semaphore(p_renderer, &(p_renderer->render_complete_semaphores[i]));
         }
 
+        // Frame contexts for tr_begin_frame/tr_end_frame
+        tr_internal_dx_create_frames(p_renderer);
+
         // Renderer is good! Assign it to result!
         *(pp_renderer) = p_renderer;
     }
@@ -1128,6 +1164,9 @@ void tr_destroy_renderer(tr_renderer* p_renderer)
                     
     }
 
+    // Destroy frame contexts - this waits for the frames still in flight
+    tr_internal_dx_destroy_frames(p_renderer);
+
     // Destroy render sync objects
     if (NULL != p_renderer->image_acquired_fences) {
         for (size_t i = 0; i < p_renderer->settings.swapchain.image_count; ++i) {
@@ -1993,6 +2032,23 @@ void tr_queue_wait_idle(tr_queue* p_queue)
     tr_internal_dx_queue_wait_idle(p_queue);
 }
 
+void tr_begin_frame(tr_renderer* p_renderer, tr_frame** pp_frame)
+{
+    TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
+    assert(NULL != pp_frame);
+
+    tr_internal_dx_begin_frame(p_renderer, pp_frame);
+}
+
+void tr_end_frame(tr_renderer* p_renderer, tr_frame* p_frame)
+{
+    TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
+    assert(NULL != p_frame);
+    assert(p_frame == &(p_renderer->frames[p_renderer->frame_index]));
+
+    tr_internal_dx_end_frame(p_renderer, p_frame);
+}
+
 void tr_render_target_set_color_clear_value(tr_render_target* p_render_target, uint32_t attachment_index, float r, float g, float b, float a)
 {
     assert(NULL != p_render_target);
@@ -4511,6 +4567,90 @@ void tr_internal_dx_queue_wait_idle(tr_queue* p_queue)
     }
 }
 
+// -------------------------------------------------------------------------------------------------
+// Internal frame functions
+// -------------------------------------------------------------------------------------------------
+void tr_internal_dx_create_frames(tr_renderer* p_renderer)
+{
+    uint32_t frame_count = p_renderer->settings.frames_in_flight;
+    if (0 == frame_count) {
+        frame_count = TINY_RENDERER_DEFAULT_FRAMES_IN_FLIGHT;
+    }
+    frame_count = frame_count > tr_max_frames_in_flight ? tr_max_frames_in_flight : frame_count;
+
+    p_renderer->frames = (tr_frame*)calloc(frame_count, sizeof(*(p_renderer->frames)));
+    assert(NULL != p_renderer->frames);
+
+    // Command allocators are reset as a whole, so each frame needs its own
+    for (uint32_t i = 0; i < frame_count; ++i) {
+        tr_frame* p_frame = &(p_renderer->frames[i]);
+        p_frame->index = i;
+        tr_create_cmd_pool(p_renderer, p_renderer->graphics_queue, true, &(p_frame->cmd_pool));
+        tr_create_cmd(p_frame->cmd_pool, false, &(p_frame->cmd));
+    }
+
+    p_renderer->frame_count = frame_count;
+    p_renderer->frame_index = 0;
+}
+
+void tr_internal_dx_destroy_frames(tr_renderer* p_renderer)
+{
+    if (NULL == p_renderer->frames) {
+        return;
+    }
+
+    tr_internal_dx_queue_wait_idle(p_renderer->graphics_queue);
+
+    for (uint32_t i = 0; i < p_renderer->frame_count; ++i) {
+        tr_frame* p_frame = &(p_renderer->frames[i]);
+        tr_destroy_cmd(p_frame->cmd_pool, p_frame->cmd);
+        tr_destroy_cmd_pool(p_renderer, p_frame->cmd_pool);
+    }
+
+    TINY_RENDERER_SAFE_FREE(p_renderer->frames);
+    p_renderer->frame_count = 0;
+}
+
+void tr_internal_dx_begin_frame(tr_renderer* p_renderer, tr_frame** pp_frame)
+{
+    assert(NULL != p_renderer->frames);
+
+    tr_queue* p_queue = p_renderer->graphics_queue;
+    tr_frame* p_frame = &(p_renderer->frames[p_renderer->frame_index]);
+
+    // Only the frame that last used this slot has to be done before its
+    // command allocator can be reset
+    if (p_queue->dx_wait_idle_fence->GetCompletedValue() < p_frame->dx_fence_value) {
+        p_queue->dx_wait_idle_fence->SetEventOnCompletion(p_frame->dx_fence_value, p_queue->dx_wait_idle_fence_event);
+        WaitForSingleObject(p_queue->dx_wait_idle_fence_event, INFINITE);
+    }
+
+    tr_internal_dx_acquire_next_image(p_renderer, NULL, NULL);
+    p_frame->swapchain_image_index = p_renderer->swapchain_image_index;
+    p_frame->render_target = p_renderer->swapchain_render_targets[p_frame->swapchain_image_index];
+
+    tr_internal_dx_begin_cmd(p_frame->cmd);
+
+    *pp_frame = p_frame;
+}
+
+void tr_internal_dx_end_frame(tr_renderer* p_renderer, tr_frame* p_frame)
+{
+    tr_queue* p_queue = p_renderer->graphics_queue;
+
+    tr_internal_dx_end_cmd(p_frame->cmd);
+
+    tr_internal_dx_queue_submit(p_queue, 1, &(p_frame->cmd), 0, NULL, 0, NULL);
+    tr_internal_dx_queue_present(p_renderer->present_queue, 0, NULL);
+
+    // Shares the wait idle fence, its value only ever increases
+    p_frame->dx_fence_value = p_queue->dx_wait_idle_fence_value;
+    p_queue->dx_queue->Signal(p_queue->dx_wait_idle_fence, p_frame->dx_fence_value);
+    ++p_queue->dx_wait_idle_fence_value;
+
+    p_renderer->frame_index = (p_renderer->frame_index + 1) % p_renderer->frame_count;
+}
+
 #endif // TINY_RENDERER_IMPLEMENTATION
 
 #if defined(__cplusplus) && defined(TINY_RENDERER_CPP_NAMESPACE)
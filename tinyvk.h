@@ -63,6 +63,7 @@ COMPILING & LINKING
 #include <assert.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -87,6 +88,15 @@ COMPILING & LINKING
 
 #include <vulkan/vulkan.h>
 
+// Worker threads for tr_create_pipeline_async and the tracer's clock
+#if defined(TINY_RENDERER_IMPLEMENTATION)
+    #if ! defined(_WIN32)
+        #include <pthread.h>
+        #include <time.h>
+        #include <unistd.h>
+    #endif
+#endif
+
 #if defined(__cplusplus) && defined(TINY_RENDERER_CPP_NAMESPACE)
 namespace TINY_RENDERER_CPP_NAMESPACE {
 #endif
@@ -114,9 +124,37 @@ enum {
     tr_max_semantic_name_length      = 128,
     tr_max_descriptor_entries        = 256,
     tr_max_mip_levels                = 0xFFFFFFFF,
+    tr_max_staging_submits           = 16,
+    tr_max_frames_in_flight          = 8,
+    tr_max_recording_threads         = 64,
 };
 #endif
 
+// Size of the device memory blocks that buffers and textures are suballocated from
+#if ! defined(TINY_RENDERER_MEMORY_BLOCK_SIZE)
+    #define TINY_RENDERER_MEMORY_BLOCK_SIZE (64ULL * 1024ULL * 1024ULL)
+#endif
+
+// Threads compiling tr_create_pipeline_async pipelines, 0 uses one less than the hardware thread count
+#if ! defined(TINY_RENDERER_PIPELINE_COMPILE_THREADS)
+    #define TINY_RENDERER_PIPELINE_COMPILE_THREADS 0
+#endif
+
+// Frames tr_begin_frame/tr_end_frame keep in flight when the settings leave it at 0
+#if ! defined(TINY_RENDERER_DEFAULT_FRAMES_IN_FLIGHT)
+    #define TINY_RENDERER_DEFAULT_FRAMES_IN_FLIGHT 2
+#endif
+
+// Sets each shared descriptor pool holds, pools get 4 descriptors of every type per set
+#if ! defined(TINY_RENDERER_DESCRIPTOR_POOL_SET_COUNT)
+    #define TINY_RENDERER_DESCRIPTOR_POOL_SET_COUNT 256
+#endif
+
+// Size of the persistently mapped staging ring used by the upload utility functions
+#if ! defined(TINY_RENDERER_STAGING_RING_SIZE)
+    #define TINY_RENDERER_STAGING_RING_SIZE (32ULL * 1024ULL * 1024ULL)
+#endif
+
 typedef enum tr_api {
     tr_api_vulkan = 0,
     tr_api_d3d12
@@ -206,6 +244,9 @@ typedef enum tr_texture_usage {
 
 typedef uint32_t tr_texture_usage_flags;
 
+// Identifies a batch of work recorded by the tr_util_*_async functions, see tr_upload_wait
+typedef uint64_t tr_upload_ticket;
+
 typedef enum tr_format {
     tr_format_undefined = 0,
     // 1 channel
@@ -325,12 +366,22 @@ typedef enum tr_pipeline_type {
   tr_pipeline_type_graphics
 } tr_pipeline_type;
 
+typedef enum tr_query_type {
+  tr_query_type_timestamp = 0,
+  tr_query_type_pipeline_statistics,
+  tr_query_type_occlusion
+} tr_query_type;
+
 // Forward declarations
 typedef struct tr_renderer tr_renderer;
 typedef struct tr_render_target tr_render_target;
 typedef struct tr_buffer tr_buffer;
 typedef struct tr_texture tr_texture;
 typedef struct tr_sampler tr_sampler;
+typedef struct tr_cmd_pool tr_cmd_pool;
+typedef struct tr_cmd tr_cmd;
+typedef struct tr_pipeline tr_pipeline;
+typedef struct tr_query_pool tr_query_pool;
 
 typedef struct tr_clear_value {
     union {
@@ -377,6 +428,14 @@ typedef struct tr_renderer_settings {
     uint32_t                            width;
     uint32_t                            height;
     tr_swapchain_settings               swapchain;
+    // Headless renderers use at most swapchain.image_count
+    uint32_t                            frames_in_flight;
+    // Threads that record into frames with tr_frame_get_thread_cmd, each gets its
+    // own command pool per frame
+    uint32_t                            recording_thread_count;
+    // No surface or swapchain - swapchain_render_targets are offscreen render targets
+    // and tr_end_frame skips present. handle is ignored.
+    bool                                headless;
     tr_log_fn                           log_fn;
     // Vulkan specific options
     tr_string_list                      instance_layers;
@@ -394,22 +453,366 @@ typedef struct tr_semaphore {
     VkSemaphore                         vk_semaphore;
 } tr_semaphore;
 
+// Needs VK_KHR_timeline_semaphore, see tr_renderer::vk_device_ext_VK_KHR_timeline_semaphore
+typedef struct tr_timeline {
+    tr_renderer*                        renderer;
+    VkSemaphore                         vk_semaphore;
+} tr_timeline;
+
+// One submit of a batch, binary semaphores and timelines can be mixed. Timelines need
+// the queue's timeline to be there.
+typedef struct tr_submit_info {
+    uint32_t                            cmd_count;
+    tr_cmd**                            pp_cmds;
+    uint32_t                            wait_semaphore_count;
+    tr_semaphore**                      pp_wait_semaphores;
+    uint32_t                            wait_timeline_count;
+    tr_timeline**                       pp_wait_timelines;
+    const uint64_t*                     p_wait_values;
+    uint32_t                            signal_semaphore_count;
+    tr_semaphore**                      pp_signal_semaphores;
+    uint32_t                            signal_timeline_count;
+    tr_timeline**                       pp_signal_timelines;
+    const uint64_t*                     p_signal_values;
+} tr_submit_info;
+
+// The Vulkan structs of a submit are built in these, they only grow
+typedef struct tr_submit_scratch {
+    uint32_t                            submit_capacity;
+    VkSubmitInfo*                       submit_infos;
+    VkTimelineSemaphoreSubmitInfoKHR*   timeline_infos;
+    uint32_t                            cmd_capacity;
+    VkCommandBuffer*                    cmds;
+    uint32_t                            wait_capacity;
+    VkSemaphore*                        wait_semaphores;
+    VkPipelineStageFlags*               wait_masks;
+    uint64_t*                           wait_values;
+    uint32_t                            signal_capacity;
+    VkSemaphore*                        signal_semaphores;
+    uint64_t*                           signal_values;
+} tr_submit_scratch;
+
+// Each submit on the queue signals timeline with the next submit_value, so waiting for
+// submit_value waits for everything submitted so far. timeline is NULL without timeline
+// semaphore support.
 typedef struct tr_queue {
     tr_renderer*                        renderer;
     VkQueue                             vk_queue;
     uint32_t                            vk_queue_family_index;
+    VkQueueFlags                        vk_queue_flags;
+    uint32_t                            vk_timestamp_valid_bits;
+    tr_timeline*                        timeline;
+    uint64_t                            submit_value;
+    tr_submit_scratch                   submit_scratch;
 } tr_queue;
 
+// Command buffers a recording thread took from its pool this frame are cmds[0, used_count),
+// the rest are left over from earlier frames and get handed out again
+typedef struct tr_frame_thread {
+    tr_cmd_pool*                        cmd_pool;
+    uint32_t                            cmd_count;
+    uint32_t                            cmd_capacity;
+    uint32_t                            used_count;
+    tr_cmd**                            cmds;
+} tr_frame_thread;
+
+typedef struct tr_frame {
+    uint32_t                            index;
+    tr_cmd_pool*                        cmd_pool;
+    tr_cmd*                             cmd;
+    uint32_t                            thread_count;
+    tr_frame_thread*                    threads;
+    uint32_t                            submit_cmd_capacity;
+    tr_cmd**                            submit_cmds;
+    tr_fence*                           fence;
+    bool                                fence_pending;
+    uint64_t                            submit_value;
+    tr_semaphore*                       image_acquired_semaphore;
+    tr_semaphore*                       render_complete_semaphore;
+    uint32_t                            swapchain_image_index;
+    tr_render_target*                   render_target;
+} tr_frame;
+
+/*
+
+Query pools are rings of per-frame slots. tr_cmd_begin_query_frame moves to the next slot,
+reads back what the slot recorded last time around and resets it. The read back never waits:
+if the GPU isn't done with the slot the results are skipped and the previous ones stay.
+
+With tr_begin_frame/tr_end_frame the ring has one slot more than there are frames in flight,
+so by the time a slot comes around again its frame has been waited on and nothing is
+skipped. Timer results are in milliseconds and lag frames_in_flight + 1 frames behind.
+
+Pipeline statistics and occlusion queries are copied on the GPU into results_buffer by
+tr_cmd_resolve_queries. Each query takes result_stride uint64_t values - the counters followed
+by an availability word - and slot N starts at N * slot_query_count * result_stride. The buffer
+is host visible and can also be bound as a storage buffer, e.g. to cull against occlusion
+results on the GPU. tr_cmd_begin_query_frame zeroes the slot's results on the GPU along with
+the query reset, so only the copy recorded for the slot's current round can set its
+availability words. Queries that haven't landed yet are left for later rather than waited on.
+
+*/
+typedef struct tr_pipeline_statistics {
+    uint64_t                            vertex_invocations;
+    uint64_t                            fragment_invocations;
+    uint64_t                            compute_invocations;
+} tr_pipeline_statistics;
+
+typedef struct tr_query_pool {
+    tr_renderer*                        renderer;
+    tr_query_type                       type;
+    uint32_t                            query_count;
+    uint32_t                            slot_count;
+    uint32_t                            slot_query_count;
+    uint32_t                            slot_index;
+    uint32_t*                           slot_used_counts;
+    uint64_t*                           slot_frame_numbers;
+    uint64_t                            frame_number;
+    uint64_t                            timestamp_mask;
+    double                              timestamp_period;
+    uint64_t*                           query_data;
+    const char**                        timer_names;
+    uint32_t                            result_stride;
+    tr_buffer*                          results_buffer;
+    uint32_t                            resolved_query_count;
+    double*                             resolved_timer_ms;
+    uint64_t*                           resolved_results;
+    uint64_t                            resolved_frame_number;
+    VkQueryPool                         vk_query_pool;
+} tr_query_pool;
+
+/*
+
+Device memory is suballocated from large blocks. Each block belongs to a single memory type
+and holds either linear (buffers, linear images) or optimal (optimal images) resources, so
+bufferImageGranularity never has to be checked between neighboring allocations. Free space
+inside a block is tracked as a list of ranges sorted by offset.
+
+*/
+typedef struct tr_memory_range {
+    uint64_t                            offset;
+    uint64_t                            size;
+} tr_memory_range;
+
+typedef struct tr_memory_block tr_memory_block;
+
+typedef struct tr_memory_block {
+    tr_memory_block*                    next;
+    uint32_t                            memory_type_index;
+    bool                                linear;
+    bool                                dedicated;  // sized for one oversized request
+    uint64_t                            size;
+    uint32_t                            allocation_count;
+    uint32_t                            free_range_count;
+    uint32_t                            free_range_capacity;
+    tr_memory_range*                    free_ranges;
+    void*                               cpu_mapped_address;
+    VkDeviceMemory                      vk_memory;
+} tr_memory_block;
+
+typedef struct tr_memory_allocation {
+    tr_memory_block*                    block;
+    uint64_t                            offset;
+    uint64_t                            size;
+} tr_memory_allocation;
+
+typedef struct tr_memory_allocator {
+    uint64_t                            block_size;
+    uint32_t                            block_count;
+    uint32_t                            allocation_count;
+    tr_memory_block*                    blocks[VK_MAX_MEMORY_TYPES][2];
+} tr_memory_allocator;
+
+/*
+
+Descriptor sets are allocated from a list of shared pools. The allocator keeps track of how
+many sets and descriptors of each type are left in every pool, so vkAllocateDescriptorSets is
+only called on a pool that can hold the set. Sets that need more descriptors of a type than a
+pool holds get a pool of their own size.
+
+Set layouts are cached on their bindings, sets with the same bindings share one
+VkDescriptorSetLayout. Cached layouts live until the renderer is destroyed.
+
+Every set keeps a copy of the descriptor infos it last wrote (descriptor_data), laid out per
+binding as tightly packed arrays of VkDescriptorImageInfo, VkDescriptorBufferInfo or VkBufferView.
+tr_update_descriptor_set compares the current resources against it and only writes elements
+that changed. The same data is the source for the layout's VkDescriptorUpdateTemplate, which is
+used once every element of the set has been written. Besides the infos each element keeps the
+serial of the resource written to it. Every buffer, texture and sampler gets a new serial when
+it is created, so a resource that is destroyed and recreated with the same Vulkan handles is
+still picked up as a change.
+
+*/
+typedef struct tr_descriptor_pool tr_descriptor_pool;
+
+typedef struct tr_descriptor_pool {
+    tr_descriptor_pool*                 next;
+    uint32_t                            set_count;
+    uint32_t                            free_set_count;
+    uint32_t                            free_descriptor_counts[VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT + 1];
+    VkDescriptorPool                    vk_descriptor_pool;
+} tr_descriptor_pool;
+
+typedef struct tr_descriptor_layout tr_descriptor_layout;
+
+typedef struct tr_descriptor_layout {
+    tr_descriptor_layout*               next;
+    uint64_t                            hash;
+    uint32_t                            binding_count;
+    VkDescriptorSetLayoutBinding*       bindings;
+    uint32_t                            descriptor_counts[VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT + 1];
+    uint32_t*                           binding_data_offsets;
+    uint32_t                            data_size;
+    uint32_t                            element_count;
+    VkDescriptorSetLayout               vk_descriptor_set_layout;
+    VkDescriptorUpdateTemplateKHR       vk_descriptor_update_template;
+} tr_descriptor_layout;
+
+typedef struct tr_descriptor_allocator {
+    uint32_t                            pool_set_count;
+    uint32_t                            pool_count;
+    uint32_t                            set_count;
+    uint32_t                            layout_count;
+    tr_descriptor_pool*                 pools;
+    tr_descriptor_layout*               layouts;
+} tr_descriptor_allocator;
+
+/*
+
+Upload data is written linearly into a persistently mapped staging ring. Positions in the
+ring (head, tail, ring_end, ring_begin) count bytes since the ring was created, the byte
+offset in the buffer is the position modulo the ring size. Copies out of the ring are either
+recorded into an internal batch command buffer, which is submitted ahead of the next submit
+on the ring's queue family, or into a command buffer supplied by the caller. Each submit that
+consumes ring data is tracked through the queue's timeline (queue_value), or a fence without
+timeline semaphores. Once it has completed the ring space up to ring_end is reused.
+
+Ring space taken by tr_util_update_buffer_cmd stays held until the caller submits its command
+buffer. If that leaves no room for a batch upload, the upload is staged in a dedicated buffer
+instead (overflows). The buffer is destroyed once the submit that carries the batch completes.
+
+Submits are numbered in order starting at 1. An upload ticket is the serial of the submit
+that carries the upload's batch, it has completed once complete_serial has caught up with it.
+The ring is not thread safe, uploads and tickets must be used from one thread at a time.
+
+There is a ring for the graphics queue and, if the device has a transfer-only queue family,
+one for the transfer queue. Uploads on the transfer queue release ownership of the resource
+to the graphics family and record the matching acquire into the graphics ring's batch. That
+batch then waits on the transfer queue's timeline, or without timeline semaphores on a binary
+semaphore signaled on the transfer queue (transfer_wait).
+
+*/
+typedef struct tr_staging_submit {
+    tr_cmd*                             cmd;
+    tr_fence*                           fence;
+    tr_semaphore*                       semaphore;
+    uint64_t                            ring_end;
+    uint64_t                            serial;
+    uint64_t                            queue_value;
+} tr_staging_submit;
+
+typedef struct tr_staging_pending_cmd {
+    tr_cmd*                             cmd;
+    uint64_t                            ring_begin;
+} tr_staging_pending_cmd;
+
+typedef struct tr_staging_overflow {
+    tr_buffer*                          buffer;
+    uint64_t                            serial;
+} tr_staging_overflow;
+
+// Worker pool behind tr_create_pipeline_async, only defined in the implementation
+typedef struct tr_pipeline_compiler tr_pipeline_compiler;
+
+// Event recorder behind tr_begin_trace/tr_end_trace, only defined in the implementation
+typedef struct tr_tracer tr_tracer;
+
+/*
+
+Pipelines are deduplicated through a registry keyed on everything that goes into the
+VkPipelineLayout and VkPipeline. The inputs are hashed by content rather than by pointer,
+so a shader program or descriptor set that is destroyed and recreated with the same contents
+still finds its pipeline, and a new object that reuses a freed address does not alias one.
+Identical layouts and compatible render passes produce the same Vulkan objects, so only the
+parts that matter for compatibility are hashed.
+
+A hit returns the existing pipeline with its reference count incremented, tr_destroy_pipeline
+only destroys it once the count drops to zero. The registry is not thread safe.
+
+Each key also owns a copy of the bytes that went into its hashes, including the shader code
+and entry points. Matching hashes are confirmed against that copy, so a hash collision misses
+instead of returning some other pipeline.
+
+*/
+typedef struct tr_pipeline_key {
+    tr_pipeline_type                    type;
+    uint64_t                            shader_hash;
+    uint64_t                            descriptor_hash;
+    uint64_t                            render_pass_hash;
+    uint64_t                            vertex_layout_hash;
+    uint64_t                            settings_hash;
+    uint32_t                            content_size;
+    uint8_t*                            content;
+    // Part of content that went into descriptor_hash
+    uint32_t                            descriptor_content_offset;
+    uint32_t                            descriptor_content_size;
+} tr_pipeline_key;
+
+typedef struct tr_pipeline_registry {
+    uint32_t                            bucket_count;
+    uint32_t                            pipeline_count;
+    tr_pipeline**                       buckets;
+    uint64_t                            hit_count;
+    uint64_t                            miss_count;
+} tr_pipeline_registry;
+
+typedef struct tr_staging_ring {
+    tr_queue*                           queue;
+    tr_buffer*                          buffer;
+    tr_cmd_pool*                        cmd_pool;
+    uint64_t                            size;
+    uint64_t                            head;
+    uint64_t                            tail;
+    bool                                recording;
+    bool                                transfer_wait;
+    uint64_t                            submit_serial;
+    uint64_t                            complete_serial;
+    uint32_t                            submit_first;
+    uint32_t                            submit_count;
+    tr_staging_submit                   submits[tr_max_staging_submits];
+    uint32_t                            pending_cmd_count;
+    uint32_t                            pending_cmd_capacity;
+    tr_staging_pending_cmd*             pending_cmds;
+    uint32_t                            overflow_count;
+    uint32_t                            overflow_capacity;
+    tr_staging_overflow*                overflows;
+} tr_staging_ring;
+
 typedef struct tr_renderer {
     tr_api                              api;
     tr_renderer_settings                settings;
     tr_render_target**                  swapchain_render_targets;
     uint32_t                            swapchain_image_index;
+    // Images handed out by the headless acquire so far
+    uint32_t                            headless_acquire_count;
     tr_queue*                           graphics_queue;
     tr_queue*                           present_queue;
+    tr_queue*                           transfer_queue;
     tr_fence**                          image_acquired_fences;
     tr_semaphore**                      image_acquired_semaphores;
     tr_semaphore**                      render_complete_semaphores;
+    uint32_t                            frame_count;
+    uint32_t                            frame_index;
+    tr_frame*                           frames;
+    tr_memory_allocator*                memory_allocator;
+    tr_descriptor_allocator*            descriptor_allocator;
+    tr_staging_ring*                    staging_ring;
+    tr_staging_ring*                    transfer_staging_ring;
+    tr_pipeline_compiler*               pipeline_compiler;
+    tr_pipeline_registry*               pipeline_registry;
+    tr_tracer*                          tracer;
+    // Last serial handed to a buffer, texture or sampler
+    uint64_t                            resource_serial;
     VkInstance                          vk_instance;
     uint32_t                            vk_gpu_count;
     VkPhysicalDevice                    vk_gpus[tr_max_gpus];
@@ -421,7 +824,18 @@ typedef struct tr_renderer {
     VkSurfaceKHR                        vk_surface;
     VkSwapchainKHR                      vk_swapchain;
     VkDebugReportCallbackEXT            vk_debug_report;
+    VkPipelineCache                     vk_pipeline_cache;
     bool                                vk_device_ext_VK_AMD_negative_viewport_height;
+    // Shader stages the device has enabled, geometry and tessellation are optional features
+    VkPipelineStageFlags                vk_shader_stages;
+    bool                                vk_device_ext_VK_KHR_descriptor_update_template;
+    PFN_vkCreateDescriptorUpdateTemplateKHR  vk_create_descriptor_update_template;
+    PFN_vkDestroyDescriptorUpdateTemplateKHR vk_destroy_descriptor_update_template;
+    PFN_vkUpdateDescriptorSetWithTemplateKHR vk_update_descriptor_set_with_template;
+    bool                                vk_device_ext_VK_KHR_timeline_semaphore;
+    PFN_vkWaitSemaphoresKHR             vk_wait_semaphores;
+    PFN_vkSignalSemaphoreKHR            vk_signal_semaphore;
+    PFN_vkGetSemaphoreCounterValueKHR   vk_get_semaphore_counter_value;
 } tr_renderer;
 
 typedef struct tr_descriptor {
@@ -438,6 +852,12 @@ typedef struct tr_descriptor {
 typedef struct tr_descriptor_set {
     uint32_t                            descriptor_count;
     tr_descriptor*                      descriptors;
+    tr_descriptor_pool*                 pool;
+    tr_descriptor_layout*               layout;
+    uint8_t*                            descriptor_data;
+    // Serial of the resource last written to each element, 0 if none
+    uint64_t*                           descriptor_serials;
+    uint32_t                            unwritten_count;
     VkDescriptorSetLayout               vk_descriptor_set_layout;
     VkDescriptorSet                     vk_descriptor_set;
     VkDescriptorPool                    vk_descriptor_pool;
@@ -445,12 +865,36 @@ typedef struct tr_descriptor_set {
 
 typedef struct tr_cmd_pool {
     tr_renderer*                        renderer;
+    tr_queue*                           queue;
     VkCommandPool                       vk_cmd_pool;
 } tr_cmd_pool;
 
 typedef struct tr_cmd {
     tr_cmd_pool*                        cmd_pool;
+    bool                                secondary;
+    // Set between tr_cmd_begin_render and tr_cmd_end_render, and for the whole of a
+    // secondary command buffer begun inside a render pass
+    tr_render_target*                   bound_render_target;
+    bool                                render_secondary_contents;
+    // The last pipelines passed to tr_cmd_bind_pipeline and what they resolved to, graphics then
+    // compute - an async pipeline can finish compiling between binds, later binds stay on the resolved one
+    tr_pipeline*                        bound_pipelines[2];
+    tr_pipeline*                        bound_resolved_pipelines[2];
     VkCommandBuffer                     vk_cmd_buf;
+    // Holds staging ring space from tr_util_update_buffer_cmd until it's submitted
+    bool                                staging_pending;
+    // Recorded since the last tr_begin_cmd
+    uint32_t                            draw_count;
+    uint32_t                            dispatch_count;
+    // Transitions requested since the last flush, they go out as one vkCmdPipelineBarrier
+    VkPipelineStageFlags                pending_src_stages;
+    VkPipelineStageFlags                pending_dst_stages;
+    uint32_t                            pending_buffer_barrier_count;
+    uint32_t                            pending_buffer_barrier_capacity;
+    VkBufferMemoryBarrier*              pending_buffer_barriers;
+    uint32_t                            pending_image_barrier_count;
+    uint32_t                            pending_image_barrier_capacity;
+    VkImageMemoryBarrier*               pending_image_barriers;
 } tr_cmd;
 
 typedef struct tr_buffer {
@@ -466,14 +910,19 @@ typedef struct tr_buffer {
     uint64_t                            struct_stride;
     bool                                raw;
     void*                               cpu_mapped_address;
+    // Usages the last recorded transition left the buffer in
+    tr_buffer_usage                     state;
     VkBuffer                            vk_buffer;
     VkDeviceMemory                      vk_memory;
+    tr_memory_allocation                vk_allocation;
     // Used for uniform and storage buffers
     VkDescriptorBufferInfo              vk_buffer_info;
     // Used for uniform texel and storage texel buffers
     VkBufferView                        vk_buffer_view;
     // Counter buffer
     tr_buffer*                          counter_buffer;
+    // Unique per created buffer, see tr_update_descriptor_set
+    uint64_t                            serial;
 } tr_buffer;
 
 typedef struct tr_texture {
@@ -490,18 +939,25 @@ typedef struct tr_texture {
     tr_clear_value                      clear_value;
     bool                                host_visible;
     void*                               cpu_mapped_address;
+    // Usage the last recorded transition left the texture in
+    tr_texture_usage                    state;
     uint32_t                            owns_image;
     VkImage                             vk_image;
     VkDeviceMemory                      vk_memory;
+    tr_memory_allocation                vk_allocation;
     VkImageView                         vk_image_view;
     VkImageAspectFlags                  vk_aspect_mask;
     VkDescriptorImageInfo               vk_texture_view;
+    // Unique per created view, see tr_update_descriptor_set
+    uint64_t                            serial;
 } tr_texture;
 
 typedef struct tr_sampler {
     tr_renderer*                        renderer;
     VkSampler                           vk_sampler;
     VkDescriptorImageInfo               vk_sampler_view;
+    // Unique per created sampler, see tr_update_descriptor_set
+    uint64_t                            serial;
 } tr_sampler;
 
 typedef struct tr_shader_program {
@@ -519,6 +975,11 @@ typedef struct tr_shader_program {
     const char*                         geom_entry_point;
     const char*                         frag_entry_point;
     const char*                         comp_entry_point;
+    // Content hash of the stages, used to key the pipeline registry
+    uint64_t                            hash;
+    // Stage sizes, code and entry points as hashed, copied into pipeline keys
+    uint32_t                            content_size;
+    uint8_t*                            content;
 } tr_shader_program;
 
 typedef struct tr_vertex_attrib {
@@ -548,6 +1009,14 @@ typedef struct tr_pipeline {
     tr_renderer*                        renderer;
     tr_pipeline_settings                settings;
     tr_pipeline_type                    type;
+    // Async pipelines bind the placeholder until their compile job is done
+    bool                                compile_async;
+    bool                                compile_pending;
+    tr_pipeline*                        placeholder;
+    uint32_t                            ref_count;
+    uint64_t                            state_hash;
+    tr_pipeline_key                     state_key;
+    tr_pipeline*                        registry_next;
     VkPipelineLayout                    vk_pipeline_layout;
     VkPipeline                          vk_pipeline;
 } tr_pipeline;
@@ -567,6 +1036,112 @@ typedef struct tr_render_target {
     VkFramebuffer                       vk_framebuffer;
 } tr_render_target;
 
+/*
+
+A render graph records a frame as passes that declare the resources they read and write.
+tr_render_graph_compile drops passes whose output never reaches an imported resource, orders
+the rest and creates the graph's transient render targets. tr_render_graph_execute records the
+passes with the transitions they need, batched into one barrier in front of each pass.
+
+Passes are ordered by their dependencies (read after write, write after write and write after
+read on the same resource), declaration order breaks ties. Among the passes that are ready, one
+that doesn't depend on the pass just scheduled goes first, so producers and consumers end up
+further apart and the barrier between them has other work to overlap with.
+
+Imported resources belong to the caller and can be rebound between executes, e.g. to the
+swapchain render target of the current frame. Transient render targets belong to the graph
+and only live from the first to the last scheduled pass that uses them. Transients whose
+lifetimes don't overlap are placed at the same offset of one memory allocation, the first pass
+that uses one discards the contents left by whatever was there before. Render passes clear
+their attachments, so a pass that renders to a target doesn't depend on earlier writes to it
+and nothing carries over between executes.
+
+Resources and passes are referred to by the index they were added at. Adding passes or
+resources after compiling needs another compile, and the GPU has to be done with the last
+execute before a graph is compiled again or destroyed.
+
+*/
+typedef void(*tr_render_graph_execute_fn)(tr_cmd* p_cmd, void* p_user_data);
+
+typedef enum tr_render_graph_resource_type {
+    tr_render_graph_resource_type_buffer = 0,
+    tr_render_graph_resource_type_texture,
+    tr_render_graph_resource_type_render_target
+} tr_render_graph_resource_type;
+
+typedef struct tr_render_graph_access {
+    uint32_t                            resource;
+    bool                                write;
+    // tr_buffer_usage or tr_texture_usage, render targets go by write
+    uint32_t                            usage;
+} tr_render_graph_access;
+
+typedef struct tr_render_graph_resource {
+    tr_render_graph_resource_type       type;
+    bool                                transient;
+    tr_buffer*                          buffer;
+    tr_texture*                         texture;
+    tr_render_target*                   render_target;
+    // Description of a transient render target
+    uint32_t                            width;
+    uint32_t                            height;
+    tr_sample_count                     sample_count;
+    tr_format                           color_format;
+    uint32_t                            color_attachment_count;
+    tr_clear_value                      color_clear_values[tr_max_render_target_attachments];
+    tr_format                           depth_stencil_format;
+    tr_clear_value                      depth_stencil_clear_value;
+    // Set by tr_render_graph_compile, uses are positions in the schedule
+    uint32_t                            first_use;
+    uint32_t                            last_use;
+    uint32_t                            heap_index;
+    uint64_t                            heap_offset;
+    uint64_t                            size;
+    uint64_t                            alignment;
+    uint32_t                            memory_type_bits;
+} tr_render_graph_resource;
+
+typedef struct tr_render_graph_pass {
+    const char*                         name;
+    tr_render_graph_execute_fn          execute_fn;
+    void*                               user_data;
+    // Resource the pass renders to, UINT32_MAX if it doesn't begin a render pass
+    uint32_t                            render_target;
+    uint32_t                            access_count;
+    uint32_t                            access_capacity;
+    tr_render_graph_access*             accesses;
+    bool                                culled;
+} tr_render_graph_pass;
+
+typedef struct tr_render_graph_heap {
+    uint32_t                            memory_type_bits;
+    uint64_t                            alignment;
+    uint64_t                            size;
+    tr_memory_allocation                vk_allocation;
+} tr_render_graph_heap;
+
+typedef struct tr_render_graph {
+    tr_renderer*                        renderer;
+    uint32_t                            resource_count;
+    uint32_t                            resource_capacity;
+    tr_render_graph_resource*           resources;
+    uint32_t                            pass_count;
+    uint32_t                            pass_capacity;
+    tr_render_graph_pass*               passes;
+    bool                                compiled;
+    // Passes in execution order, culled passes are left out
+    uint32_t                            schedule_count;
+    uint32_t*                           schedule;
+    uint32_t                            culled_pass_count;
+    uint32_t                            heap_count;
+    tr_render_graph_heap*               heaps;
+    // Memory the transients take up, and would take up without aliasing
+    uint64_t                            transient_memory_size;
+    uint64_t                            transient_unaliased_size;
+    uint32_t                            alias_capacity;
+    tr_texture**                        aliases;
+} tr_render_graph;
+
 typedef struct tr_mesh {
     tr_renderer*                        renderer;
     tr_buffer*                          uniform_buffer;
@@ -594,6 +1169,15 @@ tr_api_export void tr_destroy_fence(tr_renderer* p_renderer, tr_fence* p_fence);
 tr_api_export void tr_create_semaphore(tr_renderer* p_renderer, tr_semaphore** pp_semaphore);
 tr_api_export void tr_destroy_semaphore(tr_renderer* p_renderer, tr_semaphore* p_semaphore);
 
+// Timeline semaphores - a 64-bit counter that only goes up, signaled and waited on from
+// submits or the host. A wait for a value is satisfied once the counter reaches it.
+// tr_timeline_wait returns false if timeout_ns ran out first.
+tr_api_export void     tr_create_timeline(tr_renderer* p_renderer, uint64_t initial_value, tr_timeline** pp_timeline);
+tr_api_export void     tr_destroy_timeline(tr_renderer* p_renderer, tr_timeline* p_timeline);
+tr_api_export uint64_t tr_timeline_get_value(tr_timeline* p_timeline);
+tr_api_export bool     tr_timeline_wait(tr_timeline* p_timeline, uint64_t value, uint64_t timeout_ns);
+tr_api_export void     tr_timeline_signal(tr_timeline* p_timeline, uint64_t value);
+
 tr_api_export void tr_create_descriptor_set(tr_renderer* p_renderer, uint32_t descriptor_count, const tr_descriptor* descriptors, tr_descriptor_set** pp_descriptor_set);
 tr_api_export void tr_destroy_descriptor_set(tr_renderer* p_renderer, tr_descriptor_set* p_descriptor_set);
 
@@ -632,6 +1216,21 @@ tr_api_export void tr_create_pipeline(tr_renderer* p_renderer, tr_shader_program
 tr_api_export void tr_create_compute_pipeline(tr_renderer* p_renderer, tr_shader_program* p_shader_program, tr_descriptor_set* p_descriptor_set, const tr_pipeline_settings* p_pipeline_settings, tr_pipeline** pp_pipeline);
 tr_api_export void tr_destroy_pipeline(tr_renderer* p_renderer, tr_pipeline* p_pipeline);
 
+// Async pipelines are compiled on worker threads and returned right away. Until they're ready, binding one
+// binds p_placeholder instead, or blocks until the compile is done if there is no placeholder. The shader
+// program, descriptor set and render target have to stay alive until the pipeline is ready. The placeholder
+// must be created with a descriptor set with the same layout, so its pipeline layout is compatible - descriptor
+// sets bound after tr_cmd_bind_pipeline use the layout of whichever pipeline was actually bound.
+tr_api_export void tr_create_pipeline_async(tr_renderer* p_renderer, tr_shader_program* p_shader_program, const tr_vertex_layout* p_vertex_layout, tr_descriptor_set* p_descriptor_set, tr_render_target* p_render_target, const tr_pipeline_settings* p_pipeline_settings, tr_pipeline* p_placeholder, tr_pipeline** pp_pipeline);
+tr_api_export void tr_create_compute_pipeline_async(tr_renderer* p_renderer, tr_shader_program* p_shader_program, tr_descriptor_set* p_descriptor_set, const tr_pipeline_settings* p_pipeline_settings, tr_pipeline* p_placeholder, tr_pipeline** pp_pipeline);
+tr_api_export bool tr_pipeline_is_ready(tr_pipeline* p_pipeline);
+tr_api_export void tr_pipeline_wait(tr_pipeline* p_pipeline);
+
+// All pipelines are created through the renderer's pipeline cache. Loading merges a file written by
+// tr_save_pipeline_cache into it - files from a different driver or GPU are rejected and false is returned.
+tr_api_export bool tr_load_pipeline_cache(tr_renderer* p_renderer, const char* file_path);
+tr_api_export bool tr_save_pipeline_cache(tr_renderer* p_renderer, const char* file_path);
+
 tr_api_export void tr_create_render_target(tr_renderer* p_renderer, uint32_t width, uint32_t height, tr_sample_count sample_count, tr_format color_format, uint32_t color_attachment_count, const tr_clear_value* color_clear_values, tr_format depth_stencil_format, const tr_clear_value* depth_stencil_clear_value, tr_render_target** pp_render_target);
 tr_api_export void tr_destroy_render_target(tr_renderer* p_renderer, tr_render_target* p_render_target);
 
@@ -641,6 +1240,16 @@ tr_api_export void tr_begin_cmd(tr_cmd* p_cmd);
 tr_api_export void tr_end_cmd(tr_cmd* p_cmd);
 tr_api_export void tr_cmd_begin_render(tr_cmd* p_cmd, tr_render_target* p_render_target);
 tr_api_export void tr_cmd_end_render(tr_cmd* p_cmd);
+
+// Secondary command buffers - tr_begin_secondary_cmd with a render target records draws for a
+// render pass begun with tr_cmd_begin_render_secondary, which can then only be filled through
+// tr_cmd_execute_cmds. The framebuffer isn't inherited, so one secondary works for every render
+// target with compatible attachments, e.g. all swapchain images. Viewport and scissor aren't
+// inherited either and have to be set in the secondary. Secondaries are begun for simultaneous
+// use and can be recorded once and executed every frame.
+tr_api_export void tr_begin_secondary_cmd(tr_cmd* p_cmd, tr_render_target* p_render_target);
+tr_api_export void tr_cmd_begin_render_secondary(tr_cmd* p_cmd, tr_render_target* p_render_target);
+tr_api_export void tr_cmd_execute_cmds(tr_cmd* p_cmd, uint32_t cmd_count, tr_cmd** pp_cmds);
 tr_api_export void tr_cmd_set_viewport(tr_cmd* p_cmd, float x, float, float width, float height, float min_depth, float max_depth);
 tr_api_export void tr_cmd_set_scissor(tr_cmd* p_cmd, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
 tr_api_export void tr_cmd_bind_pipeline(tr_cmd* p_cmd, tr_pipeline* p_pipeline);
@@ -652,15 +1261,94 @@ tr_api_export void tr_cmd_draw_indexed(tr_cmd* p_cmd, uint32_t index_count, uint
 tr_api_export void tr_cmd_draw_mesh(tr_cmd* p_cmd, const tr_mesh* p_mesh);
 tr_api_export void tr_cmd_buffer_transition(tr_cmd* p_cmd, tr_buffer* p_buffer, tr_buffer_usage old_usage, tr_buffer_usage new_usage);
 tr_api_export void tr_cmd_image_transition(tr_cmd* p_cmd, tr_texture* p_texture, tr_texture_usage old_usage, tr_texture_usage new_usage);
+tr_api_export void tr_cmd_buffer_queue_transfer(tr_cmd* p_cmd, tr_buffer* p_buffer, tr_queue* p_src_queue, tr_queue* p_dst_queue, tr_buffer_usage old_usage, tr_buffer_usage new_usage);
+tr_api_export void tr_cmd_image_queue_transfer(tr_cmd* p_cmd, tr_texture* p_texture, tr_queue* p_src_queue, tr_queue* p_dst_queue, tr_texture_usage old_usage, tr_texture_usage new_usage);
 tr_api_export void tr_cmd_render_target_transition(tr_cmd* p_cmd, tr_render_target* p_render_target, tr_texture_usage old_usage, tr_texture_usage new_usage);
+// Transitions from whatever state the last transition recorded left the resource in. They're
+// batched in p_cmd and go out as one barrier before the next command that can touch them:
+// render passes, dispatches, copies, tr_end_cmd or tr_cmd_flush_barriers. Recording order is
+// taken as execution order, so a resource shouldn't be transitioned on more than one thread.
+tr_api_export void tr_cmd_buffer_state(tr_cmd* p_cmd, tr_buffer* p_buffer, tr_buffer_usage new_usage);
+tr_api_export void tr_cmd_image_state(tr_cmd* p_cmd, tr_texture* p_texture, tr_texture_usage new_usage);
+tr_api_export void tr_cmd_flush_barriers(tr_cmd* p_cmd);
 tr_api_export void tr_cmd_dispatch(tr_cmd* p_cmd, uint32_t group_count_x, uint32_t group_count_y, uint32_t group_count_z);
 tr_api_export void tr_cmd_copy_buffer_to_texture2d(tr_cmd* p_cmd, uint32_t width, uint32_t height, uint32_t row_pitch, uint64_t buffer_offset, uint32_t mip_level, tr_buffer* p_buffer, tr_texture* p_texture);
+// Fills mip levels 1 and up by blitting each level down from the one above it, starting from
+// mip 0 in its tracked state. All levels are left in new_usage. Needs a graphics queue, a
+// single layer 1D or 2D texture and a format that supports blits, see tr_util_texture_supports_gpu_mips.
+tr_api_export void tr_cmd_generate_mips(tr_cmd* p_cmd, tr_texture* p_texture, tr_texture_usage new_usage);
 
 tr_api_export void tr_acquire_next_image(tr_renderer* p_renderer, tr_semaphore* p_signal_semaphore, tr_fence* p_fence);
 tr_api_export void tr_queue_submit(tr_queue* p_queue, uint32_t cmd_count, tr_cmd** pp_cmds, uint32_t wait_semaphore_count, tr_semaphore** pp_wait_semaphores, uint32_t signal_semaphore_count, tr_semaphore** pp_signal_semaphores);
+// Waits for and signals timeline values, p_fence is optional. Other queues can wait on this
+// submit through p_queue->timeline and p_queue->submit_value.
+tr_api_export void tr_queue_submit_timeline(tr_queue* p_queue, uint32_t cmd_count, tr_cmd** pp_cmds, uint32_t wait_timeline_count, tr_timeline** pp_wait_timelines, const uint64_t* p_wait_values, uint32_t signal_timeline_count, tr_timeline** pp_signal_timelines, const uint64_t* p_signal_values, tr_fence* p_fence);
+// All submits go to one vkQueueSubmit in order, p_fence is optional and signals once all of them are done
+tr_api_export void tr_queue_submit_batch(tr_queue* p_queue, uint32_t submit_count, const tr_submit_info* p_submits, tr_fence* p_fence);
 tr_api_export void tr_queue_present(tr_queue* p_queue, uint32_t wait_semaphore_count, tr_semaphore** pp_wait_semaphores);
 tr_api_export void tr_queue_wait_idle(tr_queue* p_queue);
 
+// Frame contexts - tr_begin_frame waits only on the frame slot being reused, acquires
+// the next swapchain image and begins the slot's command buffer. tr_end_frame ends, submits and presents it.
+tr_api_export void tr_begin_frame(tr_renderer* p_renderer, tr_frame** pp_frame);
+tr_api_export void tr_end_frame(tr_renderer* p_renderer, tr_frame* p_frame);
+
+// Parallel recording - thread_index picks one of recording_thread_count per-frame command pools,
+// so calls with different thread indices can run concurrently. The command buffers are valid until
+// the frame slot comes around again and are begun and ended by the caller. tr_end_frame submits
+// the primary ones in thread order, then in the order they were handed out, ahead of p_frame->cmd.
+// Recording threads don't share command buffer state, but the staging ring and query pools are
+// renderer-wide and not locked: tr_util_update_buffer_cmd and the tr_cmd_*query*/timer calls
+// belong on the thread that runs tr_begin_frame, which debug builds assert.
+tr_api_export void tr_frame_get_thread_cmd(tr_frame* p_frame, uint32_t thread_index, bool secondary, tr_cmd** pp_cmd);
+
+// GPU queries - tr_cmd_begin_query_frame and tr_cmd_resolve_queries go outside of a render pass,
+// once per frame and after tr_begin_frame. Timers and queries are numbered in the order they're
+// begun within the frame. All of the tr_cmd_* query calls run on the thread that runs tr_begin_frame.
+tr_api_export void     tr_create_query_pool(tr_renderer* p_renderer, tr_query_type type, uint32_t query_count, tr_query_pool** pp_query_pool);
+tr_api_export void     tr_destroy_query_pool(tr_renderer* p_renderer, tr_query_pool* p_query_pool);
+tr_api_export void     tr_cmd_begin_query_frame(tr_cmd* p_cmd, tr_query_pool* p_query_pool);
+tr_api_export uint32_t tr_cmd_begin_timer(tr_cmd* p_cmd, tr_query_pool* p_query_pool, const char* name);
+tr_api_export void     tr_cmd_end_timer(tr_cmd* p_cmd, tr_query_pool* p_query_pool, uint32_t timer);
+tr_api_export uint32_t tr_cmd_begin_query(tr_cmd* p_cmd, tr_query_pool* p_query_pool);
+tr_api_export void     tr_cmd_end_query(tr_cmd* p_cmd, tr_query_pool* p_query_pool, uint32_t query);
+tr_api_export void     tr_cmd_resolve_queries(tr_cmd* p_cmd, tr_query_pool* p_query_pool);
+tr_api_export bool     tr_query_pool_get_timer_ms(const tr_query_pool* p_query_pool, uint32_t timer, double* p_ms);
+tr_api_export bool     tr_query_pool_get_pipeline_statistics(const tr_query_pool* p_query_pool, uint32_t query, tr_pipeline_statistics* p_statistics);
+tr_api_export bool     tr_query_pool_get_occlusion(const tr_query_pool* p_query_pool, uint32_t query, uint64_t* p_sample_count);
+
+// Tracing - between tr_begin_trace and tr_end_trace every tr_* call is recorded as a CPU scope and
+// timers resolved by query pools are recorded as GPU scopes, then written out as Chrome trace event
+// JSON for chrome://tracing or ui.perfetto.dev. Names have to stay valid until tr_end_trace.
+// tr_begin_trace waits for the graphics queue to go idle to line up the GPU and CPU clocks.
+// Don't call tr_end_trace while other threads are inside tr_* calls.
+// Built as C, CPU scopes need GCC or Clang (cleanup attribute), other compilers only record GPU scopes.
+tr_api_export void     tr_begin_trace(tr_renderer* p_renderer);
+tr_api_export bool     tr_end_trace(tr_renderer* p_renderer, const char* file_path);
+
+// Render graphs - see the comment above tr_render_graph. Functions that add resources or passes
+// return their index. tr_render_graph_get_render_target returns NULL for transients that no
+// pass uses once the graph is compiled.
+tr_api_export void              tr_create_render_graph(tr_renderer* p_renderer, tr_render_graph** pp_render_graph);
+tr_api_export void              tr_destroy_render_graph(tr_renderer* p_renderer, tr_render_graph* p_render_graph);
+tr_api_export uint32_t          tr_render_graph_import_buffer(tr_render_graph* p_render_graph, tr_buffer* p_buffer);
+tr_api_export uint32_t          tr_render_graph_import_texture(tr_render_graph* p_render_graph, tr_texture* p_texture);
+tr_api_export uint32_t          tr_render_graph_import_render_target(tr_render_graph* p_render_graph, tr_render_target* p_render_target);
+tr_api_export uint32_t          tr_render_graph_create_render_target(tr_render_graph* p_render_graph, uint32_t width, uint32_t height, tr_sample_count sample_count, tr_format color_format, uint32_t color_attachment_count, const tr_clear_value* p_color_clear_values, tr_format depth_stencil_format, const tr_clear_value* p_depth_stencil_clear_value);
+tr_api_export void              tr_render_graph_bind_buffer(tr_render_graph* p_render_graph, uint32_t resource, tr_buffer* p_buffer);
+tr_api_export void              tr_render_graph_bind_texture(tr_render_graph* p_render_graph, uint32_t resource, tr_texture* p_texture);
+tr_api_export void              tr_render_graph_bind_render_target(tr_render_graph* p_render_graph, uint32_t resource, tr_render_target* p_render_target);
+tr_api_export tr_render_target* tr_render_graph_get_render_target(tr_render_graph* p_render_graph, uint32_t resource);
+tr_api_export uint32_t          tr_render_graph_add_pass(tr_render_graph* p_render_graph, const char* name, tr_render_graph_execute_fn execute_fn, void* p_user_data);
+tr_api_export void              tr_render_graph_pass_render_target(tr_render_graph* p_render_graph, uint32_t pass, uint32_t resource);
+tr_api_export void              tr_render_graph_pass_read_render_target(tr_render_graph* p_render_graph, uint32_t pass, uint32_t resource);
+tr_api_export void              tr_render_graph_pass_read_buffer(tr_render_graph* p_render_graph, uint32_t pass, uint32_t resource, tr_buffer_usage usage);
+tr_api_export void              tr_render_graph_pass_write_buffer(tr_render_graph* p_render_graph, uint32_t pass, uint32_t resource, tr_buffer_usage usage);
+tr_api_export void              tr_render_graph_pass_read_texture(tr_render_graph* p_render_graph, uint32_t pass, uint32_t resource, tr_texture_usage usage);
+tr_api_export void              tr_render_graph_pass_write_texture(tr_render_graph* p_render_graph, uint32_t pass, uint32_t resource, tr_texture_usage usage);
+tr_api_export void              tr_render_graph_compile(tr_render_graph* p_render_graph);
+tr_api_export void              tr_render_graph_execute(tr_render_graph* p_render_graph, tr_cmd* p_cmd);
+
 tr_api_export void tr_render_target_set_color_clear_value(tr_render_target* p_render_target, uint32_t attachment_index, float r, float g, float b, float a);
 tr_api_export void tr_render_target_set_depth_stencil_clear_value(tr_render_target* p_render_target, float depth, uint8_t stencil);
 
@@ -679,9 +1367,36 @@ tr_api_export void               tr_util_transition_image(tr_queue* p_queue, tr_
 tr_api_export void               tr_util_set_storage_buffer_count(tr_queue* p_queue, uint64_t count_offset, uint32_t count, tr_buffer* p_buffer);
 tr_api_export void               tr_util_clear_buffer(tr_queue* p_queue, tr_buffer* p_buffer);
 tr_api_export void               tr_util_update_buffer(tr_queue* p_queue, uint64_t size, const void* p_src_data, tr_buffer* p_buffer);
+// Stages into the ring and records the copy into p_cmd. The space is held until p_cmd is submitted
+// and has completed, or until it's begun again. Returns false without recording anything if the
+// data is larger than the ring or if command buffers that haven't been submitted yet hold the
+// rest of it - submit them and try again, or use tr_util_update_buffer. The ring isn't locked,
+// so this is called, and p_cmd begun again or destroyed, on the thread that runs tr_begin_frame.
+tr_api_export bool               tr_util_update_buffer_cmd(tr_cmd* p_cmd, uint64_t size, const void* p_src_data, tr_buffer* p_buffer);
+tr_api_export void               tr_util_flush_uploads(tr_queue* p_queue);
 tr_api_export void               tr_util_update_texture_uint8(tr_queue* p_queue, uint32_t src_width, uint32_t src_height, uint32_t src_row_stride, const uint8_t* p_src_data, uint32_t src_channel_count, tr_texture* p_texture, tr_image_resize_uint8_fn resize_fn, void* p_user_data);
+// Uploads only mip 0 and generates the rest of the chain with tr_cmd_generate_mips in the graphics
+// queue's upload batch, ahead of the next graphics submit. Formats that can't be blitted, cube
+// maps and 3D textures fall back to resizing every level on the CPU.
+tr_api_export bool               tr_util_texture_supports_gpu_mips(tr_renderer* p_renderer, tr_format format);
+tr_api_export void               tr_util_update_texture_uint8_gpu_mips(tr_queue* p_queue, uint32_t src_width, uint32_t src_height, uint32_t src_row_stride, const uint8_t* p_src_data, uint32_t src_channel_count, tr_texture* p_texture, tr_image_resize_uint8_fn resize_fn, void* p_user_data);
 tr_api_export void               tr_util_update_texture_float(tr_queue* p_queue, uint32_t src_width, uint32_t src_height, uint32_t src_row_stride, const float* p_src_data, uint32_t channels, tr_texture* p_texture, tr_image_resize_float_fn resize_fn, void* p_user_data);
 
+// Non-blocking utility functions - the work is recorded into the staging ring's batch and is
+// submitted ahead of the next submit on p_queue's family, or by tr_upload_wait/tr_util_flush_uploads.
+// The blocking versions above wait on their own ticket instead of draining the queue. Data that
+// doesn't fit in the ring because tr_util_update_buffer_cmd command buffers that haven't been
+// submitted hold it is staged in a temporary buffer instead, so every upload lands with its ticket.
+tr_api_export tr_upload_ticket   tr_util_transition_buffer_async(tr_queue* p_queue, tr_buffer* p_buffer, tr_buffer_usage old_usage, tr_buffer_usage new_usage);
+tr_api_export tr_upload_ticket   tr_util_transition_image_async(tr_queue* p_queue, tr_texture* p_texture, tr_texture_usage old_usage, tr_texture_usage new_usage);
+tr_api_export tr_upload_ticket   tr_util_set_storage_buffer_count_async(tr_queue* p_queue, uint64_t count_offset, uint32_t count, tr_buffer* p_buffer);
+tr_api_export tr_upload_ticket   tr_util_clear_buffer_async(tr_queue* p_queue, tr_buffer* p_buffer);
+tr_api_export tr_upload_ticket   tr_util_update_buffer_async(tr_queue* p_queue, uint64_t size, const void* p_src_data, tr_buffer* p_buffer);
+tr_api_export tr_upload_ticket   tr_util_update_texture_uint8_async(tr_queue* p_queue, uint32_t src_width, uint32_t src_height, uint32_t src_row_stride, const uint8_t* p_src_data, uint32_t src_channel_count, tr_texture* p_texture, tr_image_resize_uint8_fn resize_fn, void* p_user_data);
+tr_api_export tr_upload_ticket   tr_util_update_texture_uint8_gpu_mips_async(tr_queue* p_queue, uint32_t src_width, uint32_t src_height, uint32_t src_row_stride, const uint8_t* p_src_data, uint32_t src_channel_count, tr_texture* p_texture, tr_image_resize_uint8_fn resize_fn, void* p_user_data);
+tr_api_export bool               tr_upload_is_complete(tr_queue* p_queue, tr_upload_ticket ticket);
+tr_api_export void               tr_upload_wait(tr_queue* p_queue, tr_upload_ticket ticket);
+
 // =================================================================================================
 // IMPLEMENTATION
 // =================================================================================================
@@ -726,6 +1441,53 @@ static inline uint32_t tr_round_up(uint32_t value, uint32_t multiple)
     return ((value + multiple - 1) / multiple) * multiple;
 }
 
+static inline uint64_t tr_max_64(uint64_t a, uint64_t b)
+{
+    return a > b ? a : b;
+}
+
+static inline uint64_t tr_min_64(uint64_t a, uint64_t b)
+{
+    return a < b ? a : b;
+}
+
+static inline uint64_t tr_round_up_64(uint64_t value, uint64_t multiple)
+{
+    assert(multiple);
+    return ((value + multiple - 1) / multiple) * multiple;
+}
+
+// 64-bit FNV-1a, pass the previous result as seed to hash several pieces of data
+static inline uint64_t tr_hash_64(uint64_t seed, size_t size, const void* p_data)
+{
+    const uint8_t* p_bytes = (const uint8_t*)p_data;
+    uint64_t hash = (0 != seed) ? seed : 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= p_bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// tr_hash_64 that also appends the data to a growable byte array, for comparing on a hash hit
+static inline uint64_t tr_hash_64_keep(uint64_t seed, size_t size, const void* p_data, uint8_t** pp_content, uint32_t* p_content_size, uint32_t* p_content_capacity)
+{
+    if ((*p_content_size + size) > *p_content_capacity) {
+        uint32_t capacity = (*p_content_capacity > 0) ? *p_content_capacity : 256;
+        while ((*p_content_size + size) > capacity) {
+            capacity *= 2;
+        }
+        *pp_content = (uint8_t*)realloc(*pp_content, capacity);
+        assert(NULL != *pp_content);
+        *p_content_capacity = capacity;
+    }
+    if (size > 0) {
+        memcpy(*pp_content + *p_content_size, p_data, size);
+        *p_content_size += (uint32_t)size;
+    }
+    return tr_hash_64(seed, size, p_data);
+}
+
 // Internal utility functions (may become external one day)
 VkSampleCountFlagBits tr_util_to_vk_sample_count(tr_sample_count sample_count);
 VkBufferUsageFlags    tr_util_to_vk_buffer_usage(tr_buffer_usage usage);
@@ -747,11 +1509,75 @@ void tr_internal_vk_destroy_surface(tr_renderer* p_renderer);
 void tr_internal_vk_destroy_device(tr_renderer* p_renderer);
 void tr_internal_vk_destroy_swapchain(tr_renderer* p_renderer);
 
+// Internal pipeline cache functions
+void tr_internal_vk_create_pipeline_cache(tr_renderer* p_renderer);
+void tr_internal_vk_destroy_pipeline_cache(tr_renderer* p_renderer);
+bool tr_internal_vk_validate_pipeline_cache(tr_renderer* p_renderer, size_t size, const void* p_data);
+bool tr_internal_vk_load_pipeline_cache(tr_renderer* p_renderer, const char* file_path);
+bool tr_internal_vk_save_pipeline_cache(tr_renderer* p_renderer, const char* file_path);
+
+// Internal async pipeline functions
+void         tr_internal_vk_create_pipeline_compiler(tr_renderer* p_renderer);
+void         tr_internal_vk_destroy_pipeline_compiler(tr_renderer* p_renderer);
+void         tr_internal_vk_queue_pipeline_job(tr_renderer* p_renderer, tr_shader_program* p_shader_program, const tr_vertex_layout* p_vertex_layout, tr_descriptor_set* p_descriptor_set, tr_render_target* p_render_target, tr_pipeline* p_pipeline);
+bool         tr_internal_vk_pipeline_is_ready(tr_pipeline* p_pipeline);
+void         tr_internal_vk_pipeline_wait(tr_pipeline* p_pipeline);
+tr_pipeline* tr_internal_vk_resolve_pipeline(tr_pipeline* p_pipeline);
+
+// Internal pipeline registry functions
+void         tr_internal_vk_create_pipeline_registry(tr_renderer* p_renderer);
+void         tr_internal_vk_destroy_pipeline_registry(tr_renderer* p_renderer);
+void         tr_internal_vk_make_pipeline_key(tr_pipeline_type type, tr_shader_program* p_shader_program, const tr_vertex_layout* p_vertex_layout, tr_descriptor_set* p_descriptor_set, tr_render_target* p_render_target, const tr_pipeline_settings* p_pipeline_settings, tr_pipeline_key* p_key);
+bool         tr_internal_vk_pipeline_key_layout_equal(const tr_pipeline_key* p_a, const tr_pipeline_key* p_b);
+tr_pipeline* tr_internal_vk_acquire_registered_pipeline(tr_renderer* p_renderer, const tr_pipeline_key* p_key);
+void         tr_internal_vk_register_pipeline(tr_renderer* p_renderer, const tr_pipeline_key* p_key, tr_pipeline* p_pipeline);
+void         tr_internal_vk_unregister_pipeline(tr_renderer* p_renderer, tr_pipeline* p_pipeline);
+
+// Internal memory functions
+void tr_internal_vk_create_memory_allocator(tr_renderer* p_renderer);
+void tr_internal_vk_destroy_memory_allocator(tr_renderer* p_renderer);
+void tr_internal_vk_allocate_memory(tr_renderer* p_renderer, const VkMemoryRequirements* p_mem_reqs, VkMemoryPropertyFlags mem_flags, bool linear, tr_memory_allocation* p_allocation);
+void tr_internal_vk_free_memory(tr_renderer* p_renderer, tr_memory_allocation* p_allocation);
+
+// Internal descriptor allocator functions
+void tr_internal_vk_create_descriptor_allocator(tr_renderer* p_renderer);
+void tr_internal_vk_destroy_descriptor_allocator(tr_renderer* p_renderer);
+tr_descriptor_layout* tr_internal_vk_acquire_descriptor_layout(tr_renderer* p_renderer, uint32_t binding_count, const VkDescriptorSetLayoutBinding* p_bindings);
+void tr_internal_vk_allocate_descriptor_set(tr_renderer* p_renderer, tr_descriptor_layout* p_layout, tr_descriptor_set* p_descriptor_set);
+void tr_internal_vk_free_descriptor_set(tr_renderer* p_renderer, tr_descriptor_set* p_descriptor_set);
+
+// Internal staging functions
+void               tr_internal_vk_create_staging_ring(tr_renderer* p_renderer, tr_queue* p_queue, tr_staging_ring** pp_ring);
+void               tr_internal_vk_destroy_staging_ring(tr_renderer* p_renderer, tr_staging_ring* p_ring);
+tr_staging_ring*   tr_internal_vk_find_staging_ring(tr_renderer* p_renderer, uint32_t queue_family_index);
+tr_staging_ring*   tr_internal_vk_staging_ring_for_queue(tr_queue* p_queue);
+bool               tr_internal_vk_staging_ring_reserve(tr_staging_ring* p_ring, uint64_t size, uint64_t alignment, uint64_t* p_ring_pos);
+bool               tr_internal_vk_staging_ring_write(tr_staging_ring* p_ring, uint64_t size, uint64_t alignment, const void* p_src_data, uint64_t* p_ring_pos);
+uint8_t*           tr_internal_vk_staging_ring_stage(tr_staging_ring* p_ring, uint64_t size, uint64_t alignment, tr_buffer** pp_src_buffer, uint64_t* p_src_offset);
+tr_upload_ticket   tr_internal_vk_staging_ring_ticket(tr_staging_ring* p_ring);
+tr_cmd*            tr_internal_vk_staging_ring_batch_cmd(tr_staging_ring* p_ring);
+void               tr_internal_vk_staging_ring_add_pending_cmd(tr_staging_ring* p_ring, tr_cmd* p_cmd, uint64_t ring_begin);
+void               tr_internal_vk_staging_ring_remove_pending_cmd(tr_staging_ring* p_ring, tr_cmd* p_cmd);
+void               tr_internal_vk_staging_ring_drop_cmd(tr_cmd* p_cmd);
+void               tr_internal_vk_staging_ring_retire(tr_staging_ring* p_ring, bool wait);
+void               tr_internal_vk_staging_ring_flush(tr_staging_ring* p_ring);
+tr_staging_submit* tr_internal_vk_staging_ring_begin_submit(tr_staging_ring* p_ring, tr_queue* p_queue, uint32_t submit_count, const tr_submit_info* p_submits);
+void               tr_internal_vk_staging_ring_end_submit(tr_staging_ring* p_ring, tr_staging_submit* p_submit, uint32_t submit_count, const tr_submit_info* p_submits);
+void               tr_internal_vk_staging_ring_release_buffer(tr_staging_ring* p_ring, tr_buffer* p_buffer, tr_buffer_usage old_usage, tr_buffer_usage new_usage);
+void               tr_internal_vk_staging_ring_release_image(tr_staging_ring* p_ring, tr_texture* p_texture, tr_texture_usage old_usage, tr_texture_usage new_usage);
+void               tr_internal_vk_staging_ring_signal_transfer(tr_renderer* p_renderer, tr_semaphore* p_semaphore);
+void               tr_internal_vk_cmd_copy_staged_buffer(tr_cmd* p_cmd, tr_buffer* p_src_buffer, uint64_t src_offset, uint64_t dst_offset, uint64_t size, tr_buffer* p_buffer);
+
 // Internal create functions
 void tr_internal_vk_create_fence(tr_renderer *p_renderer, tr_fence* p_fence);
 void tr_internal_vk_destroy_fence(tr_renderer *p_renderer, tr_fence* p_fence);
 void tr_internal_vk_create_semaphore(tr_renderer *p_renderer, tr_semaphore* p_semaphore);
 void tr_internal_vk_destroy_semaphore(tr_renderer *p_renderer, tr_semaphore* p_semaphore);
+void tr_internal_vk_create_timeline(tr_renderer *p_renderer, uint64_t initial_value, tr_timeline* p_timeline);
+void tr_internal_vk_destroy_timeline(tr_renderer *p_renderer, tr_timeline* p_timeline);
+uint64_t tr_internal_vk_timeline_get_value(tr_timeline* p_timeline);
+bool tr_internal_vk_timeline_wait(tr_timeline* p_timeline, uint64_t value, uint64_t timeout_ns);
+void tr_internal_vk_timeline_signal(tr_timeline* p_timeline, uint64_t value);
 void tr_internal_vk_create_descriptor_set(tr_renderer* p_renderer, tr_descriptor_set* p_descriptor_set);
 void tr_internal_vk_destroy_descriptor_set(tr_renderer* p_renderer, tr_descriptor_set* p_descriptor_set);
 void tr_internal_vk_create_cmd_pool(tr_renderer *p_renderer, tr_queue* p_queue, bool transient, tr_cmd_pool* p_cmd_pool);
@@ -760,6 +1586,7 @@ void tr_internal_vk_create_cmd(tr_cmd_pool *p_cmd_pool, bool secondary, tr_cmd*
 void tr_internal_vk_destroy_cmd(tr_cmd_pool *p_cmd_pool, tr_cmd* p_cmd);
 void tr_internal_vk_create_buffer(tr_renderer* p_renderer, tr_buffer* p_buffer);
 void tr_internal_vk_destroy_buffer(tr_renderer* p_renderer, tr_buffer* p_buffer);
+void tr_internal_vk_create_texture_image(tr_renderer* p_renderer, tr_texture* p_texture, bool allocate_memory);
 void tr_internal_vk_create_texture(tr_renderer* p_renderer, tr_texture* p_texture);
 void tr_internal_vk_destroy_texture(tr_renderer* p_renderer, tr_texture* p_texture);
 void tr_internal_vk_create_sampler(tr_renderer* p_renderer, tr_sampler* p_sampler);
@@ -776,9 +1603,10 @@ void tr_internal_vk_destroy_render_target(tr_renderer* p_renderer, tr_render_tar
 void tr_internal_vk_update_descriptor_set(tr_renderer* p_renderer, tr_descriptor_set* p_descriptor_set);
 
 // Internal command buffer functions
-void tr_internal_vk_begin_cmd(tr_cmd* p_cmd);
+void tr_internal_vk_begin_cmd(tr_cmd* p_cmd, tr_render_target* p_render_target);
 void tr_internal_vk_end_cmd(tr_cmd* p_cmd);
-void tr_internal_vk_cmd_begin_render(tr_cmd* p_cmd, tr_render_target* p_render_target);
+void tr_internal_vk_cmd_begin_render(tr_cmd* p_cmd, tr_render_target* p_render_target, bool secondary_contents);
+void tr_internal_vk_cmd_execute_cmds(tr_cmd* p_cmd, uint32_t cmd_count, tr_cmd** pp_cmds);
 void tr_internal_vk_cmd_end_render(tr_cmd* p_cmd);
 void tr_internal_vk_cmd_set_viewport(tr_cmd* p_cmd, float x, float, float width, float height, float min_depth, float max_depth);
 void tr_internal_vk_cmd_set_scissor(tr_cmd* p_cmd, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
@@ -792,15 +1620,49 @@ void tr_internal_vk_cmd_draw_indexed(tr_cmd* p_cmd, uint32_t index_count, uint32
 void tr_internal_vk_cmd_draw_mesh(tr_cmd* p_cmd, const tr_mesh* p_mesh);
 void tr_internal_vk_cmd_buffer_transition(tr_cmd* p_cmd, tr_buffer* p_buffer, tr_buffer_usage old_usage, tr_buffer_usage new_usage);
 void tr_internal_vk_cmd_image_transition(tr_cmd* p_cmd, tr_texture* p_texture, tr_texture_usage old_usage, tr_texture_usage new_usage);
+void tr_internal_vk_cmd_buffer_barrier(tr_cmd* p_cmd, tr_buffer* p_buffer, tr_buffer_usage old_usage, tr_buffer_usage new_usage, uint32_t src_queue_family_index, uint32_t dst_queue_family_index);
+void tr_internal_vk_cmd_image_barrier(tr_cmd* p_cmd, tr_texture* p_texture, tr_texture_usage old_usage, tr_texture_usage new_usage, uint32_t src_queue_family_index, uint32_t dst_queue_family_index);
 void tr_internal_vk_cmd_render_target_transition(tr_cmd* p_cmd, tr_render_target* p_render_target, tr_texture_usage old_usage, tr_texture_usage new_usage);
+void tr_internal_vk_cmd_buffer_state(tr_cmd* p_cmd, tr_buffer* p_buffer, tr_buffer_usage new_usage);
+void tr_internal_vk_cmd_image_state(tr_cmd* p_cmd, tr_texture* p_texture, tr_texture_usage new_usage);
+void tr_internal_vk_cmd_flush_barriers(tr_cmd* p_cmd);
+void tr_internal_vk_cmd_image_discard(tr_cmd* p_cmd, tr_texture* p_texture, tr_texture_usage new_usage, uint32_t alias_count, tr_texture** pp_aliases);
 void tr_internal_vk_cmd_dispatch(tr_cmd* p_cmd, uint32_t group_count_x, uint32_t group_count_y, uint32_t group_count_z);
 void tr_internal_vk_cmd_copy_buffer_to_texture2d(tr_cmd* p_cmd, uint32_t width, uint32_t height, uint32_t row_pitch, uint64_t buffer_offset, uint32_t mip_level, tr_buffer* p_buffer, tr_texture* p_texture);
+void tr_internal_vk_cmd_generate_mips(tr_cmd* p_cmd, tr_texture* p_texture, tr_texture_usage new_usage);
 
 // Internal queue/swapchain functions
 void tr_internal_vk_acquire_next_image(tr_renderer* p_renderer, tr_semaphore* p_signal_semaphore, tr_fence* p_fence);
-void tr_internal_vk_queue_submit(tr_queue* p_queue, uint32_t cmd_count, tr_cmd** pp_cmds, uint32_t wait_semaphore_count, tr_semaphore** pp_wait_semaphores, uint32_t signal_semaphore_count, tr_semaphore** pp_signal_semaphores);
+void tr_internal_vk_queue_submit(tr_queue* p_queue, uint32_t cmd_count, tr_cmd** pp_cmds, uint32_t wait_semaphore_count, tr_semaphore** pp_wait_semaphores, uint32_t signal_semaphore_count, tr_semaphore** pp_signal_semaphores, tr_fence* p_fence);
+void tr_internal_vk_queue_submit_batch(tr_queue* p_queue, uint32_t submit_count, const tr_submit_info* p_submits, tr_fence* p_fence);
+void tr_internal_vk_free_submit_scratch(tr_submit_scratch* p_scratch);
 void tr_internal_vk_queue_present(tr_queue* p_queue, uint32_t wait_semaphore_count, tr_semaphore** pp_wait_semaphores);
 void tr_internal_vk_queue_wait_idle(tr_queue* p_queue);
+void tr_internal_vk_queue_wait_submits(tr_queue* p_queue);
+
+// Internal frame functions
+void tr_internal_vk_create_frames(tr_renderer* p_renderer);
+void tr_internal_vk_destroy_frames(tr_renderer* p_renderer);
+void tr_internal_vk_begin_frame(tr_renderer* p_renderer, tr_frame** pp_frame);
+void tr_internal_vk_end_frame(tr_renderer* p_renderer, tr_frame* p_frame);
+void tr_internal_vk_frame_get_thread_cmd(tr_frame* p_frame, uint32_t thread_index, bool secondary, tr_cmd** pp_cmd);
+
+// Internal query functions
+void tr_internal_vk_create_query_pool(tr_renderer* p_renderer, tr_query_pool* p_query_pool);
+void tr_internal_vk_destroy_query_pool(tr_renderer* p_renderer, tr_query_pool* p_query_pool);
+void tr_internal_vk_cmd_begin_query_frame(tr_cmd* p_cmd, tr_query_pool* p_query_pool);
+uint32_t tr_internal_vk_cmd_begin_timer(tr_cmd* p_cmd, tr_query_pool* p_query_pool, const char* name);
+void tr_internal_vk_cmd_end_timer(tr_cmd* p_cmd, tr_query_pool* p_query_pool, uint32_t timer);
+uint32_t tr_internal_vk_cmd_begin_query(tr_cmd* p_cmd, tr_query_pool* p_query_pool);
+void tr_internal_vk_cmd_end_query(tr_cmd* p_cmd, tr_query_pool* p_query_pool, uint32_t query);
+void tr_internal_vk_cmd_resolve_queries(tr_cmd* p_cmd, tr_query_pool* p_query_pool);
+
+// Internal render graph functions
+uint32_t tr_internal_vk_render_graph_add_resource(tr_render_graph* p_render_graph, tr_render_graph_resource_type type, bool transient);
+void tr_internal_vk_render_graph_add_access(tr_render_graph* p_render_graph, uint32_t pass, uint32_t resource, bool write, uint32_t usage);
+void tr_internal_vk_render_graph_compile(tr_render_graph* p_render_graph);
+void tr_internal_vk_render_graph_release_transients(tr_render_graph* p_render_graph);
+void tr_internal_vk_render_graph_execute(tr_render_graph* p_render_graph, tr_cmd* p_cmd);
 
 
 // -------------------------------------------------------------------------------------------------
@@ -1028,14 +1890,208 @@ bool ptr_vector_destroy(ptr_vector* p_vector)
 // ptr_vector (end)
 // -------------------------------------------------------------------------------------------------
 
+// -------------------------------------------------------------------------------------------------
+// Internal thread functions
+// -------------------------------------------------------------------------------------------------
+typedef void (*tr_internal_thread_fn)(void* p_data);
+
+#if defined(_WIN32)
+typedef SRWLOCK                 tr_internal_mutex;
+typedef CONDITION_VARIABLE      tr_internal_cond;
+typedef DWORD                   tr_internal_thread_id;
+#else
+typedef pthread_mutex_t         tr_internal_mutex;
+typedef pthread_cond_t          tr_internal_cond;
+typedef pthread_t               tr_internal_thread_id;
+#endif
+
+// Must stay at a stable address until joined, the platform thread reads fn and data from it
+typedef struct tr_internal_thread {
+#if defined(_WIN32)
+    HANDLE                      handle;
+#else
+    pthread_t                   handle;
+#endif
+    tr_internal_thread_fn       fn;
+    void*                       data;
+} tr_internal_thread;
+
+static void tr_internal_mutex_init(tr_internal_mutex* p_mutex)
+{
+#if defined(_WIN32)
+    InitializeSRWLock(p_mutex);
+#else
+    int result = pthread_mutex_init(p_mutex, NULL);
+    assert(0 == result);
+    (void)result;
+#endif
+}
+
+static void tr_internal_mutex_destroy(tr_internal_mutex* p_mutex)
+{
+#if defined(_WIN32)
+    (void)p_mutex;
+#else
+    pthread_mutex_destroy(p_mutex);
+#endif
+}
+
+static void tr_internal_mutex_lock(tr_internal_mutex* p_mutex)
+{
+#if defined(_WIN32)
+    AcquireSRWLockExclusive(p_mutex);
+#else
+    pthread_mutex_lock(p_mutex);
+#endif
+}
+
+static void tr_internal_mutex_unlock(tr_internal_mutex* p_mutex)
+{
+#if defined(_WIN32)
+    ReleaseSRWLockExclusive(p_mutex);
+#else
+    pthread_mutex_unlock(p_mutex);
+#endif
+}
+
+static void tr_internal_cond_init(tr_internal_cond* p_cond)
+{
+#if defined(_WIN32)
+    InitializeConditionVariable(p_cond);
+#else
+    int result = pthread_cond_init(p_cond, NULL);
+    assert(0 == result);
+    (void)result;
+#endif
+}
+
+static void tr_internal_cond_destroy(tr_internal_cond* p_cond)
+{
+#if defined(_WIN32)
+    (void)p_cond;
+#else
+    pthread_cond_destroy(p_cond);
+#endif
+}
+
+// p_mutex must be locked, it is released while waiting and locked again before returning
+static void tr_internal_cond_wait(tr_internal_cond* p_cond, tr_internal_mutex* p_mutex)
+{
+#if defined(_WIN32)
+    SleepConditionVariableSRW(p_cond, p_mutex, INFINITE, 0);
+#else
+    pthread_cond_wait(p_cond, p_mutex);
+#endif
+}
+
+static void tr_internal_cond_signal(tr_internal_cond* p_cond)
+{
+#if defined(_WIN32)
+    WakeConditionVariable(p_cond);
+#else
+    pthread_cond_signal(p_cond);
+#endif
+}
+
+static void tr_internal_cond_broadcast(tr_internal_cond* p_cond)
+{
+#if defined(_WIN32)
+    WakeAllConditionVariable(p_cond);
+#else
+    pthread_cond_broadcast(p_cond);
+#endif
+}
+
+#if defined(_WIN32)
+static DWORD WINAPI tr_internal_thread_entry(LPVOID p_param)
+{
+    tr_internal_thread* p_thread = (tr_internal_thread*)p_param;
+    p_thread->fn(p_thread->data);
+    return 0;
+}
+#else
+static void* tr_internal_thread_entry(void* p_param)
+{
+    tr_internal_thread* p_thread = (tr_internal_thread*)p_param;
+    p_thread->fn(p_thread->data);
+    return NULL;
+}
+#endif
+
+static bool tr_internal_thread_start(tr_internal_thread* p_thread, tr_internal_thread_fn fn, void* p_data)
+{
+    p_thread->fn   = fn;
+    p_thread->data = p_data;
+#if defined(_WIN32)
+    p_thread->handle = CreateThread(NULL, 0, tr_internal_thread_entry, p_thread, 0, NULL);
+    return NULL != p_thread->handle;
+#else
+    return 0 == pthread_create(&(p_thread->handle), NULL, tr_internal_thread_entry, p_thread);
+#endif
+}
+
+static void tr_internal_thread_join(tr_internal_thread* p_thread)
+{
+#if defined(_WIN32)
+    WaitForSingleObject(p_thread->handle, INFINITE);
+    CloseHandle(p_thread->handle);
+    p_thread->handle = NULL;
+#else
+    pthread_join(p_thread->handle, NULL);
+#endif
+}
+
+static tr_internal_thread_id tr_internal_current_thread_id()
+{
+#if defined(_WIN32)
+    return GetCurrentThreadId();
+#else
+    return pthread_self();
+#endif
+}
+
+static bool tr_internal_thread_id_equal(tr_internal_thread_id a, tr_internal_thread_id b)
+{
+#if defined(_WIN32)
+    return a == b;
+#else
+    return 0 != pthread_equal(a, b);
+#endif
+}
+
+// Number of logical processors, 0 if the platform can't tell
+static uint32_t tr_internal_hardware_thread_count()
+{
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (uint32_t)info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (uint32_t)count : 0;
+#endif
+}
+// -------------------------------------------------------------------------------------------------
+// Internal thread functions (end)
+// -------------------------------------------------------------------------------------------------
+
 // Internal singleton 
 typedef struct tr_internal_data {
     tr_renderer*        renderer;   
-    tr_render_target*   bound_render_target;
+    // Last thread to call tr_begin_frame, only valid once has_frame_thread is set
+    bool                has_frame_thread;
+    tr_internal_thread_id frame_thread;
 } tr_internal_data;
 
 static tr_internal_data* s_tr_internal = NULL;
 
+// Staging ring and query pool state is shared by all command buffers and isn't locked, the
+// calls that change it are limited to the frame thread. Always true before the first frame.
+static bool tr_internal_on_frame_thread()
+{
+    return (! s_tr_internal->has_frame_thread) || tr_internal_thread_id_equal(tr_internal_current_thread_id(), s_tr_internal->frame_thread);
+}
+
 // Proxy log callback
 static void tr_internal_log(tr_log_type type, const char* msg, const char* component)
 {
@@ -1078,40 +2134,372 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL tr_internal_debug_report_callback(
 }
 
 // -------------------------------------------------------------------------------------------------
-// API functions
+// Tracing
 // -------------------------------------------------------------------------------------------------
-void tr_create_renderer(const char *app_name, const tr_renderer_settings* settings, tr_renderer** pp_renderer)
+typedef struct tr_trace_event {
+    const char*                         name;
+    uint64_t                            begin_ns;
+    uint64_t                            duration_ns;
+    uint32_t                            thread_id;
+    bool                                gpu;
+} tr_trace_event;
+
+// Events are appended from whichever thread calls into the renderer, mutex guards the array.
+// GPU timestamps are placed on the CPU timeline through one calibration point taken when
+// the trace begins.
+struct tr_tracer {
+    tr_internal_mutex                   mutex;
+    uint64_t                            epoch_ns;
+    uint32_t                            event_count;
+    uint32_t                            event_capacity;
+    tr_trace_event*                     events;
+    bool                                gpu_calibrated;
+    uint64_t                            gpu_epoch_ticks;
+    uint64_t                            gpu_epoch_ns;
+    uint64_t                            gpu_timestamp_mask;
+    double                              gpu_timestamp_period;
+};
+
+// Monotonic clock in nanoseconds from an arbitrary start
+static uint64_t tr_internal_trace_clock_ns()
 {
-    if (NULL == s_tr_internal) {
-        s_tr_internal = (tr_internal_data*)calloc(1, sizeof(*s_tr_internal));
-        assert(NULL != s_tr_internal);
+#if defined(_WIN32)
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    // Split to keep counter * 1e9 from overflowing
+    uint64_t seconds = (uint64_t)(counter.QuadPart / frequency.QuadPart);
+    uint64_t remainder = (uint64_t)(counter.QuadPart % frequency.QuadPart);
+    return (seconds * 1000000000ULL) + ((remainder * 1000000000ULL) / (uint64_t)frequency.QuadPart);
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * 1000000000ULL) + (uint64_t)now.tv_nsec;
+#else
+    // Strict ISO C modes hide the POSIX clocks, fall back to the C11 wall clock
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return ((uint64_t)now.tv_sec * 1000000000ULL) + (uint64_t)now.tv_nsec;
+#endif
+}
 
-        s_tr_internal->renderer = (tr_renderer*)calloc(1, sizeof(*(s_tr_internal->renderer)));
-        assert(NULL != s_tr_internal->renderer);
+static uint64_t tr_internal_trace_now_ns(tr_tracer* p_tracer)
+{
+    return tr_internal_trace_clock_ns() - p_tracer->epoch_ns;
+}
 
-        // Shorter way to get to the object
-        tr_renderer* p_renderer = s_tr_internal->renderer;
+static void tr_internal_trace_add_event(tr_tracer* p_tracer, const char* name, uint64_t begin_ns, uint64_t end_ns, uint32_t thread_id, bool gpu)
+{
+    tr_internal_mutex_lock(&(p_tracer->mutex));
+    if (p_tracer->event_count == p_tracer->event_capacity) {
+        uint32_t capacity = (p_tracer->event_capacity > 0) ? (2 * p_tracer->event_capacity) : 4096;
+        tr_trace_event* events = (tr_trace_event*)realloc(p_tracer->events, capacity * sizeof(*events));
+        assert(NULL != events);
+        p_tracer->events = events;
+        p_tracer->event_capacity = capacity;
+    }
 
-        // Copy settings
-        memcpy(&(p_renderer->settings), settings, sizeof(*settings));
+    tr_trace_event* p_event = &(p_tracer->events[p_tracer->event_count++]);
+    p_event->name        = name;
+    p_event->begin_ns    = begin_ns;
+    p_event->duration_ns = (end_ns > begin_ns) ? (end_ns - begin_ns) : 0;
+    p_event->thread_id   = thread_id;
+    p_event->gpu         = gpu;
+    tr_internal_mutex_unlock(&(p_tracer->mutex));
+}
 
-        // Allocate storage for queues
-        p_renderer->graphics_queue = (tr_queue*)calloc(1, sizeof(*p_renderer->graphics_queue));
-        assert(NULL != p_renderer->graphics_queue);
-        p_renderer->present_queue = (tr_queue*)calloc(1, sizeof(*p_renderer->present_queue));
-        assert(NULL != p_renderer->present_queue);
+// Places a pair of GPU timestamps on the trace timeline, timers that began before the
+// calibration point wrap around and are dropped
+static void tr_internal_trace_add_gpu_event(tr_tracer* p_tracer, const char* name, uint64_t begin_ticks, uint64_t end_ticks)
+{
+    if (! p_tracer->gpu_calibrated) {
+        return;
+    }
+
+    uint64_t mask = p_tracer->gpu_timestamp_mask;
+    uint64_t begin_delta = (begin_ticks - p_tracer->gpu_epoch_ticks) & mask;
+    uint64_t duration = (end_ticks - begin_ticks) & mask;
+    if (begin_delta > (mask >> 1)) {
+        return;
+    }
+
+    uint64_t begin_ns = p_tracer->gpu_epoch_ns + (uint64_t)((double)begin_delta * p_tracer->gpu_timestamp_period);
+    uint64_t end_ns = begin_ns + (uint64_t)((double)duration * p_tracer->gpu_timestamp_period);
+    tr_internal_trace_add_event(p_tracer, (NULL != name) ? name : "gpu_timer", begin_ns, end_ns, 0, true);
+}
+
+static uint32_t tr_internal_trace_thread_id()
+{
+    // FNV-1a over the platform id, Chrome wants small integers and 0 is left for the GPU
+    tr_internal_thread_id thread_id = tr_internal_current_thread_id();
+    const uint8_t* p_bytes = (const uint8_t*)&thread_id;
+    uint32_t id = 2166136261u;
+    for (size_t i = 0; i < sizeof(thread_id); ++i) {
+        id = (id ^ p_bytes[i]) * 16777619u;
+    }
+    return (0 != id) ? id : 1;
+}
+
+// Records the time between begin and end, no-op unless a trace is running
+typedef struct tr_trace_scope {
+    tr_tracer*                          tracer;
+    const char*                         name;
+    uint64_t                            begin_ns;
+} tr_trace_scope;
+
+static tr_trace_scope tr_internal_trace_scope_begin(tr_renderer* p_renderer, const char* name)
+{
+    tr_trace_scope scope;
+    scope.tracer   = (NULL != p_renderer) ? p_renderer->tracer : NULL;
+    scope.name     = name;
+    scope.begin_ns = (NULL != scope.tracer) ? tr_internal_trace_now_ns(scope.tracer) : 0;
+    return scope;
+}
+
+static void tr_internal_trace_scope_end(tr_trace_scope* p_scope)
+{
+    if (NULL != p_scope->tracer) {
+        tr_internal_trace_add_event(p_scope->tracer, p_scope->name, p_scope->begin_ns, tr_internal_trace_now_ns(p_scope->tracer), tr_internal_trace_thread_id(), false);
+    }
+}
+
+static tr_renderer* tr_internal_trace_renderer_of_renderer(tr_renderer* p_renderer)                 { return p_renderer; }
+static tr_renderer* tr_internal_trace_renderer_of_queue(tr_queue* p_queue)                          { return (NULL != p_queue) ? p_queue->renderer : NULL; }
+static tr_renderer* tr_internal_trace_renderer_of_cmd_pool(tr_cmd_pool* p_cmd_pool)                 { return (NULL != p_cmd_pool) ? p_cmd_pool->renderer : NULL; }
+static tr_renderer* tr_internal_trace_renderer_of_cmd(tr_cmd* p_cmd)                                { return (NULL != p_cmd) ? tr_internal_trace_renderer_of_cmd_pool(p_cmd->cmd_pool) : NULL; }
+static tr_renderer* tr_internal_trace_renderer_of_render_target(tr_render_target* p_render_target)  { return (NULL != p_render_target) ? p_render_target->renderer : NULL; }
+static tr_renderer* tr_internal_trace_renderer_of_pipeline(tr_pipeline* p_pipeline)                { return (NULL != p_pipeline) ? p_pipeline->renderer : NULL; }
+static tr_renderer* tr_internal_trace_renderer_of_render_graph(tr_render_graph* p_render_graph)     { return (NULL != p_render_graph) ? p_render_graph->renderer : NULL; }
+static tr_renderer* tr_internal_trace_renderer_of_timeline(tr_timeline* p_timeline)                 { return (NULL != p_timeline) ? p_timeline->renderer : NULL; }
+static tr_renderer* tr_internal_trace_renderer_of_frame(tr_frame* p_frame)                          { return (NULL != p_frame) ? tr_internal_trace_renderer_of_cmd_pool(p_frame->cmd_pool) : NULL; }
+
+#if defined(__cplusplus)
+static tr_renderer* tr_internal_trace_renderer(tr_renderer* p_renderer)              { return tr_internal_trace_renderer_of_renderer(p_renderer); }
+static tr_renderer* tr_internal_trace_renderer(tr_queue* p_queue)                    { return tr_internal_trace_renderer_of_queue(p_queue); }
+static tr_renderer* tr_internal_trace_renderer(tr_cmd_pool* p_cmd_pool)              { return tr_internal_trace_renderer_of_cmd_pool(p_cmd_pool); }
+static tr_renderer* tr_internal_trace_renderer(tr_cmd* p_cmd)                        { return tr_internal_trace_renderer_of_cmd(p_cmd); }
+static tr_renderer* tr_internal_trace_renderer(tr_render_target* p_render_target)    { return tr_internal_trace_renderer_of_render_target(p_render_target); }
+static tr_renderer* tr_internal_trace_renderer(tr_pipeline* p_pipeline)              { return tr_internal_trace_renderer_of_pipeline(p_pipeline); }
+static tr_renderer* tr_internal_trace_renderer(tr_render_graph* p_render_graph)      { return tr_internal_trace_renderer_of_render_graph(p_render_graph); }
+static tr_renderer* tr_internal_trace_renderer(tr_timeline* p_timeline)              { return tr_internal_trace_renderer_of_timeline(p_timeline); }
+static tr_renderer* tr_internal_trace_renderer(tr_frame* p_frame)                    { return tr_internal_trace_renderer_of_frame(p_frame); }
+
+// Ends the scope from the destructor
+struct tr_trace_scope_guard {
+    tr_trace_scope                      scope;
+
+    tr_trace_scope_guard(tr_renderer* p_renderer, const char* name) : scope(tr_internal_trace_scope_begin(p_renderer, name)) {}
+    ~tr_trace_scope_guard() { tr_internal_trace_scope_end(&scope); }
+};
+
+// Scopes the rest of the enclosing block, p_object is anything tr_internal_trace_renderer takes
+#define TINY_RENDERER_TRACE_SCOPE(p_object) \
+    tr_trace_scope_guard tr_trace_scope_(tr_internal_trace_renderer(p_object), __func__)
+
+#define TINY_RENDERER_TRACE_NAMED_SCOPE(p_object, name) \
+    tr_trace_scope_guard tr_trace_scope_named_(tr_internal_trace_renderer(p_object), name)
+#else
+#define tr_internal_trace_renderer(p_object)                            \
+    _Generic((p_object),                                                \
+        tr_renderer*:      tr_internal_trace_renderer_of_renderer,      \
+        tr_queue*:         tr_internal_trace_renderer_of_queue,         \
+        tr_cmd_pool*:      tr_internal_trace_renderer_of_cmd_pool,      \
+        tr_cmd*:           tr_internal_trace_renderer_of_cmd,           \
+        tr_render_target*: tr_internal_trace_renderer_of_render_target, \
+        tr_pipeline*:      tr_internal_trace_renderer_of_pipeline,      \
+        tr_render_graph*:  tr_internal_trace_renderer_of_render_graph,  \
+        tr_timeline*:      tr_internal_trace_renderer_of_timeline,      \
+        tr_frame*:         tr_internal_trace_renderer_of_frame)(p_object)
+
+// C has no destructors, the cleanup attribute ends the scope on GCC and Clang. Other C
+// compilers don't record CPU scopes, GPU timers still show up in the trace.
+#if defined(__GNUC__) || defined(__clang__)
+#define TINY_RENDERER_TRACE_SCOPE(p_object) \
+    tr_trace_scope tr_trace_scope_ __attribute__((cleanup(tr_internal_trace_scope_end))) = tr_internal_trace_scope_begin(tr_internal_trace_renderer(p_object), __func__)
+
+#define TINY_RENDERER_TRACE_NAMED_SCOPE(p_object, name) \
+    tr_trace_scope tr_trace_scope_named_ __attribute__((cleanup(tr_internal_trace_scope_end))) = tr_internal_trace_scope_begin(tr_internal_trace_renderer(p_object), name)
+#else
+#define TINY_RENDERER_TRACE_SCOPE(p_object)             (void)(p_object)
+#define TINY_RENDERER_TRACE_NAMED_SCOPE(p_object, name) (void)(p_object)
+#endif
+#endif
+
+// Writes a timestamp on the graphics queue and waits for it, the readback time is taken as the
+// CPU time the timestamp was written at - this is off by the submit and wait latency
+static void tr_internal_trace_calibrate_gpu(tr_renderer* p_renderer, tr_tracer* p_tracer)
+{
+    uint32_t valid_bits = p_renderer->graphics_queue->vk_timestamp_valid_bits;
+    if (0 == valid_bits) {
+        return;
+    }
+
+    TINY_RENDERER_DECLARE_ZERO(VkQueryPoolCreateInfo, create_info);
+    create_info.sType      = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    create_info.pNext      = NULL;
+    create_info.flags      = 0;
+    create_info.queryType  = VK_QUERY_TYPE_TIMESTAMP;
+    create_info.queryCount = 1;
+    VkQueryPool vk_query_pool = VK_NULL_HANDLE;
+    VkResult vk_res = vkCreateQueryPool(p_renderer->vk_device, &create_info, NULL, &vk_query_pool);
+    assert(VK_SUCCESS == vk_res);
+
+    tr_cmd_pool* p_cmd_pool = NULL;
+    tr_cmd* p_cmd = NULL;
+    tr_create_cmd_pool(p_renderer, p_renderer->graphics_queue, true, &p_cmd_pool);
+    tr_create_cmd(p_cmd_pool, false, &p_cmd);
+
+    tr_begin_cmd(p_cmd);
+    vkCmdResetQueryPool(p_cmd->vk_cmd_buf, vk_query_pool, 0, 1);
+    vkCmdWriteTimestamp(p_cmd->vk_cmd_buf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, vk_query_pool, 0);
+    tr_end_cmd(p_cmd);
+    tr_queue_submit(p_renderer->graphics_queue, 1, &p_cmd, 0, NULL, 0, NULL);
+    tr_internal_vk_queue_wait_submits(p_renderer->graphics_queue);
+
+    uint64_t ticks = 0;
+    vk_res = vkGetQueryPoolResults(p_renderer->vk_device, vk_query_pool, 0, 1, sizeof(ticks), &ticks, sizeof(ticks), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+    if (VK_SUCCESS == vk_res) {
+        p_tracer->gpu_calibrated       = true;
+        p_tracer->gpu_epoch_ticks      = ticks;
+        p_tracer->gpu_epoch_ns         = tr_internal_trace_now_ns(p_tracer);
+        p_tracer->gpu_timestamp_mask   = (valid_bits >= 64) ? UINT64_MAX : ((1ULL << valid_bits) - 1);
+        p_tracer->gpu_timestamp_period = p_renderer->vk_active_gpu_properties.limits.timestampPeriod;
+    }
+
+    tr_destroy_cmd(p_cmd_pool, p_cmd);
+    tr_destroy_cmd_pool(p_renderer, p_cmd_pool);
+    vkDestroyQueryPool(p_renderer->vk_device, vk_query_pool, NULL);
+}
+
+// Event names come from the application, they're written as JSON strings with quotes,
+// backslashes and control characters escaped
+static void tr_internal_trace_write_string(FILE* fp, const char* str)
+{
+    fputc('"', fp);
+    for (const char* p = (NULL != str) ? str : ""; '\0' != *p; ++p) {
+        unsigned char c = (unsigned char)*p;
+        switch (c) {
+            case '"'  : fputs("\\\"", fp); break;
+            case '\\' : fputs("\\\\", fp); break;
+            case '\b' : fputs("\\b", fp); break;
+            case '\f' : fputs("\\f", fp); break;
+            case '\n' : fputs("\\n", fp); break;
+            case '\r' : fputs("\\r", fp); break;
+            case '\t' : fputs("\\t", fp); break;
+            default: {
+                if (c < 0x20) {
+                    fprintf(fp, "\\u%04x", c);
+                }
+                else {
+                    fputc(c, fp);
+                }
+            }
+            break;
+        }
+    }
+    fputc('"', fp);
+}
+
+static bool tr_internal_trace_write(tr_tracer* p_tracer, const char* file_path)
+{
+    FILE* fp = fopen(file_path, "w");
+    if (NULL == fp) {
+        return false;
+    }
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(fp, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"CPU\"}},\n");
+    fprintf(fp, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":2,\"tid\":0,\"args\":{\"name\":\"GPU\"}}");
+    for (uint32_t i = 0; i < p_tracer->event_count; ++i) {
+        const tr_trace_event* p_event = &(p_tracer->events[i]);
+        fprintf(fp, ",\n{\"name\":");
+        tr_internal_trace_write_string(fp, p_event->name);
+        fprintf(fp, ",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":%u,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                p_event->gpu ? "gpu" : "cpu",
+                p_event->gpu ? 2 : 1,
+                p_event->thread_id,
+                (double)p_event->begin_ns / 1000.0,
+                (double)p_event->duration_ns / 1000.0);
+    }
+    fprintf(fp, "\n]}\n");
+
+    bool result = (0 == ferror(fp));
+    fclose(fp);
+    return result;
+}
+
+static void tr_internal_destroy_tracer(tr_renderer* p_renderer)
+{
+    tr_tracer* p_tracer = p_renderer->tracer;
+    if (NULL == p_tracer) {
+        return;
+    }
+
+    p_renderer->tracer = NULL;
+    tr_internal_mutex_destroy(&(p_tracer->mutex));
+    TINY_RENDERER_SAFE_FREE(p_tracer->events);
+    TINY_RENDERER_SAFE_FREE(p_tracer);
+}
+
+// -------------------------------------------------------------------------------------------------
+// API functions
+// -------------------------------------------------------------------------------------------------
+void tr_create_renderer(const char *app_name, const tr_renderer_settings* settings, tr_renderer** pp_renderer)
+{
+    if (NULL == s_tr_internal) {
+        s_tr_internal = (tr_internal_data*)calloc(1, sizeof(*s_tr_internal));
+        assert(NULL != s_tr_internal);
+        s_tr_internal->has_frame_thread = false;
+
+        s_tr_internal->renderer = (tr_renderer*)calloc(1, sizeof(*(s_tr_internal->renderer)));
+        assert(NULL != s_tr_internal->renderer);
+
+        // Shorter way to get to the object
+        tr_renderer* p_renderer = s_tr_internal->renderer;
+
+        // Copy settings
+        memcpy(&(p_renderer->settings), settings, sizeof(*settings));
+
+        // Allocate storage for queues
+        p_renderer->graphics_queue = (tr_queue*)calloc(1, sizeof(*p_renderer->graphics_queue));
+        assert(NULL != p_renderer->graphics_queue);
+        p_renderer->present_queue = (tr_queue*)calloc(1, sizeof(*p_renderer->present_queue));
+        assert(NULL != p_renderer->present_queue);
+        p_renderer->transfer_queue = (tr_queue*)calloc(1, sizeof(*p_renderer->transfer_queue));
+        assert(NULL != p_renderer->transfer_queue);
 
         p_renderer->graphics_queue->renderer = p_renderer;
         p_renderer->present_queue->renderer = p_renderer;
+        p_renderer->transfer_queue->renderer = p_renderer;
 
         // Initialize the Vulkan bits
         {
             tr_internal_vk_create_instance(app_name, p_renderer);
-            tr_internal_vk_create_surface(p_renderer);
+            if (! p_renderer->settings.headless) {
+                tr_internal_vk_create_surface(p_renderer);
+            }
             tr_internal_vk_create_device(p_renderer);
+            tr_internal_vk_create_memory_allocator(p_renderer);
+            tr_internal_vk_create_descriptor_allocator(p_renderer);
+            tr_internal_vk_create_pipeline_cache(p_renderer);
+            tr_internal_vk_create_pipeline_registry(p_renderer);
             tr_internal_vk_create_swapchain(p_renderer);
         }
 
+        // Queue timelines, frames, uploads and queue waits use them over fences when they're there
+        if (p_renderer->vk_device_ext_VK_KHR_timeline_semaphore) {
+            tr_create_timeline(p_renderer, 0, &(p_renderer->graphics_queue->timeline));
+            tr_create_timeline(p_renderer, 0, &(p_renderer->present_queue->timeline));
+            tr_create_timeline(p_renderer, 0, &(p_renderer->transfer_queue->timeline));
+        }
+
+        // Staging rings for the upload utility functions
+        tr_internal_vk_create_staging_ring(p_renderer, p_renderer->graphics_queue, &(p_renderer->staging_ring));
+        if (p_renderer->transfer_queue->vk_queue_family_index != p_renderer->graphics_queue->vk_queue_family_index) {
+            tr_internal_vk_create_staging_ring(p_renderer, p_renderer->transfer_queue, &(p_renderer->transfer_staging_ring));
+        }
+
         // Allocate and configure render target objects
         tr_internal_create_swapchain_renderpass(p_renderer);
 
@@ -1140,11 +2528,15 @@ void tr_create_renderer(const char *app_name, const tr_renderer_settings* settin
             tr_create_semaphore(p_renderer, &(p_renderer->render_complete_semaphores[i]));
         }
 
+        // Frame contexts for tr_begin_frame/tr_end_frame
+        tr_internal_vk_create_frames(p_renderer);
+
         // Transition the swapchain render targets to first use
         if (p_renderer->settings.swapchain.sample_count > tr_sample_count_1) {
             for (uint32_t i = 0; i < p_renderer->settings.swapchain.image_count; ++i) {
                 tr_render_target* render_target = p_renderer->swapchain_render_targets[i];
-                // Color single-sample images are swapchain images and are not transitioned
+                // Color single-sample images are swapchain images and are not transitioned,
+                // in headless mode they are resolve targets and the render pass discards them
 
                 // Color multi-sample
                 tr_util_transition_image(p_renderer->graphics_queue, 
@@ -1185,6 +2577,21 @@ void tr_destroy_renderer(tr_renderer* p_renderer)
 {
     TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
     assert(NULL != s_tr_internal);
+
+    // Finish outstanding pipeline compiles and stop the workers
+    tr_internal_vk_destroy_pipeline_compiler(p_renderer);
+
+    // Drop a trace that was never ended
+    tr_internal_destroy_tracer(p_renderer);
+
+    // Nothing below may be in use by the GPU, frames in flight still reference the swapchain
+    // images and acquires can still be pending on the image fences
+    if (VK_NULL_HANDLE != p_renderer->vk_device) {
+        vkDeviceWaitIdle(p_renderer->vk_device);
+    }
+
+    // Destroy frame contexts before the render targets their command buffers recorded into
+    tr_internal_vk_destroy_frames(p_renderer);
     
     // Destroy the swapchain render targets
     if (NULL != p_renderer->swapchain_render_targets) {
@@ -1212,6 +2619,22 @@ void tr_destroy_renderer(tr_renderer* p_renderer)
     }
 
     // Destroy the Vulkan bits
+    // The graphics ring may still have to wait on the transfer ring
+    tr_internal_vk_destroy_staging_ring(p_renderer, p_renderer->staging_ring);
+    tr_internal_vk_destroy_staging_ring(p_renderer, p_renderer->transfer_staging_ring);
+    tr_queue* queues[3] = { p_renderer->graphics_queue, p_renderer->present_queue, p_renderer->transfer_queue };
+    for (uint32_t i = 0; i < 3; ++i) {
+        if (NULL != queues[i]->timeline) {
+            tr_internal_vk_timeline_wait(queues[i]->timeline, queues[i]->submit_value, UINT64_MAX);
+            tr_destroy_timeline(p_renderer, queues[i]->timeline);
+            queues[i]->timeline = NULL;
+        }
+        tr_internal_vk_free_submit_scratch(&(queues[i]->submit_scratch));
+    }
+    tr_internal_vk_destroy_memory_allocator(p_renderer);
+    tr_internal_vk_destroy_descriptor_allocator(p_renderer);
+    tr_internal_vk_destroy_pipeline_cache(p_renderer);
+    tr_internal_vk_destroy_pipeline_registry(p_renderer);
     tr_internal_vk_destroy_swapchain(p_renderer);
     tr_internal_vk_destroy_surface(p_renderer);
     tr_internal_vk_destroy_device(p_renderer);
@@ -1222,6 +2645,7 @@ void tr_destroy_renderer(tr_renderer* p_renderer)
     TINY_RENDERER_SAFE_FREE(s_tr_internal->renderer->image_acquired_fences);
     TINY_RENDERER_SAFE_FREE(s_tr_internal->renderer->image_acquired_semaphores);
     TINY_RENDERER_SAFE_FREE(s_tr_internal->renderer->render_complete_semaphores);
+    TINY_RENDERER_SAFE_FREE(s_tr_internal->renderer->transfer_queue);
     TINY_RENDERER_SAFE_FREE(s_tr_internal->renderer->present_queue);
     TINY_RENDERER_SAFE_FREE(s_tr_internal->renderer->graphics_queue);
     TINY_RENDERER_SAFE_FREE(s_tr_internal->renderer);
@@ -1230,6 +2654,7 @@ void tr_destroy_renderer(tr_renderer* p_renderer)
 
 void tr_create_fence(tr_renderer *p_renderer, tr_fence** pp_fence)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
     TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
 
     tr_fence* p_fence = (tr_fence*)calloc(1, sizeof(*p_fence));
@@ -1242,6 +2667,7 @@ void tr_create_fence(tr_renderer *p_renderer, tr_fence** pp_fence)
 
 void tr_destroy_fence(tr_renderer *p_renderer, tr_fence* p_fence)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
     TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
     assert(NULL != p_fence);
 
@@ -1252,6 +2678,7 @@ void tr_destroy_fence(tr_renderer *p_renderer, tr_fence* p_fence)
 
 void tr_create_semaphore(tr_renderer *p_renderer, tr_semaphore** pp_semaphore)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
     TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
 
     tr_semaphore* p_semaphore = (tr_semaphore*)calloc(1, sizeof(*p_semaphore));
@@ -1264,6 +2691,7 @@ void tr_create_semaphore(tr_renderer *p_renderer, tr_semaphore** pp_semaphore)
 
 void tr_destroy_semaphore(tr_renderer *p_renderer, tr_semaphore* p_semaphore)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
     TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
     assert(NULL != p_semaphore);
 
@@ -1272,8 +2700,60 @@ void tr_destroy_semaphore(tr_renderer *p_renderer, tr_semaphore* p_semaphore)
     TINY_RENDERER_SAFE_FREE(p_semaphore);
 }
 
+void tr_create_timeline(tr_renderer *p_renderer, uint64_t initial_value, tr_timeline** pp_timeline)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
+    TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
+    assert(p_renderer->vk_device_ext_VK_KHR_timeline_semaphore);
+
+    tr_timeline* p_timeline = (tr_timeline*)calloc(1, sizeof(*p_timeline));
+    assert(NULL != p_timeline);
+
+    p_timeline->renderer = p_renderer;
+
+    tr_internal_vk_create_timeline(p_renderer, initial_value, p_timeline);
+
+    *pp_timeline = p_timeline;
+}
+
+void tr_destroy_timeline(tr_renderer *p_renderer, tr_timeline* p_timeline)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
+    TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
+    assert(NULL != p_timeline);
+
+    tr_internal_vk_destroy_timeline(p_renderer, p_timeline);
+
+    TINY_RENDERER_SAFE_FREE(p_timeline);
+}
+
+uint64_t tr_timeline_get_value(tr_timeline* p_timeline)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_timeline);
+    assert(NULL != p_timeline);
+
+    return tr_internal_vk_timeline_get_value(p_timeline);
+}
+
+bool tr_timeline_wait(tr_timeline* p_timeline, uint64_t value, uint64_t timeout_ns)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_timeline);
+    assert(NULL != p_timeline);
+
+    return tr_internal_vk_timeline_wait(p_timeline, value, timeout_ns);
+}
+
+void tr_timeline_signal(tr_timeline* p_timeline, uint64_t value)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_timeline);
+    assert(NULL != p_timeline);
+
+    tr_internal_vk_timeline_signal(p_timeline, value);
+}
+
 void tr_create_descriptor_set(tr_renderer* p_renderer, uint32_t descriptor_count, const tr_descriptor* p_descriptors, tr_descriptor_set** pp_descriptor_set)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
     TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
 
     tr_descriptor_set* p_descriptor_set = (tr_descriptor_set*)calloc(1, sizeof(*p_descriptor_set));
@@ -1292,6 +2772,7 @@ void tr_create_descriptor_set(tr_renderer* p_renderer, uint32_t descriptor_count
 
 void tr_destroy_descriptor_set(tr_renderer* p_renderer, tr_descriptor_set* p_descriptor_set)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
     TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
     assert(NULL != p_descriptor_set);
 
@@ -1304,12 +2785,14 @@ void tr_destroy_descriptor_set(tr_renderer* p_renderer, tr_descriptor_set* p_des
 
 void tr_create_cmd_pool(tr_renderer *p_renderer, tr_queue* p_queue, bool transient, tr_cmd_pool** pp_cmd_pool)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
     TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
 
     tr_cmd_pool* p_cmd_pool = (tr_cmd_pool*)calloc(1, sizeof(*p_cmd_pool));
     assert(NULL != p_cmd_pool);
 
     p_cmd_pool->renderer = p_renderer;
+    p_cmd_pool->queue    = p_queue;
 
     tr_internal_vk_create_cmd_pool(p_renderer, p_queue, transient, p_cmd_pool);
     
@@ -1318,6 +2801,7 @@ void tr_create_cmd_pool(tr_renderer *p_renderer, tr_queue* p_queue, bool transie
 
 void tr_destroy_cmd_pool(tr_renderer *p_renderer, tr_cmd_pool* p_cmd_pool)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
     TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
     assert(NULL != p_cmd_pool);
 
@@ -1328,12 +2812,14 @@ void tr_destroy_cmd_pool(tr_renderer *p_renderer, tr_cmd_pool* p_cmd_pool)
 
 void tr_create_cmd(tr_cmd_pool* p_cmd_pool, bool secondary, tr_cmd** pp_cmd)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_cmd_pool);
     assert(NULL != p_cmd_pool);
 
     tr_cmd* p_cmd = (tr_cmd*)calloc(1, sizeof(*p_cmd));
     assert(NULL != p_cmd);
 
-    p_cmd->cmd_pool = p_cmd_pool;
+    p_cmd->cmd_pool  = p_cmd_pool;
+    p_cmd->secondary = secondary;
 
     tr_internal_vk_create_cmd(p_cmd_pool, secondary, p_cmd);
     
@@ -1342,6 +2828,7 @@ void tr_create_cmd(tr_cmd_pool* p_cmd_pool, bool secondary, tr_cmd** pp_cmd)
 
 void tr_destroy_cmd(tr_cmd_pool* p_cmd_pool, tr_cmd* p_cmd)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_cmd_pool);
     assert(NULL != p_cmd_pool);
     assert(NULL != p_cmd);
 
@@ -1352,6 +2839,7 @@ void tr_destroy_cmd(tr_cmd_pool* p_cmd_pool, tr_cmd* p_cmd)
 
 void tr_create_cmd_n(tr_cmd_pool *p_cmd_pool, bool secondary, uint32_t cmd_count, tr_cmd*** ppp_cmd)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_cmd_pool);
     assert(NULL != ppp_cmd);
 
     tr_cmd** pp_cmd = (tr_cmd**)calloc(cmd_count, sizeof(*pp_cmd));
@@ -1366,6 +2854,7 @@ void tr_create_cmd_n(tr_cmd_pool *p_cmd_pool, bool secondary, uint32_t cmd_count
 
 void tr_destroy_cmd_n(tr_cmd_pool *p_cmd_pool, uint32_t cmd_count, tr_cmd** pp_cmd)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_cmd_pool);
     assert(NULL != pp_cmd);
 
     for (uint32_t i = 0; i < cmd_count; ++i) {
@@ -1378,6 +2867,7 @@ void tr_destroy_cmd_n(tr_cmd_pool *p_cmd_pool, uint32_t cmd_count, tr_cmd** pp_c
 
 void tr_create_buffer(tr_renderer* p_renderer, tr_buffer_usage usage, uint64_t size, bool host_visible, tr_buffer** pp_buffer)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
     TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
     assert(size > 0 );
 
@@ -1396,23 +2886,27 @@ void tr_create_buffer(tr_renderer* p_renderer, tr_buffer_usage usage, uint64_t s
 
 void tr_create_index_buffer(tr_renderer* p_renderer, uint64_t size, bool host_visible, tr_index_type index_type, tr_buffer** pp_buffer)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
     tr_create_buffer(p_renderer, tr_buffer_usage_index, size, host_visible, pp_buffer);
     (*pp_buffer)->index_type = index_type;
 }
 
 void tr_create_uniform_buffer(tr_renderer* p_renderer, uint64_t size, bool host_visible, tr_buffer** pp_buffer)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
     tr_create_buffer(p_renderer, tr_buffer_usage_uniform_cbv, size, host_visible, pp_buffer);
 }
 
 void tr_create_vertex_buffer(tr_renderer* p_renderer, uint64_t size, bool host_visible, uint32_t vertex_stride, tr_buffer** pp_buffer)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
     tr_create_buffer(p_renderer, tr_buffer_usage_vertex, size, host_visible, pp_buffer);
     (*pp_buffer)->vertex_stride = vertex_stride;
 }
 
 void tr_create_structured_buffer(tr_renderer* p_renderer, uint64_t size, uint64_t first_element, uint64_t element_count, uint64_t struct_stride, bool raw, tr_buffer** pp_buffer)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
     TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
     assert(size > 0 );
 
@@ -1435,6 +2929,7 @@ void tr_create_structured_buffer(tr_renderer* p_renderer, uint64_t size, uint64_
 
 void tr_create_rw_structured_buffer(tr_renderer* p_renderer, uint64_t size, uint64_t first_element, uint64_t element_count, uint64_t struct_stride, bool raw, tr_buffer** pp_counter_buffer, tr_buffer** pp_buffer)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
     TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
     assert(size > 0 );
 
@@ -1484,6 +2979,7 @@ void tr_create_rw_structured_buffer(tr_renderer* p_renderer, uint64_t size, uint
 
 void tr_destroy_buffer(tr_renderer* p_renderer, tr_buffer* p_buffer)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
     TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
     assert(NULL != p_buffer);
 
@@ -1507,6 +3003,7 @@ void tr_create_texture(
     tr_texture**             pp_texture
 )
 {
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
     TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
     assert((width > 0) && (height > 0) && (depth > 0));
 
@@ -1553,6 +3050,7 @@ void tr_create_texture_1d(
     tr_texture**            pp_texture
 )
 {
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
     tr_create_texture(p_renderer, tr_texture_type_1d, width, 1, 1, sample_count, format, 1, NULL, host_visible, usage, pp_texture);
 }
 
@@ -1569,6 +3067,7 @@ void tr_create_texture_2d(
     tr_texture**              pp_texture
 )
 {
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
     if (tr_max_mip_levels == mip_levels) {
         mip_levels = tr_util_calc_mip_levels(width, height);
     }
@@ -1588,11 +3087,13 @@ void tr_create_texture_3d(
     tr_texture**            pp_texture
 )
 {
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
     tr_create_texture(p_renderer, tr_texture_type_3d, width, height, depth, sample_count, format, 1, NULL, host_visible, usage, pp_texture);
 }
 
 void tr_destroy_texture(tr_renderer* p_renderer, tr_texture* p_texture)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
     TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
     assert(NULL != p_texture);
 
@@ -1603,6 +3104,7 @@ void tr_destroy_texture(tr_renderer* p_renderer, tr_texture* p_texture)
 
 void tr_create_sampler(tr_renderer* p_renderer, tr_sampler** pp_sampler)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
     TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
 
     tr_sampler* p_sampler = (tr_sampler*)calloc(1, sizeof(*p_sampler));
@@ -1617,6 +3119,7 @@ void tr_create_sampler(tr_renderer* p_renderer, tr_sampler** pp_sampler)
 
 void tr_destroy_sampler(tr_renderer* p_renderer, tr_sampler* p_sampler)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
     TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
     assert(NULL != p_sampler);
 
@@ -1627,6 +3130,7 @@ void tr_destroy_sampler(tr_renderer* p_renderer, tr_sampler* p_sampler)
 
 void tr_create_shader_program_n(tr_renderer* p_renderer, uint32_t vert_size, const void* vert_code, const char* vert_enpt, uint32_t tesc_size, const void* tesc_code, const char* tesc_enpt, uint32_t tese_size, const void* tese_code, const char* tese_enpt, uint32_t geom_size, const void* geom_code, const char* geom_enpt, uint32_t frag_size, const void* frag_code, const char* frag_enpt, uint32_t comp_size, const void* comp_code, const char* comp_enpt, tr_shader_program** pp_shader_program)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
     TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
     if (vert_size > 0) {
         assert(NULL != vert_code);
@@ -1658,6 +3162,27 @@ void tr_create_shader_program_n(tr_renderer* p_renderer, uint32_t vert_size, con
     p_shader_program->shader_stages |= (frag_size > 0) ? tr_shader_stage_frag : 0;
     p_shader_program->shader_stages |= (comp_size > 0) ? tr_shader_stage_comp : 0;
 
+    // Stage sizes go into the hash too so code can't shift between stages unnoticed
+    {
+        const uint32_t    sizes[]   = { vert_size, tesc_size, tese_size, geom_size, frag_size, comp_size };
+        const void*       codes[]   = { vert_code, tesc_code, tese_code, geom_code, frag_code, comp_code };
+        const char*       enpts[]   = { vert_enpt, tesc_enpt, tese_enpt, geom_enpt, frag_enpt, comp_enpt };
+        uint8_t* content = NULL;
+        uint32_t content_size = 0;
+        uint32_t content_capacity = 0;
+        uint64_t hash = 0;
+        for (uint32_t i = 0; i < 6; ++i) {
+            hash = tr_hash_64_keep(hash, sizeof(sizes[i]), &(sizes[i]), &content, &content_size, &content_capacity);
+            if (sizes[i] > 0) {
+                hash = tr_hash_64_keep(hash, sizes[i], codes[i], &content, &content_size, &content_capacity);
+                hash = tr_hash_64_keep(hash, (NULL != enpts[i]) ? strlen(enpts[i]) + 1 : 0, enpts[i], &content, &content_size, &content_capacity);
+            }
+        }
+        p_shader_program->hash = hash;
+        p_shader_program->content_size = content_size;
+        p_shader_program->content = content;
+    }
+
     tr_internal_vk_create_shader_program(p_renderer, vert_size, vert_code, vert_enpt, tesc_size, tesc_code, tesc_enpt, tese_size, tese_code, tese_enpt, geom_size, geom_code, geom_enpt, frag_size, frag_code, frag_enpt, comp_size, comp_code, comp_enpt, p_shader_program);
 
     if ((vert_enpt != NULL) && (strlen(vert_enpt) > 0)) {
@@ -1681,67 +3206,220 @@ void tr_create_shader_program_n(tr_renderer* p_renderer, uint32_t vert_size, con
     *pp_shader_program = p_shader_program;
 }
 
-void tr_create_shader_program(tr_renderer* p_renderer, uint32_t vert_size, const uint32_t* vert_code, const char* vert_enpt, uint32_t frag_size, const uint32_t* frag_code, const char* frag_enpt, tr_shader_program** pp_shader_program)
+void tr_create_shader_program(tr_renderer* p_renderer, uint32_t vert_size, const void* vert_code, const char* vert_enpt, uint32_t frag_size, const void* frag_code, const char* frag_enpt, tr_shader_program** pp_shader_program)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
     tr_create_shader_program_n(p_renderer, vert_size, vert_code, vert_enpt, 0, NULL, NULL, 0, NULL, NULL, 0, NULL, NULL, frag_size, frag_code, frag_enpt, 0, NULL, NULL, pp_shader_program);
 }
 
 void tr_create_shader_program_compute(tr_renderer* p_renderer, uint32_t comp_size, const void* comp_code, const char* comp_enpt, tr_shader_program** pp_shader_program)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
     tr_create_shader_program_n(p_renderer, 0, NULL, NULL, 0, NULL, NULL, 0, NULL, NULL, 0, NULL, NULL, 0, NULL, NULL, comp_size, comp_code, comp_enpt, pp_shader_program);
 }
 
 void tr_destroy_shader_program(tr_renderer* p_renderer, tr_shader_program* p_shader_program)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
     TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
 
     tr_internal_vk_destroy_shader_program(p_renderer, p_shader_program);
+
+    TINY_RENDERER_SAFE_FREE(p_shader_program->content);
 }
 
 void tr_create_pipeline(tr_renderer* p_renderer, tr_shader_program* p_shader_program, const tr_vertex_layout* p_vertex_layout, tr_descriptor_set* p_descriptor_set, tr_render_target* p_render_target, const tr_pipeline_settings* p_pipeline_settings, tr_pipeline** pp_pipeline)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
     TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
     assert(NULL != p_render_target);
     assert(NULL != p_pipeline_settings);
 
+    TINY_RENDERER_DECLARE_ZERO(tr_pipeline_key, key);
+    tr_internal_vk_make_pipeline_key(tr_pipeline_type_graphics, p_shader_program, p_vertex_layout, p_descriptor_set, p_render_target, p_pipeline_settings, &key);
+    tr_pipeline* p_existing = tr_internal_vk_acquire_registered_pipeline(p_renderer, &key);
+    if (NULL != p_existing) {
+        TINY_RENDERER_SAFE_FREE(key.content);
+        *pp_pipeline = p_existing;
+        return;
+    }
+
     tr_pipeline* p_pipeline = (tr_pipeline*)calloc(1, sizeof(*p_pipeline));
     assert(NULL != p_pipeline);
 
     memcpy(&(p_pipeline->settings), p_pipeline_settings, sizeof(*p_pipeline_settings));
+    p_pipeline->renderer = p_renderer;
 
     tr_internal_vk_create_pipeline(p_renderer, p_shader_program, p_vertex_layout, p_descriptor_set, p_render_target, p_pipeline_settings, p_pipeline);
     p_pipeline->type = tr_pipeline_type_graphics;
 
+    tr_internal_vk_register_pipeline(p_renderer, &key, p_pipeline);
+
     *pp_pipeline = p_pipeline;
 }
 
 tr_api_export void tr_create_compute_pipeline(tr_renderer* p_renderer, tr_shader_program* p_shader_program, tr_descriptor_set* p_descriptor_set, const tr_pipeline_settings* p_pipeline_settings, tr_pipeline** pp_pipeline)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
     TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
     assert(NULL != p_shader_program);
     assert(NULL != p_pipeline_settings);
 
+    TINY_RENDERER_DECLARE_ZERO(tr_pipeline_key, key);
+    tr_internal_vk_make_pipeline_key(tr_pipeline_type_compute, p_shader_program, NULL, p_descriptor_set, NULL, p_pipeline_settings, &key);
+    tr_pipeline* p_existing = tr_internal_vk_acquire_registered_pipeline(p_renderer, &key);
+    if (NULL != p_existing) {
+        TINY_RENDERER_SAFE_FREE(key.content);
+        *pp_pipeline = p_existing;
+        return;
+    }
+
     tr_pipeline* p_pipeline = (tr_pipeline*)calloc(1, sizeof(*p_pipeline));
     assert(NULL != p_pipeline);
 
     memcpy(&(p_pipeline->settings), p_pipeline_settings, sizeof(*p_pipeline_settings));
+    p_pipeline->renderer = p_renderer;
 
     tr_internal_vk_create_compute_pipeline(p_renderer, p_shader_program, p_descriptor_set, p_pipeline_settings, p_pipeline);
     p_pipeline->type = tr_pipeline_type_compute;
 
+    tr_internal_vk_register_pipeline(p_renderer, &key, p_pipeline);
+
+    *pp_pipeline = p_pipeline;
+}
+
+void tr_create_pipeline_async(tr_renderer* p_renderer, tr_shader_program* p_shader_program, const tr_vertex_layout* p_vertex_layout, tr_descriptor_set* p_descriptor_set, tr_render_target* p_render_target, const tr_pipeline_settings* p_pipeline_settings, tr_pipeline* p_placeholder, tr_pipeline** pp_pipeline)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
+    TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
+    assert(NULL != p_vertex_layout);
+    assert(NULL != p_render_target);
+    assert(NULL != p_pipeline_settings);
+    if (NULL != p_placeholder) {
+        assert(tr_pipeline_type_graphics == p_placeholder->type);
+    }
+
+    // A hit may still be compiling, it binds its own placeholder until it is done
+    TINY_RENDERER_DECLARE_ZERO(tr_pipeline_key, key);
+    tr_internal_vk_make_pipeline_key(tr_pipeline_type_graphics, p_shader_program, p_vertex_layout, p_descriptor_set, p_render_target, p_pipeline_settings, &key);
+    assert(((NULL == p_placeholder) || tr_internal_vk_pipeline_key_layout_equal(&(p_placeholder->state_key), &key)) && "placeholder's pipeline layout must be compatible");
+    tr_pipeline* p_existing = tr_internal_vk_acquire_registered_pipeline(p_renderer, &key);
+    if (NULL != p_existing) {
+        TINY_RENDERER_SAFE_FREE(key.content);
+        *pp_pipeline = p_existing;
+        return;
+    }
+
+    tr_pipeline* p_pipeline = (tr_pipeline*)calloc(1, sizeof(*p_pipeline));
+    assert(NULL != p_pipeline);
+
+    memcpy(&(p_pipeline->settings), p_pipeline_settings, sizeof(*p_pipeline_settings));
+    p_pipeline->renderer        = p_renderer;
+    p_pipeline->type            = tr_pipeline_type_graphics;
+    p_pipeline->compile_async   = true;
+    p_pipeline->compile_pending = true;
+    p_pipeline->placeholder     = p_placeholder;
+
+    tr_internal_vk_register_pipeline(p_renderer, &key, p_pipeline);
+    tr_internal_vk_queue_pipeline_job(p_renderer, p_shader_program, p_vertex_layout, p_descriptor_set, p_render_target, p_pipeline);
+
+    *pp_pipeline = p_pipeline;
+}
+
+void tr_create_compute_pipeline_async(tr_renderer* p_renderer, tr_shader_program* p_shader_program, tr_descriptor_set* p_descriptor_set, const tr_pipeline_settings* p_pipeline_settings, tr_pipeline* p_placeholder, tr_pipeline** pp_pipeline)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
+    TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
+    assert(NULL != p_shader_program);
+    assert(NULL != p_pipeline_settings);
+    if (NULL != p_placeholder) {
+        assert(tr_pipeline_type_compute == p_placeholder->type);
+    }
+
+    // A hit may still be compiling, it binds its own placeholder until it is done
+    TINY_RENDERER_DECLARE_ZERO(tr_pipeline_key, key);
+    tr_internal_vk_make_pipeline_key(tr_pipeline_type_compute, p_shader_program, NULL, p_descriptor_set, NULL, p_pipeline_settings, &key);
+    assert(((NULL == p_placeholder) || tr_internal_vk_pipeline_key_layout_equal(&(p_placeholder->state_key), &key)) && "placeholder's pipeline layout must be compatible");
+    tr_pipeline* p_existing = tr_internal_vk_acquire_registered_pipeline(p_renderer, &key);
+    if (NULL != p_existing) {
+        TINY_RENDERER_SAFE_FREE(key.content);
+        *pp_pipeline = p_existing;
+        return;
+    }
+
+    tr_pipeline* p_pipeline = (tr_pipeline*)calloc(1, sizeof(*p_pipeline));
+    assert(NULL != p_pipeline);
+
+    memcpy(&(p_pipeline->settings), p_pipeline_settings, sizeof(*p_pipeline_settings));
+    p_pipeline->renderer        = p_renderer;
+    p_pipeline->type            = tr_pipeline_type_compute;
+    p_pipeline->compile_async   = true;
+    p_pipeline->compile_pending = true;
+    p_pipeline->placeholder     = p_placeholder;
+
+    tr_internal_vk_register_pipeline(p_renderer, &key, p_pipeline);
+    tr_internal_vk_queue_pipeline_job(p_renderer, p_shader_program, NULL, p_descriptor_set, NULL, p_pipeline);
+
     *pp_pipeline = p_pipeline;
 }
 
+bool tr_pipeline_is_ready(tr_pipeline* p_pipeline)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_pipeline);
+    assert(NULL != p_pipeline);
+
+    return tr_internal_vk_pipeline_is_ready(p_pipeline);
+}
+
+void tr_pipeline_wait(tr_pipeline* p_pipeline)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_pipeline);
+    assert(NULL != p_pipeline);
+
+    tr_internal_vk_pipeline_wait(p_pipeline);
+}
+
 void tr_destroy_pipeline(tr_renderer* p_renderer, tr_pipeline* p_pipeline)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
     TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
     assert(NULL != p_pipeline);
+    assert(p_pipeline->ref_count > 0);
+
+    // Other references to a deduplicated pipeline keep it alive
+    p_pipeline->ref_count -= 1;
+    if (p_pipeline->ref_count > 0) {
+        return;
+    }
+    tr_internal_vk_unregister_pipeline(p_renderer, p_pipeline);
+    TINY_RENDERER_SAFE_FREE(p_pipeline->state_key.content);
+
+    // A worker may still be writing to the pipeline
+    tr_internal_vk_pipeline_wait(p_pipeline);
 
     tr_internal_vk_destroy_pipeline(p_renderer, p_pipeline);
 
     TINY_RENDERER_SAFE_FREE(p_pipeline);
 }
 
+bool tr_load_pipeline_cache(tr_renderer* p_renderer, const char* file_path)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
+    TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
+    assert(NULL != file_path);
+
+    return tr_internal_vk_load_pipeline_cache(p_renderer, file_path);
+}
+
+bool tr_save_pipeline_cache(tr_renderer* p_renderer, const char* file_path)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
+    TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
+    assert(NULL != file_path);
+
+    return tr_internal_vk_save_pipeline_cache(p_renderer, file_path);
+}
+
 void tr_create_render_target(
     tr_renderer*            p_renderer, 
     uint32_t                width, 
@@ -1755,6 +3433,7 @@ void tr_create_render_target(
     tr_render_target**      pp_render_target
 )
 {
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
     TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
 
     tr_render_target* p_render_target = (tr_render_target*)calloc(1, sizeof(*p_render_target));
@@ -1805,7 +3484,7 @@ void tr_create_render_target(
                                  p_render_target->width, 
                                  p_render_target->height, 
                                  p_render_target->sample_count,
-                                 p_render_target->color_format,
+                                 p_render_target->depth_stencil_format,
                                  1,
                                  p_depth_stencil_clear_value,
                                  false,
@@ -1822,6 +3501,7 @@ void tr_create_render_target(
 
 void tr_destroy_render_target(tr_renderer* p_renderer, tr_render_target* p_render_target)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
     TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
     assert(NULL != p_render_target);
 
@@ -1859,6 +3539,7 @@ void tr_destroy_render_target(tr_renderer* p_renderer, tr_render_target* p_rende
 // -------------------------------------------------------------------------------------------------
 void tr_update_descriptor_set(tr_renderer* p_renderer, tr_descriptor_set* p_descriptor_set)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
     assert(NULL != p_renderer);
     assert(NULL != p_descriptor_set);
 
@@ -1870,13 +3551,24 @@ void tr_update_descriptor_set(tr_renderer* p_renderer, tr_descriptor_set* p_desc
 // -------------------------------------------------------------------------------------------------
 void tr_begin_cmd(tr_cmd* p_cmd)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_cmd);
+    assert(NULL != p_cmd);
+
+    tr_internal_vk_begin_cmd(p_cmd, NULL);
+}
+
+void tr_begin_secondary_cmd(tr_cmd* p_cmd, tr_render_target* p_render_target)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_cmd);
     assert(NULL != p_cmd);
+    assert(p_cmd->secondary);
 
-    tr_internal_vk_begin_cmd(p_cmd);
+    tr_internal_vk_begin_cmd(p_cmd, p_render_target);
 }
 
 void tr_end_cmd(tr_cmd* p_cmd)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_cmd);
     assert(NULL != p_cmd);
 
     tr_internal_vk_end_cmd(p_cmd);
@@ -1884,25 +3576,54 @@ void tr_end_cmd(tr_cmd* p_cmd)
 
 void tr_cmd_begin_render(tr_cmd* p_cmd, tr_render_target* p_render_target)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_cmd);
+    assert(NULL != p_cmd);
+    assert(NULL != p_render_target);
+
+    p_cmd->bound_render_target = p_render_target;
+
+    tr_internal_vk_cmd_begin_render(p_cmd, p_render_target, false);
+}
+
+void tr_cmd_begin_render_secondary(tr_cmd* p_cmd, tr_render_target* p_render_target)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_cmd);
     assert(NULL != p_cmd);
+    assert(! p_cmd->secondary);
     assert(NULL != p_render_target);
 
-    s_tr_internal->bound_render_target = p_render_target;
+    p_cmd->bound_render_target = p_render_target;
+    p_cmd->render_secondary_contents = true;
 
-    tr_internal_vk_cmd_begin_render(p_cmd, p_render_target);
+    tr_internal_vk_cmd_begin_render(p_cmd, p_render_target, true);
 }
 
 void tr_cmd_end_render(tr_cmd* p_cmd)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_cmd);
     assert(NULL != p_cmd);
 
     tr_internal_vk_cmd_end_render(p_cmd);
 
-    s_tr_internal->bound_render_target = NULL;
+    p_cmd->bound_render_target = NULL;
+    p_cmd->render_secondary_contents = false;
+}
+
+void tr_cmd_execute_cmds(tr_cmd* p_cmd, uint32_t cmd_count, tr_cmd** pp_cmds)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_cmd);
+    assert(NULL != p_cmd);
+    assert(! p_cmd->secondary);
+    assert(NULL != pp_cmds);
+    // Inside a render pass only one begun for secondary contents takes them
+    assert((NULL == p_cmd->bound_render_target) || p_cmd->render_secondary_contents);
+
+    tr_internal_vk_cmd_execute_cmds(p_cmd, cmd_count, pp_cmds);
 }
 
 void tr_cmd_set_viewport(tr_cmd* p_cmd, float x, float y, float width, float height, float min_depth, float max_depth)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_cmd);
     assert(NULL != p_cmd);
 
     tr_internal_vk_cmd_set_viewport(p_cmd, x, y, width, height, min_depth, max_depth);
@@ -1910,6 +3631,7 @@ void tr_cmd_set_viewport(tr_cmd* p_cmd, float x, float y, float width, float hei
 
 void tr_cmd_set_scissor(tr_cmd* p_cmd, uint32_t x, uint32_t y, uint32_t width, uint32_t height)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_cmd);
     assert(NULL != p_cmd);
 
     tr_internal_vk_cmd_set_scissor(p_cmd, x, y, width, height);
@@ -1924,6 +3646,7 @@ void tr_cmd_clear_color_attachment(tr_cmd* p_cmd, uint32_t attachment_index, con
 
 void tr_cmd_bind_pipeline(tr_cmd* p_cmd, tr_pipeline* p_pipeline)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_cmd);
     assert(NULL != p_cmd);
     assert(NULL != p_pipeline);
 
@@ -1932,6 +3655,7 @@ void tr_cmd_bind_pipeline(tr_cmd* p_cmd, tr_pipeline* p_pipeline)
 
 void tr_cmd_bind_descriptor_sets(tr_cmd* p_cmd, tr_pipeline* p_pipeline, tr_descriptor_set* p_descriptor_set)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_cmd);
     assert(NULL != p_cmd);
     assert(NULL != p_pipeline);
     assert(NULL != p_descriptor_set);
@@ -1941,6 +3665,7 @@ void tr_cmd_bind_descriptor_sets(tr_cmd* p_cmd, tr_pipeline* p_pipeline, tr_desc
 
 void tr_cmd_bind_index_buffer(tr_cmd* p_cmd, tr_buffer* p_buffer)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_cmd);
     assert(NULL != p_cmd);
     assert(NULL != p_buffer);
 
@@ -1949,6 +3674,7 @@ void tr_cmd_bind_index_buffer(tr_cmd* p_cmd, tr_buffer* p_buffer)
 
 void tr_cmd_bind_vertex_buffers(tr_cmd* p_cmd, uint32_t buffer_count, tr_buffer** pp_buffers)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_cmd);
     assert(NULL != p_cmd);
     assert(0 != buffer_count);
     assert(NULL != pp_buffers);
@@ -1958,6 +3684,7 @@ void tr_cmd_bind_vertex_buffers(tr_cmd* p_cmd, uint32_t buffer_count, tr_buffer*
 
 void tr_cmd_draw(tr_cmd* p_cmd, uint32_t vertex_count, uint32_t first_vertex)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_cmd);
     assert(NULL != p_cmd);
 
     tr_internal_vk_cmd_draw(p_cmd, vertex_count, first_vertex);
@@ -1965,6 +3692,7 @@ void tr_cmd_draw(tr_cmd* p_cmd, uint32_t vertex_count, uint32_t first_vertex)
 
 void tr_cmd_draw_indexed(tr_cmd* p_cmd, uint32_t index_count, uint32_t first_index)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_cmd);
     assert(NULL != p_cmd);
 
     tr_internal_vk_cmd_draw_indexed(p_cmd, index_count, first_index);
@@ -1972,6 +3700,7 @@ void tr_cmd_draw_indexed(tr_cmd* p_cmd, uint32_t index_count, uint32_t first_ind
 
 void tr_cmd_buffer_transition(tr_cmd* p_cmd, tr_buffer* p_buffer, tr_buffer_usage old_usage, tr_buffer_usage new_usage)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_cmd);
     assert(NULL != p_cmd);
     assert(NULL != p_buffer);
 
@@ -1980,20 +3709,50 @@ void tr_cmd_buffer_transition(tr_cmd* p_cmd, tr_buffer* p_buffer, tr_buffer_usag
 
 void tr_cmd_image_transition(tr_cmd* p_cmd, tr_texture* p_texture, tr_texture_usage old_usage, tr_texture_usage new_usage)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_cmd);
+    assert(NULL != p_cmd);
+    assert(NULL != p_texture);
+
+    tr_internal_vk_cmd_image_transition(p_cmd, p_texture, old_usage, new_usage);
+}
+
+void tr_cmd_buffer_queue_transfer(tr_cmd* p_cmd, tr_buffer* p_buffer, tr_queue* p_src_queue, tr_queue* p_dst_queue, tr_buffer_usage old_usage, tr_buffer_usage new_usage)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_cmd);
+    assert(NULL != p_cmd);
+    assert(NULL != p_buffer);
+    assert(NULL != p_src_queue);
+    assert(NULL != p_dst_queue);
+
+    // Record once in a command buffer for p_src_queue (release) and once in a
+    // command buffer for p_dst_queue (acquire), with the same arguments.
+    if (p_src_queue->vk_queue_family_index == p_dst_queue->vk_queue_family_index) {
+        tr_internal_vk_cmd_buffer_transition(p_cmd, p_buffer, old_usage, new_usage);
+        return;
+    }
+
+    tr_internal_vk_cmd_buffer_barrier(p_cmd, p_buffer, old_usage, new_usage, p_src_queue->vk_queue_family_index, p_dst_queue->vk_queue_family_index);
+}
+
+void tr_cmd_image_queue_transfer(tr_cmd* p_cmd, tr_texture* p_texture, tr_queue* p_src_queue, tr_queue* p_dst_queue, tr_texture_usage old_usage, tr_texture_usage new_usage)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_cmd);
     assert(NULL != p_cmd);
     assert(NULL != p_texture);
+    assert(NULL != p_src_queue);
+    assert(NULL != p_dst_queue);
 
-    // Vulkan doesn't have an VkImageLayout corresponding to tr_texture_usage_storage, so
-    // just ignore transitions into or out of tr_texture_usage_storage.
-    if ((old_usage == tr_texture_usage_storage_image) || (new_usage == tr_texture_usage_storage_image)) {
-      return;
+    if (p_src_queue->vk_queue_family_index == p_dst_queue->vk_queue_family_index) {
+        tr_internal_vk_cmd_image_transition(p_cmd, p_texture, old_usage, new_usage);
+        return;
     }
 
-    tr_internal_vk_cmd_image_transition(p_cmd, p_texture, old_usage, new_usage);
+    tr_internal_vk_cmd_image_barrier(p_cmd, p_texture, old_usage, new_usage, p_src_queue->vk_queue_family_index, p_dst_queue->vk_queue_family_index);
 }
 
 void tr_cmd_render_target_transition(tr_cmd* p_cmd, tr_render_target* p_render_target, tr_texture_usage old_usage, tr_texture_usage new_usage)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_cmd);
     // Vulkan render passes take care of transitions, so just ignore this for now...
 
     //assert(NULL != p_cmd);
@@ -2002,14 +3761,42 @@ void tr_cmd_render_target_transition(tr_cmd* p_cmd, tr_render_target* p_render_t
     //tr_internal_vk_cmd_render_target_transition(p_cmd, p_render_target, old_usage, new_usage);
 }
 
+void tr_cmd_buffer_state(tr_cmd* p_cmd, tr_buffer* p_buffer, tr_buffer_usage new_usage)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_cmd);
+    assert(NULL != p_cmd);
+    assert(NULL != p_buffer);
+
+    tr_internal_vk_cmd_buffer_state(p_cmd, p_buffer, new_usage);
+}
+
+void tr_cmd_image_state(tr_cmd* p_cmd, tr_texture* p_texture, tr_texture_usage new_usage)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_cmd);
+    assert(NULL != p_cmd);
+    assert(NULL != p_texture);
+
+    tr_internal_vk_cmd_image_state(p_cmd, p_texture, new_usage);
+}
+
+void tr_cmd_flush_barriers(tr_cmd* p_cmd)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_cmd);
+    assert(NULL != p_cmd);
+
+    tr_internal_vk_cmd_flush_barriers(p_cmd);
+}
+
 void tr_cmd_dispatch(tr_cmd* p_cmd, uint32_t group_count_x, uint32_t group_count_y, uint32_t group_count_z)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_cmd);
     assert(NULL != p_cmd);
     tr_internal_vk_cmd_dispatch(p_cmd, group_count_x, group_count_y, group_count_z);
 }
 
 void tr_cmd_copy_buffer_to_texture2d(tr_cmd* p_cmd, uint32_t width, uint32_t height, uint32_t row_pitch, uint64_t buffer_offset, uint32_t mip_level, tr_buffer* p_buffer, tr_texture* p_texture)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_cmd);
     assert(p_cmd != NULL);
     assert(p_buffer != NULL);
     assert(p_texture != NULL);
@@ -2017,8 +3804,19 @@ void tr_cmd_copy_buffer_to_texture2d(tr_cmd* p_cmd, uint32_t width, uint32_t hei
     tr_internal_vk_cmd_copy_buffer_to_texture2d(p_cmd, width, height, row_pitch, buffer_offset, mip_level, p_buffer, p_texture);
 }
 
-void tr_acquire_next_image(tr_renderer* p_renderer, tr_semaphore* p_signal_semaphore, tr_fence* p_fence)
+void tr_cmd_generate_mips(tr_cmd* p_cmd, tr_texture* p_texture, tr_texture_usage new_usage)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_cmd);
+    assert(NULL != p_cmd);
+    assert(NULL != p_texture);
+    assert(tr_util_texture_supports_gpu_mips(p_cmd->cmd_pool->renderer, p_texture->format));
+
+    tr_internal_vk_cmd_generate_mips(p_cmd, p_texture, new_usage);
+}
+
+void tr_acquire_next_image(tr_renderer* p_renderer, tr_semaphore* p_signal_semaphore, tr_fence* p_fence)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
     TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
 
     tr_internal_vk_acquire_next_image(p_renderer, p_signal_semaphore, p_fence);
@@ -2034,6 +3832,7 @@ void tr_queue_submit(
     tr_semaphore** pp_signal_semaphores
 )
 {
+    TINY_RENDERER_TRACE_SCOPE(p_queue);
     assert(NULL != p_queue);
     assert(cmd_count > 0);
     assert(NULL != pp_cmds);
@@ -2050,11 +3849,73 @@ void tr_queue_submit(
                                 wait_semaphore_count, 
                                 pp_wait_semaphores, 
                                 signal_semaphore_count, 
-                                pp_signal_semaphores);
+                                pp_signal_semaphores,
+                                NULL);
+}
+
+void tr_queue_submit_timeline(
+    tr_queue*       p_queue,
+    uint32_t        cmd_count,
+    tr_cmd**        pp_cmds,
+    uint32_t        wait_timeline_count,
+    tr_timeline**   pp_wait_timelines,
+    const uint64_t* p_wait_values,
+    uint32_t        signal_timeline_count,
+    tr_timeline**   pp_signal_timelines,
+    const uint64_t* p_signal_values,
+    tr_fence*       p_fence
+)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_queue);
+    assert(NULL != p_queue);
+    assert(NULL != p_queue->timeline);
+    if (cmd_count > 0) {
+        assert(NULL != pp_cmds);
+    }
+    if (wait_timeline_count > 0) {
+        assert(NULL != pp_wait_timelines);
+        assert(NULL != p_wait_values);
+    }
+    if (signal_timeline_count > 0) {
+        assert(NULL != pp_signal_timelines);
+        assert(NULL != p_signal_values);
+    }
+
+    TINY_RENDERER_DECLARE_ZERO(tr_submit_info, submit);
+    submit.cmd_count             = cmd_count;
+    submit.pp_cmds               = pp_cmds;
+    submit.wait_timeline_count   = wait_timeline_count;
+    submit.pp_wait_timelines     = pp_wait_timelines;
+    submit.p_wait_values         = p_wait_values;
+    submit.signal_timeline_count = signal_timeline_count;
+    submit.pp_signal_timelines   = pp_signal_timelines;
+    submit.p_signal_values       = p_signal_values;
+    tr_internal_vk_queue_submit_batch(p_queue, 1, &submit, p_fence);
+}
+
+void tr_queue_submit_batch(tr_queue* p_queue, uint32_t submit_count, const tr_submit_info* p_submits, tr_fence* p_fence)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_queue);
+    assert(NULL != p_queue);
+    if (submit_count > 0) {
+        assert(NULL != p_submits);
+    }
+    for (uint32_t i = 0; i < submit_count; ++i) {
+        const tr_submit_info* p_submit = &(p_submits[i]);
+        assert((0 == p_submit->cmd_count) || (NULL != p_submit->pp_cmds));
+        assert((0 == p_submit->wait_semaphore_count) || (NULL != p_submit->pp_wait_semaphores));
+        assert((0 == p_submit->signal_semaphore_count) || (NULL != p_submit->pp_signal_semaphores));
+        assert((0 == p_submit->wait_timeline_count) || ((NULL != p_submit->pp_wait_timelines) && (NULL != p_submit->p_wait_values)));
+        assert((0 == p_submit->signal_timeline_count) || ((NULL != p_submit->pp_signal_timelines) && (NULL != p_submit->p_signal_values)));
+        assert((NULL != p_queue->timeline) || ((0 == p_submit->wait_timeline_count) && (0 == p_submit->signal_timeline_count)));
+    }
+
+    tr_internal_vk_queue_submit_batch(p_queue, submit_count, p_submits, p_fence);
 }
 
 void tr_queue_present(tr_queue* p_queue, uint32_t wait_semaphore_count, tr_semaphore** pp_wait_semaphores)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_queue);
     assert(NULL != p_queue);
     if (wait_semaphore_count > 0) {
         assert(NULL != pp_wait_semaphores);
@@ -2065,13 +3926,236 @@ void tr_queue_present(tr_queue* p_queue, uint32_t wait_semaphore_count, tr_semap
 
 void tr_queue_wait_idle(tr_queue* p_queue)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_queue);
     assert(NULL != p_queue);
 
     tr_internal_vk_queue_wait_idle(p_queue);
 }
 
+void tr_begin_frame(tr_renderer* p_renderer, tr_frame** pp_frame)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
+    TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
+    assert(NULL != pp_frame);
+
+    s_tr_internal->has_frame_thread = true;
+    s_tr_internal->frame_thread     = tr_internal_current_thread_id();
+
+    tr_internal_vk_begin_frame(p_renderer, pp_frame);
+}
+
+void tr_end_frame(tr_renderer* p_renderer, tr_frame* p_frame)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
+    TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
+    assert(NULL != p_frame);
+    assert(p_frame == &(p_renderer->frames[p_renderer->frame_index]));
+
+    tr_internal_vk_end_frame(p_renderer, p_frame);
+}
+
+void tr_frame_get_thread_cmd(tr_frame* p_frame, uint32_t thread_index, bool secondary, tr_cmd** pp_cmd)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_frame);
+    assert(NULL != p_frame);
+    assert(thread_index < p_frame->thread_count);
+    assert(NULL != pp_cmd);
+
+    tr_internal_vk_frame_get_thread_cmd(p_frame, thread_index, secondary, pp_cmd);
+}
+
+void tr_create_query_pool(tr_renderer* p_renderer, tr_query_type type, uint32_t query_count, tr_query_pool** pp_query_pool)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
+    TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
+    assert(query_count > 0);
+    assert(NULL != pp_query_pool);
+
+    tr_query_pool* p_query_pool = (tr_query_pool*)calloc(1, sizeof(*p_query_pool));
+    assert(NULL != p_query_pool);
+
+    p_query_pool->renderer    = p_renderer;
+    p_query_pool->type        = type;
+    p_query_pool->query_count = query_count;
+
+    tr_internal_vk_create_query_pool(p_renderer, p_query_pool);
+
+    *pp_query_pool = p_query_pool;
+}
+
+void tr_destroy_query_pool(tr_renderer* p_renderer, tr_query_pool* p_query_pool)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
+    TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
+    assert(NULL != p_query_pool);
+
+    tr_internal_vk_destroy_query_pool(p_renderer, p_query_pool);
+
+    if (NULL != p_query_pool->results_buffer) {
+        tr_destroy_buffer(p_renderer, p_query_pool->results_buffer);
+    }
+
+    TINY_RENDERER_SAFE_FREE(p_query_pool->slot_used_counts);
+    TINY_RENDERER_SAFE_FREE(p_query_pool->slot_frame_numbers);
+    TINY_RENDERER_SAFE_FREE(p_query_pool->query_data);
+    TINY_RENDERER_SAFE_FREE(p_query_pool->timer_names);
+    TINY_RENDERER_SAFE_FREE(p_query_pool->resolved_timer_ms);
+    TINY_RENDERER_SAFE_FREE(p_query_pool->resolved_results);
+    TINY_RENDERER_SAFE_FREE(p_query_pool);
+}
+
+void tr_cmd_begin_query_frame(tr_cmd* p_cmd, tr_query_pool* p_query_pool)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_cmd);
+    assert(NULL != p_cmd);
+    assert(NULL != p_query_pool);
+    assert(tr_internal_on_frame_thread() && "query pools are only recorded on the frame thread");
+
+    tr_internal_vk_cmd_begin_query_frame(p_cmd, p_query_pool);
+}
+
+uint32_t tr_cmd_begin_timer(tr_cmd* p_cmd, tr_query_pool* p_query_pool, const char* name)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_cmd);
+    assert(NULL != p_cmd);
+    assert(NULL != p_query_pool);
+    assert(tr_internal_on_frame_thread() && "query pools are only recorded on the frame thread");
+    assert(tr_query_type_timestamp == p_query_pool->type);
+
+    return tr_internal_vk_cmd_begin_timer(p_cmd, p_query_pool, name);
+}
+
+void tr_cmd_end_timer(tr_cmd* p_cmd, tr_query_pool* p_query_pool, uint32_t timer)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_cmd);
+    assert(NULL != p_cmd);
+    assert(NULL != p_query_pool);
+    assert(tr_internal_on_frame_thread() && "query pools are only recorded on the frame thread");
+    assert(tr_query_type_timestamp == p_query_pool->type);
+    assert(timer < p_query_pool->slot_used_counts[p_query_pool->slot_index]);
+
+    tr_internal_vk_cmd_end_timer(p_cmd, p_query_pool, timer);
+}
+
+uint32_t tr_cmd_begin_query(tr_cmd* p_cmd, tr_query_pool* p_query_pool)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_cmd);
+    assert(NULL != p_cmd);
+    assert(NULL != p_query_pool);
+    assert(tr_internal_on_frame_thread() && "query pools are only recorded on the frame thread");
+    assert(tr_query_type_timestamp != p_query_pool->type);
+
+    return tr_internal_vk_cmd_begin_query(p_cmd, p_query_pool);
+}
+
+void tr_cmd_end_query(tr_cmd* p_cmd, tr_query_pool* p_query_pool, uint32_t query)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_cmd);
+    assert(NULL != p_cmd);
+    assert(NULL != p_query_pool);
+    assert(tr_internal_on_frame_thread() && "query pools are only recorded on the frame thread");
+    assert(tr_query_type_timestamp != p_query_pool->type);
+    assert(query < p_query_pool->slot_used_counts[p_query_pool->slot_index]);
+
+    tr_internal_vk_cmd_end_query(p_cmd, p_query_pool, query);
+}
+
+void tr_cmd_resolve_queries(tr_cmd* p_cmd, tr_query_pool* p_query_pool)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_cmd);
+    assert(NULL != p_cmd);
+    assert(NULL != p_query_pool);
+    assert(tr_internal_on_frame_thread() && "query pools are only recorded on the frame thread");
+    assert(tr_query_type_timestamp != p_query_pool->type);
+
+    tr_internal_vk_cmd_resolve_queries(p_cmd, p_query_pool);
+}
+
+bool tr_query_pool_get_timer_ms(const tr_query_pool* p_query_pool, uint32_t timer, double* p_ms)
+{
+    assert(NULL != p_query_pool);
+    assert(tr_query_type_timestamp == p_query_pool->type);
+    assert(NULL != p_ms);
+
+    if (timer >= p_query_pool->resolved_query_count) {
+        return false;
+    }
+
+    *p_ms = p_query_pool->resolved_timer_ms[timer];
+    return true;
+}
+
+bool tr_query_pool_get_pipeline_statistics(const tr_query_pool* p_query_pool, uint32_t query, tr_pipeline_statistics* p_statistics)
+{
+    assert(NULL != p_query_pool);
+    assert(tr_query_type_pipeline_statistics == p_query_pool->type);
+    assert(NULL != p_statistics);
+
+    if (query >= p_query_pool->resolved_query_count) {
+        return false;
+    }
+
+    // Counters come back in VkQueryPipelineStatisticFlagBits order
+    const uint64_t* p_results = p_query_pool->resolved_results + query * (p_query_pool->result_stride - 1);
+    p_statistics->vertex_invocations   = p_results[0];
+    p_statistics->fragment_invocations = p_results[1];
+    p_statistics->compute_invocations  = p_results[2];
+    return true;
+}
+
+bool tr_query_pool_get_occlusion(const tr_query_pool* p_query_pool, uint32_t query, uint64_t* p_sample_count)
+{
+    assert(NULL != p_query_pool);
+    assert(tr_query_type_occlusion == p_query_pool->type);
+    assert(NULL != p_sample_count);
+
+    if (query >= p_query_pool->resolved_query_count) {
+        return false;
+    }
+
+    *p_sample_count = p_query_pool->resolved_results[query];
+    return true;
+}
+
+void tr_begin_trace(tr_renderer* p_renderer)
+{
+    TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
+    assert(NULL == p_renderer->tracer);
+
+    tr_tracer* p_tracer = (tr_tracer*)calloc(1, sizeof(*p_tracer));
+    assert(NULL != p_tracer);
+
+    tr_internal_mutex_init(&(p_tracer->mutex));
+    p_tracer->epoch_ns       = tr_internal_trace_clock_ns();
+    p_tracer->event_count    = 0;
+    p_tracer->event_capacity = 0;
+    p_tracer->events         = NULL;
+    p_tracer->gpu_calibrated = false;
+
+    // Calibrate before the tracer is live so the calibration itself isn't in the trace
+    tr_internal_trace_calibrate_gpu(p_renderer, p_tracer);
+
+    p_renderer->tracer = p_tracer;
+}
+
+bool tr_end_trace(tr_renderer* p_renderer, const char* file_path)
+{
+    TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
+    assert(NULL != p_renderer->tracer);
+    assert(NULL != file_path);
+
+    tr_internal_mutex_lock(&(p_renderer->tracer->mutex));
+    bool result = tr_internal_trace_write(p_renderer->tracer, file_path);
+    tr_internal_mutex_unlock(&(p_renderer->tracer->mutex));
+
+    tr_internal_destroy_tracer(p_renderer);
+
+    return result;
+}
+
 void tr_render_target_set_color_clear_value(tr_render_target* p_render_target, uint32_t attachment_index, float r, float g, float b, float a)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_render_target);
     assert(NULL != p_render_target);
     assert(attachment_index < p_render_target->color_attachment_count);
 
@@ -2083,6 +4167,7 @@ void tr_render_target_set_color_clear_value(tr_render_target* p_render_target, u
 
 void tr_render_target_set_depth_stencil_clear_value(tr_render_target* p_render_target, float depth, uint8_t stencil)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_render_target);
     assert(NULL != p_render_target);
 
     p_render_target->depth_stencil_attachment->clear_value.depth = depth;
@@ -2132,6 +4217,255 @@ uint32_t tr_vertex_layout_stride(const tr_vertex_layout* p_vertex_layout)
     return result;
 }
 
+// -------------------------------------------------------------------------------------------------
+// Render graph functions
+// -------------------------------------------------------------------------------------------------
+void tr_create_render_graph(tr_renderer* p_renderer, tr_render_graph** pp_render_graph)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
+    TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
+    assert(NULL != pp_render_graph);
+
+    tr_render_graph* p_render_graph = (tr_render_graph*)calloc(1, sizeof(*p_render_graph));
+    assert(NULL != p_render_graph);
+
+    p_render_graph->renderer = p_renderer;
+
+    *pp_render_graph = p_render_graph;
+}
+
+void tr_destroy_render_graph(tr_renderer* p_renderer, tr_render_graph* p_render_graph)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
+    TINY_RENDERER_RENDERER_PTR_CHECK(p_renderer);
+    assert(NULL != p_render_graph);
+
+    tr_internal_vk_render_graph_release_transients(p_render_graph);
+
+    for (uint32_t i = 0; i < p_render_graph->pass_count; ++i) {
+        TINY_RENDERER_SAFE_FREE(p_render_graph->passes[i].accesses);
+    }
+    TINY_RENDERER_SAFE_FREE(p_render_graph->passes);
+    TINY_RENDERER_SAFE_FREE(p_render_graph->resources);
+    TINY_RENDERER_SAFE_FREE(p_render_graph->schedule);
+    TINY_RENDERER_SAFE_FREE(p_render_graph->aliases);
+    TINY_RENDERER_SAFE_FREE(p_render_graph);
+}
+
+uint32_t tr_render_graph_import_buffer(tr_render_graph* p_render_graph, tr_buffer* p_buffer)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_render_graph);
+    assert(NULL != p_render_graph);
+    assert(NULL != p_buffer);
+
+    uint32_t resource = tr_internal_vk_render_graph_add_resource(p_render_graph, tr_render_graph_resource_type_buffer, false);
+    p_render_graph->resources[resource].buffer = p_buffer;
+    return resource;
+}
+
+uint32_t tr_render_graph_import_texture(tr_render_graph* p_render_graph, tr_texture* p_texture)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_render_graph);
+    assert(NULL != p_render_graph);
+    assert(NULL != p_texture);
+
+    uint32_t resource = tr_internal_vk_render_graph_add_resource(p_render_graph, tr_render_graph_resource_type_texture, false);
+    p_render_graph->resources[resource].texture = p_texture;
+    return resource;
+}
+
+uint32_t tr_render_graph_import_render_target(tr_render_graph* p_render_graph, tr_render_target* p_render_target)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_render_graph);
+    assert(NULL != p_render_graph);
+    assert(NULL != p_render_target);
+
+    uint32_t resource = tr_internal_vk_render_graph_add_resource(p_render_graph, tr_render_graph_resource_type_render_target, false);
+    p_render_graph->resources[resource].render_target = p_render_target;
+    return resource;
+}
+
+uint32_t tr_render_graph_create_render_target(
+    tr_render_graph*        p_render_graph,
+    uint32_t                width,
+    uint32_t                height,
+    tr_sample_count         sample_count,
+    tr_format               color_format,
+    uint32_t                color_attachment_count,
+    const tr_clear_value*   p_color_clear_values,
+    tr_format               depth_stencil_format,
+    const tr_clear_value*   p_depth_stencil_clear_value
+)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_render_graph);
+    assert(NULL != p_render_graph);
+    assert((width > 0) && (height > 0));
+    assert(color_attachment_count <= tr_max_render_target_attachments);
+    assert((color_attachment_count > 0) || (tr_format_undefined != depth_stencil_format));
+
+    uint32_t resource = tr_internal_vk_render_graph_add_resource(p_render_graph, tr_render_graph_resource_type_render_target, true);
+    tr_render_graph_resource* p_resource = &(p_render_graph->resources[resource]);
+    p_resource->width                  = width;
+    p_resource->height                 = height;
+    p_resource->sample_count           = sample_count;
+    p_resource->color_format           = color_format;
+    p_resource->color_attachment_count = color_attachment_count;
+    p_resource->depth_stencil_format   = depth_stencil_format;
+    if (NULL != p_color_clear_values) {
+        memcpy(p_resource->color_clear_values, p_color_clear_values, color_attachment_count * sizeof(*p_color_clear_values));
+    }
+    if (NULL != p_depth_stencil_clear_value) {
+        p_resource->depth_stencil_clear_value = *p_depth_stencil_clear_value;
+    }
+    return resource;
+}
+
+void tr_render_graph_bind_buffer(tr_render_graph* p_render_graph, uint32_t resource, tr_buffer* p_buffer)
+{
+    assert(NULL != p_render_graph);
+    assert(resource < p_render_graph->resource_count);
+    assert(tr_render_graph_resource_type_buffer == p_render_graph->resources[resource].type);
+    assert(NULL != p_buffer);
+
+    p_render_graph->resources[resource].buffer = p_buffer;
+}
+
+void tr_render_graph_bind_texture(tr_render_graph* p_render_graph, uint32_t resource, tr_texture* p_texture)
+{
+    assert(NULL != p_render_graph);
+    assert(resource < p_render_graph->resource_count);
+    assert(tr_render_graph_resource_type_texture == p_render_graph->resources[resource].type);
+    assert(NULL != p_texture);
+
+    p_render_graph->resources[resource].texture = p_texture;
+}
+
+void tr_render_graph_bind_render_target(tr_render_graph* p_render_graph, uint32_t resource, tr_render_target* p_render_target)
+{
+    assert(NULL != p_render_graph);
+    assert(resource < p_render_graph->resource_count);
+    assert(tr_render_graph_resource_type_render_target == p_render_graph->resources[resource].type);
+    assert(! p_render_graph->resources[resource].transient);
+    assert(NULL != p_render_target);
+
+    p_render_graph->resources[resource].render_target = p_render_target;
+}
+
+tr_render_target* tr_render_graph_get_render_target(tr_render_graph* p_render_graph, uint32_t resource)
+{
+    assert(NULL != p_render_graph);
+    assert(resource < p_render_graph->resource_count);
+    assert(tr_render_graph_resource_type_render_target == p_render_graph->resources[resource].type);
+
+    return p_render_graph->resources[resource].render_target;
+}
+
+uint32_t tr_render_graph_add_pass(tr_render_graph* p_render_graph, const char* name, tr_render_graph_execute_fn execute_fn, void* p_user_data)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_render_graph);
+    assert(NULL != p_render_graph);
+    assert(NULL != execute_fn);
+
+    if (p_render_graph->pass_count == p_render_graph->pass_capacity) {
+        uint32_t capacity = (p_render_graph->pass_capacity > 0) ? (2 * p_render_graph->pass_capacity) : 16;
+        p_render_graph->passes = (tr_render_graph_pass*)realloc(p_render_graph->passes, capacity * sizeof(*(p_render_graph->passes)));
+        assert(NULL != p_render_graph->passes);
+        p_render_graph->pass_capacity = capacity;
+    }
+
+    uint32_t pass = p_render_graph->pass_count++;
+    tr_render_graph_pass* p_pass = &(p_render_graph->passes[pass]);
+    memset(p_pass, 0, sizeof(*p_pass));
+    p_pass->name          = (NULL != name) ? name : "render_graph_pass";
+    p_pass->execute_fn    = execute_fn;
+    p_pass->user_data     = p_user_data;
+    p_pass->render_target = UINT32_MAX;
+    p_render_graph->compiled = false;
+    return pass;
+}
+
+void tr_render_graph_pass_render_target(tr_render_graph* p_render_graph, uint32_t pass, uint32_t resource)
+{
+    assert(NULL != p_render_graph);
+    assert(pass < p_render_graph->pass_count);
+    assert(resource < p_render_graph->resource_count);
+    assert(tr_render_graph_resource_type_render_target == p_render_graph->resources[resource].type);
+    // One render pass per pass
+    assert(UINT32_MAX == p_render_graph->passes[pass].render_target);
+
+    p_render_graph->passes[pass].render_target = resource;
+    tr_internal_vk_render_graph_add_access(p_render_graph, pass, resource, true, 0);
+}
+
+void tr_render_graph_pass_read_render_target(tr_render_graph* p_render_graph, uint32_t pass, uint32_t resource)
+{
+    assert(NULL != p_render_graph);
+    assert(pass < p_render_graph->pass_count);
+    assert(resource < p_render_graph->resource_count);
+    assert(tr_render_graph_resource_type_render_target == p_render_graph->resources[resource].type);
+
+    tr_internal_vk_render_graph_add_access(p_render_graph, pass, resource, false, tr_texture_usage_sampled_image);
+}
+
+void tr_render_graph_pass_read_buffer(tr_render_graph* p_render_graph, uint32_t pass, uint32_t resource, tr_buffer_usage usage)
+{
+    assert(NULL != p_render_graph);
+    assert(pass < p_render_graph->pass_count);
+    assert(resource < p_render_graph->resource_count);
+    assert(tr_render_graph_resource_type_buffer == p_render_graph->resources[resource].type);
+
+    tr_internal_vk_render_graph_add_access(p_render_graph, pass, resource, false, usage);
+}
+
+void tr_render_graph_pass_write_buffer(tr_render_graph* p_render_graph, uint32_t pass, uint32_t resource, tr_buffer_usage usage)
+{
+    assert(NULL != p_render_graph);
+    assert(pass < p_render_graph->pass_count);
+    assert(resource < p_render_graph->resource_count);
+    assert(tr_render_graph_resource_type_buffer == p_render_graph->resources[resource].type);
+
+    tr_internal_vk_render_graph_add_access(p_render_graph, pass, resource, true, usage);
+}
+
+void tr_render_graph_pass_read_texture(tr_render_graph* p_render_graph, uint32_t pass, uint32_t resource, tr_texture_usage usage)
+{
+    assert(NULL != p_render_graph);
+    assert(pass < p_render_graph->pass_count);
+    assert(resource < p_render_graph->resource_count);
+    assert(tr_render_graph_resource_type_texture == p_render_graph->resources[resource].type);
+
+    tr_internal_vk_render_graph_add_access(p_render_graph, pass, resource, false, usage);
+}
+
+void tr_render_graph_pass_write_texture(tr_render_graph* p_render_graph, uint32_t pass, uint32_t resource, tr_texture_usage usage)
+{
+    assert(NULL != p_render_graph);
+    assert(pass < p_render_graph->pass_count);
+    assert(resource < p_render_graph->resource_count);
+    assert(tr_render_graph_resource_type_texture == p_render_graph->resources[resource].type);
+
+    tr_internal_vk_render_graph_add_access(p_render_graph, pass, resource, true, usage);
+}
+
+void tr_render_graph_compile(tr_render_graph* p_render_graph)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_render_graph);
+    assert(NULL != p_render_graph);
+
+    tr_internal_vk_render_graph_compile(p_render_graph);
+}
+
+void tr_render_graph_execute(tr_render_graph* p_render_graph, tr_cmd* p_cmd)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_render_graph);
+    assert(NULL != p_render_graph);
+    assert(p_render_graph->compiled);
+    assert(NULL != p_cmd);
+    assert(NULL == p_cmd->bound_render_target);
+
+    tr_internal_vk_render_graph_execute(p_render_graph, p_cmd);
+}
+
 // -------------------------------------------------------------------------------------------------
 // Utility functions
 // -------------------------------------------------------------------------------------------------
@@ -2354,46 +4688,40 @@ uint32_t tr_util_format_channel_count(tr_format format)
 
 void tr_util_transition_buffer(tr_queue* p_queue, tr_buffer* p_buffer, tr_buffer_usage old_usage, tr_buffer_usage new_usage)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_queue);
+    tr_upload_wait(p_queue, tr_util_transition_buffer_async(p_queue, p_buffer, old_usage, new_usage));
+}
+
+void tr_util_transition_image(tr_queue* p_queue, tr_texture* p_texture, tr_texture_usage old_usage, tr_texture_usage new_usage)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_queue);
+    tr_upload_wait(p_queue, tr_util_transition_image_async(p_queue, p_texture, old_usage, new_usage));
+}
+
+tr_upload_ticket tr_util_transition_buffer_async(tr_queue* p_queue, tr_buffer* p_buffer, tr_buffer_usage old_usage, tr_buffer_usage new_usage)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_queue);
     assert(NULL != p_queue);
     assert(NULL != p_buffer);
 
-    tr_cmd_pool* p_cmd_pool = NULL;
-    tr_create_cmd_pool(p_queue->renderer, p_queue, true, &p_cmd_pool);
-
-    tr_cmd* p_cmd = NULL;
-    tr_create_cmd(p_cmd_pool, false, &p_cmd);
-    
-    tr_begin_cmd(p_cmd);
+    tr_staging_ring* p_ring = tr_internal_vk_staging_ring_for_queue(p_queue);
+    tr_cmd* p_cmd = tr_internal_vk_staging_ring_batch_cmd(p_ring);
     tr_cmd_buffer_transition(p_cmd, p_buffer, old_usage, new_usage);
-    tr_end_cmd(p_cmd);
 
-    tr_queue_submit(p_queue, 1, &p_cmd, 0, NULL, 0, NULL);
-    tr_queue_wait_idle(p_queue);
-
-    tr_destroy_cmd(p_cmd_pool, p_cmd);
-    tr_destroy_cmd_pool(p_queue->renderer, p_cmd_pool);
+    return tr_internal_vk_staging_ring_ticket(p_ring);
 }
 
-void tr_util_transition_image(tr_queue* p_queue, tr_texture* p_texture, tr_texture_usage old_usage, tr_texture_usage new_usage)
+tr_upload_ticket tr_util_transition_image_async(tr_queue* p_queue, tr_texture* p_texture, tr_texture_usage old_usage, tr_texture_usage new_usage)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_queue);
     assert(NULL != p_queue);
     assert(NULL != p_texture);
 
-    tr_cmd_pool* p_cmd_pool = NULL;
-    tr_create_cmd_pool(p_queue->renderer, p_queue, true, &p_cmd_pool);
-
-    tr_cmd* p_cmd = NULL;
-    tr_create_cmd(p_cmd_pool, false, &p_cmd);
-    
-    tr_begin_cmd(p_cmd);
+    tr_staging_ring* p_ring = tr_internal_vk_staging_ring_for_queue(p_queue);
+    tr_cmd* p_cmd = tr_internal_vk_staging_ring_batch_cmd(p_ring);
     tr_cmd_image_transition(p_cmd, p_texture, old_usage, new_usage);
-    tr_end_cmd(p_cmd);
 
-    tr_queue_submit(p_queue, 1, &p_cmd, 0, NULL, 0, NULL);
-    tr_queue_wait_idle(p_queue);
-
-    tr_destroy_cmd(p_cmd_pool, p_cmd);
-    tr_destroy_cmd_pool(p_queue->renderer, p_cmd_pool);
+    return tr_internal_vk_staging_ring_ticket(p_ring);
 }
 
 bool tr_image_resize_uint8_t(
@@ -2430,113 +4758,169 @@ bool tr_image_resize_uint8_t(
 
 void tr_util_set_storage_buffer_count(tr_queue* p_queue, uint64_t count_offset, uint32_t count, tr_buffer* p_counter_buffer)
 {
-    assert(NULL != p_queue);
-    assert(NULL != p_counter_buffer);
-    assert(NULL != p_counter_buffer->vk_buffer);
+    TINY_RENDERER_TRACE_SCOPE(p_queue);
+    tr_upload_wait(p_queue, tr_util_set_storage_buffer_count_async(p_queue, count_offset, count, p_counter_buffer));
+}
 
-    tr_buffer* buffer = NULL;
-    tr_create_buffer(p_counter_buffer->renderer, tr_buffer_usage_transfer_src, p_counter_buffer->size, true, &buffer);
-    uint32_t* mapped_ptr = (uint32_t*)buffer->cpu_mapped_address;
-    *(mapped_ptr) = count;
-    
-    tr_cmd_pool* p_cmd_pool = NULL;
-    tr_create_cmd_pool(p_queue->renderer, p_queue, true, &p_cmd_pool);
+void tr_util_clear_buffer(tr_queue* p_queue, tr_buffer* p_buffer)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_queue);
+    tr_upload_wait(p_queue, tr_util_clear_buffer_async(p_queue, p_buffer));
+}
 
-    tr_cmd* p_cmd = NULL;
-    tr_create_cmd(p_cmd_pool, false, &p_cmd);
-
-    tr_begin_cmd(p_cmd);
-    tr_internal_vk_cmd_buffer_transition(p_cmd, p_counter_buffer, tr_buffer_usage_storage_uav, tr_buffer_usage_transfer_dst);
-    TINY_RENDERER_DECLARE_ZERO(VkBufferCopy, region);
-    region.srcOffset = 0;
-    region.dstOffset = 0;
-    region.size      = (VkDeviceSize)4;
-    vkCmdCopyBuffer(p_cmd->vk_cmd_buf, buffer->vk_buffer, p_counter_buffer->vk_buffer, 1, &region);
-    tr_internal_vk_cmd_buffer_transition(p_cmd, p_counter_buffer, tr_buffer_usage_transfer_dst, tr_buffer_usage_storage_uav);
-    tr_end_cmd(p_cmd);
+void tr_util_update_buffer(tr_queue* p_queue, uint64_t size, const void* p_src_data, tr_buffer* p_buffer)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_queue);
+    // Doesn't wait, the batch is submitted with the next submit on the queue
+    tr_util_update_buffer_async(p_queue, size, p_src_data, p_buffer);
+}
 
-    tr_queue_submit(p_queue, 1, &p_cmd, 0, NULL, 0, NULL);
-    tr_queue_wait_idle(p_queue);
+tr_upload_ticket tr_util_set_storage_buffer_count_async(tr_queue* p_queue, uint64_t count_offset, uint32_t count, tr_buffer* p_counter_buffer)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_queue);
+    assert(NULL != p_queue);
+    assert(NULL != p_counter_buffer);
+    assert(NULL != p_counter_buffer->vk_buffer);
+    assert((count_offset + sizeof(count)) <= p_counter_buffer->size);
 
-    tr_destroy_cmd(p_cmd_pool, p_cmd);
-    tr_destroy_cmd_pool(p_queue->renderer, p_cmd_pool);
+    tr_staging_ring* p_ring = tr_internal_vk_staging_ring_for_queue(p_queue);
+    tr_buffer* p_src_buffer = NULL;
+    uint64_t src_offset = 0;
+    uint8_t* p_dst = tr_internal_vk_staging_ring_stage(p_ring, sizeof(count), 4, &p_src_buffer, &src_offset);
+    memcpy(p_dst, &count, sizeof(count));
+    tr_cmd* p_cmd = tr_internal_vk_staging_ring_batch_cmd(p_ring);
+    tr_internal_vk_cmd_copy_staged_buffer(p_cmd, p_src_buffer, src_offset, count_offset, sizeof(count), p_counter_buffer);
+    tr_internal_vk_staging_ring_release_buffer(p_ring, p_counter_buffer, tr_buffer_usage_transfer_dst, p_counter_buffer->usage);
 
-    tr_destroy_buffer(p_counter_buffer->renderer, buffer);
+    return tr_internal_vk_staging_ring_ticket(p_ring);
 }
 
-void tr_util_clear_buffer(tr_queue* p_queue, tr_buffer* p_buffer)
+tr_upload_ticket tr_util_clear_buffer_async(tr_queue* p_queue, tr_buffer* p_buffer)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_queue);
     assert(NULL != p_queue);
     assert(NULL != p_buffer);
     assert(NULL != p_buffer->vk_buffer);
 
-    tr_buffer* buffer = NULL;
-    tr_create_buffer(p_buffer->renderer, tr_buffer_usage_transfer_src, p_buffer->size, true, &buffer);
-    memset(buffer->cpu_mapped_address, 0, buffer->size);
-    
-    tr_cmd_pool* p_cmd_pool = NULL;
-    tr_create_cmd_pool(p_queue->renderer, p_queue, true, &p_cmd_pool);
+    // Fills on the GPU, nothing needs to be staged. Vulkan 1.0 transfer queues can't fill buffers.
+    assert(0 != (p_queue->vk_queue_flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)));
+    tr_staging_ring* p_ring = tr_internal_vk_staging_ring_for_queue(p_queue);
+    tr_cmd* p_cmd = tr_internal_vk_staging_ring_batch_cmd(p_ring);
+    tr_internal_vk_cmd_buffer_state(p_cmd, p_buffer, tr_buffer_usage_transfer_dst);
+    tr_internal_vk_cmd_flush_barriers(p_cmd);
+    vkCmdFillBuffer(p_cmd->vk_cmd_buf, p_buffer->vk_buffer, 0, VK_WHOLE_SIZE, 0);
+    tr_internal_vk_cmd_buffer_state(p_cmd, p_buffer, p_buffer->usage);
 
-    tr_cmd* p_cmd = NULL;
-    tr_create_cmd(p_cmd_pool, false, &p_cmd);
+    return tr_internal_vk_staging_ring_ticket(p_ring);
+}
 
-    tr_begin_cmd(p_cmd);
-    tr_internal_vk_cmd_buffer_transition(p_cmd, p_buffer, p_buffer->usage, tr_buffer_usage_transfer_dst);
-    TINY_RENDERER_DECLARE_ZERO(VkBufferCopy, region);
-    region.srcOffset = 0;
-    region.dstOffset = 0;
-    region.size      = (VkDeviceSize)p_buffer->size;
-    vkCmdCopyBuffer(p_cmd->vk_cmd_buf, buffer->vk_buffer, p_buffer->vk_buffer, 1, &region);
-    tr_internal_vk_cmd_buffer_transition(p_cmd, p_buffer, tr_buffer_usage_transfer_dst, p_buffer->usage);
-    tr_end_cmd(p_cmd);
+tr_upload_ticket tr_util_update_buffer_async(tr_queue* p_queue, uint64_t size, const void* p_src_data, tr_buffer* p_buffer)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_queue);
+    assert(NULL != p_queue);
+    assert(NULL != p_src_data);
+    assert(NULL != p_buffer);
+    assert(NULL != p_buffer->vk_buffer);
+    assert(p_buffer->size >= size);
 
-    tr_queue_submit(p_queue, 1, &p_cmd, 0, NULL, 0, NULL);
-    tr_queue_wait_idle(p_queue);
+    tr_staging_ring* p_ring = tr_internal_vk_staging_ring_for_queue(p_queue);
 
-    tr_destroy_cmd(p_cmd_pool, p_cmd);
-    tr_destroy_cmd_pool(p_queue->renderer, p_cmd_pool);
+    // Large updates are split up so that a single update never needs the entire ring
+    const uint64_t max_chunk_size = p_ring->size / 4;
+    uint64_t offset = 0;
+    while (offset < size) {
+        uint64_t chunk_size = tr_min_64(size - offset, max_chunk_size);
+        tr_buffer* p_src_buffer = NULL;
+        uint64_t src_offset = 0;
+        uint8_t* p_dst = tr_internal_vk_staging_ring_stage(p_ring, chunk_size, 16, &p_src_buffer, &src_offset);
+        memcpy(p_dst, (const uint8_t*)p_src_data + offset, chunk_size);
+        tr_cmd* p_cmd = tr_internal_vk_staging_ring_batch_cmd(p_ring);
+        tr_internal_vk_cmd_copy_staged_buffer(p_cmd, p_src_buffer, src_offset, offset, chunk_size, p_buffer);
+        offset += chunk_size;
+    }
+    tr_internal_vk_staging_ring_release_buffer(p_ring, p_buffer, tr_buffer_usage_transfer_dst, p_buffer->usage);
 
-    tr_destroy_buffer(p_buffer->renderer, buffer);
+    return tr_internal_vk_staging_ring_ticket(p_ring);
 }
 
-void tr_util_update_buffer(tr_queue* p_queue, uint64_t size, const void* p_src_data, tr_buffer* p_buffer)
+bool tr_util_update_buffer_cmd(tr_cmd* p_cmd, uint64_t size, const void* p_src_data, tr_buffer* p_buffer)
 {
-    assert(NULL != p_queue);
+    TINY_RENDERER_TRACE_SCOPE(p_cmd);
+    assert(NULL != p_cmd);
     assert(NULL != p_src_data);
     assert(NULL != p_buffer);
     assert(NULL != p_buffer->vk_buffer);
     assert(p_buffer->size >= size);
+    assert(tr_internal_on_frame_thread() && "the staging ring is only used on the frame thread");
 
-    tr_buffer* buffer = NULL;
-    tr_create_buffer(p_buffer->renderer, tr_buffer_usage_transfer_src, size, true, &buffer);
-    memcpy(buffer->cpu_mapped_address, p_src_data, size);
-    
-    tr_cmd_pool* p_cmd_pool = NULL;
-    tr_create_cmd_pool(p_queue->renderer, p_queue, true, &p_cmd_pool);
+    // Uploads recorded into the caller's command buffer don't transfer queue ownership,
+    // on the transfer queue that's left to the caller (tr_cmd_buffer_queue_transfer).
+    tr_staging_ring* p_ring = tr_internal_vk_staging_ring_for_queue(p_cmd->cmd_pool->queue);
 
-    tr_cmd* p_cmd = NULL;
-    tr_create_cmd(p_cmd_pool, false, &p_cmd);
+    // Ring space used by p_cmd is held until p_cmd has been submitted and has completed, so
+    // splitting it up wouldn't help - it's staged in one piece or not at all.
+    if (size > p_ring->size) {
+        return false;
+    }
+    uint64_t ring_pos = 0;
+    if (! tr_internal_vk_staging_ring_write(p_ring, size, 16, p_src_data, &ring_pos)) {
+        return false;
+    }
+    tr_internal_vk_staging_ring_add_pending_cmd(p_ring, p_cmd, ring_pos);
+    tr_internal_vk_cmd_copy_staged_buffer(p_cmd, p_ring->buffer, ring_pos % p_ring->size, 0, size, p_buffer);
+    return true;
+}
 
-    tr_begin_cmd(p_cmd);
-    tr_internal_vk_cmd_buffer_transition(p_cmd, p_buffer, p_buffer->usage, tr_buffer_usage_transfer_dst);
-    TINY_RENDERER_DECLARE_ZERO(VkBufferCopy, region);
-    region.srcOffset = 0;
-    region.dstOffset = 0;
-    region.size      = (VkDeviceSize)size;
-    vkCmdCopyBuffer(p_cmd->vk_cmd_buf, buffer->vk_buffer, p_buffer->vk_buffer, 1, &region);
-    tr_internal_vk_cmd_buffer_transition(p_cmd, p_buffer, tr_buffer_usage_transfer_dst, p_buffer->usage);
-    tr_end_cmd(p_cmd);
+void tr_util_flush_uploads(tr_queue* p_queue)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_queue);
+    assert(NULL != p_queue);
 
-    tr_queue_submit(p_queue, 1, &p_cmd, 0, NULL, 0, NULL);
-    tr_queue_wait_idle(p_queue);
+    tr_staging_ring* p_ring = tr_internal_vk_staging_ring_for_queue(p_queue);
+    if (p_ring->recording) {
+        tr_internal_vk_queue_submit(p_queue, 0, NULL, 0, NULL, 0, NULL, NULL);
+    }
+}
 
-    tr_destroy_cmd(p_cmd_pool, p_cmd);
-    tr_destroy_cmd_pool(p_queue->renderer, p_cmd_pool);
+// Blits need both blit features on optimal tiling, integer formats can't be filtered linearly
+static bool tr_internal_vk_format_blit_filter(tr_renderer* p_renderer, tr_format format, VkFilter* p_filter)
+{
+    TINY_RENDERER_DECLARE_ZERO(VkFormatProperties, format_props);
+    vkGetPhysicalDeviceFormatProperties(p_renderer->vk_active_gpu, tr_util_to_vk_format(format), &format_props);
+    const VkFormatFeatureFlags features = format_props.optimalTilingFeatures;
+    const VkFormatFeatureFlags blit_features = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+    if (blit_features != (features & blit_features)) {
+        return false;
+    }
+    if (NULL != p_filter) {
+        *p_filter = (features & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+    }
+    return true;
+}
+
+bool tr_util_texture_supports_gpu_mips(tr_renderer* p_renderer, tr_format format)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_renderer);
+    assert(NULL != p_renderer);
 
-    tr_destroy_buffer(p_buffer->renderer, buffer);
+    return tr_internal_vk_format_blit_filter(p_renderer, format, NULL);
 }
 
 void tr_util_update_texture_uint8(tr_queue* p_queue, uint32_t src_width, uint32_t src_height, uint32_t src_row_stride, const uint8_t* p_src_data, uint32_t src_channel_count, tr_texture* p_texture, tr_image_resize_uint8_fn resize_fn, void* p_user_data)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_queue);
+    tr_upload_ticket ticket = tr_util_update_texture_uint8_async(p_queue, src_width, src_height, src_row_stride, p_src_data, src_channel_count, p_texture, resize_fn, p_user_data);
+    tr_upload_wait(p_queue, ticket);
+}
+
+void tr_util_update_texture_uint8_gpu_mips(tr_queue* p_queue, uint32_t src_width, uint32_t src_height, uint32_t src_row_stride, const uint8_t* p_src_data, uint32_t src_channel_count, tr_texture* p_texture, tr_image_resize_uint8_fn resize_fn, void* p_user_data)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_queue);
+    tr_upload_ticket ticket = tr_util_update_texture_uint8_gpu_mips_async(p_queue, src_width, src_height, src_row_stride, p_src_data, src_channel_count, p_texture, resize_fn, p_user_data);
+    tr_upload_wait(p_queue, ticket);
+}
+
+static tr_upload_ticket tr_internal_vk_update_texture_uint8(tr_queue* p_queue, uint32_t src_width, uint32_t src_height, uint32_t src_row_stride, const uint8_t* p_src_data, uint32_t src_channel_count, tr_texture* p_texture, tr_image_resize_uint8_fn resize_fn, void* p_user_data, bool gpu_mips)
 {
     assert(NULL != p_queue);
     assert(NULL != p_src_data);
@@ -2545,9 +4929,11 @@ void tr_util_update_texture_uint8(tr_queue* p_queue, uint32_t src_width, uint32_
     assert((src_width > 0) && (src_height > 0) && (src_row_stride > 0));
     assert(tr_sample_count_1 == p_texture->sample_count);
 
+    tr_staging_ring* p_ring = tr_internal_vk_staging_ring_for_queue(p_queue);
+
     uint8_t* p_expanded_src_data = NULL;
     const uint32_t dst_channel_count = tr_util_format_channel_count(p_texture->format);
-    assert(src_channel_count < dst_channel_count);
+    assert(src_channel_count <= dst_channel_count);
 
     if (src_channel_count < dst_channel_count) {
         uint32_t expanded_row_stride = src_width * dst_channel_count;
@@ -2581,12 +4967,6 @@ void tr_util_update_texture_uint8(tr_queue* p_queue, uint32_t src_width, uint32_
         p_src_data = p_expanded_src_data;
     }
 
-    // Get memory requirements that covers all mip levels
-    TINY_RENDERER_DECLARE_ZERO(VkMemoryRequirements, mem_reqs);
-    vkGetImageMemoryRequirements(p_texture->renderer->vk_device, p_texture->vk_image, &mem_reqs);
-    // Create temporary buffer big enough to fit all mip levels
-    tr_buffer* buffer = NULL;
-    tr_create_buffer(p_texture->renderer, tr_buffer_usage_transfer_src, mem_reqs.size, true, &buffer);
     //
     // If you're coming from D3D12, you might want to do something like:
     //
@@ -2611,85 +4991,166 @@ void tr_util_update_texture_uint8(tr_queue* p_queue, uint32_t src_width, uint32_
     // and offset for each mip level manually.
     // 
     
-    // Use default simple resize if a resize function was not supplied
+    // Use default simple resize if a resize function was not supplied. At the source size it
+    // only copies, so that level is copied straight from the source rows.
+    const bool copy_full_size = (NULL == resize_fn);
     if (NULL == resize_fn) {
         resize_fn = &tr_image_resize_uint8_t;
     }
-    // Resize image into appropriate mip level
-    uint32_t dst_width = p_texture->width;
-    uint32_t dst_height = p_texture->height;
-    VkDeviceSize buffer_offset = 0;
-    for (uint32_t mip_level = 0; mip_level < p_texture->mip_levels; ++mip_level) {
-        uint32_t dst_row_stride = src_row_stride >> mip_level;
-        uint8_t* p_dst_data = (uint8_t*)buffer->cpu_mapped_address + buffer_offset;
-        resize_fn(src_width, src_height, src_row_stride, p_src_data, dst_width, dst_height, dst_row_stride, p_dst_data, dst_channel_count, p_user_data);
-        buffer_offset += dst_row_stride * dst_height;
-        dst_width >>= 1;
-        dst_height >>= 1;
-    }
-
-    // Copy buffer to texture
-    buffer_offset = 0;
+
+    // Only mip 0 goes through the ring when the rest are blitted on the graphics queue
+    tr_renderer* p_renderer = p_queue->renderer;
+    gpu_mips = gpu_mips && (p_texture->mip_levels > 1) && (tr_texture_type_cube != p_texture->type) && (1 == p_texture->depth) &&
+               tr_internal_vk_format_blit_filter(p_renderer, p_texture->format, NULL);
+    const uint32_t upload_mip_levels = gpu_mips ? 1 : p_texture->mip_levels;
+
     VkFormat format = tr_util_to_vk_format(p_texture->format);
     VkImageAspectFlags aspect_mask = tr_util_vk_determine_aspect_mask(format);
-    {
-        const uint32_t region_count = p_texture->mip_levels;
-        VkBufferImageCopy* regions = (VkBufferImageCopy*)calloc(region_count, sizeof(*regions));
-        assert(NULL != regions);
-
-        dst_width = p_texture->width;
-        dst_height = p_texture->height;
-        for (uint32_t mip_level = 0; mip_level < p_texture->mip_levels; ++mip_level) {
-            regions[mip_level].bufferOffset                    = buffer_offset;
-            regions[mip_level].bufferRowLength                 = dst_width;
-            regions[mip_level].bufferImageHeight               = dst_height;
-            regions[mip_level].imageSubresource.aspectMask     = aspect_mask;
-            regions[mip_level].imageSubresource.mipLevel       = mip_level;
-            regions[mip_level].imageSubresource.baseArrayLayer = 0;
-            regions[mip_level].imageSubresource.layerCount     = 1;
-            regions[mip_level].imageOffset.x                   = 0;
-            regions[mip_level].imageOffset.y                   = 0;
-            regions[mip_level].imageOffset.z                   = 0;
-            regions[mip_level].imageExtent.width               = dst_width;
-            regions[mip_level].imageExtent.height              = dst_height;
-            regions[mip_level].imageExtent.depth               = 1;
-            buffer_offset += (src_row_stride >> mip_level) * dst_height;
-            dst_width >>= 1;
-            dst_height >>= 1;
-        }
-        
-        tr_cmd_pool* p_cmd_pool = NULL;
-        tr_create_cmd_pool(p_queue->renderer, p_queue, true, &p_cmd_pool);
+    // Texels of 8-bit formats are one byte per channel, bufferOffset has to be a multiple of both 4 and the texel size
+    const uint32_t texel_stride = dst_channel_count;
+    const uint64_t alignment = 16;
+    assert(0 == (alignment % texel_stride));
+    const uint64_t max_chunk_size = p_ring->size / 4;
 
-        tr_cmd* p_cmd = NULL;
-        tr_create_cmd(p_cmd_pool, false, &p_cmd);
+    tr_cmd* p_cmd = tr_internal_vk_staging_ring_batch_cmd(p_ring);
+    //
+    // Vulkan textures are created with VK_IMAGE_LAYOUT_UNDEFFINED (tr_texture_usage_undefined)
+    //
+    tr_internal_vk_cmd_image_transition(p_cmd, p_texture, tr_texture_usage_undefined, tr_texture_usage_transfer_dst);
 
-        tr_begin_cmd(p_cmd);
-        //
-        // Vulkan textures are created with VK_IMAGE_LAYOUT_UNDEFFINED (tr_texture_usage_undefined)
-        //
-        tr_internal_vk_cmd_image_transition(p_cmd, p_texture, tr_texture_usage_undefined, tr_texture_usage_transfer_dst);
-        vkCmdCopyBufferToImage(p_cmd->vk_cmd_buf, buffer->vk_buffer, p_texture->vk_image,
-            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, region_count, regions);
-        tr_internal_vk_cmd_image_transition(p_cmd, p_texture, tr_texture_usage_transfer_dst, tr_texture_usage_sampled_image);
-        tr_end_cmd(p_cmd);
+    // Mip levels that fit in a ring chunk are resized straight into the ring, larger ones
+    // are resized into p_mip_data first and copied in bands of rows. Levels that are only
+    // copied go band by band from the source rows.
+    uint8_t* p_mip_data = NULL;
+    uint32_t dst_width = p_texture->width;
+    uint32_t dst_height = p_texture->height;
+    for (uint32_t mip_level = 0; mip_level < upload_mip_levels; ++mip_level) {
+        const uint32_t dst_row_stride = dst_width * texel_stride;
+        const uint64_t mip_size = (uint64_t)dst_row_stride * dst_height;
+        const bool banded = mip_size > max_chunk_size;
+        const bool copy = copy_full_size && (dst_width == src_width) && (dst_height == src_height);
+        uint32_t band_height = dst_height;
+        if (banded) {
+            band_height = (uint32_t)(max_chunk_size / dst_row_stride);
+            assert(band_height > 0);
+        }
+        if (banded && (! copy)) {
+            TINY_RENDERER_SAFE_FREE(p_mip_data);
+            p_mip_data = (uint8_t*)calloc(1, (size_t)mip_size);
+            assert(NULL != p_mip_data);
+            resize_fn(src_width, src_height, src_row_stride, p_src_data, dst_width, dst_height, dst_row_stride, p_mip_data, dst_channel_count, p_user_data);
+        }
+
+        for (uint32_t y = 0; y < dst_height; y += band_height) {
+            const uint32_t row_count = tr_min(band_height, dst_height - y);
+            const uint64_t size = (uint64_t)dst_row_stride * row_count;
+            tr_buffer* p_src_buffer = NULL;
+            uint64_t src_offset = 0;
+            uint8_t* p_dst_data = tr_internal_vk_staging_ring_stage(p_ring, size, alignment, &p_src_buffer, &src_offset);
+            if (banded && (! copy)) {
+                memcpy(p_dst_data, p_mip_data + ((uint64_t)dst_row_stride * y), size);
+            }
+            else {
+                if (copy) {
+                    const uint8_t* p_src_row = p_src_data + ((uint64_t)src_row_stride * y);
+                    for (uint32_t row = 0; row < row_count; ++row) {
+                        memcpy(p_dst_data + ((uint64_t)dst_row_stride * row), p_src_row + ((uint64_t)src_row_stride * row), dst_row_stride);
+                    }
+                }
+                else {
+                    resize_fn(src_width, src_height, src_row_stride, p_src_data, dst_width, dst_height, dst_row_stride, p_dst_data, dst_channel_count, p_user_data);
+                }
+            }
 
-        tr_queue_submit(p_queue, 1, &p_cmd, 0, NULL, 0, NULL);
-        tr_queue_wait_idle(p_queue);
+            TINY_RENDERER_DECLARE_ZERO(VkBufferImageCopy, region);
+            region.bufferOffset                    = (VkDeviceSize)src_offset;
+            region.bufferRowLength                 = dst_width;
+            region.bufferImageHeight               = row_count;
+            region.imageSubresource.aspectMask     = aspect_mask;
+            region.imageSubresource.mipLevel       = mip_level;
+            region.imageSubresource.baseArrayLayer = 0;
+            region.imageSubresource.layerCount     = 1;
+            region.imageOffset.x                   = 0;
+            region.imageOffset.y                   = (int32_t)y;
+            region.imageOffset.z                   = 0;
+            region.imageExtent.width               = dst_width;
+            region.imageExtent.height              = row_count;
+            region.imageExtent.depth               = 1;
+
+            // Writing to the ring may have submitted the previous batch
+            p_cmd = tr_internal_vk_staging_ring_batch_cmd(p_ring);
+            tr_internal_vk_cmd_flush_barriers(p_cmd);
+            vkCmdCopyBufferToImage(p_cmd->vk_cmd_buf, p_src_buffer->vk_buffer, p_texture->vk_image,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+        }
+
+        dst_width = tr_max(dst_width >> 1, 1);
+        dst_height = tr_max(dst_height >> 1, 1);
+    }
+
+    // On the transfer queue this hands the texture over to the graphics queue. Blits need the
+    // graphics queue, so with GPU mips the acquire is followed by the blits in its batch.
+    if (gpu_mips) {
+        if (p_ring != p_renderer->staging_ring) {
+            tr_internal_vk_staging_ring_release_image(p_ring, p_texture, tr_texture_usage_transfer_dst, tr_texture_usage_transfer_dst);
+        }
+        p_cmd = tr_internal_vk_staging_ring_batch_cmd(p_renderer->staging_ring);
+        tr_internal_vk_cmd_generate_mips(p_cmd, p_texture, tr_texture_usage_sampled_image);
+    }
+    else {
+        tr_internal_vk_staging_ring_release_image(p_ring, p_texture, tr_texture_usage_transfer_dst, tr_texture_usage_sampled_image);
+    }
 
-        tr_destroy_cmd(p_cmd_pool, p_cmd);
-        tr_destroy_cmd_pool(p_queue->renderer, p_cmd_pool);
+    TINY_RENDERER_SAFE_FREE(p_mip_data);
+    TINY_RENDERER_SAFE_FREE(p_expanded_src_data);
 
-        tr_destroy_buffer(p_texture->renderer, buffer);
+    return tr_internal_vk_staging_ring_ticket(p_ring);
+}
 
-        TINY_RENDERER_SAFE_FREE(regions);
-    }
+tr_upload_ticket tr_util_update_texture_uint8_async(tr_queue* p_queue, uint32_t src_width, uint32_t src_height, uint32_t src_row_stride, const uint8_t* p_src_data, uint32_t src_channel_count, tr_texture* p_texture, tr_image_resize_uint8_fn resize_fn, void* p_user_data)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_queue);
+    return tr_internal_vk_update_texture_uint8(p_queue, src_width, src_height, src_row_stride, p_src_data, src_channel_count, p_texture, resize_fn, p_user_data, false);
+}
 
-    TINY_RENDERER_SAFE_FREE(p_expanded_src_data);
+tr_upload_ticket tr_util_update_texture_uint8_gpu_mips_async(tr_queue* p_queue, uint32_t src_width, uint32_t src_height, uint32_t src_row_stride, const uint8_t* p_src_data, uint32_t src_channel_count, tr_texture* p_texture, tr_image_resize_uint8_fn resize_fn, void* p_user_data)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_queue);
+    return tr_internal_vk_update_texture_uint8(p_queue, src_width, src_height, src_row_stride, p_src_data, src_channel_count, p_texture, resize_fn, p_user_data, true);
 }
 
 void tr_util_update_texture_float(tr_queue* p_queue, uint32_t src_width, uint32_t src_height, uint32_t src_row_stride, const float* p_src_data, uint32_t channels, tr_texture* p_texture, tr_image_resize_float_fn resize_fn, void* p_user_data)
 {
+    TINY_RENDERER_TRACE_SCOPE(p_queue);
+}
+
+bool tr_upload_is_complete(tr_queue* p_queue, tr_upload_ticket ticket)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_queue);
+    assert(NULL != p_queue);
+
+    tr_staging_ring* p_ring = tr_internal_vk_staging_ring_for_queue(p_queue);
+    if (p_ring->complete_serial < ticket) {
+        tr_internal_vk_staging_ring_retire(p_ring, false);
+    }
+    return p_ring->complete_serial >= ticket;
+}
+
+void tr_upload_wait(tr_queue* p_queue, tr_upload_ticket ticket)
+{
+    TINY_RENDERER_TRACE_SCOPE(p_queue);
+    assert(NULL != p_queue);
+
+    tr_staging_ring* p_ring = tr_internal_vk_staging_ring_for_queue(p_queue);
+    assert(ticket <= tr_internal_vk_staging_ring_ticket(p_ring));
+
+    // The ticket's batch may still be recording
+    if (ticket > p_ring->submit_serial) {
+        tr_internal_vk_staging_ring_flush(p_ring);
+    }
+    while (p_ring->complete_serial < ticket) {
+        tr_internal_vk_staging_ring_retire(p_ring, true);
+    }
 }
 
 // -------------------------------------------------------------------------------------------------
@@ -2779,6 +5240,8 @@ VkImageLayout tr_util_to_vk_image_layout(tr_texture_usage usage)
         case tr_texture_usage_storage_image            : result = VK_IMAGE_LAYOUT_GENERAL; break;
         case tr_texture_usage_color_attachment         : result = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL; break;
         case tr_texture_usage_depth_stencil_attachment : result = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL; break;
+        case tr_texture_usage_resolve_src              : result = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL; break;
+        case tr_texture_usage_resolve_dst              : result = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL; break;
         case tr_texture_usage_present                  : result = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; break;
     }
     return result;
@@ -2907,6 +5370,74 @@ bool tr_internal_vk_find_present_queue_family(VkPhysicalDevice gpu, VkSurfaceKHR
     return (VK_TRUE == found) ?  true : false;
 }
 
+bool tr_internal_vk_find_transfer_queue_family(VkPhysicalDevice gpu, uint32_t* p_queue_family_index)
+{
+    uint32_t count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(gpu, &count, NULL);
+    if (0 == count) {
+        return false;
+    }
+
+    VkQueueFamilyProperties* properties = (VkQueueFamilyProperties*)calloc(count, sizeof(*properties));
+    assert(NULL != properties);
+
+    vkGetPhysicalDeviceQueueFamilyProperties(gpu, &count, properties);
+
+    // Families that can do transfers but not graphics, prefer ones that can't do compute either
+    uint32_t found_index = UINT32_MAX;
+    for (uint32_t index = 0; index < count; ++index) {
+        VkQueueFlags flags = properties[index].queueFlags;
+        if ((0 == (flags & VK_QUEUE_TRANSFER_BIT)) || (0 != (flags & VK_QUEUE_GRAPHICS_BIT))) {
+            continue;
+        }
+        if ((UINT32_MAX == found_index) || (0 == (flags & VK_QUEUE_COMPUTE_BIT))) {
+            found_index = index;
+        }
+    }
+
+    TINY_RENDERER_SAFE_FREE(properties);
+
+    if ((UINT32_MAX != found_index) && (NULL != p_queue_family_index)) {
+        *p_queue_family_index = found_index;
+    }
+
+    return (UINT32_MAX != found_index) ? true : false;
+}
+
+VkQueueFlags tr_internal_vk_get_queue_family_flags(VkPhysicalDevice gpu, uint32_t queue_family_index)
+{
+    uint32_t count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(gpu, &count, NULL);
+    assert(queue_family_index < count);
+
+    VkQueueFamilyProperties* properties = (VkQueueFamilyProperties*)calloc(count, sizeof(*properties));
+    assert(NULL != properties);
+
+    vkGetPhysicalDeviceQueueFamilyProperties(gpu, &count, properties);
+    VkQueueFlags result = properties[queue_family_index].queueFlags;
+
+    TINY_RENDERER_SAFE_FREE(properties);
+
+    return result;
+}
+
+uint32_t tr_internal_vk_get_queue_family_timestamp_valid_bits(VkPhysicalDevice gpu, uint32_t queue_family_index)
+{
+    uint32_t count = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(gpu, &count, NULL);
+    assert(queue_family_index < count);
+
+    VkQueueFamilyProperties* properties = (VkQueueFamilyProperties*)calloc(count, sizeof(*properties));
+    assert(NULL != properties);
+
+    vkGetPhysicalDeviceQueueFamilyProperties(gpu, &count, properties);
+    uint32_t result = properties[queue_family_index].timestampValidBits;
+
+    TINY_RENDERER_SAFE_FREE(properties);
+
+    return result;
+}
+
 void tr_internal_vk_create_instance(const char* app_name, tr_renderer* p_renderer)
 {
     uint32_t count = 0;
@@ -3078,9 +5609,9 @@ void tr_internal_vk_create_device(tr_renderer* p_renderer)
             continue;
         }
 
-        // Make sure GPU supports present
-        uint32_t present_queue_family_index = UINT32_MAX;
-        if (! tr_internal_vk_find_present_queue_family(gpu, p_renderer->vk_surface, &present_queue_family_index)) {
+        // Make sure GPU supports present - without a surface the graphics queue stands in for it
+        uint32_t present_queue_family_index = graphics_queue_family_index;
+        if ((! p_renderer->settings.headless) && (! tr_internal_vk_find_present_queue_family(gpu, p_renderer->vk_surface, &present_queue_family_index))) {
             continue;
         }
             
@@ -3111,9 +5642,22 @@ void tr_internal_vk_create_device(tr_renderer* p_renderer)
     // Get device properties
     vkGetPhysicalDeviceProperties(p_renderer->vk_active_gpu, &(p_renderer->vk_active_gpu_properties));
 
+    // Uploads on the transfer queue can overlap rendering if the GPU has a separate transfer
+    // family, otherwise the transfer queue is just another name for the graphics queue.
+    p_renderer->transfer_queue->vk_queue_family_index = p_renderer->graphics_queue->vk_queue_family_index;
+    tr_internal_vk_find_transfer_queue_family(p_renderer->vk_active_gpu, &(p_renderer->transfer_queue->vk_queue_family_index));
+
+    p_renderer->graphics_queue->vk_queue_flags = tr_internal_vk_get_queue_family_flags(p_renderer->vk_active_gpu, p_renderer->graphics_queue->vk_queue_family_index);
+    p_renderer->present_queue->vk_queue_flags  = tr_internal_vk_get_queue_family_flags(p_renderer->vk_active_gpu, p_renderer->present_queue->vk_queue_family_index);
+    p_renderer->transfer_queue->vk_queue_flags = tr_internal_vk_get_queue_family_flags(p_renderer->vk_active_gpu, p_renderer->transfer_queue->vk_queue_family_index);
+
+    p_renderer->graphics_queue->vk_timestamp_valid_bits = tr_internal_vk_get_queue_family_timestamp_valid_bits(p_renderer->vk_active_gpu, p_renderer->graphics_queue->vk_queue_family_index);
+    p_renderer->present_queue->vk_timestamp_valid_bits  = tr_internal_vk_get_queue_family_timestamp_valid_bits(p_renderer->vk_active_gpu, p_renderer->present_queue->vk_queue_family_index);
+    p_renderer->transfer_queue->vk_timestamp_valid_bits = tr_internal_vk_get_queue_family_timestamp_valid_bits(p_renderer->vk_active_gpu, p_renderer->transfer_queue->vk_queue_family_index);
+
     float queue_priorites[1] = {1.0f};
     uint32_t queue_create_infos_count = 1;
-    TINY_RENDERER_DECLARE_ZERO(VkDeviceQueueCreateInfo, queue_create_infos[2]);
+    TINY_RENDERER_DECLARE_ZERO(VkDeviceQueueCreateInfo, queue_create_infos[3]);
     queue_create_infos[0].sType            = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
     queue_create_infos[0].pNext            = NULL;
     queue_create_infos[0].flags            = 0;
@@ -3129,6 +5673,17 @@ void tr_internal_vk_create_device(tr_renderer* p_renderer)
         queue_create_infos[1].queueCount       = 1;
         queue_create_infos[1].pQueuePriorities = queue_priorites;
     }
+    if ((p_renderer->transfer_queue->vk_queue_family_index != p_renderer->graphics_queue->vk_queue_family_index) &&
+        (p_renderer->transfer_queue->vk_queue_family_index != p_renderer->present_queue->vk_queue_family_index)) {
+        uint32_t n = queue_create_infos_count;
+        queue_create_infos_count               = n + 1;
+        queue_create_infos[n].sType            = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queue_create_infos[n].pNext            = NULL;
+        queue_create_infos[n].flags            = 0;
+        queue_create_infos[n].queueFamilyIndex = p_renderer->transfer_queue->vk_queue_family_index;
+        queue_create_infos[n].queueCount       = 1;
+        queue_create_infos[n].pQueuePriorities = queue_priorites;
+    }
 
     uint32_t extension_count = 0;
     const char* extensions[tr_max_instance_extensions] = { 0 };
@@ -3146,6 +5701,12 @@ void tr_internal_vk_create_device(tr_renderer* p_renderer)
             if (strcmp(extension_name, "VK_AMD_negative_viewport_height") == 0) {
               p_renderer->vk_device_ext_VK_AMD_negative_viewport_height = true;
             }
+            if (strcmp(extension_name, "VK_KHR_descriptor_update_template") == 0) {
+              p_renderer->vk_device_ext_VK_KHR_descriptor_update_template = true;
+            }
+            if (strcmp(extension_name, "VK_KHR_timeline_semaphore") == 0) {
+              p_renderer->vk_device_ext_VK_KHR_timeline_semaphore = true;
+            }
             uint32_t n = extension_count;
             size_t len = strlen(extension_name);
             extensions[n] = (const char*)calloc(1, len + 1);
@@ -3171,10 +5732,34 @@ void tr_internal_vk_create_device(tr_renderer* p_renderer)
     VkPhysicalDeviceFeatures gpu_features = { 0 };
     vkGetPhysicalDeviceFeatures(p_renderer->vk_active_gpu, &gpu_features);
     //gpu_features.multiViewport = VK_FALSE;
-        
+
+    // Everything supported is enabled, barriers can only name the optional stages if they are
+    p_renderer->vk_shader_stages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    if (VK_TRUE == gpu_features.geometryShader) {
+        p_renderer->vk_shader_stages |= VK_PIPELINE_STAGE_GEOMETRY_SHADER_BIT;
+    }
+    if (VK_TRUE == gpu_features.tessellationShader) {
+        p_renderer->vk_shader_stages |= VK_PIPELINE_STAGE_TESSELLATION_CONTROL_SHADER_BIT | VK_PIPELINE_STAGE_TESSELLATION_EVALUATION_SHADER_BIT;
+    }
+
+    // The timeline semaphore extension also needs its feature turned on
+    TINY_RENDERER_DECLARE_ZERO(VkPhysicalDeviceTimelineSemaphoreFeaturesKHR, timeline_features);
+    timeline_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+    timeline_features.pNext = NULL;
+    if (p_renderer->vk_device_ext_VK_KHR_timeline_semaphore) {
+        PFN_vkGetPhysicalDeviceFeatures2KHR get_features_2 = (PFN_vkGetPhysicalDeviceFeatures2KHR)vkGetInstanceProcAddr(p_renderer->vk_instance, "vkGetPhysicalDeviceFeatures2KHR");
+        if (NULL != get_features_2) {
+            TINY_RENDERER_DECLARE_ZERO(VkPhysicalDeviceFeatures2KHR, features_2);
+            features_2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+            features_2.pNext = &timeline_features;
+            get_features_2(p_renderer->vk_active_gpu, &features_2);
+        }
+        p_renderer->vk_device_ext_VK_KHR_timeline_semaphore = (VK_TRUE == timeline_features.timelineSemaphore);
+    }
+
     TINY_RENDERER_DECLARE_ZERO(VkDeviceCreateInfo, create_info);
     create_info.sType                   = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-    create_info.pNext                   = NULL;
+    create_info.pNext                   = p_renderer->vk_device_ext_VK_KHR_timeline_semaphore ? &timeline_features : NULL;
     create_info.flags                   = 0;
     create_info.queueCreateInfoCount    = queue_create_infos_count;
     create_info.pQueueCreateInfos       = queue_create_infos;
@@ -3197,6 +5782,29 @@ void tr_internal_vk_create_device(tr_renderer* p_renderer)
 
     vkGetDeviceQueue(p_renderer->vk_device, p_renderer->present_queue->vk_queue_family_index, 0, &(p_renderer->present_queue->vk_queue));
     assert(VK_NULL_HANDLE != p_renderer->present_queue->vk_queue);
+
+    vkGetDeviceQueue(p_renderer->vk_device, p_renderer->transfer_queue->vk_queue_family_index, 0, &(p_renderer->transfer_queue->vk_queue));
+    assert(VK_NULL_HANDLE != p_renderer->transfer_queue->vk_queue);
+
+    // Descriptor update templates, the set updates fall back to vkUpdateDescriptorSets without them
+    if (p_renderer->vk_device_ext_VK_KHR_descriptor_update_template) {
+        p_renderer->vk_create_descriptor_update_template   = (PFN_vkCreateDescriptorUpdateTemplateKHR)vkGetDeviceProcAddr(p_renderer->vk_device, "vkCreateDescriptorUpdateTemplateKHR");
+        p_renderer->vk_destroy_descriptor_update_template  = (PFN_vkDestroyDescriptorUpdateTemplateKHR)vkGetDeviceProcAddr(p_renderer->vk_device, "vkDestroyDescriptorUpdateTemplateKHR");
+        p_renderer->vk_update_descriptor_set_with_template = (PFN_vkUpdateDescriptorSetWithTemplateKHR)vkGetDeviceProcAddr(p_renderer->vk_device, "vkUpdateDescriptorSetWithTemplateKHR");
+        p_renderer->vk_device_ext_VK_KHR_descriptor_update_template = (NULL != p_renderer->vk_create_descriptor_update_template) &&
+                                                                      (NULL != p_renderer->vk_destroy_descriptor_update_template) &&
+                                                                      (NULL != p_renderer->vk_update_descriptor_set_with_template);
+    }
+
+    // Timeline semaphores, frames and uploads fall back to fences without them
+    if (p_renderer->vk_device_ext_VK_KHR_timeline_semaphore) {
+        p_renderer->vk_wait_semaphores             = (PFN_vkWaitSemaphoresKHR)vkGetDeviceProcAddr(p_renderer->vk_device, "vkWaitSemaphoresKHR");
+        p_renderer->vk_signal_semaphore            = (PFN_vkSignalSemaphoreKHR)vkGetDeviceProcAddr(p_renderer->vk_device, "vkSignalSemaphoreKHR");
+        p_renderer->vk_get_semaphore_counter_value = (PFN_vkGetSemaphoreCounterValueKHR)vkGetDeviceProcAddr(p_renderer->vk_device, "vkGetSemaphoreCounterValueKHR");
+        p_renderer->vk_device_ext_VK_KHR_timeline_semaphore = (NULL != p_renderer->vk_wait_semaphores) &&
+                                                              (NULL != p_renderer->vk_signal_semaphore) &&
+                                                              (NULL != p_renderer->vk_get_semaphore_counter_value);
+    }
 }
 
 void tr_internal_vk_create_swapchain(tr_renderer* p_renderer)
@@ -3211,7 +5819,34 @@ void tr_internal_vk_create_swapchain(tr_renderer* p_renderer)
         if (0 == p_renderer->settings.swapchain.image_count) {
             p_renderer->settings.swapchain.image_count = 2;
         }
+    }
+
+    // Make sure depth/stencil format is supported - fall back to VK_FORMAT_D16_UNORM if not
+    VkFormat vk_depth_stencil_format = tr_util_to_vk_format(p_renderer->settings.swapchain.depth_stencil_format);
+    if (VK_FORMAT_UNDEFINED != vk_depth_stencil_format) {
+        TINY_RENDERER_DECLARE_ZERO(VkImageFormatProperties, properties);
+        VkResult vk_res = vkGetPhysicalDeviceImageFormatProperties(p_renderer->vk_active_gpu, 
+                                                                   vk_depth_stencil_format,
+                                                                   VK_IMAGE_TYPE_2D, VK_IMAGE_TILING_OPTIMAL,
+                                                                   VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 
+                                                                   0, 
+                                                                   &properties);
+        // Fall back to something that's guaranteed to work
+        if (VK_SUCCESS != vk_res) {
+            p_renderer->settings.swapchain.depth_stencil_format = tr_format_d16_unorm;
+        }
+    }
+
+    // Headless renderers render into offscreen images, there's no surface to match
+    if (p_renderer->settings.headless) {
+        if (tr_format_undefined == p_renderer->settings.swapchain.color_format) {
+            p_renderer->settings.swapchain.color_format = tr_format_b8g8r8a8_unorm;
+        }
+        return;
+    }
 
+    // Surface image count
+    {
         TINY_RENDERER_DECLARE_ZERO(VkSurfaceCapabilitiesKHR, caps);
         VkResult vk_res = vkGetPhysicalDeviceSurfaceCapabilitiesKHR(p_renderer->vk_active_gpu, p_renderer->vk_surface, &caps);
         assert(VK_SUCCESS == vk_res);
@@ -3328,22 +5963,6 @@ void tr_internal_vk_create_swapchain(tr_renderer* p_renderer)
         assert(VK_SUCCESS == vk_res);
 
         p_renderer->settings.swapchain.color_format = tr_util_from_vk_format(surface_format.format);
-
-        // Make sure depth/stencil format is supported - fall back to VK_FORMAT_D16_UNORM if not
-        VkFormat vk_depth_stencil_format = tr_util_to_vk_format(p_renderer->settings.swapchain.depth_stencil_format);
-        if (VK_FORMAT_UNDEFINED != vk_depth_stencil_format) {
-            TINY_RENDERER_DECLARE_ZERO(VkImageFormatProperties, properties);
-            vk_res = vkGetPhysicalDeviceImageFormatProperties(p_renderer->vk_active_gpu, 
-                                                           vk_depth_stencil_format,
-                                                           VK_IMAGE_TYPE_2D, VK_IMAGE_TILING_OPTIMAL,
-                                                           VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 
-                                                           0, 
-                                                           &properties);
-            // Fall back to something that's guaranteed to work
-            if (VK_SUCCESS != vk_res) {
-                p_renderer->settings.swapchain.depth_stencil_format = tr_format_d16_unorm;
-            }
-        }
     }
 }
 
@@ -3383,6 +6002,10 @@ void tr_internal_create_swapchain_renderpass(tr_renderer* p_renderer)
         tr_render_target* render_target = p_renderer->swapchain_render_targets[i];
         render_target->color_attachments[0]->type          = tr_texture_type_2d;
         render_target->color_attachments[0]->usage         = (tr_texture_usage)(tr_texture_usage_color_attachment | tr_texture_usage_present);
+        if (p_renderer->settings.headless) {
+            // Offscreen images can be sampled or copied out for readback
+            render_target->color_attachments[0]->usage     = (tr_texture_usage)(tr_texture_usage_color_attachment | tr_texture_usage_sampled_image | tr_texture_usage_transfer_src);
+        }
         render_target->color_attachments[0]->width         = p_renderer->settings.width;
         render_target->color_attachments[0]->height        = p_renderer->settings.height;
         render_target->color_attachments[0]->depth         = 1;
@@ -3428,6 +6051,25 @@ void tr_internal_vk_create_swapchain_renderpass(tr_renderer* p_renderer)
 {
     assert(VK_NULL_HANDLE != p_renderer->vk_device);
 
+    // Headless render targets own their color images, same as tr_create_render_target
+    if (p_renderer->settings.headless) {
+        for (uint32_t i = 0; i < p_renderer->settings.swapchain.image_count; ++i) {
+            tr_render_target* render_target = p_renderer->swapchain_render_targets[i];
+            tr_internal_vk_create_texture(p_renderer, render_target->color_attachments[0]);
+
+            if (p_renderer->settings.swapchain.sample_count > tr_sample_count_1) {
+                tr_internal_vk_create_texture(p_renderer, render_target->color_attachments_multisample[0]);
+            }
+
+            if (NULL != render_target->depth_stencil_attachment) {
+                tr_internal_vk_create_texture(p_renderer, render_target->depth_stencil_attachment);
+            }
+
+            tr_internal_vk_create_render_target(p_renderer, false, render_target);
+        }
+        return;
+    }
+
     uint32_t image_count = 0;
     VkResult vk_res = vkGetSwapchainImagesKHR(p_renderer->vk_device, p_renderer->vk_swapchain, &image_count, NULL);
     assert(VK_SUCCESS == vk_res);
@@ -3477,6 +6119,10 @@ void tr_internal_vk_destroy_instance(tr_renderer* p_renderer)
 
 void tr_internal_vk_destroy_surface(tr_renderer* p_renderer)
 {
+    if (p_renderer->settings.headless) {
+        return;
+    }
+
     assert(VK_NULL_HANDLE != p_renderer->vk_surface);
 
     vkDestroySurfaceKHR(p_renderer->vk_instance, p_renderer->vk_surface, NULL);
@@ -3484,13 +6130,17 @@ void tr_internal_vk_destroy_surface(tr_renderer* p_renderer)
 
 void tr_internal_vk_destroy_device(tr_renderer* p_renderer)
 {
-    assert(VK_NULL_HANDLE != p_renderer->vk_surface);
+    assert(VK_NULL_HANDLE != p_renderer->vk_device);
 
     vkDestroyDevice(p_renderer->vk_device, NULL);
 }
 
 void tr_internal_vk_destroy_swapchain(tr_renderer* p_renderer)
 {
+    if (p_renderer->settings.headless) {
+        return;
+    }
+
     assert(VK_NULL_HANDLE != p_renderer->vk_swapchain);
     assert(VK_NULL_HANDLE != p_renderer->vk_surface);
 
@@ -3498,1957 +6148,4991 @@ void tr_internal_vk_destroy_swapchain(tr_renderer* p_renderer)
 }
 
 // -------------------------------------------------------------------------------------------------
-// Internal create functions
+// Internal pipeline cache functions
 // -------------------------------------------------------------------------------------------------
-void tr_internal_vk_create_fence(tr_renderer *p_renderer, tr_fence* p_fence)
-{   
+void tr_internal_vk_create_pipeline_cache(tr_renderer* p_renderer)
+{
     assert(VK_NULL_HANDLE != p_renderer->vk_device);
 
-    TINY_RENDERER_DECLARE_ZERO(VkFenceCreateInfo, create_info);
-    create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    create_info.pNext = NULL;
-    create_info.flags = 0;
-    VkResult vk_res = vkCreateFence(p_renderer->vk_device,  &create_info, NULL, &(p_fence->vk_fence));
+    TINY_RENDERER_DECLARE_ZERO(VkPipelineCacheCreateInfo, create_info);
+    create_info.sType           = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    create_info.pNext           = NULL;
+    create_info.flags           = 0;
+    create_info.initialDataSize = 0;
+    create_info.pInitialData    = NULL;
+    VkResult vk_res = vkCreatePipelineCache(p_renderer->vk_device, &create_info, NULL, &(p_renderer->vk_pipeline_cache));
     assert(VK_SUCCESS == vk_res);
 }
 
-void tr_internal_vk_destroy_fence(tr_renderer *p_renderer, tr_fence* p_fence)
-{   
+void tr_internal_vk_destroy_pipeline_cache(tr_renderer* p_renderer)
+{
     assert(VK_NULL_HANDLE != p_renderer->vk_device);
-    assert(VK_NULL_HANDLE != p_fence->vk_fence);
+    assert(VK_NULL_HANDLE != p_renderer->vk_pipeline_cache);
 
-    vkDestroyFence(p_renderer->vk_device, p_fence->vk_fence, NULL);
+    vkDestroyPipelineCache(p_renderer->vk_device, p_renderer->vk_pipeline_cache, NULL);
 }
 
-void tr_internal_vk_create_semaphore(tr_renderer *p_renderer, tr_semaphore* p_semaphore)
-{   
-    assert(VK_NULL_HANDLE != p_renderer->vk_device);
-
-    TINY_RENDERER_DECLARE_ZERO(VkSemaphoreCreateInfo, create_info);
-    create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-    create_info.pNext = NULL;
-    create_info.flags = 0;
-    VkResult vk_res = vkCreateSemaphore(p_renderer->vk_device,  &create_info, NULL, &(p_semaphore->vk_semaphore));
-    assert(VK_SUCCESS == vk_res);
+static uint32_t tr_internal_vk_read_cache_uint32(const uint8_t* p_data)
+{
+    // Header fields are stored least significant byte first
+    return (uint32_t)p_data[0] | ((uint32_t)p_data[1] << 8) | ((uint32_t)p_data[2] << 16) | ((uint32_t)p_data[3] << 24);
 }
 
-void tr_internal_vk_destroy_semaphore(tr_renderer *p_renderer, tr_semaphore* p_semaphore)
-{   
-    assert(VK_NULL_HANDLE != p_renderer->vk_device);
-    assert(VK_NULL_HANDLE != p_semaphore->vk_semaphore);
+bool tr_internal_vk_validate_pipeline_cache(tr_renderer* p_renderer, size_t size, const void* p_data)
+{
+    // headerSize, headerVersion, vendorID, deviceID, pipelineCacheUUID
+    const size_t header_size = (4 * sizeof(uint32_t)) + VK_UUID_SIZE;
+    if (size < header_size) {
+        return false;
+    }
 
-    vkDestroySemaphore(p_renderer->vk_device, p_semaphore->vk_semaphore, NULL);
+    const uint8_t* p_header = (const uint8_t*)p_data;
+    uint32_t stored_header_size = tr_internal_vk_read_cache_uint32(p_header +  0);
+    uint32_t header_version     = tr_internal_vk_read_cache_uint32(p_header +  4);
+    uint32_t vendor_id          = tr_internal_vk_read_cache_uint32(p_header +  8);
+    uint32_t device_id          = tr_internal_vk_read_cache_uint32(p_header + 12);
+    const uint8_t* p_uuid       = p_header + 16;
+
+    const VkPhysicalDeviceProperties* p_props = &(p_renderer->vk_active_gpu_properties);
+    bool valid = (stored_header_size >= header_size) && (stored_header_size <= size) &&
+                 (VK_PIPELINE_CACHE_HEADER_VERSION_ONE == header_version) &&
+                 (p_props->vendorID == vendor_id) &&
+                 (p_props->deviceID == device_id) &&
+                 (0 == memcmp(p_props->pipelineCacheUUID, p_uuid, VK_UUID_SIZE));
+    return valid;
 }
 
-void tr_internal_vk_create_descriptor_set(tr_renderer* p_renderer, tr_descriptor_set* p_descriptor_set)
+bool tr_internal_vk_load_pipeline_cache(tr_renderer* p_renderer, const char* file_path)
 {
     assert(VK_NULL_HANDLE != p_renderer->vk_device);
+    assert(VK_NULL_HANDLE != p_renderer->vk_pipeline_cache);
 
-    enum {max_types = 12};
+    FILE* p_file = fopen(file_path, "rb");
+    if (NULL == p_file) {
+        return false;
+    }
 
-    TINY_RENDERER_DECLARE_ZERO(VkDescriptorPoolSize, pool_sizes_by_type[max_types]);
-    pool_sizes_by_type[VK_DESCRIPTOR_TYPE_SAMPLER               ].type = VK_DESCRIPTOR_TYPE_SAMPLER;
-    pool_sizes_by_type[VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    pool_sizes_by_type[VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE         ].type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
-    pool_sizes_by_type[VK_DESCRIPTOR_TYPE_STORAGE_IMAGE         ].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-    pool_sizes_by_type[VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER  ].type = VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
-    pool_sizes_by_type[VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER  ].type = VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER;
-    pool_sizes_by_type[VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER        ].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    pool_sizes_by_type[VK_DESCRIPTOR_TYPE_STORAGE_BUFFER        ].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER ;
-    pool_sizes_by_type[VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
-    pool_sizes_by_type[VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
-    pool_sizes_by_type[VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT      ].type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+    fseek(p_file, 0, SEEK_END);
+    long file_size = ftell(p_file);
+    fseek(p_file, 0, SEEK_SET);
+    if (file_size <= 0) {
+        fclose(p_file);
+        return false;
+    }
 
-    VkDescriptorSetLayoutBinding* bindings = (VkDescriptorSetLayoutBinding*)calloc(p_descriptor_set->descriptor_count, sizeof(*bindings));
-    assert(NULL != bindings);
+    size_t size = (size_t)file_size;
+    void* p_data = malloc(size);
+    assert(NULL != p_data);
+    size_t read_size = fread(p_data, 1, size, p_file);
+    fclose(p_file);
+
+    // A cache from another driver or GPU is at best useless, the driver isn't required to reject it
+    bool valid = (read_size == size) && tr_internal_vk_validate_pipeline_cache(p_renderer, size, p_data);
+    if (valid) {
+        TINY_RENDERER_DECLARE_ZERO(VkPipelineCacheCreateInfo, create_info);
+        create_info.sType           = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        create_info.pNext           = NULL;
+        create_info.flags           = 0;
+        create_info.initialDataSize = size;
+        create_info.pInitialData    = p_data;
+        VkPipelineCache loaded_cache = VK_NULL_HANDLE;
+        VkResult vk_res = vkCreatePipelineCache(p_renderer->vk_device, &create_info, NULL, &loaded_cache);
+        assert(VK_SUCCESS == vk_res);
 
-    for (uint32_t i = 0; i < p_descriptor_set->descriptor_count; ++i) {
-        const tr_descriptor* descriptor = &(p_descriptor_set->descriptors[i]);
-        VkDescriptorSetLayoutBinding* binding = &(bindings[i]);
-        uint32_t type_index = UINT32_MAX;
-        switch (descriptor->type) {
-            case tr_descriptor_type_sampler                  : type_index = VK_DESCRIPTOR_TYPE_SAMPLER; break;
-            case tr_descriptor_type_uniform_buffer_cbv       : type_index = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER; break;
-            case tr_descriptor_type_storage_buffer_srv       : type_index = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER; break;
-            case tr_descriptor_type_storage_buffer_uav       : type_index = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER; break;
-            case tr_descriptor_type_uniform_texel_buffer_srv : type_index = VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER; break;
-            case tr_descriptor_type_storage_texel_buffer_uav : type_index = VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER; break;
-            case tr_descriptor_type_texture_srv              : type_index = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE; break;
-            case tr_descriptor_type_texture_uav              : type_index = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE; break;
-        }
-        if (UINT32_MAX != type_index) {
-            binding->binding            = descriptor->binding;
-            binding->descriptorType     = (VkDescriptorType)type_index;
-            binding->descriptorCount    = descriptor->count;
-            binding->stageFlags         = tr_util_to_vk_shader_stages(descriptor->shader_stages);
-            binding->pImmutableSamplers = NULL;
+        // Merge rather than replace so pipelines created before the load stay cached
+        vk_res = vkMergePipelineCaches(p_renderer->vk_device, p_renderer->vk_pipeline_cache, 1, &loaded_cache);
+        assert(VK_SUCCESS == vk_res);
 
-            pool_sizes_by_type[type_index].descriptorCount += descriptor->count;
-        }
+        vkDestroyPipelineCache(p_renderer->vk_device, loaded_cache, NULL);
+    }
+    else {
+        tr_internal_log(tr_log_type_warn, "Pipeline cache file was written by a different device or driver - ignoring it", "tr_load_pipeline_cache");
     }
 
-    uint32_t pool_size_count = 0;
-    TINY_RENDERER_DECLARE_ZERO(VkDescriptorPoolSize, pool_sizes[max_types]);
-    for (uint32_t i = 0; i < max_types; ++i) {
-        if (pool_sizes_by_type[i].descriptorCount > 0) {
-            pool_sizes[pool_size_count].type = pool_sizes_by_type[i].type;
-            pool_sizes[pool_size_count].descriptorCount = pool_sizes_by_type[i].descriptorCount;
-            ++pool_size_count;
-        }
+    TINY_RENDERER_SAFE_FREE(p_data);
+
+    return valid;
+}
+
+bool tr_internal_vk_save_pipeline_cache(tr_renderer* p_renderer, const char* file_path)
+{
+    assert(VK_NULL_HANDLE != p_renderer->vk_device);
+    assert(VK_NULL_HANDLE != p_renderer->vk_pipeline_cache);
+
+    size_t size = 0;
+    VkResult vk_res = vkGetPipelineCacheData(p_renderer->vk_device, p_renderer->vk_pipeline_cache, &size, NULL);
+    assert(VK_SUCCESS == vk_res);
+    if (0 == size) {
+        return false;
     }
 
-    assert(0 != pool_size_count);
+    void* p_data = malloc(size);
+    assert(NULL != p_data);
+    vk_res = vkGetPipelineCacheData(p_renderer->vk_device, p_renderer->vk_pipeline_cache, &size, p_data);
+    assert((VK_SUCCESS == vk_res) || (VK_INCOMPLETE == vk_res));
 
-    // Descriptor pool
-    {
-        TINY_RENDERER_DECLARE_ZERO(VkDescriptorPoolCreateInfo, create_info);
-        create_info.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-        create_info.pNext         = NULL;
-        create_info.flags         = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT ;
-        create_info.maxSets       = 1;
-        create_info.poolSizeCount = pool_size_count;
-        create_info.pPoolSizes    = pool_sizes;
-        VkResult vk_res = vkCreateDescriptorPool(p_renderer->vk_device, &create_info, NULL, &(p_descriptor_set->vk_descriptor_pool));
-        assert(VK_SUCCESS == vk_res);
+    bool saved = false;
+    FILE* p_file = fopen(file_path, "wb");
+    if (NULL != p_file) {
+        saved = (size == fwrite(p_data, 1, size, p_file));
+        saved = (0 == fclose(p_file)) && saved;
     }
 
-    // Descriptor set layout
-    {
-        TINY_RENDERER_DECLARE_ZERO(VkDescriptorSetLayoutCreateInfo, create_info);
-        create_info.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-        create_info.pNext        = NULL;
-        create_info.flags        = 0;
-        create_info.bindingCount = p_descriptor_set->descriptor_count;
-        create_info.pBindings    = bindings;
-        VkResult vk_res = vkCreateDescriptorSetLayout(p_renderer->vk_device, &create_info, NULL, &(p_descriptor_set->vk_descriptor_set_layout));
-        assert(VK_SUCCESS == vk_res);
+    TINY_RENDERER_SAFE_FREE(p_data);
+
+    return saved;
+}
+
+// -------------------------------------------------------------------------------------------------
+// Internal async pipeline functions
+// -------------------------------------------------------------------------------------------------
+typedef struct tr_pipeline_job {
+    struct tr_pipeline_job*             next;
+    tr_shader_program*                  shader_program;
+    tr_vertex_layout                    vertex_layout;
+    tr_descriptor_set*                  descriptor_set;
+    tr_render_target*                   render_target;
+    tr_pipeline*                        pipeline;
+} tr_pipeline_job;
+
+// Jobs are a FIFO list guarded by mutex, which also guards tr_pipeline::compile_pending
+struct tr_pipeline_compiler {
+    tr_renderer*                        renderer;
+    tr_internal_mutex                   mutex;
+    tr_internal_cond                    job_added;
+    tr_internal_cond                    job_done;
+    tr_pipeline_job*                    first_job;
+    tr_pipeline_job*                    last_job;
+    bool                                stop;
+    uint32_t                            thread_count;
+    tr_internal_thread*                 threads;
+};
+
+static void tr_internal_vk_pipeline_compiler_thread(void* p_data)
+{
+    tr_pipeline_compiler* p_compiler = (tr_pipeline_compiler*)p_data;
+    tr_internal_mutex_lock(&(p_compiler->mutex));
+    for (;;) {
+        while ((NULL == p_compiler->first_job) && (! p_compiler->stop)) {
+            tr_internal_cond_wait(&(p_compiler->job_added), &(p_compiler->mutex));
+        }
+        // Stop only once the queue is empty, nobody else is going to finish these pipelines
+        if (NULL == p_compiler->first_job) {
+            break;
+        }
+
+        tr_pipeline_job* p_job = p_compiler->first_job;
+        p_compiler->first_job = p_job->next;
+        if (NULL == p_compiler->first_job) {
+            p_compiler->last_job = NULL;
+        }
+        tr_internal_mutex_unlock(&(p_compiler->mutex));
+
+        tr_pipeline* p_pipeline = p_job->pipeline;
+        {
+            TINY_RENDERER_TRACE_NAMED_SCOPE(p_compiler->renderer, "tr_pipeline_compile");
+            if (tr_pipeline_type_compute == p_pipeline->type) {
+                tr_internal_vk_create_compute_pipeline(p_compiler->renderer, p_job->shader_program, p_job->descriptor_set, &(p_pipeline->settings), p_pipeline);
+            }
+            else {
+                tr_internal_vk_create_pipeline(p_compiler->renderer, p_job->shader_program, &(p_job->vertex_layout), p_job->descriptor_set, p_job->render_target, &(p_pipeline->settings), p_pipeline);
+            }
+        }
+        TINY_RENDERER_SAFE_FREE(p_job);
+
+        tr_internal_mutex_lock(&(p_compiler->mutex));
+        p_pipeline->compile_pending = false;
+        tr_internal_cond_broadcast(&(p_compiler->job_done));
     }
+    tr_internal_mutex_unlock(&(p_compiler->mutex));
+}
 
-    // Allocate descriptor set
-    {
-        TINY_RENDERER_DECLARE_ZERO(VkDescriptorSetAllocateInfo, alloc_info);
-        alloc_info.sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-        alloc_info.pNext              = NULL;
-        alloc_info.descriptorPool     = p_descriptor_set->vk_descriptor_pool;
-        alloc_info.descriptorSetCount = 1;
-        alloc_info.pSetLayouts        = &(p_descriptor_set->vk_descriptor_set_layout);
-        VkResult vk_res = vkAllocateDescriptorSets(p_renderer->vk_device, &alloc_info, &(p_descriptor_set->vk_descriptor_set));
-        assert(VK_SUCCESS == vk_res);
+void tr_internal_vk_create_pipeline_compiler(tr_renderer* p_renderer)
+{
+    tr_pipeline_compiler* p_compiler = (tr_pipeline_compiler*)calloc(1, sizeof(*p_compiler));
+    assert(NULL != p_compiler);
+
+    uint32_t thread_count = TINY_RENDERER_PIPELINE_COMPILE_THREADS;
+    if (0 == thread_count) {
+        uint32_t hw_thread_count = tr_internal_hardware_thread_count();
+        thread_count = hw_thread_count > 1 ? (hw_thread_count - 1) : 1;
+    }
+
+    tr_internal_mutex_init(&(p_compiler->mutex));
+    tr_internal_cond_init(&(p_compiler->job_added));
+    tr_internal_cond_init(&(p_compiler->job_done));
+    p_compiler->renderer  = p_renderer;
+    p_compiler->first_job = NULL;
+    p_compiler->last_job  = NULL;
+    p_compiler->stop      = false;
+    p_compiler->threads   = (tr_internal_thread*)calloc(thread_count, sizeof(*(p_compiler->threads)));
+    assert(NULL != p_compiler->threads);
+    // Only count the threads that actually started so destroy never joins a bad handle
+    p_compiler->thread_count = 0;
+    for (uint32_t i = 0; i < thread_count; ++i) {
+        bool started = tr_internal_thread_start(&(p_compiler->threads[i]), tr_internal_vk_pipeline_compiler_thread, p_compiler);
+        assert(started);
+        if (! started) {
+            break;
+        }
+        ++(p_compiler->thread_count);
     }
 
-    TINY_RENDERER_SAFE_FREE(bindings);
+    p_renderer->pipeline_compiler = p_compiler;
 }
 
-void tr_internal_vk_destroy_descriptor_set(tr_renderer* p_renderer, tr_descriptor_set* p_descriptor_set)
+void tr_internal_vk_destroy_pipeline_compiler(tr_renderer* p_renderer)
 {
-    assert(VK_NULL_HANDLE != p_renderer->vk_device);
-    assert(VK_NULL_HANDLE != p_descriptor_set->vk_descriptor_set_layout);
-    assert(VK_NULL_HANDLE != p_descriptor_set->vk_descriptor_set);
-    assert(VK_NULL_HANDLE != p_descriptor_set->vk_descriptor_pool);
+    tr_pipeline_compiler* p_compiler = p_renderer->pipeline_compiler;
+    if (NULL == p_compiler) {
+        return;
+    }
 
-    VkResult vk_res = vkFreeDescriptorSets(p_renderer->vk_device, p_descriptor_set->vk_descriptor_pool, 1, &(p_descriptor_set->vk_descriptor_set));
-    assert(VK_SUCCESS == vk_res);
+    tr_internal_mutex_lock(&(p_compiler->mutex));
+    p_compiler->stop = true;
+    tr_internal_mutex_unlock(&(p_compiler->mutex));
+    tr_internal_cond_broadcast(&(p_compiler->job_added));
 
-    vkDestroyDescriptorSetLayout(p_renderer->vk_device, p_descriptor_set->vk_descriptor_set_layout, NULL);
-    vkDestroyDescriptorPool(p_renderer->vk_device, p_descriptor_set->vk_descriptor_pool, NULL);
+    for (uint32_t i = 0; i < p_compiler->thread_count; ++i) {
+        tr_internal_thread_join(&(p_compiler->threads[i]));
+    }
+
+    tr_internal_cond_destroy(&(p_compiler->job_done));
+    tr_internal_cond_destroy(&(p_compiler->job_added));
+    tr_internal_mutex_destroy(&(p_compiler->mutex));
+    TINY_RENDERER_SAFE_FREE(p_compiler->threads);
+    TINY_RENDERER_SAFE_FREE(p_compiler);
+    p_renderer->pipeline_compiler = NULL;
 }
 
-void tr_internal_vk_create_cmd_pool(tr_renderer *p_renderer, tr_queue* p_queue, bool transient, tr_cmd_pool* p_cmd_pool)
+void tr_internal_vk_queue_pipeline_job(tr_renderer* p_renderer, tr_shader_program* p_shader_program, const tr_vertex_layout* p_vertex_layout, tr_descriptor_set* p_descriptor_set, tr_render_target* p_render_target, tr_pipeline* p_pipeline)
 {
-    assert(VK_NULL_HANDLE != p_renderer->vk_device);
-    assert(p_renderer->graphics_queue->vk_queue_family_index == p_queue->vk_queue_family_index);
-    assert((p_queue->vk_queue_family_index == p_renderer->graphics_queue->vk_queue_family_index) ||
-           (p_queue->vk_queue_family_index == p_renderer->present_queue->vk_queue_family_index));
+    // Workers are only started once something asks for them
+    if (NULL == p_renderer->pipeline_compiler) {
+        tr_internal_vk_create_pipeline_compiler(p_renderer);
+    }
 
-    TINY_RENDERER_DECLARE_ZERO(VkCommandPoolCreateInfo, create_info);
-    create_info.sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    create_info.pNext            = NULL;
-    create_info.flags            = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-    create_info.queueFamilyIndex = p_queue->vk_queue_family_index;
-    if (transient) {
-        create_info.flags |= VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    tr_pipeline_job* p_job = (tr_pipeline_job*)calloc(1, sizeof(*p_job));
+    assert(NULL != p_job);
+
+    p_job->shader_program = p_shader_program;
+    p_job->descriptor_set = p_descriptor_set;
+    p_job->render_target  = p_render_target;
+    p_job->pipeline       = p_pipeline;
+    if (NULL != p_vertex_layout) {
+        memcpy(&(p_job->vertex_layout), p_vertex_layout, sizeof(*p_vertex_layout));
     }
-    VkResult vk_res = vkCreateCommandPool(p_renderer->vk_device, &create_info, NULL, &(p_cmd_pool->vk_cmd_pool));
-    assert(VK_SUCCESS == vk_res);
+
+    tr_pipeline_compiler* p_compiler = p_renderer->pipeline_compiler;
+    tr_internal_mutex_lock(&(p_compiler->mutex));
+    if (NULL != p_compiler->last_job) {
+        p_compiler->last_job->next = p_job;
+    }
+    else {
+        p_compiler->first_job = p_job;
+    }
+    p_compiler->last_job = p_job;
+    tr_internal_mutex_unlock(&(p_compiler->mutex));
+    tr_internal_cond_signal(&(p_compiler->job_added));
 }
 
-void tr_internal_vk_destroy_cmd_pool(tr_renderer *p_renderer, tr_cmd_pool* p_cmd_pool)
+bool tr_internal_vk_pipeline_is_ready(tr_pipeline* p_pipeline)
 {
-    assert(VK_NULL_HANDLE != p_renderer->vk_device);
-    assert(VK_NULL_HANDLE != p_cmd_pool->vk_cmd_pool);
+    if (! p_pipeline->compile_async) {
+        return true;
+    }
 
-    vkDestroyCommandPool(p_renderer->vk_device, p_cmd_pool->vk_cmd_pool, NULL);
+    tr_pipeline_compiler* p_compiler = p_pipeline->renderer->pipeline_compiler;
+    tr_internal_mutex_lock(&(p_compiler->mutex));
+    bool ready = ! p_pipeline->compile_pending;
+    tr_internal_mutex_unlock(&(p_compiler->mutex));
+    return ready;
 }
 
-void tr_internal_vk_create_cmd(tr_cmd_pool *p_cmd_pool, bool secondary, tr_cmd* p_cmd)
+void tr_internal_vk_pipeline_wait(tr_pipeline* p_pipeline)
 {
-    assert(VK_NULL_HANDLE != p_cmd_pool->renderer->vk_device);
-    assert(VK_NULL_HANDLE != p_cmd_pool->vk_cmd_pool);
+    if (! p_pipeline->compile_async) {
+        return;
+    }
 
-    TINY_RENDERER_DECLARE_ZERO(VkCommandBufferAllocateInfo, alloc_info);
-    alloc_info.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    alloc_info.pNext              = NULL;
-    alloc_info.commandPool        = p_cmd_pool->vk_cmd_pool;
-    alloc_info.level              = secondary ? VK_COMMAND_BUFFER_LEVEL_SECONDARY : VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    alloc_info.commandBufferCount = 1;
-    VkResult vk_res = vkAllocateCommandBuffers(p_cmd_pool->renderer->vk_device, &alloc_info, &(p_cmd->vk_cmd_buf));
-    assert(VK_SUCCESS == vk_res);
+    tr_pipeline_compiler* p_compiler = p_pipeline->renderer->pipeline_compiler;
+    tr_internal_mutex_lock(&(p_compiler->mutex));
+    while (p_pipeline->compile_pending) {
+        tr_internal_cond_wait(&(p_compiler->job_done), &(p_compiler->mutex));
+    }
+    tr_internal_mutex_unlock(&(p_compiler->mutex));
 }
 
-void tr_internal_vk_destroy_cmd(tr_cmd_pool *p_cmd_pool, tr_cmd* p_cmd)
+tr_pipeline* tr_internal_vk_resolve_pipeline(tr_pipeline* p_pipeline)
 {
-    assert(VK_NULL_HANDLE != p_cmd_pool->renderer->vk_device);
-    assert(VK_NULL_HANDLE != p_cmd_pool->vk_cmd_pool);
-    assert(VK_NULL_HANDLE != p_cmd->vk_cmd_buf);
+    if (tr_internal_vk_pipeline_is_ready(p_pipeline)) {
+        return p_pipeline;
+    }
 
-    vkFreeCommandBuffers(p_cmd_pool->renderer->vk_device, p_cmd_pool->vk_cmd_pool, 1, &(p_cmd->vk_cmd_buf));
+    if (NULL != p_pipeline->placeholder) {
+        return tr_internal_vk_resolve_pipeline(p_pipeline->placeholder);
+    }
+
+    tr_internal_vk_pipeline_wait(p_pipeline);
+    return p_pipeline;
 }
 
-void tr_internal_vk_create_buffer(tr_renderer* p_renderer, tr_buffer* p_buffer)
+// -------------------------------------------------------------------------------------------------
+// Internal pipeline registry functions
+// -------------------------------------------------------------------------------------------------
+static void tr_internal_vk_rehash_pipeline_registry(tr_pipeline_registry* p_registry, uint32_t bucket_count)
 {
-    assert(VK_NULL_HANDLE != p_renderer->vk_device);
+    // Bucket count has to stay a power of 2 for the mask below
+    assert(0 == (bucket_count & (bucket_count - 1)));
 
-    // Align the buffer size to multiples of the dynamic uniform buffer minimum size
-    if (p_buffer->usage & tr_buffer_usage_uniform_cbv) {
-        // Make minimum size 256 bytes to match D3D12
-        p_buffer->size = tr_round_up(tr_max(p_buffer->size, 256), 
-                                     static_cast<uint32_t>(p_renderer->vk_active_gpu_properties.limits.minUniformBufferOffsetAlignment));
+    tr_pipeline** buckets = (tr_pipeline**)calloc(bucket_count, sizeof(*buckets));
+    assert(NULL != buckets);
+
+    for (uint32_t i = 0; i < p_registry->bucket_count; ++i) {
+        tr_pipeline* p_pipeline = p_registry->buckets[i];
+        while (NULL != p_pipeline) {
+            tr_pipeline* p_next = p_pipeline->registry_next;
+            uint32_t index = (uint32_t)(p_pipeline->state_hash & (bucket_count - 1));
+            p_pipeline->registry_next = buckets[index];
+            buckets[index] = p_pipeline;
+            p_pipeline = p_next;
+        }
     }
 
-    TINY_RENDERER_DECLARE_ZERO(VkBufferCreateInfo, create_info);
-    create_info.sType                 = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    create_info.pNext                 = NULL;
-    create_info.flags                 = 0;
-    create_info.size                  = p_buffer->size;
-    create_info.usage                 = tr_util_to_vk_buffer_usage(p_buffer->usage);
-    create_info.sharingMode           = VK_SHARING_MODE_EXCLUSIVE;
-    create_info.queueFamilyIndexCount = 0;
-    create_info.pQueueFamilyIndices   = NULL;
+    TINY_RENDERER_SAFE_FREE(p_registry->buckets);
+    p_registry->buckets = buckets;
+    p_registry->bucket_count = bucket_count;
+}
 
-    // Make it easy to copy to and from buffer
-    create_info.usage |= (VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+void tr_internal_vk_create_pipeline_registry(tr_renderer* p_renderer)
+{
+    tr_pipeline_registry* p_registry = (tr_pipeline_registry*)calloc(1, sizeof(*p_registry));
+    assert(NULL != p_registry);
 
-    VkResult vk_res = vkCreateBuffer(p_renderer->vk_device, &create_info, NULL, &(p_buffer->vk_buffer));
-    assert(VK_SUCCESS == vk_res);
+    tr_internal_vk_rehash_pipeline_registry(p_registry, 64);
 
-    TINY_RENDERER_DECLARE_ZERO(VkMemoryRequirements, mem_reqs);
-    vkGetBufferMemoryRequirements(p_renderer->vk_device, p_buffer->vk_buffer, &mem_reqs);
+    p_renderer->pipeline_registry = p_registry;
+}
 
-    VkMemoryPropertyFlags mem_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-    if (p_buffer->host_visible) {
-        mem_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+void tr_internal_vk_destroy_pipeline_registry(tr_renderer* p_renderer)
+{
+    tr_pipeline_registry* p_registry = p_renderer->pipeline_registry;
+    if (NULL == p_registry) {
+        return;
     }
 
-    uint32_t memory_type_index = UINT32_MAX;
-    bool found_memmory = tr_util_vk_get_memory_type(&p_renderer->vk_memory_properties, mem_reqs.memoryTypeBits, mem_flags, &memory_type_index);
-    assert(found_memmory);
+    // Pipelines still in the registry belong to the application, only the table goes away
+    TINY_RENDERER_SAFE_FREE(p_registry->buckets);
+    TINY_RENDERER_SAFE_FREE(p_renderer->pipeline_registry);
+}
 
-    TINY_RENDERER_DECLARE_ZERO(VkMemoryAllocateInfo, alloc_info);
-    alloc_info.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    alloc_info.pNext           = NULL;
-    alloc_info.allocationSize  = mem_reqs.size;
-    alloc_info.memoryTypeIndex = memory_type_index;
-    vk_res = vkAllocateMemory(p_renderer->vk_device, &alloc_info, NULL, &(p_buffer->vk_memory));
-    assert(VK_SUCCESS == vk_res);
+void tr_internal_vk_make_pipeline_key(tr_pipeline_type type, tr_shader_program* p_shader_program, const tr_vertex_layout* p_vertex_layout, tr_descriptor_set* p_descriptor_set, tr_render_target* p_render_target, const tr_pipeline_settings* p_pipeline_settings, tr_pipeline_key* p_key)
+{
+    memset(p_key, 0, sizeof(*p_key));
+    p_key->type = type;
 
-    vk_res = vkBindBufferMemory(p_renderer->vk_device, p_buffer->vk_buffer, p_buffer->vk_memory, 0);
-    assert(VK_SUCCESS == vk_res);
+    // The hashes are rebuilt while the content is copied, the registry owns it once registered
+    uint8_t** pp_content = &(p_key->content);
+    uint32_t* p_content_size = &(p_key->content_size);
+    uint32_t content_capacity = 0;
 
-    if (p_buffer->host_visible) {
-        vk_res = vkMapMemory(p_renderer->vk_device, p_buffer->vk_memory, 0, VK_WHOLE_SIZE, 0, &(p_buffer->cpu_mapped_address));
-        assert(VK_SUCCESS == vk_res);
+    if (NULL != p_shader_program) {
+        p_key->shader_hash = p_shader_program->hash;
+        tr_hash_64_keep(0, p_shader_program->content_size, p_shader_program->content, pp_content, p_content_size, &content_capacity);
     }
 
-    switch (p_buffer->usage) {
-        case tr_buffer_usage_uniform_texel_srv:
-        case tr_buffer_usage_storage_texel_uav: {
-            TINY_RENDERER_DECLARE_ZERO(VkBufferViewCreateInfo, buffer_view_create_info);
-            buffer_view_create_info.sType   = VK_STRUCTURE_TYPE_BUFFER_VIEW_CREATE_INFO;
-            buffer_view_create_info.pNext   = NULL;
-            buffer_view_create_info.flags   = 0;
-            buffer_view_create_info.buffer  = p_buffer->vk_buffer;
-            buffer_view_create_info.format  = tr_util_to_vk_format(p_buffer->format);
-            buffer_view_create_info.range   = VK_WHOLE_SIZE;
-            vk_res = vkCreateBufferView(p_renderer->vk_device, &buffer_view_create_info, NULL, &(p_buffer->vk_buffer_view));
+    // Only what goes into the descriptor set layout
+    if (NULL != p_descriptor_set) {
+        p_key->descriptor_content_offset = *p_content_size;
+        uint64_t hash = tr_hash_64_keep(0, sizeof(p_descriptor_set->descriptor_count), &(p_descriptor_set->descriptor_count), pp_content, p_content_size, &content_capacity);
+        for (uint32_t i = 0; i < p_descriptor_set->descriptor_count; ++i) {
+            const tr_descriptor* p_descriptor = &(p_descriptor_set->descriptors[i]);
+            hash = tr_hash_64_keep(hash, sizeof(p_descriptor->type), &(p_descriptor->type), pp_content, p_content_size, &content_capacity);
+            hash = tr_hash_64_keep(hash, sizeof(p_descriptor->binding), &(p_descriptor->binding), pp_content, p_content_size, &content_capacity);
+            hash = tr_hash_64_keep(hash, sizeof(p_descriptor->count), &(p_descriptor->count), pp_content, p_content_size, &content_capacity);
+            hash = tr_hash_64_keep(hash, sizeof(p_descriptor->shader_stages), &(p_descriptor->shader_stages), pp_content, p_content_size, &content_capacity);
         }
-        break;
+        p_key->descriptor_hash = hash;
+        p_key->descriptor_content_size = *p_content_size - p_key->descriptor_content_offset;
+    }
 
-        case tr_buffer_usage_uniform_cbv:
-        case tr_buffer_usage_storage_srv:
-        case tr_buffer_usage_storage_uav: {
-            p_buffer->vk_buffer_info.buffer = p_buffer->vk_buffer;
-            p_buffer->vk_buffer_info.offset = 0;
-            p_buffer->vk_buffer_info.range  = VK_WHOLE_SIZE;
+    // Render pass compatibility only depends on the attachment formats and sample counts
+    if (NULL != p_render_target) {
+        uint64_t hash = tr_hash_64_keep(0, sizeof(p_render_target->sample_count), &(p_render_target->sample_count), pp_content, p_content_size, &content_capacity);
+        hash = tr_hash_64_keep(hash, sizeof(p_render_target->color_attachment_count), &(p_render_target->color_attachment_count), pp_content, p_content_size, &content_capacity);
+        hash = tr_hash_64_keep(hash, sizeof(p_render_target->color_format), &(p_render_target->color_format), pp_content, p_content_size, &content_capacity);
+        hash = tr_hash_64_keep(hash, sizeof(p_render_target->depth_stencil_format), &(p_render_target->depth_stencil_format), pp_content, p_content_size, &content_capacity);
+        p_key->render_pass_hash = hash;
+    }
+
+    // Semantic names don't make it into the pipeline
+    if (NULL != p_vertex_layout) {
+        uint64_t hash = tr_hash_64_keep(0, sizeof(p_vertex_layout->attrib_count), &(p_vertex_layout->attrib_count), pp_content, p_content_size, &content_capacity);
+        for (uint32_t i = 0; i < p_vertex_layout->attrib_count; ++i) {
+            const tr_vertex_attrib* p_attrib = &(p_vertex_layout->attribs[i]);
+            hash = tr_hash_64_keep(hash, sizeof(p_attrib->semantic), &(p_attrib->semantic), pp_content, p_content_size, &content_capacity);
+            hash = tr_hash_64_keep(hash, sizeof(p_attrib->format), &(p_attrib->format), pp_content, p_content_size, &content_capacity);
+            hash = tr_hash_64_keep(hash, sizeof(p_attrib->binding), &(p_attrib->binding), pp_content, p_content_size, &content_capacity);
+            hash = tr_hash_64_keep(hash, sizeof(p_attrib->location), &(p_attrib->location), pp_content, p_content_size, &content_capacity);
+            hash = tr_hash_64_keep(hash, sizeof(p_attrib->offset), &(p_attrib->offset), pp_content, p_content_size, &content_capacity);
         }
-        break;
+        p_key->vertex_layout_hash = hash;
+    }
+
+    // Field by field, padding in the application's copy of the settings is undefined
+    {
+        uint64_t hash = tr_hash_64_keep(0, sizeof(p_pipeline_settings->primitive_topo), &(p_pipeline_settings->primitive_topo), pp_content, p_content_size, &content_capacity);
+        hash = tr_hash_64_keep(hash, sizeof(p_pipeline_settings->cull_mode), &(p_pipeline_settings->cull_mode), pp_content, p_content_size, &content_capacity);
+        hash = tr_hash_64_keep(hash, sizeof(p_pipeline_settings->front_face), &(p_pipeline_settings->front_face), pp_content, p_content_size, &content_capacity);
+        hash = tr_hash_64_keep(hash, sizeof(p_pipeline_settings->depth_test), &(p_pipeline_settings->depth_test), pp_content, p_content_size, &content_capacity);
+        hash = tr_hash_64_keep(hash, sizeof(p_pipeline_settings->depth_write), &(p_pipeline_settings->depth_write), pp_content, p_content_size, &content_capacity);
+        p_key->settings_hash = hash;
     }
 }
 
-void tr_internal_vk_destroy_buffer(tr_renderer* p_renderer, tr_buffer* p_buffer)
+static uint64_t tr_internal_vk_hash_pipeline_key(const tr_pipeline_key* p_key)
 {
-    assert(VK_NULL_HANDLE != p_renderer->vk_device);
-    assert(VK_NULL_HANDLE != p_buffer->vk_buffer);
-    
-    vkDestroyBuffer(p_renderer->vk_device, p_buffer->vk_buffer, NULL);
+    uint64_t hash = tr_hash_64(0, sizeof(p_key->type), &(p_key->type));
+    hash = tr_hash_64(hash, sizeof(p_key->shader_hash), &(p_key->shader_hash));
+    hash = tr_hash_64(hash, sizeof(p_key->descriptor_hash), &(p_key->descriptor_hash));
+    hash = tr_hash_64(hash, sizeof(p_key->render_pass_hash), &(p_key->render_pass_hash));
+    hash = tr_hash_64(hash, sizeof(p_key->vertex_layout_hash), &(p_key->vertex_layout_hash));
+    hash = tr_hash_64(hash, sizeof(p_key->settings_hash), &(p_key->settings_hash));
+    return hash;
 }
 
-void tr_internal_vk_create_texture(tr_renderer* p_renderer, tr_texture* p_texture)
+static bool tr_internal_vk_pipeline_key_equal(const tr_pipeline_key* p_a, const tr_pipeline_key* p_b)
 {
-    assert(VK_NULL_HANDLE != p_renderer->vk_device);
+    return (p_a->type == p_b->type) &&
+           (p_a->shader_hash == p_b->shader_hash) &&
+           (p_a->descriptor_hash == p_b->descriptor_hash) &&
+           (p_a->render_pass_hash == p_b->render_pass_hash) &&
+           (p_a->vertex_layout_hash == p_b->vertex_layout_hash) &&
+           (p_a->settings_hash == p_b->settings_hash) &&
+           (p_a->content_size == p_b->content_size) &&
+           ((0 == p_a->content_size) || (0 == memcmp(p_a->content, p_b->content, p_a->content_size)));
+}
 
-    p_texture->renderer = p_renderer;
+// Pipeline layouts are built from the descriptor set alone, so matching descriptors are compatible
+bool tr_internal_vk_pipeline_key_layout_equal(const tr_pipeline_key* p_a, const tr_pipeline_key* p_b)
+{
+    return (p_a->descriptor_hash == p_b->descriptor_hash) &&
+           (p_a->descriptor_content_size == p_b->descriptor_content_size) &&
+           ((0 == p_a->descriptor_content_size) ||
+            (0 == memcmp(p_a->content + p_a->descriptor_content_offset, p_b->content + p_b->descriptor_content_offset, p_a->descriptor_content_size)));
+}
 
-    if (VK_NULL_HANDLE == p_texture->vk_image) {
-        VkImageType image_type = VK_IMAGE_TYPE_2D;
-        switch (p_texture->type) {
-            case tr_texture_type_1d   : image_type = VK_IMAGE_TYPE_1D; break;
-            case tr_texture_type_2d   : image_type = VK_IMAGE_TYPE_2D; break;
-            case tr_texture_type_3d   : image_type = VK_IMAGE_TYPE_3D; break;
-            case tr_texture_type_cube : image_type = VK_IMAGE_TYPE_2D; break;
-        }
+tr_pipeline* tr_internal_vk_acquire_registered_pipeline(tr_renderer* p_renderer, const tr_pipeline_key* p_key)
+{
+    tr_pipeline_registry* p_registry = p_renderer->pipeline_registry;
+    assert(NULL != p_registry);
 
-        TINY_RENDERER_DECLARE_ZERO(VkImageCreateInfo, create_info);
-        create_info.sType                 = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-        create_info.pNext                 = NULL;
-        create_info.flags                 = 0;
-        create_info.imageType             = image_type;
-        create_info.format                = tr_util_to_vk_format(p_texture->format);
-        create_info.extent.width          = p_texture->width;
-        create_info.extent.height         = p_texture->height;
-        create_info.extent.depth          = p_texture->depth;
-        create_info.mipLevels             = p_texture->mip_levels;
-        create_info.arrayLayers           = p_texture->host_visible ? 1 : 1;
-        create_info.samples               = tr_util_to_vk_sample_count(p_texture->sample_count);
-        create_info.tiling                = (0 != p_texture->host_visible) ? VK_IMAGE_TILING_LINEAR : VK_IMAGE_TILING_OPTIMAL;
-        create_info.usage                 = tr_util_to_vk_image_usage(p_texture->usage);
-        create_info.sharingMode           = VK_SHARING_MODE_EXCLUSIVE;
-        create_info.queueFamilyIndexCount = 0;
-        create_info.pQueueFamilyIndices   = NULL;
-        create_info.initialLayout         = VK_IMAGE_LAYOUT_UNDEFINED;
-        if (VK_IMAGE_USAGE_SAMPLED_BIT & create_info.usage) {
-            // Make it easy to copy to and from textures
-            create_info.usage |= (VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
-        }
-        // Verify that GPU supports this format
-        TINY_RENDERER_DECLARE_ZERO(VkFormatProperties, format_props);
-        vkGetPhysicalDeviceFormatProperties(p_renderer->vk_active_gpu, create_info.format, &format_props);
-        VkFormatFeatureFlags format_features = tr_util_vk_image_usage_to_format_features(create_info.usage);
-        if (p_texture->host_visible) {
-            VkFormatFeatureFlags flags = format_props.linearTilingFeatures & format_features;
-            assert((0 != flags) && "Format is not supported for host visible images");
-        }
-        else {
-            VkFormatFeatureFlags flags = format_props.optimalTilingFeatures & format_features;
-            assert((0 != flags) && "Format is not supported for GPU local images (i.e. not host visible images)");
+    uint64_t hash = tr_internal_vk_hash_pipeline_key(p_key);
+    uint32_t index = (uint32_t)(hash & (p_registry->bucket_count - 1));
+    for (tr_pipeline* p_pipeline = p_registry->buckets[index]; NULL != p_pipeline; p_pipeline = p_pipeline->registry_next) {
+        if ((p_pipeline->state_hash == hash) && tr_internal_vk_pipeline_key_equal(&(p_pipeline->state_key), p_key)) {
+            p_pipeline->ref_count += 1;
+            p_registry->hit_count += 1;
+            return p_pipeline;
         }
-        // Apply some bounds to the image
-        TINY_RENDERER_DECLARE_ZERO(VkImageFormatProperties, image_format_props);
-        VkResult vk_res = vkGetPhysicalDeviceImageFormatProperties(p_renderer->vk_active_gpu, create_info.format,
-            create_info.imageType, create_info.tiling, create_info.usage, create_info.flags, &image_format_props);
-        assert(VK_SUCCESS == vk_res);
-        if (create_info.mipLevels > 1) {
-            p_texture->mip_levels = tr_min(p_texture->mip_levels, image_format_props.maxMipLevels);
-            create_info.mipLevels = p_texture->mip_levels;
-        }
-        // Create image
-        vk_res = vkCreateImage(p_renderer->vk_device, &create_info, NULL, &(p_texture->vk_image));
-        assert(VK_SUCCESS == vk_res);
+    }
 
-        TINY_RENDERER_DECLARE_ZERO(VkMemoryRequirements, mem_reqs);
-        vkGetImageMemoryRequirements(p_renderer->vk_device, p_texture->vk_image, &mem_reqs);
+    p_registry->miss_count += 1;
+    return NULL;
+}
 
-        VkMemoryPropertyFlags mem_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-        if (p_texture->host_visible) {
-            mem_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-        }
+void tr_internal_vk_register_pipeline(tr_renderer* p_renderer, const tr_pipeline_key* p_key, tr_pipeline* p_pipeline)
+{
+    tr_pipeline_registry* p_registry = p_renderer->pipeline_registry;
+    assert(NULL != p_registry);
 
-        uint32_t memory_type_index = UINT32_MAX;
-        bool found_memory = tr_util_vk_get_memory_type(&p_renderer->vk_memory_properties, mem_reqs.memoryTypeBits, mem_flags, &memory_type_index);
-        assert(found_memory);
+    memcpy(&(p_pipeline->state_key), p_key, sizeof(*p_key));
+    p_pipeline->state_hash = tr_internal_vk_hash_pipeline_key(p_key);
+    p_pipeline->ref_count = 1;
 
-        TINY_RENDERER_DECLARE_ZERO(VkMemoryAllocateInfo, alloc_info);
-        alloc_info.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        alloc_info.pNext           = NULL;
-        alloc_info.allocationSize  = mem_reqs.size;
-        alloc_info.memoryTypeIndex = memory_type_index;
-        vk_res = vkAllocateMemory(p_renderer->vk_device, &alloc_info, NULL, &(p_texture->vk_memory));
-        assert(VK_SUCCESS == vk_res);
+    // Keep the load factor at or below 1
+    if (p_registry->pipeline_count >= p_registry->bucket_count) {
+        tr_internal_vk_rehash_pipeline_registry(p_registry, 2 * p_registry->bucket_count);
+    }
 
-        vk_res = vkBindImageMemory(p_renderer->vk_device, p_texture->vk_image, p_texture->vk_memory, 0);
-        assert(VK_SUCCESS == vk_res);
+    uint32_t index = (uint32_t)(p_pipeline->state_hash & (p_registry->bucket_count - 1));
+    p_pipeline->registry_next = p_registry->buckets[index];
+    p_registry->buckets[index] = p_pipeline;
+    p_registry->pipeline_count += 1;
+}
 
-        if (p_texture->host_visible) {
-            vk_res = vkMapMemory(p_renderer->vk_device, p_texture->vk_memory, 0, VK_WHOLE_SIZE, 0, &(p_texture->cpu_mapped_address));
-            assert(VK_SUCCESS == vk_res);
+void tr_internal_vk_unregister_pipeline(tr_renderer* p_renderer, tr_pipeline* p_pipeline)
+{
+    tr_pipeline_registry* p_registry = p_renderer->pipeline_registry;
+    assert(NULL != p_registry);
+
+    uint32_t index = (uint32_t)(p_pipeline->state_hash & (p_registry->bucket_count - 1));
+    tr_pipeline** pp_link = &(p_registry->buckets[index]);
+    while (NULL != *pp_link) {
+        if (*pp_link == p_pipeline) {
+            *pp_link = p_pipeline->registry_next;
+            p_pipeline->registry_next = NULL;
+            p_registry->pipeline_count -= 1;
+            return;
         }
+        pp_link = &((*pp_link)->registry_next);
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+// Internal memory functions
+// -------------------------------------------------------------------------------------------------
+static tr_memory_block* tr_internal_vk_create_memory_block(tr_renderer* p_renderer, uint32_t memory_type_index, bool linear, uint64_t size)
+{
+    tr_memory_block* p_block = (tr_memory_block*)calloc(1, sizeof(*p_block));
+    assert(NULL != p_block);
+
+    p_block->memory_type_index   = memory_type_index;
+    p_block->linear              = linear;
+    p_block->size                = size;
+    p_block->free_range_capacity = 16;
+    p_block->free_ranges         = (tr_memory_range*)calloc(p_block->free_range_capacity, sizeof(*(p_block->free_ranges)));
+    assert(NULL != p_block->free_ranges);
+
+    // The whole block starts out as one free range
+    p_block->free_range_count       = 1;
+    p_block->free_ranges[0].offset  = 0;
+    p_block->free_ranges[0].size    = size;
+
+    TINY_RENDERER_DECLARE_ZERO(VkMemoryAllocateInfo, alloc_info);
+    alloc_info.sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    alloc_info.pNext           = NULL;
+    alloc_info.allocationSize  = size;
+    alloc_info.memoryTypeIndex = memory_type_index;
+    VkResult vk_res = vkAllocateMemory(p_renderer->vk_device, &alloc_info, NULL, &(p_block->vk_memory));
+    assert(VK_SUCCESS == vk_res);
 
-        p_texture->owns_image = true;
+    // Host visible blocks stay mapped for their entire lifetime
+    VkMemoryPropertyFlags type_flags = p_renderer->vk_memory_properties.memoryTypes[memory_type_index].propertyFlags;
+    if (type_flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        vk_res = vkMapMemory(p_renderer->vk_device, p_block->vk_memory, 0, VK_WHOLE_SIZE, 0, &(p_block->cpu_mapped_address));
+        assert(VK_SUCCESS == vk_res);
     }
 
-    // Create image view
-    {
-        VkImageViewType view_type = VK_IMAGE_VIEW_TYPE_2D;
-        switch (p_texture->type) {
-            case tr_texture_type_1d   : view_type = VK_IMAGE_VIEW_TYPE_1D;   break;
-            case tr_texture_type_2d   : view_type = VK_IMAGE_VIEW_TYPE_2D;   break;
-            case tr_texture_type_3d   : view_type = VK_IMAGE_VIEW_TYPE_3D;   break;
-            case tr_texture_type_cube : view_type = VK_IMAGE_VIEW_TYPE_CUBE; break;
-        }
+    return p_block;
+}
 
-        TINY_RENDERER_DECLARE_ZERO(VkImageViewCreateInfo, create_info);
-        create_info.sType                           = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-        create_info.pNext                           = NULL;
-        create_info.flags                           = 0;
-        create_info.image                           = p_texture->vk_image;
-        create_info.viewType                        = view_type;
-        create_info.format                          = tr_util_to_vk_format(p_texture->format);
-        create_info.components.r                    = VK_COMPONENT_SWIZZLE_R;
-        create_info.components.g                    = VK_COMPONENT_SWIZZLE_G;
-        create_info.components.b                    = VK_COMPONENT_SWIZZLE_B;
-        create_info.components.a                    = VK_COMPONENT_SWIZZLE_A;
-        create_info.subresourceRange.aspectMask     = tr_util_vk_determine_aspect_mask(tr_util_to_vk_format(p_texture->format));
-        create_info.subresourceRange.baseMipLevel   = 0;
-        create_info.subresourceRange.levelCount     = p_texture->mip_levels;
-        create_info.subresourceRange.baseArrayLayer = 0;
-        create_info.subresourceRange.layerCount     = 1;
-        VkResult vk_res = vkCreateImageView(p_renderer->vk_device, &create_info, NULL, &(p_texture->vk_image_view));
-        assert(VK_SUCCESS == vk_res);
+static void tr_internal_vk_destroy_memory_block(tr_renderer* p_renderer, tr_memory_block* p_block)
+{
+    assert(VK_NULL_HANDLE != p_block->vk_memory);
 
-        p_texture->vk_aspect_mask = create_info.subresourceRange.aspectMask;
+    if (NULL != p_block->cpu_mapped_address) {
+        vkUnmapMemory(p_renderer->vk_device, p_block->vk_memory);
     }
+    vkFreeMemory(p_renderer->vk_device, p_block->vk_memory, NULL);
 
-    p_texture->vk_texture_view.imageView = p_texture->vk_image_view;
-    p_texture->vk_texture_view.imageLayout = (p_texture->usage & tr_texture_usage_storage_image) ? VK_IMAGE_LAYOUT_GENERAL
-                                                                                                 : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    TINY_RENDERER_SAFE_FREE(p_block->free_ranges);
+    TINY_RENDERER_SAFE_FREE(p_block);
 }
 
-void tr_internal_vk_destroy_texture(tr_renderer* p_renderer, tr_texture* p_texture)
+static void tr_internal_vk_memory_block_insert_range(tr_memory_block* p_block, uint32_t index, uint64_t offset, uint64_t size)
 {
-    assert(VK_NULL_HANDLE != p_renderer->vk_device);
-    assert(VK_NULL_HANDLE != p_texture->vk_image);
-    assert(VK_NULL_HANDLE != p_texture->vk_image_view);
-    if (p_texture->owns_image) {
-        assert(VK_NULL_HANDLE != p_texture->vk_memory);
+    assert(index <= p_block->free_range_count);
+
+    if (p_block->free_range_count == p_block->free_range_capacity) {
+        uint32_t new_capacity = 2 * p_block->free_range_capacity;
+        tr_memory_range* new_ranges = (tr_memory_range*)calloc(new_capacity, sizeof(*new_ranges));
+        assert(NULL != new_ranges);
+        memcpy(new_ranges, p_block->free_ranges, p_block->free_range_count * sizeof(*new_ranges));
+        TINY_RENDERER_SAFE_FREE(p_block->free_ranges);
+        p_block->free_ranges         = new_ranges;
+        p_block->free_range_capacity = new_capacity;
     }
 
-    if (VK_NULL_HANDLE != p_texture->vk_memory) {
-        vkFreeMemory(p_renderer->vk_device, p_texture->vk_memory, NULL);
+    memmove(&(p_block->free_ranges[index + 1]),
+            &(p_block->free_ranges[index]),
+            (p_block->free_range_count - index) * sizeof(*(p_block->free_ranges)));
+    p_block->free_ranges[index].offset = offset;
+    p_block->free_ranges[index].size   = size;
+    p_block->free_range_count += 1;
+}
+
+static void tr_internal_vk_memory_block_remove_range(tr_memory_block* p_block, uint32_t index)
+{
+    assert(index < p_block->free_range_count);
+
+    memmove(&(p_block->free_ranges[index]),
+            &(p_block->free_ranges[index + 1]),
+            (p_block->free_range_count - index - 1) * sizeof(*(p_block->free_ranges)));
+    p_block->free_range_count -= 1;
+}
+
+// First fit - returns false if the block doesn't have a free range large enough
+static bool tr_internal_vk_memory_block_alloc(tr_memory_block* p_block, uint64_t size, uint64_t alignment, uint64_t* p_offset)
+{
+    for (uint32_t i = 0; i < p_block->free_range_count; ++i) {
+        tr_memory_range* p_range = &(p_block->free_ranges[i]);
+        uint64_t offset  = tr_round_up_64(p_range->offset, alignment);
+        uint64_t padding = offset - p_range->offset;
+        if (p_range->size < (padding + size)) {
+            continue;
+        }
+
+        uint64_t tail_offset = offset + size;
+        uint64_t tail_size   = (p_range->offset + p_range->size) - tail_offset;
+        if (padding > 0) {
+            // Alignment padding stays free, whatever is left over after the allocation follows it
+            p_range->size = padding;
+            if (tail_size > 0) {
+                tr_internal_vk_memory_block_insert_range(p_block, i + 1, tail_offset, tail_size);
+            }
+        }
+        else if (tail_size > 0) {
+            p_range->offset = tail_offset;
+            p_range->size   = tail_size;
+        }
+        else {
+            tr_internal_vk_memory_block_remove_range(p_block, i);
+        }
+
+        *p_offset = offset;
+        return true;
     }
+    return false;
+}
 
-    if ((VK_NULL_HANDLE != p_texture->vk_image) && (p_texture->owns_image)) {
-        vkDestroyImage(p_renderer->vk_device, p_texture->vk_image, NULL);
+// Returns the range to the free list and merges it with its neighbors
+static void tr_internal_vk_memory_block_free(tr_memory_block* p_block, uint64_t offset, uint64_t size)
+{
+    // Find the first free range that comes after the returned one
+    uint32_t lo = 0;
+    uint32_t hi = p_block->free_range_count;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (p_block->free_ranges[mid].offset < offset) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
     }
+    uint32_t index = lo;
 
-    if (VK_NULL_HANDLE != p_texture->vk_image_view) {
-        vkDestroyImageView(p_renderer->vk_device, p_texture->vk_image_view, NULL);
+    tr_memory_range* p_prev = (index > 0) ? &(p_block->free_ranges[index - 1]) : NULL;
+    tr_memory_range* p_next = (index < p_block->free_range_count) ? &(p_block->free_ranges[index]) : NULL;
+    bool merge_prev = (NULL != p_prev) && ((p_prev->offset + p_prev->size) == offset);
+    bool merge_next = (NULL != p_next) && ((offset + size) == p_next->offset);
+
+    if (merge_prev && merge_next) {
+        p_prev->size += size + p_next->size;
+        tr_internal_vk_memory_block_remove_range(p_block, index);
+    }
+    else if (merge_prev) {
+        p_prev->size += size;
+    }
+    else if (merge_next) {
+        p_next->offset  = offset;
+        p_next->size   += size;
+    }
+    else {
+        tr_internal_vk_memory_block_insert_range(p_block, index, offset, size);
     }
 }
 
-void tr_internal_vk_create_sampler(tr_renderer* p_renderer, tr_sampler* p_sampler)
+void tr_internal_vk_create_memory_allocator(tr_renderer* p_renderer)
 {
     assert(VK_NULL_HANDLE != p_renderer->vk_device);
 
-    TINY_RENDERER_DECLARE_ZERO(VkSamplerCreateInfo, create_info);
-    create_info.sType                   = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-    create_info.pNext                   = NULL;
-    create_info.flags                   = 0;
-    create_info.magFilter               = VK_FILTER_LINEAR;
-    create_info.minFilter               = VK_FILTER_LINEAR;
-    create_info.mipmapMode              = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-    create_info.addressModeU            = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-    create_info.addressModeV            = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-    create_info.addressModeW            = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-    create_info.mipLodBias              = 0.0f;
-    create_info.anisotropyEnable        = VK_FALSE;
-    create_info.maxAnisotropy           = 1.0f;
-    create_info.compareEnable           = VK_FALSE;
-    create_info.compareOp               = VK_COMPARE_OP_NEVER;
-    create_info.minLod                  = 0.0f;
-    create_info.maxLod                  = 0.0f;
-    create_info.borderColor             = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
-    create_info.unnormalizedCoordinates = VK_FALSE;
-    VkResult vk_res = vkCreateSampler(p_renderer->vk_device, &create_info, NULL, &(p_sampler->vk_sampler));
-    assert(VK_SUCCESS == vk_res);
+    p_renderer->memory_allocator = (tr_memory_allocator*)calloc(1, sizeof(*(p_renderer->memory_allocator)));
+    assert(NULL != p_renderer->memory_allocator);
 
-    p_sampler->vk_sampler_view.sampler = p_sampler->vk_sampler;
+    p_renderer->memory_allocator->block_size = TINY_RENDERER_MEMORY_BLOCK_SIZE;
 }
 
-void tr_internal_vk_destroy_sampler(tr_renderer* p_renderer, tr_sampler* p_sampler)
+void tr_internal_vk_destroy_memory_allocator(tr_renderer* p_renderer)
 {
     assert(VK_NULL_HANDLE != p_renderer->vk_device);
-    assert(VK_NULL_HANDLE != p_sampler->vk_sampler);
+    assert(NULL != p_renderer->memory_allocator);
+
+    tr_memory_allocator* p_allocator = p_renderer->memory_allocator;
+    for (uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; ++i) {
+        for (uint32_t j = 0; j < 2; ++j) {
+            tr_memory_block* p_block = p_allocator->blocks[i][j];
+            while (NULL != p_block) {
+                tr_memory_block* p_next = p_block->next;
+                tr_internal_vk_destroy_memory_block(p_renderer, p_block);
+                p_block = p_next;
+            }
+            p_allocator->blocks[i][j] = NULL;
+        }
+    }
 
-    vkDestroySampler(p_renderer->vk_device, p_sampler->vk_sampler, NULL);
+    TINY_RENDERER_SAFE_FREE(p_renderer->memory_allocator);
 }
 
-void tr_internal_vk_create_shader_program(tr_renderer* p_renderer, uint32_t vert_size, const void* vert_code, const char* vert_enpt, uint32_t tesc_size, const void* tesc_code, const char* tesc_enpt, uint32_t tese_size, const void* tese_code, const char* tese_enpt, uint32_t geom_size, const void* geom_code, const char* geom_enpt, uint32_t frag_size, const void* frag_code, const char* frag_enpt, uint32_t comp_size, const void* comp_code, const char* comp_enpt, tr_shader_program* p_shader_program)
+void tr_internal_vk_allocate_memory(tr_renderer* p_renderer, const VkMemoryRequirements* p_mem_reqs, VkMemoryPropertyFlags mem_flags, bool linear, tr_memory_allocation* p_allocation)
 {
     assert(VK_NULL_HANDLE != p_renderer->vk_device);
+    assert(NULL != p_renderer->memory_allocator);
+    assert(p_mem_reqs->size > 0);
 
-    for (uint32_t i = 0; i < tr_shader_stage_count; ++i) {
-        tr_shader_stage stage_mask = (tr_shader_stage)(1 << i);
-        if (stage_mask == (p_shader_program->shader_stages & stage_mask)) {
-            TINY_RENDERER_DECLARE_ZERO(VkShaderModuleCreateInfo, create_info);
-            create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-            create_info.pNext = NULL;
-            create_info.flags = 0;  
-            switch(stage_mask) {
-                case tr_shader_stage_vert: {
-                    create_info.codeSize = vert_size;
-                    create_info.pCode = (const uint32_t*)vert_code;                 
-                    VkResult vk_res = vkCreateShaderModule(p_renderer->vk_device, &create_info, NULL, &(p_shader_program->vk_vert));
-                    assert(VK_SUCCESS == vk_res);
-                } break;
-                case tr_shader_stage_tesc: {
-                    create_info.codeSize = tesc_size;
-                    create_info.pCode = (const uint32_t*)tesc_code;
-                    VkResult vk_res = vkCreateShaderModule(p_renderer->vk_device, &create_info, NULL, &(p_shader_program->vk_tesc));
-                    assert(VK_SUCCESS == vk_res);
-                } break;
-                case tr_shader_stage_tese: {
-                    create_info.codeSize = tese_size;
-                    create_info.pCode = (const uint32_t*)tese_code;
-                    VkResult vk_res = vkCreateShaderModule(p_renderer->vk_device, &create_info, NULL, &(p_shader_program->vk_tese));
-                    assert(VK_SUCCESS == vk_res);
-                } break;
-                case tr_shader_stage_geom: {
-                    create_info.codeSize = geom_size;
-                    create_info.pCode = (const uint32_t*)geom_code;
-                    VkResult vk_res = vkCreateShaderModule(p_renderer->vk_device, &create_info, NULL, &(p_shader_program->vk_geom));
-                    assert(VK_SUCCESS == vk_res);
-                } break;
-                case tr_shader_stage_frag: {
-                    create_info.codeSize = frag_size;
-                    create_info.pCode = (const uint32_t*)frag_code;
-                    VkResult vk_res = vkCreateShaderModule(p_renderer->vk_device, &create_info, NULL, &(p_shader_program->vk_frag));
-                    assert(VK_SUCCESS == vk_res);
-                } break;
-                case tr_shader_stage_comp: {
-                    create_info.codeSize = comp_size;
-                    create_info.pCode = (const uint32_t*)comp_code;
-                    VkResult vk_res = vkCreateShaderModule(p_renderer->vk_device, &create_info, NULL, &(p_shader_program->vk_comp));
-                    assert(VK_SUCCESS == vk_res);
-                } break;
-            }
+    tr_memory_allocator* p_allocator = p_renderer->memory_allocator;
+
+    uint32_t memory_type_index = UINT32_MAX;
+    bool found_memory = tr_util_vk_get_memory_type(&p_renderer->vk_memory_properties, p_mem_reqs->memoryTypeBits, mem_flags, &memory_type_index);
+    assert(found_memory);
+
+    uint64_t alignment = tr_max_64(p_mem_reqs->alignment, 1);
+    uint64_t offset = 0;
+    tr_memory_block** pp_head = &(p_allocator->blocks[memory_type_index][linear ? 1 : 0]);
+    tr_memory_block* p_block = *pp_head;
+    for (; NULL != p_block; p_block = p_block->next) {
+        if (tr_internal_vk_memory_block_alloc(p_block, p_mem_reqs->size, alignment, &offset)) {
+            break;
         }
-    }   
+    }
+
+    // No room in any of the existing blocks, requests larger than the block size get a block of their own size
+    if (NULL == p_block) {
+        uint32_t heap_index = p_renderer->vk_memory_properties.memoryTypes[memory_type_index].heapIndex;
+        uint64_t heap_size = p_renderer->vk_memory_properties.memoryHeaps[heap_index].size;
+        uint64_t standard_size = tr_min_64(p_allocator->block_size, heap_size);
+        uint64_t block_size = tr_max_64(standard_size, p_mem_reqs->size);
+
+        p_block = tr_internal_vk_create_memory_block(p_renderer, memory_type_index, linear, block_size);
+        p_block->dedicated = (block_size > standard_size);
+        p_block->next = *pp_head;
+        *pp_head = p_block;
+        p_allocator->block_count += 1;
+
+        bool allocated = tr_internal_vk_memory_block_alloc(p_block, p_mem_reqs->size, alignment, &offset);
+        assert(allocated);
+    }
+
+    p_block->allocation_count += 1;
+    p_allocator->allocation_count += 1;
+
+    p_allocation->block  = p_block;
+    p_allocation->offset = offset;
+    p_allocation->size   = p_mem_reqs->size;
 }
 
-void tr_internal_vk_destroy_shader_program(tr_renderer* p_renderer, tr_shader_program* p_shader_program)
+void tr_internal_vk_free_memory(tr_renderer* p_renderer, tr_memory_allocation* p_allocation)
 {
     assert(VK_NULL_HANDLE != p_renderer->vk_device);
+    assert(NULL != p_renderer->memory_allocator);
 
-    if (VK_NULL_HANDLE != p_shader_program->vk_vert) {
-        vkDestroyShaderModule(p_renderer->vk_device, p_shader_program->vk_vert, NULL);
+    tr_memory_block* p_block = p_allocation->block;
+    if (NULL == p_block) {
+        return;
     }
 
-    if (VK_NULL_HANDLE != p_shader_program->vk_tesc) {
-        vkDestroyShaderModule(p_renderer->vk_device, p_shader_program->vk_tesc, NULL);
+    tr_memory_allocator* p_allocator = p_renderer->memory_allocator;
+
+    assert(p_block->allocation_count > 0);
+    tr_internal_vk_memory_block_free(p_block, p_allocation->offset, p_allocation->size);
+    p_block->allocation_count -= 1;
+    p_allocator->allocation_count -= 1;
+
+    // Release empty blocks - except for one standard sized block per list, so
+    // create/destroy cycles don't end up calling vkAllocateMemory every time.
+    // Dedicated blocks are always released, they'd pin large textures' memory.
+    tr_memory_block** pp_link = &(p_allocator->blocks[p_block->memory_type_index][p_block->linear ? 1 : 0]);
+    bool release = false;
+    if (0 == p_block->allocation_count) {
+        release = p_block->dedicated;
+        for (tr_memory_block* p_other = *pp_link; (NULL != p_other) && (! release); p_other = p_other->next) {
+            release = (p_other != p_block) && (0 == p_other->allocation_count) && (! p_other->dedicated);
+        }
+    }
+    if (release) {
+        while (*pp_link != p_block) {
+            pp_link = &((*pp_link)->next);
+        }
+        *pp_link = p_block->next;
+        tr_internal_vk_destroy_memory_block(p_renderer, p_block);
+        p_allocator->block_count -= 1;
     }
 
-    if (VK_NULL_HANDLE != p_shader_program->vk_tese) {
-        vkDestroyShaderModule(p_renderer->vk_device, p_shader_program->vk_tese, NULL);
+    memset(p_allocation, 0, sizeof(*p_allocation));
+}
+
+// -------------------------------------------------------------------------------------------------
+// Internal descriptor allocator functions
+// -------------------------------------------------------------------------------------------------
+static uint32_t tr_internal_vk_descriptor_info_size(VkDescriptorType type)
+{
+    switch (type) {
+        case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER   :
+        case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER   : return sizeof(VkBufferView);
+        case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER         :
+        case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER         :
+        case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC :
+        case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC : return sizeof(VkDescriptorBufferInfo);
+        default: break;
     }
+    return sizeof(VkDescriptorImageInfo);
+}
 
-    if (VK_NULL_HANDLE != p_shader_program->vk_geom) {
-        vkDestroyShaderModule(p_renderer->vk_device, p_shader_program->vk_geom, NULL);
+static tr_descriptor_pool* tr_internal_vk_create_descriptor_pool(tr_renderer* p_renderer, uint32_t set_count, const uint32_t* p_min_descriptor_counts)
+{
+    tr_descriptor_pool* p_pool = (tr_descriptor_pool*)calloc(1, sizeof(*p_pool));
+    assert(NULL != p_pool);
+
+    enum {max_types = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT + 1};
+
+    TINY_RENDERER_DECLARE_ZERO(VkDescriptorPoolSize, pool_sizes[max_types]);
+    for (uint32_t i = 0; i < max_types; ++i) {
+        pool_sizes[i].type            = (VkDescriptorType)i;
+        pool_sizes[i].descriptorCount = tr_max(4 * set_count, p_min_descriptor_counts[i]);
+
+        p_pool->free_descriptor_counts[i] = pool_sizes[i].descriptorCount;
     }
+    p_pool->free_set_count = set_count;
 
-    if (VK_NULL_HANDLE != p_shader_program->vk_frag) {
-        vkDestroyShaderModule(p_renderer->vk_device, p_shader_program->vk_frag, NULL);
+    TINY_RENDERER_DECLARE_ZERO(VkDescriptorPoolCreateInfo, create_info);
+    create_info.sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    create_info.pNext         = NULL;
+    create_info.flags         = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+    create_info.maxSets       = set_count;
+    create_info.poolSizeCount = max_types;
+    create_info.pPoolSizes    = pool_sizes;
+    VkResult vk_res = vkCreateDescriptorPool(p_renderer->vk_device, &create_info, NULL, &(p_pool->vk_descriptor_pool));
+    assert(VK_SUCCESS == vk_res);
+
+    return p_pool;
+}
+
+static void tr_internal_vk_destroy_descriptor_pool(tr_renderer* p_renderer, tr_descriptor_pool* p_pool)
+{
+    if (VK_NULL_HANDLE != p_pool->vk_descriptor_pool) {
+        vkDestroyDescriptorPool(p_renderer->vk_device, p_pool->vk_descriptor_pool, NULL);
     }
+    TINY_RENDERER_SAFE_FREE(p_pool);
 }
 
-void tr_internal_vk_create_pipeline(tr_renderer* p_renderer, tr_shader_program* p_shader_program, const tr_vertex_layout* p_vertex_layout, tr_descriptor_set* p_descriptor_set, tr_render_target* p_render_target, const tr_pipeline_settings* p_pipeline_settings, tr_pipeline* p_pipeline)
+static bool tr_internal_vk_descriptor_pool_fits(const tr_descriptor_pool* p_pool, const tr_descriptor_layout* p_layout)
+{
+    if (0 == p_pool->free_set_count) {
+        return false;
+    }
+    for (uint32_t i = 0; i <= VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT; ++i) {
+        if (p_pool->free_descriptor_counts[i] < p_layout->descriptor_counts[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void tr_internal_vk_create_descriptor_allocator(tr_renderer* p_renderer)
 {
     assert(VK_NULL_HANDLE != p_renderer->vk_device);
-    assert((VK_NULL_HANDLE != p_shader_program->vk_vert) || (VK_NULL_HANDLE != p_shader_program->vk_tesc) || (VK_NULL_HANDLE != p_shader_program->vk_tese) || (VK_NULL_HANDLE != p_shader_program->vk_geom) || (VK_NULL_HANDLE != p_shader_program->vk_frag));
-    assert(VK_NULL_HANDLE != p_render_target->vk_render_pass);
 
-    // Pipeline layout
-    {
-        TINY_RENDERER_DECLARE_ZERO(VkPipelineLayoutCreateInfo, create_info);
-        create_info.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        create_info.pNext                  = NULL;
-        create_info.flags                  = 0;
-        create_info.setLayoutCount         = (NULL != p_descriptor_set) ? 1 : 0;
-        create_info.pSetLayouts            = (NULL != p_descriptor_set) ? &(p_descriptor_set->vk_descriptor_set_layout) : NULL;
-        create_info.pushConstantRangeCount = 0;
-        create_info.pPushConstantRanges    = NULL;
-        VkResult vk_res = vkCreatePipelineLayout(p_renderer->vk_device, &create_info, NULL, &(p_pipeline->vk_pipeline_layout));
-        assert(VK_SUCCESS == vk_res);
+    p_renderer->descriptor_allocator = (tr_descriptor_allocator*)calloc(1, sizeof(*(p_renderer->descriptor_allocator)));
+    assert(NULL != p_renderer->descriptor_allocator);
+
+    p_renderer->descriptor_allocator->pool_set_count = tr_max(TINY_RENDERER_DESCRIPTOR_POOL_SET_COUNT, 1);
+}
+
+void tr_internal_vk_destroy_descriptor_allocator(tr_renderer* p_renderer)
+{
+    assert(VK_NULL_HANDLE != p_renderer->vk_device);
+    assert(NULL != p_renderer->descriptor_allocator);
+
+    tr_descriptor_allocator* p_allocator = p_renderer->descriptor_allocator;
+
+    // Destroying the pools also frees any sets that are still around
+    tr_descriptor_pool* p_pool = p_allocator->pools;
+    while (NULL != p_pool) {
+        tr_descriptor_pool* p_next = p_pool->next;
+        tr_internal_vk_destroy_descriptor_pool(p_renderer, p_pool);
+        p_pool = p_next;
     }
 
-    // Pipeline
-    {
-        uint32_t stage_count = 0;
-        TINY_RENDERER_DECLARE_ZERO(VkPipelineShaderStageCreateInfo, stages[5]);
-        for (uint32_t i = 0; i < 5; ++i) {
-            tr_shader_stage stage_mask = (tr_shader_stage)(1 << i);
-            if (stage_mask == (p_shader_program->shader_stages & stage_mask)) {
-                stages[stage_count].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-                stages[stage_count].pNext = NULL;
-                stages[stage_count].flags = 0;
-                stages[stage_count].pSpecializationInfo = NULL;         
-                switch(stage_mask) {
-                    case tr_shader_stage_vert: {
-                        stages[stage_count].pName  = p_shader_program->vert_entry_point;
-                        stages[stage_count].stage  = VK_SHADER_STAGE_VERTEX_BIT; 
-                        stages[stage_count].module = p_shader_program->vk_vert;
-                    } break;
-                    case tr_shader_stage_tesc: {
-                        stages[stage_count].pName  = p_shader_program->tesc_entry_point;
-                        stages[stage_count].stage = VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT; 
-                        stages[stage_count].module = p_shader_program->vk_tesc;
-                    } break;
-                    case tr_shader_stage_tese: {
-                        stages[stage_count].pName  = p_shader_program->tese_entry_point;
-                        stages[stage_count].stage = VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
-                        stages[stage_count].module = p_shader_program->vk_tese;
-                    } break;
-                    case tr_shader_stage_geom: {
-                        stages[stage_count].pName  = p_shader_program->geom_entry_point;
-                        stages[stage_count].stage = VK_SHADER_STAGE_GEOMETRY_BIT; 
-                        stages[stage_count].module = p_shader_program->vk_geom;
-                    } break;
-                    case tr_shader_stage_frag: {
-                        stages[stage_count].pName  = p_shader_program->frag_entry_point;
-                        stages[stage_count].stage = VK_SHADER_STAGE_FRAGMENT_BIT; 
-                        stages[stage_count].module = p_shader_program->vk_frag;
-                    } break;
-                }
-                ++stage_count;
-            }
+    tr_descriptor_layout* p_layout = p_allocator->layouts;
+    while (NULL != p_layout) {
+        tr_descriptor_layout* p_next = p_layout->next;
+        if (VK_NULL_HANDLE != p_layout->vk_descriptor_update_template) {
+            p_renderer->vk_destroy_descriptor_update_template(p_renderer->vk_device, p_layout->vk_descriptor_update_template, NULL);
         }
+        vkDestroyDescriptorSetLayout(p_renderer->vk_device, p_layout->vk_descriptor_set_layout, NULL);
+        TINY_RENDERER_SAFE_FREE(p_layout->binding_data_offsets);
+        TINY_RENDERER_SAFE_FREE(p_layout->bindings);
+        TINY_RENDERER_SAFE_FREE(p_layout);
+        p_layout = p_next;
+    }
 
-        // Make sure there's a shader
-        assert(0 != stage_count);
-        
-        // Make sure there's attributes
-        assert(0 != p_vertex_layout->attrib_count);
+    TINY_RENDERER_SAFE_FREE(p_renderer->descriptor_allocator);
+}
 
-        uint32_t input_binding_count = 0;
-        VkVertexInputBindingDescription input_bindings[tr_max_vertex_bindings] = {0};
-        uint32_t input_attribute_count = 0;
-        VkVertexInputAttributeDescription input_attributes[tr_max_vertex_attribs] = {0};
-        // Ignore everything that's beyond tr_max_vertex_attribs
-        uint32_t attrib_count = p_vertex_layout->attrib_count > tr_max_vertex_attribs ? tr_max_vertex_attribs : p_vertex_layout->attrib_count;
-        // Initial values
-        uint32_t binding_value = UINT32_MAX;
-        for (uint32_t i = 0; i < attrib_count; ++i) {
-            const tr_vertex_attrib* attrib = &(p_vertex_layout->attribs[i]);
-            if (binding_value != attrib->binding) {
-                binding_value = attrib->binding;
-                ++input_binding_count;
-            }
-
-            input_bindings[input_binding_count - 1].binding = binding_value;
-            input_bindings[input_binding_count - 1].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-            input_bindings[input_binding_count - 1].stride += tr_util_format_stride(attrib->format);
-            
-            input_attributes[input_attribute_count].location = attrib->location;
-            input_attributes[input_attribute_count].binding  = attrib->binding;
-            input_attributes[input_attribute_count].format   = tr_util_to_vk_format(attrib->format);
-            input_attributes[input_attribute_count].offset   = attrib->offset;
-            ++input_attribute_count;
-        }
-        
-        TINY_RENDERER_DECLARE_ZERO(VkPipelineVertexInputStateCreateInfo, vi);
-        vi.sType                                    = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-        vi.pNext                                    = NULL;
-        vi.flags                                    = 0;
-        vi.vertexBindingDescriptionCount            = input_binding_count;
-        vi.pVertexBindingDescriptions               = input_bindings;
-        vi.vertexAttributeDescriptionCount          = input_attribute_count;
-        vi.pVertexAttributeDescriptions             = input_attributes;
-                                                
-        VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-        switch(p_pipeline_settings->primitive_topo) {
-            case tr_primitive_topo_point_list : topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST; break;
-            case tr_primitive_topo_line_list  : topology = VK_PRIMITIVE_TOPOLOGY_LINE_LIST; break;
-            case tr_primitive_topo_line_strip : topology = VK_PRIMITIVE_TOPOLOGY_LINE_STRIP; break;
-            case tr_primitive_topo_tri_strip  : topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP; break;
-            case tr_primitive_topo_tri_fan    : topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_FAN; break;
-        }
-        TINY_RENDERER_DECLARE_ZERO(VkPipelineInputAssemblyStateCreateInfo, ia);
-        ia.sType                                    = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-        ia.pNext                                    = NULL;
-        ia.flags                                    = 0;
-        ia.topology                                 = topology;
-        ia.primitiveRestartEnable                   = VK_FALSE;
-
-        TINY_RENDERER_DECLARE_ZERO(VkPipelineTessellationStateCreateInfo, ts);
-        ts.sType                                    = VK_STRUCTURE_TYPE_PIPELINE_TESSELLATION_STATE_CREATE_INFO;
-        ts.pNext                                    = NULL;
-        ts.flags                                    = 0;
-        ts.patchControlPoints                       = 1;
+tr_descriptor_layout* tr_internal_vk_acquire_descriptor_layout(tr_renderer* p_renderer, uint32_t binding_count, const VkDescriptorSetLayoutBinding* p_bindings)
+{
+    assert(VK_NULL_HANDLE != p_renderer->vk_device);
+    assert(NULL != p_renderer->descriptor_allocator);
 
-        TINY_RENDERER_DECLARE_ZERO(VkPipelineViewportStateCreateInfo, vs);
-        vs.sType                                    = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-        vs.pNext                                    = NULL;
-        vs.flags                                    = 0;
-        vs.viewportCount                            = 0;
-        vs.pViewports                               = NULL;
-        vs.scissorCount                             = 0;
-        vs.pScissors                                = NULL;
+    tr_descriptor_allocator* p_allocator = p_renderer->descriptor_allocator;
 
-        VkCullModeFlags cull_mode = VK_CULL_MODE_NONE;
-        switch(p_pipeline_settings->cull_mode) {
-            case tr_cull_mode_back  : cull_mode = VK_CULL_MODE_BACK_BIT; break;
-            case tr_cull_mode_front : cull_mode = VK_CULL_MODE_FRONT_BIT; break;
-            case tr_cull_mode_both  : cull_mode = VK_CULL_MODE_FRONT_AND_BACK; break;
+    // Bindings are zero initialized by the caller, so they can be hashed and compared as bytes
+    size_t bindings_size = binding_count * sizeof(*p_bindings);
+    uint64_t hash = tr_hash_64(0, bindings_size, p_bindings);
+    for (tr_descriptor_layout* p_layout = p_allocator->layouts; NULL != p_layout; p_layout = p_layout->next) {
+        if ((p_layout->hash == hash) && (p_layout->binding_count == binding_count) && (0 == memcmp(p_layout->bindings, p_bindings, bindings_size))) {
+            return p_layout;
         }
-        VkFrontFace front_face = (tr_fornt_face_cw == p_pipeline_settings->front_face) ? VK_FRONT_FACE_CLOCKWISE : VK_FRONT_FACE_COUNTER_CLOCKWISE;
-        TINY_RENDERER_DECLARE_ZERO(VkPipelineRasterizationStateCreateInfo, rs);
-        rs.sType                                    = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-        rs.pNext                                    = NULL;
-        rs.flags                                    = 0;
-        rs.depthClampEnable                         = VK_FALSE;
-        rs.rasterizerDiscardEnable                  = VK_FALSE;
-        rs.polygonMode                              = VK_POLYGON_MODE_FILL;
-        rs.cullMode                                 = cull_mode;
-        rs.frontFace                                = front_face;
-        rs.depthBiasEnable                          = VK_FALSE;
-        rs.depthBiasConstantFactor                  = 0.0f;
-        rs.depthBiasClamp                           = 0.0f;
-        rs.depthBiasSlopeFactor                     = 0.0f;
-        rs.lineWidth                                = 1.0f;
+    }
 
-        TINY_RENDERER_DECLARE_ZERO(VkPipelineMultisampleStateCreateInfo, ms);
-        ms.sType                                    = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-        ms.pNext                                    = NULL;
-        ms.flags                                    = 0;
-        ms.rasterizationSamples                     = tr_util_to_vk_sample_count(p_render_target->sample_count);
-        ms.sampleShadingEnable                      = VK_FALSE;
-        ms.minSampleShading                         = 0.0f;
-        ms.pSampleMask                              = 0;
-        ms.alphaToCoverageEnable                    = VK_FALSE;
-        ms.alphaToOneEnable                         = VK_FALSE;
+    tr_descriptor_layout* p_layout = (tr_descriptor_layout*)calloc(1, sizeof(*p_layout));
+    assert(NULL != p_layout);
 
-        TINY_RENDERER_DECLARE_ZERO(VkPipelineDepthStencilStateCreateInfo, ds);
-        ds.sType                                    = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-        ds.pNext                                    = NULL;
-        ds.flags                                    = 0;
-        ds.depthTestEnable                          = p_pipeline_settings->depth_test ? VK_TRUE : VK_FALSE;
-        ds.depthWriteEnable                         = p_pipeline_settings->depth_write ? VK_TRUE : VK_FALSE;
-        ds.depthCompareOp                           = VK_COMPARE_OP_LESS_OR_EQUAL; // @TODO: Add more depth funcs
-        ds.depthBoundsTestEnable                    = VK_FALSE;
-        ds.stencilTestEnable                        = VK_FALSE;
-        ds.front.failOp                             = VK_STENCIL_OP_KEEP;
-        ds.front.passOp                             = VK_STENCIL_OP_KEEP;
-        ds.front.depthFailOp                        = VK_STENCIL_OP_KEEP;
-        ds.front.compareOp                          = VK_COMPARE_OP_NEVER; 
-        ds.front.compareMask                        = 0;
-        ds.front.writeMask                          = 0;
-        ds.front.reference                          = 0;
-        ds.back.failOp                              = VK_STENCIL_OP_KEEP;
-        ds.back.passOp                              = VK_STENCIL_OP_KEEP;
-        ds.back.depthFailOp                         = VK_STENCIL_OP_KEEP;
-        ds.back.compareOp                           = VK_COMPARE_OP_NEVER; 
-        ds.back.compareMask                         = 0;
-        ds.back.writeMask                           = 0;
-        ds.back.reference                           = 0;
-        ds.minDepthBounds                           = 0.0f;
-        ds.maxDepthBounds                           = 0.0;
+    p_layout->hash          = hash;
+    p_layout->binding_count = binding_count;
+    p_layout->bindings      = (VkDescriptorSetLayoutBinding*)calloc(tr_max(binding_count, 1), sizeof(*(p_layout->bindings)));
+    assert(NULL != p_layout->bindings);
+    memcpy(p_layout->bindings, p_bindings, bindings_size);
 
-        TINY_RENDERER_DECLARE_ZERO(VkPipelineColorBlendAttachmentState, cbas);
-        cbas.colorWriteMask                         = 0xf;
-        cbas.blendEnable                            = VK_FALSE;
-        cbas.alphaBlendOp                           = VK_BLEND_OP_ADD;
-        cbas.colorBlendOp                           = VK_BLEND_OP_ADD;
-        cbas.srcColorBlendFactor                    = VK_BLEND_FACTOR_ZERO;
-        cbas.dstColorBlendFactor                    = VK_BLEND_FACTOR_ZERO;
-        cbas.srcAlphaBlendFactor                    = VK_BLEND_FACTOR_ZERO;
-        cbas.dstAlphaBlendFactor                    = VK_BLEND_FACTOR_ZERO;
-        TINY_RENDERER_DECLARE_ZERO(VkPipelineColorBlendStateCreateInfo, cb);
-        cb.sType                                    = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-        cb.pNext                                    = NULL;
-        cb.flags                                    = 0;
-        cb.logicOpEnable                            = VK_FALSE;
-        cb.logicOp                                  = VK_LOGIC_OP_NO_OP;
-        cb.attachmentCount                          = 1;
-        cb.pAttachments                             = &cbas;
-        cb.blendConstants[0]                        = 0.0f;
-        cb.blendConstants[1]                        = 0.0f;
-        cb.blendConstants[2]                        = 0.0f;
-        cb.blendConstants[3]                        = 0.0f;
+    for (uint32_t i = 0; i < binding_count; ++i) {
+        assert(p_bindings[i].descriptorType <= VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT);
+        p_layout->descriptor_counts[p_bindings[i].descriptorType] += p_bindings[i].descriptorCount;
+    }
 
-        TINY_RENDERER_DECLARE_ZERO(VkDynamicState, dyn_states[9]);
-        dyn_states[0]                               = VK_DYNAMIC_STATE_VIEWPORT;
-        dyn_states[1]                               = VK_DYNAMIC_STATE_SCISSOR;
-        dyn_states[2]                               = VK_DYNAMIC_STATE_LINE_WIDTH;
-        dyn_states[3]                               = VK_DYNAMIC_STATE_DEPTH_BIAS;
-        dyn_states[4]                               = VK_DYNAMIC_STATE_BLEND_CONSTANTS;
-        dyn_states[5]                               = VK_DYNAMIC_STATE_DEPTH_BOUNDS;
-        dyn_states[6]                               = VK_DYNAMIC_STATE_STENCIL_COMPARE_MASK;
-        dyn_states[7]                               = VK_DYNAMIC_STATE_STENCIL_WRITE_MASK;
-        dyn_states[8]                               = VK_DYNAMIC_STATE_STENCIL_REFERENCE;
-        TINY_RENDERER_DECLARE_ZERO(VkPipelineDynamicStateCreateInfo, dy);
-        dy.sType                                    = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
-        dy.pNext                                    = NULL;
-        dy.flags                                    = 0;
-        dy.dynamicStateCount                        = 9;
-        dy.pDynamicStates                           = dyn_states;
+    TINY_RENDERER_DECLARE_ZERO(VkDescriptorSetLayoutCreateInfo, create_info);
+    create_info.sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    create_info.pNext        = NULL;
+    create_info.flags        = 0;
+    create_info.bindingCount = binding_count;
+    create_info.pBindings    = p_layout->bindings;
+    VkResult vk_res = vkCreateDescriptorSetLayout(p_renderer->vk_device, &create_info, NULL, &(p_layout->vk_descriptor_set_layout));
+    assert(VK_SUCCESS == vk_res);
 
-        TINY_RENDERER_DECLARE_ZERO(VkGraphicsPipelineCreateInfo, create_info);
-        create_info.sType                           = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-        create_info.pNext                           = NULL;
-        create_info.flags                           = 0;
-        create_info.stageCount                      = stage_count;
-        create_info.pStages                         = stages;
-        create_info.pVertexInputState               = &vi;
-        create_info.pInputAssemblyState             = &ia;
-        create_info.pTessellationState              = &ts;
-        create_info.pViewportState                  = &vs;
-        create_info.pRasterizationState             = &rs;
-        create_info.pMultisampleState               = &ms;
-        create_info.pDepthStencilState              = &ds;
-        create_info.pColorBlendState                = &cb;
-        create_info.pDynamicState                   = &dy;
-        create_info.layout                          = p_pipeline->vk_pipeline_layout;
-        create_info.renderPass                      = p_render_target->vk_render_pass;
-        create_info.subpass                         = 0;
-        create_info.basePipelineHandle              = VK_NULL_HANDLE;
-        create_info.basePipelineIndex               = -1;
-        VkResult vk_res = vkCreateGraphicsPipelines(p_renderer->vk_device, VK_NULL_HANDLE, 1, &create_info, NULL, &(p_pipeline->vk_pipeline));
+    // Where each binding's infos go in a set's descriptor data
+    p_layout->binding_data_offsets = (uint32_t*)calloc(tr_max(binding_count, 1), sizeof(*(p_layout->binding_data_offsets)));
+    assert(NULL != p_layout->binding_data_offsets);
+    for (uint32_t i = 0; i < binding_count; ++i) {
+        p_layout->binding_data_offsets[i] = p_layout->data_size;
+        p_layout->data_size += p_bindings[i].descriptorCount * tr_internal_vk_descriptor_info_size(p_bindings[i].descriptorType);
+        p_layout->element_count += p_bindings[i].descriptorCount;
+    }
+
+    if (p_renderer->vk_device_ext_VK_KHR_descriptor_update_template) {
+        assert(binding_count <= tr_max_descriptors);
+
+        TINY_RENDERER_DECLARE_ZERO(VkDescriptorUpdateTemplateEntryKHR, entries[tr_max_descriptors]);
+        for (uint32_t i = 0; i < binding_count; ++i) {
+            entries[i].dstBinding      = p_bindings[i].binding;
+            entries[i].dstArrayElement = 0;
+            entries[i].descriptorCount = p_bindings[i].descriptorCount;
+            entries[i].descriptorType  = p_bindings[i].descriptorType;
+            entries[i].offset          = p_layout->binding_data_offsets[i];
+            entries[i].stride          = tr_internal_vk_descriptor_info_size(p_bindings[i].descriptorType);
+        }
+
+        TINY_RENDERER_DECLARE_ZERO(VkDescriptorUpdateTemplateCreateInfoKHR, template_create_info);
+        template_create_info.sType                      = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO_KHR;
+        template_create_info.pNext                      = NULL;
+        template_create_info.flags                      = 0;
+        template_create_info.descriptorUpdateEntryCount = binding_count;
+        template_create_info.pDescriptorUpdateEntries   = entries;
+        template_create_info.templateType               = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET_KHR;
+        template_create_info.descriptorSetLayout        = p_layout->vk_descriptor_set_layout;
+        vk_res = p_renderer->vk_create_descriptor_update_template(p_renderer->vk_device, &template_create_info, NULL, &(p_layout->vk_descriptor_update_template));
         assert(VK_SUCCESS == vk_res);
     }
+
+    p_layout->next = p_allocator->layouts;
+    p_allocator->layouts = p_layout;
+    p_allocator->layout_count += 1;
+
+    return p_layout;
 }
 
-void tr_internal_vk_create_compute_pipeline(tr_renderer* p_renderer, tr_shader_program* p_shader_program, tr_descriptor_set* p_descriptor_set, const tr_pipeline_settings* p_pipeline_settings, tr_pipeline* p_pipeline)
+void tr_internal_vk_allocate_descriptor_set(tr_renderer* p_renderer, tr_descriptor_layout* p_layout, tr_descriptor_set* p_descriptor_set)
 {
-    assert(p_renderer->vk_device != VK_NULL_HANDLE);
-    assert(p_shader_program->vk_comp != VK_NULL_HANDLE);
+    assert(VK_NULL_HANDLE != p_renderer->vk_device);
+    assert(NULL != p_renderer->descriptor_allocator);
 
-    // Pipeline layout
-    {
-        TINY_RENDERER_DECLARE_ZERO(VkPipelineLayoutCreateInfo, create_info);
-        create_info.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        create_info.pNext                  = NULL;
-        create_info.flags                  = 0;
-        create_info.setLayoutCount         = (NULL != p_descriptor_set) ? 1 : 0;
-        create_info.pSetLayouts            = (NULL != p_descriptor_set) ? &(p_descriptor_set->vk_descriptor_set_layout) : NULL;
-        create_info.pushConstantRangeCount = 0;
-        create_info.pPushConstantRanges    = NULL;
-        VkResult vk_res = vkCreatePipelineLayout(p_renderer->vk_device, &create_info, NULL, &(p_pipeline->vk_pipeline_layout));
-        assert(VK_SUCCESS == vk_res);
+    tr_descriptor_allocator* p_allocator = p_renderer->descriptor_allocator;
+
+    TINY_RENDERER_DECLARE_ZERO(VkDescriptorSetAllocateInfo, alloc_info);
+    alloc_info.sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    alloc_info.pNext              = NULL;
+    alloc_info.descriptorSetCount = 1;
+    alloc_info.pSetLayouts        = &(p_layout->vk_descriptor_set_layout);
+
+    // Counts can fit while the pool is too fragmented, in that case move on to the next pool
+    VkDescriptorSet vk_descriptor_set = VK_NULL_HANDLE;
+    tr_descriptor_pool* p_pool = p_allocator->pools;
+    for (; NULL != p_pool; p_pool = p_pool->next) {
+        if (! tr_internal_vk_descriptor_pool_fits(p_pool, p_layout)) {
+            continue;
+        }
+        alloc_info.descriptorPool = p_pool->vk_descriptor_pool;
+        if (VK_SUCCESS == vkAllocateDescriptorSets(p_renderer->vk_device, &alloc_info, &vk_descriptor_set)) {
+            break;
+        }
     }
 
-    // Pipeline
-    {
-      TINY_RENDERER_DECLARE_ZERO(VkPipelineShaderStageCreateInfo , stage);
-      stage.sType               = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-      stage.pNext               = NULL;
-      stage.flags               = 0;
-      stage.stage               = VK_SHADER_STAGE_COMPUTE_BIT;
-      stage.module              = p_shader_program->vk_comp;
-      stage.pName               = p_shader_program->comp_entry_point;
-      stage.pSpecializationInfo = NULL;  
+    // No room in any of the existing pools, sets larger than a pool get a pool of their own size
+    if (NULL == p_pool) {
+        p_pool = tr_internal_vk_create_descriptor_pool(p_renderer, p_allocator->pool_set_count, p_layout->descriptor_counts);
+        p_pool->next = p_allocator->pools;
+        p_allocator->pools = p_pool;
+        p_allocator->pool_count += 1;
 
-      TINY_RENDERER_DECLARE_ZERO(VkComputePipelineCreateInfo, create_info);
-      create_info.sType               = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
-      create_info.pNext               = NULL;
-      create_info.flags               = 0;
-      create_info.stage               = stage;
-      create_info.layout              = p_pipeline->vk_pipeline_layout;
-      create_info.basePipelineHandle  = 0;
-      create_info.basePipelineIndex   = 0;
-      VkResult vk_res = vkCreateComputePipelines(p_renderer->vk_device, VK_NULL_HANDLE, 1, &create_info, NULL, &(p_pipeline->vk_pipeline));
-      assert(VK_SUCCESS == vk_res);
+        alloc_info.descriptorPool = p_pool->vk_descriptor_pool;
+        VkResult vk_res = vkAllocateDescriptorSets(p_renderer->vk_device, &alloc_info, &vk_descriptor_set);
+        assert(VK_SUCCESS == vk_res);
+    }
+
+    p_pool->set_count      += 1;
+    p_pool->free_set_count -= 1;
+    for (uint32_t i = 0; i <= VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT; ++i) {
+        p_pool->free_descriptor_counts[i] -= p_layout->descriptor_counts[i];
     }
+    p_allocator->set_count += 1;
+
+    p_descriptor_set->pool                     = p_pool;
+    p_descriptor_set->layout                   = p_layout;
+    p_descriptor_set->vk_descriptor_set_layout = p_layout->vk_descriptor_set_layout;
+    p_descriptor_set->vk_descriptor_set        = vk_descriptor_set;
+    p_descriptor_set->vk_descriptor_pool       = p_pool->vk_descriptor_pool;
 }
 
-void tr_internal_vk_destroy_pipeline(tr_renderer* p_renderer, tr_pipeline* p_pipeline)
+void tr_internal_vk_free_descriptor_set(tr_renderer* p_renderer, tr_descriptor_set* p_descriptor_set)
 {
     assert(VK_NULL_HANDLE != p_renderer->vk_device);
-    assert(VK_NULL_HANDLE != p_pipeline->vk_pipeline);
-    assert(VK_NULL_HANDLE != p_pipeline->vk_pipeline_layout);
+    assert(NULL != p_renderer->descriptor_allocator);
 
-    vkDestroyPipeline(p_renderer->vk_device, p_pipeline->vk_pipeline, NULL);
-    vkDestroyPipelineLayout(p_renderer->vk_device, p_pipeline->vk_pipeline_layout, NULL);
+    tr_descriptor_allocator* p_allocator = p_renderer->descriptor_allocator;
+    tr_descriptor_pool* p_pool = p_descriptor_set->pool;
+    tr_descriptor_layout* p_layout = p_descriptor_set->layout;
+    assert(p_pool->set_count > 0);
+
+    VkResult vk_res = vkFreeDescriptorSets(p_renderer->vk_device, p_pool->vk_descriptor_pool, 1, &(p_descriptor_set->vk_descriptor_set));
+    assert(VK_SUCCESS == vk_res);
+
+    p_pool->set_count      -= 1;
+    p_pool->free_set_count += 1;
+    for (uint32_t i = 0; i <= VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT; ++i) {
+        p_pool->free_descriptor_counts[i] += p_layout->descriptor_counts[i];
+    }
+    p_allocator->set_count -= 1;
+
+    // Release empty pools - except the most recent pool in the list, so
+    // create/destroy cycles don't end up calling vkCreateDescriptorPool every time.
+    tr_descriptor_pool** pp_link = &(p_allocator->pools);
+    if ((0 == p_pool->set_count) && (*pp_link != p_pool)) {
+        while (*pp_link != p_pool) {
+            pp_link = &((*pp_link)->next);
+        }
+        *pp_link = p_pool->next;
+        tr_internal_vk_destroy_descriptor_pool(p_renderer, p_pool);
+        p_allocator->pool_count -= 1;
+    }
+
+    p_descriptor_set->pool               = NULL;
+    p_descriptor_set->vk_descriptor_set  = VK_NULL_HANDLE;
+    p_descriptor_set->vk_descriptor_pool = VK_NULL_HANDLE;
 }
 
-void tr_internal_vk_create_render_pass(tr_renderer* p_renderer, bool is_swapchain, tr_render_target* p_render_target)
+// -------------------------------------------------------------------------------------------------
+// Internal staging functions
+// -------------------------------------------------------------------------------------------------
+void tr_internal_vk_create_staging_ring(tr_renderer* p_renderer, tr_queue* p_queue, tr_staging_ring** pp_ring)
 {
     assert(VK_NULL_HANDLE != p_renderer->vk_device);
+    assert(NULL != p_queue);
 
-    uint32_t color_attachment_count = p_render_target->color_attachment_count;
-    uint32_t depth_stencil_attachment_count = (tr_format_undefined != p_render_target->depth_stencil_format) ? 1 : 0;
+    tr_staging_ring* p_ring = (tr_staging_ring*)calloc(1, sizeof(*p_ring));
+    assert(NULL != p_ring);
 
-    VkAttachmentDescription* attachments = NULL;
-    VkAttachmentReference* color_attachment_refs = NULL;
-    VkAttachmentReference* resolve_attachment_refs = NULL;
-    VkAttachmentReference* depth_stencil_attachment_ref = NULL;
+    p_ring->queue = p_queue;
+    p_ring->size  = TINY_RENDERER_STAGING_RING_SIZE;
 
-    // Fill out attachment descriptions and references
-    if (p_render_target->sample_count > tr_sample_count_1) {
-        attachments = (VkAttachmentDescription*)calloc((2 * color_attachment_count) + depth_stencil_attachment_count, sizeof(*attachments));
-        assert(NULL != attachments);
+    tr_create_buffer(p_renderer, tr_buffer_usage_transfer_src, p_ring->size, true, &(p_ring->buffer));
+    tr_create_cmd_pool(p_renderer, p_ring->queue, true, &(p_ring->cmd_pool));
+    for (uint32_t i = 0; i < tr_max_staging_submits; ++i) {
+        tr_create_cmd(p_ring->cmd_pool, false, &(p_ring->submits[i].cmd));
+        tr_create_fence(p_renderer, &(p_ring->submits[i].fence));
+        tr_create_semaphore(p_renderer, &(p_ring->submits[i].semaphore));
+    }
 
-        if (color_attachment_count > 0) {
-            color_attachment_refs = (VkAttachmentReference*)calloc(color_attachment_count, sizeof(*color_attachment_refs));
+    *pp_ring = p_ring;
+}
+
+void tr_internal_vk_destroy_staging_ring(tr_renderer* p_renderer, tr_staging_ring* p_ring)
+{
+    if (NULL == p_ring) {
+        return;
+    }
+
+    // Submits anything still batched and waits for everything in flight
+    if (p_ring->recording || (p_ring->submit_count > 0)) {
+        tr_internal_vk_queue_wait_submits(p_ring->queue);
+    }
+
+    for (uint32_t i = 0; i < tr_max_staging_submits; ++i) {
+        tr_destroy_semaphore(p_renderer, p_ring->submits[i].semaphore);
+        tr_destroy_fence(p_renderer, p_ring->submits[i].fence);
+        tr_destroy_cmd(p_ring->cmd_pool, p_ring->submits[i].cmd);
+    }
+    tr_destroy_cmd_pool(p_renderer, p_ring->cmd_pool);
+    tr_destroy_buffer(p_renderer, p_ring->buffer);
+    for (uint32_t i = 0; i < p_ring->overflow_count; ++i) {
+        tr_destroy_buffer(p_renderer, p_ring->overflows[i].buffer);
+    }
+    TINY_RENDERER_SAFE_FREE(p_ring->overflows);
+    TINY_RENDERER_SAFE_FREE(p_ring->pending_cmds);
+
+    if (p_renderer->staging_ring == p_ring) {
+        p_renderer->staging_ring = NULL;
+    }
+    if (p_renderer->transfer_staging_ring == p_ring) {
+        p_renderer->transfer_staging_ring = NULL;
+    }
+    TINY_RENDERER_SAFE_FREE(p_ring);
+}
+
+tr_staging_ring* tr_internal_vk_find_staging_ring(tr_renderer* p_renderer, uint32_t queue_family_index)
+{
+    tr_staging_ring* rings[2] = { p_renderer->staging_ring, p_renderer->transfer_staging_ring };
+    for (uint32_t i = 0; i < 2; ++i) {
+        if ((NULL != rings[i]) && (rings[i]->queue->vk_queue_family_index == queue_family_index)) {
+            return rings[i];
+        }
+    }
+    return NULL;
+}
+
+void tr_internal_vk_staging_ring_retire(tr_staging_ring* p_ring, bool wait)
+{
+    VkDevice device = p_ring->queue->renderer->vk_device;
+
+    // Ring space handed to command buffers that haven't been submitted yet can't be reused
+    uint64_t pending_begin = UINT64_MAX;
+    for (uint32_t i = 0; i < p_ring->pending_cmd_count; ++i) {
+        pending_begin = tr_min_64(pending_begin, p_ring->pending_cmds[i].ring_begin);
+    }
+
+    // With a queue timeline one counter read covers all the submits in flight
+    tr_timeline* p_timeline = p_ring->queue->timeline;
+    uint64_t completed_value = 0;
+    if ((NULL != p_timeline) && (p_ring->submit_count > 0)) {
+        completed_value = tr_internal_vk_timeline_get_value(p_timeline);
+    }
+
+    while (p_ring->submit_count > 0) {
+        tr_staging_submit* p_submit = &(p_ring->submits[p_ring->submit_first]);
+        if (NULL != p_timeline) {
+            if (wait && (completed_value < p_submit->queue_value)) {
+                TINY_RENDERER_TRACE_NAMED_SCOPE(p_ring->queue, "vkWaitSemaphores");
+                tr_internal_vk_timeline_wait(p_timeline, p_submit->queue_value, UINT64_MAX);
+                completed_value = tr_internal_vk_timeline_get_value(p_timeline);
+            }
+            wait = false;
+            if (completed_value < p_submit->queue_value) {
+                break;
+            }
+        }
+        else {
+            VkResult vk_res = VK_SUCCESS;
+            if (wait) {
+                TINY_RENDERER_TRACE_NAMED_SCOPE(p_ring->queue, "vkWaitForFences");
+                vk_res = vkWaitForFences(device, 1, &(p_submit->fence->vk_fence), VK_TRUE, UINT64_MAX);
+                // Only the oldest submit is waited on, the rest are picked up if they're done
+                wait = false;
+            }
+            else {
+                vk_res = vkGetFenceStatus(device, p_submit->fence->vk_fence);
+            }
+            if (VK_SUCCESS != vk_res) {
+                assert(VK_NOT_READY == vk_res || VK_TIMEOUT == vk_res);
+                break;
+            }
+
+            vk_res = vkResetFences(device, 1, &(p_submit->fence->vk_fence));
+            assert(VK_SUCCESS == vk_res);
+        }
+
+        p_ring->tail = tr_max_64(p_ring->tail, tr_min_64(p_submit->ring_end, pending_begin));
+        p_ring->complete_serial = p_submit->serial;
+        p_ring->submit_first = (p_ring->submit_first + 1) % tr_max_staging_submits;
+        p_ring->submit_count -= 1;
+    }
+
+    // Overflow buffers go away with the batch that copied out of them
+    uint32_t overflow_count = 0;
+    for (uint32_t i = 0; i < p_ring->overflow_count; ++i) {
+        if (p_ring->overflows[i].serial <= p_ring->complete_serial) {
+            tr_destroy_buffer(p_ring->queue->renderer, p_ring->overflows[i].buffer);
+        }
+        else {
+            p_ring->overflows[overflow_count++] = p_ring->overflows[i];
+        }
+    }
+    p_ring->overflow_count = overflow_count;
+
+    // Nothing in flight or waiting to be submitted references the ring
+    if ((0 == p_ring->submit_count) && (0 == p_ring->pending_cmd_count) && (! p_ring->recording)) {
+        p_ring->tail = p_ring->head;
+    }
+}
+
+static bool tr_internal_vk_staging_ring_fit(tr_staging_ring* p_ring, uint64_t tail, uint64_t size, uint64_t alignment, uint64_t* p_ring_pos)
+{
+    uint64_t ring_pos = tr_round_up_64(p_ring->head, alignment);
+    // Writes never wrap around the end of the buffer
+    uint64_t offset = ring_pos % p_ring->size;
+    if ((offset + size) > p_ring->size) {
+        ring_pos += p_ring->size - offset;
+    }
+    *p_ring_pos = ring_pos;
+    return (ring_pos + size - tail) <= p_ring->size;
+}
+
+tr_staging_ring* tr_internal_vk_staging_ring_for_queue(tr_queue* p_queue)
+{
+    tr_staging_ring* p_ring = tr_internal_vk_find_staging_ring(p_queue->renderer, p_queue->vk_queue_family_index);
+    assert((NULL != p_ring) && "uploads need the graphics or the transfer queue");
+    return p_ring;
+}
+
+bool tr_internal_vk_staging_ring_reserve(tr_staging_ring* p_ring, uint64_t size, uint64_t alignment, uint64_t* p_ring_pos)
+{
+    assert(size > 0);
+    assert(size <= p_ring->size);
+    assert((p_ring->size % alignment) == 0);
+
+    uint64_t ring_pos = 0;
+    if (! tr_internal_vk_staging_ring_fit(p_ring, p_ring->tail, size, alignment, &ring_pos)) {
+        // Space from the oldest command buffer that hasn't been submitted on is held no matter
+        // how long we wait, don't stall on submits in flight if the rest isn't enough
+        uint64_t pending_begin = UINT64_MAX;
+        for (uint32_t i = 0; i < p_ring->pending_cmd_count; ++i) {
+            pending_begin = tr_min_64(pending_begin, p_ring->pending_cmds[i].ring_begin);
+        }
+        if ((p_ring->pending_cmd_count > 0) && (! tr_internal_vk_staging_ring_fit(p_ring, pending_begin, size, alignment, &ring_pos))) {
+            return false;
+        }
+
+        // Out of space: reclaim whatever the GPU is done with. If that isn't
+        // enough, submit the batch and wait on the oldest submits.
+        tr_internal_vk_staging_ring_retire(p_ring, false);
+        while (! tr_internal_vk_staging_ring_fit(p_ring, p_ring->tail, size, alignment, &ring_pos)) {
+            tr_internal_vk_staging_ring_flush(p_ring);
+            // What's left is held by command buffers that haven't been submitted, waiting won't free it
+            if (0 == p_ring->submit_count) {
+                return false;
+            }
+            tr_internal_vk_staging_ring_retire(p_ring, true);
+        }
+    }
+
+    p_ring->head = ring_pos + size;
+
+    *p_ring_pos = ring_pos;
+    return true;
+}
+
+bool tr_internal_vk_staging_ring_write(tr_staging_ring* p_ring, uint64_t size, uint64_t alignment, const void* p_src_data, uint64_t* p_ring_pos)
+{
+    if (! tr_internal_vk_staging_ring_reserve(p_ring, size, alignment, p_ring_pos)) {
+        return false;
+    }
+
+    uint8_t* p_dst = (uint8_t*)p_ring->buffer->cpu_mapped_address + (*p_ring_pos % p_ring->size);
+    memcpy(p_dst, p_src_data, size);
+
+    return true;
+}
+
+// Staging for a copy recorded into the ring's batch, returns where to write the data. When
+// tr_util_update_buffer_cmd command buffers that haven't been submitted hold the ring, that's
+// an overflow buffer that lives until the batch has completed.
+uint8_t* tr_internal_vk_staging_ring_stage(tr_staging_ring* p_ring, uint64_t size, uint64_t alignment, tr_buffer** pp_src_buffer, uint64_t* p_src_offset)
+{
+    uint64_t ring_pos = 0;
+    if (tr_internal_vk_staging_ring_reserve(p_ring, size, alignment, &ring_pos)) {
+        *pp_src_buffer = p_ring->buffer;
+        *p_src_offset  = ring_pos % p_ring->size;
+        return (uint8_t*)p_ring->buffer->cpu_mapped_address + *p_src_offset;
+    }
+
+    if (p_ring->overflow_count == p_ring->overflow_capacity) {
+        uint32_t capacity = (p_ring->overflow_capacity > 0) ? (2 * p_ring->overflow_capacity) : 8;
+        p_ring->overflows = (tr_staging_overflow*)realloc(p_ring->overflows, capacity * sizeof(*(p_ring->overflows)));
+        assert(NULL != p_ring->overflows);
+        p_ring->overflow_capacity = capacity;
+    }
+
+    tr_staging_overflow* p_overflow = &(p_ring->overflows[p_ring->overflow_count++]);
+    tr_create_buffer(p_ring->queue->renderer, tr_buffer_usage_transfer_src, size, true, &(p_overflow->buffer));
+    // The copy goes out with the batch that's recording, or with the next one
+    p_overflow->serial = p_ring->submit_serial + 1;
+
+    *pp_src_buffer = p_overflow->buffer;
+    *p_src_offset  = 0;
+    return (uint8_t*)p_overflow->buffer->cpu_mapped_address;
+}
+
+tr_upload_ticket tr_internal_vk_staging_ring_ticket(tr_staging_ring* p_ring)
+{
+    // A recording batch goes out with the next submit
+    return p_ring->recording ? (p_ring->submit_serial + 1) : p_ring->submit_serial;
+}
+
+tr_cmd* tr_internal_vk_staging_ring_batch_cmd(tr_staging_ring* p_ring)
+{
+    if (! p_ring->recording) {
+        // The batch uses the command buffer of the next submit slot
+        if (p_ring->submit_count == tr_max_staging_submits) {
+            tr_internal_vk_staging_ring_retire(p_ring, true);
+        }
+        uint32_t index = (p_ring->submit_first + p_ring->submit_count) % tr_max_staging_submits;
+        tr_internal_vk_begin_cmd(p_ring->submits[index].cmd, NULL);
+        p_ring->recording = true;
+    }
+
+    uint32_t index = (p_ring->submit_first + p_ring->submit_count) % tr_max_staging_submits;
+    return p_ring->submits[index].cmd;
+}
+
+void tr_internal_vk_staging_ring_add_pending_cmd(tr_staging_ring* p_ring, tr_cmd* p_cmd, uint64_t ring_begin)
+{
+    for (uint32_t i = 0; i < p_ring->pending_cmd_count; ++i) {
+        if (p_ring->pending_cmds[i].cmd == p_cmd) {
+            return;
+        }
+    }
+
+    if (p_ring->pending_cmd_count == p_ring->pending_cmd_capacity) {
+        uint32_t capacity = (p_ring->pending_cmd_capacity > 0) ? (2 * p_ring->pending_cmd_capacity) : 8;
+        p_ring->pending_cmds = (tr_staging_pending_cmd*)realloc(p_ring->pending_cmds, capacity * sizeof(*(p_ring->pending_cmds)));
+        assert(NULL != p_ring->pending_cmds);
+        p_ring->pending_cmd_capacity = capacity;
+    }
+
+    p_ring->pending_cmds[p_ring->pending_cmd_count].cmd        = p_cmd;
+    p_ring->pending_cmds[p_ring->pending_cmd_count].ring_begin = ring_begin;
+    p_ring->pending_cmd_count += 1;
+    p_cmd->staging_pending = true;
+}
+
+void tr_internal_vk_staging_ring_remove_pending_cmd(tr_staging_ring* p_ring, tr_cmd* p_cmd)
+{
+    for (uint32_t i = 0; i < p_ring->pending_cmd_count; ++i) {
+        if (p_ring->pending_cmds[i].cmd == p_cmd) {
+            p_ring->pending_cmd_count -= 1;
+            p_ring->pending_cmds[i] = p_ring->pending_cmds[p_ring->pending_cmd_count];
+            p_cmd->staging_pending = false;
+            return;
+        }
+    }
+}
+
+// p_cmd is being re-recorded or destroyed without having been submitted, the GPU never sees its uploads
+void tr_internal_vk_staging_ring_drop_cmd(tr_cmd* p_cmd)
+{
+    if (! p_cmd->staging_pending) {
+        return;
+    }
+    assert(tr_internal_on_frame_thread() && "the staging ring is only used on the frame thread");
+
+    tr_queue* p_queue = p_cmd->cmd_pool->queue;
+    tr_staging_ring* p_ring = tr_internal_vk_find_staging_ring(p_queue->renderer, p_queue->vk_queue_family_index);
+    if (NULL != p_ring) {
+        tr_internal_vk_staging_ring_remove_pending_cmd(p_ring, p_cmd);
+    }
+    p_cmd->staging_pending = false;
+}
+
+void tr_internal_vk_staging_ring_flush(tr_staging_ring* p_ring)
+{
+    if (p_ring->recording) {
+        tr_internal_vk_queue_submit(p_ring->queue, 0, NULL, 0, NULL, 0, NULL, NULL);
+    }
+}
+
+tr_staging_submit* tr_internal_vk_staging_ring_begin_submit(tr_staging_ring* p_ring, tr_queue* p_queue, uint32_t submit_count, const tr_submit_info* p_submits)
+{
+    if (NULL == p_ring) {
+        return NULL;
+    }
+
+    bool uses_ring = p_ring->recording;
+    for (uint32_t i = 0; (i < p_ring->pending_cmd_count) && (! uses_ring); ++i) {
+        for (uint32_t j = 0; (j < submit_count) && (! uses_ring); ++j) {
+            for (uint32_t k = 0; k < p_submits[j].cmd_count; ++k) {
+                if (p_ring->pending_cmds[i].cmd == p_submits[j].pp_cmds[k]) {
+                    uses_ring = true;
+                    break;
+                }
+            }
+        }
+    }
+    if (! uses_ring) {
+        return NULL;
+    }
+
+    // A recording batch already owns the next slot
+    if ((! p_ring->recording) && (p_ring->submit_count == tr_max_staging_submits)) {
+        tr_internal_vk_staging_ring_retire(p_ring, true);
+    }
+
+    uint32_t index = (p_ring->submit_first + p_ring->submit_count) % tr_max_staging_submits;
+    return &(p_ring->submits[index]);
+}
+
+void tr_internal_vk_staging_ring_end_submit(tr_staging_ring* p_ring, tr_staging_submit* p_submit, uint32_t submit_count, const tr_submit_info* p_submits)
+{
+    p_ring->submit_serial += 1;
+    p_submit->ring_end = p_ring->head;
+    p_submit->serial   = p_ring->submit_serial;
+    p_ring->submit_count += 1;
+    p_ring->recording = false;
+    p_ring->transfer_wait = false;
+
+    for (uint32_t i = 0; i < submit_count; ++i) {
+        for (uint32_t j = 0; j < p_submits[i].cmd_count; ++j) {
+            tr_internal_vk_staging_ring_remove_pending_cmd(p_ring, p_submits[i].pp_cmds[j]);
+        }
+    }
+}
+
+void tr_internal_vk_staging_ring_release_buffer(tr_staging_ring* p_ring, tr_buffer* p_buffer, tr_buffer_usage old_usage, tr_buffer_usage new_usage)
+{
+    tr_renderer* p_renderer = p_ring->queue->renderer;
+    tr_staging_ring* p_graphics_ring = p_renderer->staging_ring;
+    if (p_ring == p_graphics_ring) {
+        return;
+    }
+
+    // Release on the transfer queue, acquire in the graphics ring's batch
+    tr_cmd* p_cmd = tr_internal_vk_staging_ring_batch_cmd(p_ring);
+    tr_cmd_buffer_queue_transfer(p_cmd, p_buffer, p_ring->queue, p_graphics_ring->queue, old_usage, new_usage);
+    p_cmd = tr_internal_vk_staging_ring_batch_cmd(p_graphics_ring);
+    tr_cmd_buffer_queue_transfer(p_cmd, p_buffer, p_ring->queue, p_graphics_ring->queue, old_usage, new_usage);
+    p_graphics_ring->transfer_wait = true;
+}
+
+void tr_internal_vk_staging_ring_release_image(tr_staging_ring* p_ring, tr_texture* p_texture, tr_texture_usage old_usage, tr_texture_usage new_usage)
+{
+    tr_renderer* p_renderer = p_ring->queue->renderer;
+    tr_staging_ring* p_graphics_ring = p_renderer->staging_ring;
+    if (p_ring == p_graphics_ring) {
+        tr_cmd* p_cmd = tr_internal_vk_staging_ring_batch_cmd(p_ring);
+        tr_cmd_image_transition(p_cmd, p_texture, old_usage, new_usage);
+        return;
+    }
+
+    // The layout transition is part of both the release and the acquire
+    tr_cmd* p_cmd = tr_internal_vk_staging_ring_batch_cmd(p_ring);
+    tr_cmd_image_queue_transfer(p_cmd, p_texture, p_ring->queue, p_graphics_ring->queue, old_usage, new_usage);
+    p_cmd = tr_internal_vk_staging_ring_batch_cmd(p_graphics_ring);
+    tr_cmd_image_queue_transfer(p_cmd, p_texture, p_ring->queue, p_graphics_ring->queue, old_usage, new_usage);
+    p_graphics_ring->transfer_wait = true;
+}
+
+void tr_internal_vk_staging_ring_signal_transfer(tr_renderer* p_renderer, tr_semaphore* p_semaphore)
+{
+    tr_staging_ring* p_ring = p_renderer->transfer_staging_ring;
+    assert(NULL != p_ring);
+
+    // Anything still batched on the transfer queue has to go first. The semaphore
+    // is signaled by an empty submit, which covers all earlier transfer submits.
+    tr_internal_vk_staging_ring_flush(p_ring);
+
+    TINY_RENDERER_DECLARE_ZERO(VkSubmitInfo, submit_info);
+    submit_info.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submit_info.pNext                = NULL;
+    submit_info.signalSemaphoreCount = 1;
+    submit_info.pSignalSemaphores    = &(p_semaphore->vk_semaphore);
+    VkResult vk_res = vkQueueSubmit(p_ring->queue->vk_queue, 1, &submit_info, VK_NULL_HANDLE);
+    assert(VK_SUCCESS == vk_res);
+}
+
+void tr_internal_vk_cmd_copy_staged_buffer(tr_cmd* p_cmd, tr_buffer* p_src_buffer, uint64_t src_offset, uint64_t dst_offset, uint64_t size, tr_buffer* p_buffer)
+{
+    // Left in all of its usages, so the copied data is visible to whichever comes next
+    tr_internal_vk_cmd_buffer_state(p_cmd, p_buffer, tr_buffer_usage_transfer_dst);
+    tr_internal_vk_cmd_flush_barriers(p_cmd);
+    TINY_RENDERER_DECLARE_ZERO(VkBufferCopy, region);
+    region.srcOffset = (VkDeviceSize)src_offset;
+    region.dstOffset = (VkDeviceSize)dst_offset;
+    region.size      = (VkDeviceSize)size;
+    vkCmdCopyBuffer(p_cmd->vk_cmd_buf, p_src_buffer->vk_buffer, p_buffer->vk_buffer, 1, &region);
+    tr_internal_vk_cmd_buffer_state(p_cmd, p_buffer, p_buffer->usage);
+}
+
+// -------------------------------------------------------------------------------------------------
+// Internal create functions
+// -------------------------------------------------------------------------------------------------
+void tr_internal_vk_create_fence(tr_renderer *p_renderer, tr_fence* p_fence)
+{   
+    assert(VK_NULL_HANDLE != p_renderer->vk_device);
+
+    TINY_RENDERER_DECLARE_ZERO(VkFenceCreateInfo, create_info);
+    create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    create_info.pNext = NULL;
+    create_info.flags = 0;
+    VkResult vk_res = vkCreateFence(p_renderer->vk_device,  &create_info, NULL, &(p_fence->vk_fence));
+    assert(VK_SUCCESS == vk_res);
+}
+
+void tr_internal_vk_destroy_fence(tr_renderer *p_renderer, tr_fence* p_fence)
+{   
+    assert(VK_NULL_HANDLE != p_renderer->vk_device);
+    assert(VK_NULL_HANDLE != p_fence->vk_fence);
+
+    vkDestroyFence(p_renderer->vk_device, p_fence->vk_fence, NULL);
+}
+
+void tr_internal_vk_create_semaphore(tr_renderer *p_renderer, tr_semaphore* p_semaphore)
+{   
+    assert(VK_NULL_HANDLE != p_renderer->vk_device);
+
+    TINY_RENDERER_DECLARE_ZERO(VkSemaphoreCreateInfo, create_info);
+    create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    create_info.pNext = NULL;
+    create_info.flags = 0;
+    VkResult vk_res = vkCreateSemaphore(p_renderer->vk_device,  &create_info, NULL, &(p_semaphore->vk_semaphore));
+    assert(VK_SUCCESS == vk_res);
+}
+
+void tr_internal_vk_destroy_semaphore(tr_renderer *p_renderer, tr_semaphore* p_semaphore)
+{   
+    assert(VK_NULL_HANDLE != p_renderer->vk_device);
+    assert(VK_NULL_HANDLE != p_semaphore->vk_semaphore);
+
+    vkDestroySemaphore(p_renderer->vk_device, p_semaphore->vk_semaphore, NULL);
+}
+
+void tr_internal_vk_create_timeline(tr_renderer *p_renderer, uint64_t initial_value, tr_timeline* p_timeline)
+{
+    assert(VK_NULL_HANDLE != p_renderer->vk_device);
+
+    TINY_RENDERER_DECLARE_ZERO(VkSemaphoreTypeCreateInfoKHR, type_create_info);
+    type_create_info.sType         = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+    type_create_info.pNext         = NULL;
+    type_create_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+    type_create_info.initialValue  = initial_value;
+
+    TINY_RENDERER_DECLARE_ZERO(VkSemaphoreCreateInfo, create_info);
+    create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    create_info.pNext = &type_create_info;
+    create_info.flags = 0;
+    VkResult vk_res = vkCreateSemaphore(p_renderer->vk_device,  &create_info, NULL, &(p_timeline->vk_semaphore));
+    assert(VK_SUCCESS == vk_res);
+}
+
+void tr_internal_vk_destroy_timeline(tr_renderer *p_renderer, tr_timeline* p_timeline)
+{
+    assert(VK_NULL_HANDLE != p_renderer->vk_device);
+    assert(VK_NULL_HANDLE != p_timeline->vk_semaphore);
+
+    vkDestroySemaphore(p_renderer->vk_device, p_timeline->vk_semaphore, NULL);
+}
+
+uint64_t tr_internal_vk_timeline_get_value(tr_timeline* p_timeline)
+{
+    tr_renderer* p_renderer = p_timeline->renderer;
+
+    uint64_t value = 0;
+    VkResult vk_res = p_renderer->vk_get_semaphore_counter_value(p_renderer->vk_device, p_timeline->vk_semaphore, &value);
+    assert(VK_SUCCESS == vk_res);
+    return value;
+}
+
+bool tr_internal_vk_timeline_wait(tr_timeline* p_timeline, uint64_t value, uint64_t timeout_ns)
+{
+    tr_renderer* p_renderer = p_timeline->renderer;
+
+    TINY_RENDERER_DECLARE_ZERO(VkSemaphoreWaitInfoKHR, wait_info);
+    wait_info.sType          = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+    wait_info.pNext          = NULL;
+    wait_info.flags          = 0;
+    wait_info.semaphoreCount = 1;
+    wait_info.pSemaphores    = &(p_timeline->vk_semaphore);
+    wait_info.pValues        = &value;
+    VkResult vk_res = p_renderer->vk_wait_semaphores(p_renderer->vk_device, &wait_info, timeout_ns);
+    assert((VK_SUCCESS == vk_res) || (VK_TIMEOUT == vk_res));
+    return VK_SUCCESS == vk_res;
+}
+
+void tr_internal_vk_timeline_signal(tr_timeline* p_timeline, uint64_t value)
+{
+    tr_renderer* p_renderer = p_timeline->renderer;
+
+    TINY_RENDERER_DECLARE_ZERO(VkSemaphoreSignalInfoKHR, signal_info);
+    signal_info.sType     = VK_STRUCTURE_TYPE_SEMAPHORE_SIGNAL_INFO_KHR;
+    signal_info.pNext     = NULL;
+    signal_info.semaphore = p_timeline->vk_semaphore;
+    signal_info.value     = value;
+    VkResult vk_res = p_renderer->vk_signal_semaphore(p_renderer->vk_device, &signal_info);
+    assert(VK_SUCCESS == vk_res);
+}
+
+void tr_internal_vk_create_descriptor_set(tr_renderer* p_renderer, tr_descriptor_set* p_descriptor_set)
+{
+    assert(VK_NULL_HANDLE != p_renderer->vk_device);
+    assert(p_descriptor_set->descriptor_count <= tr_max_descriptors);
+
+    TINY_RENDERER_DECLARE_ZERO(VkDescriptorSetLayoutBinding, bindings[tr_max_descriptors]);
+
+    uint32_t binding_count = 0;
+    for (uint32_t i = 0; i < p_descriptor_set->descriptor_count; ++i) {
+        const tr_descriptor* descriptor = &(p_descriptor_set->descriptors[i]);
+        uint32_t type_index = UINT32_MAX;
+        switch (descriptor->type) {
+            case tr_descriptor_type_sampler                  : type_index = VK_DESCRIPTOR_TYPE_SAMPLER; break;
+            case tr_descriptor_type_uniform_buffer_cbv       : type_index = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER; break;
+            case tr_descriptor_type_storage_buffer_srv       : type_index = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER; break;
+            case tr_descriptor_type_storage_buffer_uav       : type_index = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER; break;
+            case tr_descriptor_type_uniform_texel_buffer_srv : type_index = VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER; break;
+            case tr_descriptor_type_storage_texel_buffer_uav : type_index = VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER; break;
+            case tr_descriptor_type_texture_srv              : type_index = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE; break;
+            case tr_descriptor_type_texture_uav              : type_index = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE; break;
+        }
+        // Bindings line up with the descriptors, the update path relies on it
+        assert(UINT32_MAX != type_index);
+        assert(descriptor->count <= tr_max_descriptor_entries);
+        {
+            VkDescriptorSetLayoutBinding* binding = &(bindings[binding_count]);
+            binding->binding            = descriptor->binding;
+            binding->descriptorType     = (VkDescriptorType)type_index;
+            binding->descriptorCount    = descriptor->count;
+            binding->stageFlags         = tr_util_to_vk_shader_stages(descriptor->shader_stages);
+            binding->pImmutableSamplers = NULL;
+            ++binding_count;
+        }
+    }
+
+    assert(0 != binding_count);
+
+    // Layouts are shared between sets with the same bindings, the set comes out of a shared pool
+    tr_descriptor_layout* p_layout = tr_internal_vk_acquire_descriptor_layout(p_renderer, binding_count, bindings);
+    tr_internal_vk_allocate_descriptor_set(p_renderer, p_layout, p_descriptor_set);
+
+    // Nothing has been written yet, zeroed infos mark unwritten elements
+    p_descriptor_set->descriptor_data = (uint8_t*)calloc(tr_max(p_layout->data_size, 1), 1);
+    assert(NULL != p_descriptor_set->descriptor_data);
+    p_descriptor_set->descriptor_serials = (uint64_t*)calloc(tr_max(p_layout->element_count, 1), sizeof(*(p_descriptor_set->descriptor_serials)));
+    assert(NULL != p_descriptor_set->descriptor_serials);
+    p_descriptor_set->unwritten_count = p_layout->element_count;
+}
+
+void tr_internal_vk_destroy_descriptor_set(tr_renderer* p_renderer, tr_descriptor_set* p_descriptor_set)
+{
+    assert(VK_NULL_HANDLE != p_renderer->vk_device);
+    assert(VK_NULL_HANDLE != p_descriptor_set->vk_descriptor_set_layout);
+    assert(VK_NULL_HANDLE != p_descriptor_set->vk_descriptor_set);
+    assert(NULL != p_descriptor_set->pool);
+
+    // The layout stays in the cache
+    tr_internal_vk_free_descriptor_set(p_renderer, p_descriptor_set);
+
+    TINY_RENDERER_SAFE_FREE(p_descriptor_set->descriptor_data);
+    TINY_RENDERER_SAFE_FREE(p_descriptor_set->descriptor_serials);
+}
+
+void tr_internal_vk_create_cmd_pool(tr_renderer *p_renderer, tr_queue* p_queue, bool transient, tr_cmd_pool* p_cmd_pool)
+{
+    assert(VK_NULL_HANDLE != p_renderer->vk_device);
+    assert((p_queue->vk_queue_family_index == p_renderer->graphics_queue->vk_queue_family_index) ||
+           (p_queue->vk_queue_family_index == p_renderer->present_queue->vk_queue_family_index) ||
+           (p_queue->vk_queue_family_index == p_renderer->transfer_queue->vk_queue_family_index));
+
+    TINY_RENDERER_DECLARE_ZERO(VkCommandPoolCreateInfo, create_info);
+    create_info.sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    create_info.pNext            = NULL;
+    create_info.flags            = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    create_info.queueFamilyIndex = p_queue->vk_queue_family_index;
+    if (transient) {
+        create_info.flags |= VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    }
+    VkResult vk_res = vkCreateCommandPool(p_renderer->vk_device, &create_info, NULL, &(p_cmd_pool->vk_cmd_pool));
+    assert(VK_SUCCESS == vk_res);
+}
+
+void tr_internal_vk_destroy_cmd_pool(tr_renderer *p_renderer, tr_cmd_pool* p_cmd_pool)
+{
+    assert(VK_NULL_HANDLE != p_renderer->vk_device);
+    assert(VK_NULL_HANDLE != p_cmd_pool->vk_cmd_pool);
+
+    vkDestroyCommandPool(p_renderer->vk_device, p_cmd_pool->vk_cmd_pool, NULL);
+}
+
+void tr_internal_vk_create_cmd(tr_cmd_pool *p_cmd_pool, bool secondary, tr_cmd* p_cmd)
+{
+    assert(VK_NULL_HANDLE != p_cmd_pool->renderer->vk_device);
+    assert(VK_NULL_HANDLE != p_cmd_pool->vk_cmd_pool);
+
+    TINY_RENDERER_DECLARE_ZERO(VkCommandBufferAllocateInfo, alloc_info);
+    alloc_info.sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    alloc_info.pNext              = NULL;
+    alloc_info.commandPool        = p_cmd_pool->vk_cmd_pool;
+    alloc_info.level              = secondary ? VK_COMMAND_BUFFER_LEVEL_SECONDARY : VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    alloc_info.commandBufferCount = 1;
+    VkResult vk_res = vkAllocateCommandBuffers(p_cmd_pool->renderer->vk_device, &alloc_info, &(p_cmd->vk_cmd_buf));
+    assert(VK_SUCCESS == vk_res);
+}
+
+void tr_internal_vk_destroy_cmd(tr_cmd_pool *p_cmd_pool, tr_cmd* p_cmd)
+{
+    assert(VK_NULL_HANDLE != p_cmd_pool->renderer->vk_device);
+    assert(VK_NULL_HANDLE != p_cmd_pool->vk_cmd_pool);
+    assert(VK_NULL_HANDLE != p_cmd->vk_cmd_buf);
+
+    tr_internal_vk_staging_ring_drop_cmd(p_cmd);
+
+    vkFreeCommandBuffers(p_cmd_pool->renderer->vk_device, p_cmd_pool->vk_cmd_pool, 1, &(p_cmd->vk_cmd_buf));
+
+    TINY_RENDERER_SAFE_FREE(p_cmd->pending_buffer_barriers);
+    TINY_RENDERER_SAFE_FREE(p_cmd->pending_image_barriers);
+}
+
+void tr_internal_vk_create_buffer(tr_renderer* p_renderer, tr_buffer* p_buffer)
+{
+    assert(VK_NULL_HANDLE != p_renderer->vk_device);
+
+    // Align the buffer size to multiples of the dynamic uniform buffer minimum size
+    if (p_buffer->usage & tr_buffer_usage_uniform_cbv) {
+        // Make minimum size 256 bytes to match D3D12
+        p_buffer->size = tr_round_up(tr_max(p_buffer->size, 256), 
+                                     (uint32_t)(p_renderer->vk_active_gpu_properties.limits.minUniformBufferOffsetAlignment));
+    }
+
+    TINY_RENDERER_DECLARE_ZERO(VkBufferCreateInfo, create_info);
+    create_info.sType                 = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    create_info.pNext                 = NULL;
+    create_info.flags                 = 0;
+    create_info.size                  = p_buffer->size;
+    create_info.usage                 = tr_util_to_vk_buffer_usage(p_buffer->usage);
+    create_info.sharingMode           = VK_SHARING_MODE_EXCLUSIVE;
+    create_info.queueFamilyIndexCount = 0;
+    create_info.pQueueFamilyIndices   = NULL;
+
+    // Make it easy to copy to and from buffer
+    create_info.usage |= (VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+    VkResult vk_res = vkCreateBuffer(p_renderer->vk_device, &create_info, NULL, &(p_buffer->vk_buffer));
+    assert(VK_SUCCESS == vk_res);
+
+    TINY_RENDERER_DECLARE_ZERO(VkMemoryRequirements, mem_reqs);
+    vkGetBufferMemoryRequirements(p_renderer->vk_device, p_buffer->vk_buffer, &mem_reqs);
+
+    VkMemoryPropertyFlags mem_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    if (p_buffer->host_visible) {
+        mem_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    }
+
+    tr_internal_vk_allocate_memory(p_renderer, &mem_reqs, mem_flags, true, &(p_buffer->vk_allocation));
+    p_buffer->vk_memory = p_buffer->vk_allocation.block->vk_memory;
+
+    vk_res = vkBindBufferMemory(p_renderer->vk_device, p_buffer->vk_buffer, p_buffer->vk_memory, p_buffer->vk_allocation.offset);
+    assert(VK_SUCCESS == vk_res);
+
+    if (p_buffer->host_visible) {
+        assert(NULL != p_buffer->vk_allocation.block->cpu_mapped_address);
+        p_buffer->cpu_mapped_address = (uint8_t*)p_buffer->vk_allocation.block->cpu_mapped_address + p_buffer->vk_allocation.offset;
+    }
+
+    switch (p_buffer->usage) {
+        case tr_buffer_usage_uniform_texel_srv:
+        case tr_buffer_usage_storage_texel_uav: {
+            TINY_RENDERER_DECLARE_ZERO(VkBufferViewCreateInfo, buffer_view_create_info);
+            buffer_view_create_info.sType   = VK_STRUCTURE_TYPE_BUFFER_VIEW_CREATE_INFO;
+            buffer_view_create_info.pNext   = NULL;
+            buffer_view_create_info.flags   = 0;
+            buffer_view_create_info.buffer  = p_buffer->vk_buffer;
+            buffer_view_create_info.format  = tr_util_to_vk_format(p_buffer->format);
+            buffer_view_create_info.range   = VK_WHOLE_SIZE;
+            vk_res = vkCreateBufferView(p_renderer->vk_device, &buffer_view_create_info, NULL, &(p_buffer->vk_buffer_view));
+        }
+        break;
+
+        case tr_buffer_usage_uniform_cbv:
+        case tr_buffer_usage_storage_srv:
+        case tr_buffer_usage_storage_uav: {
+            p_buffer->vk_buffer_info.buffer = p_buffer->vk_buffer;
+            p_buffer->vk_buffer_info.offset = 0;
+            p_buffer->vk_buffer_info.range  = VK_WHOLE_SIZE;
+        }
+        break;
+    }
+
+    p_buffer->serial = ++(p_renderer->resource_serial);
+}
+
+void tr_internal_vk_destroy_buffer(tr_renderer* p_renderer, tr_buffer* p_buffer)
+{
+    assert(VK_NULL_HANDLE != p_renderer->vk_device);
+    assert(VK_NULL_HANDLE != p_buffer->vk_buffer);
+
+    if (VK_NULL_HANDLE != p_buffer->vk_buffer_view) {
+        vkDestroyBufferView(p_renderer->vk_device, p_buffer->vk_buffer_view, NULL);
+    }
+
+    vkDestroyBuffer(p_renderer->vk_device, p_buffer->vk_buffer, NULL);
+
+    tr_internal_vk_free_memory(p_renderer, &(p_buffer->vk_allocation));
+    p_buffer->vk_memory = VK_NULL_HANDLE;
+}
+
+// Creates the image and, if allocate_memory is set, binds memory to it. Images created
+// without memory have to be bound by the caller before the view is created.
+void tr_internal_vk_create_texture_image(tr_renderer* p_renderer, tr_texture* p_texture, bool allocate_memory)
+{
+    assert(VK_NULL_HANDLE != p_renderer->vk_device);
+    assert(VK_NULL_HANDLE == p_texture->vk_image);
+
+    VkImageType image_type = VK_IMAGE_TYPE_2D;
+    switch (p_texture->type) {
+        case tr_texture_type_1d   : image_type = VK_IMAGE_TYPE_1D; break;
+        case tr_texture_type_2d   : image_type = VK_IMAGE_TYPE_2D; break;
+        case tr_texture_type_3d   : image_type = VK_IMAGE_TYPE_3D; break;
+        case tr_texture_type_cube : image_type = VK_IMAGE_TYPE_2D; break;
+    }
+
+    TINY_RENDERER_DECLARE_ZERO(VkImageCreateInfo, create_info);
+    create_info.sType                 = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    create_info.pNext                 = NULL;
+    create_info.flags                 = 0;
+    create_info.imageType             = image_type;
+    create_info.format                = tr_util_to_vk_format(p_texture->format);
+    create_info.extent.width          = p_texture->width;
+    create_info.extent.height         = p_texture->height;
+    create_info.extent.depth          = p_texture->depth;
+    create_info.mipLevels             = p_texture->mip_levels;
+    create_info.arrayLayers           = p_texture->host_visible ? 1 : 1;
+    create_info.samples               = tr_util_to_vk_sample_count(p_texture->sample_count);
+    create_info.tiling                = (0 != p_texture->host_visible) ? VK_IMAGE_TILING_LINEAR : VK_IMAGE_TILING_OPTIMAL;
+    create_info.usage                 = tr_util_to_vk_image_usage(p_texture->usage);
+    create_info.sharingMode           = VK_SHARING_MODE_EXCLUSIVE;
+    create_info.queueFamilyIndexCount = 0;
+    create_info.pQueueFamilyIndices   = NULL;
+    create_info.initialLayout         = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (VK_IMAGE_USAGE_SAMPLED_BIT & create_info.usage) {
+        // Make it easy to copy to and from textures
+        create_info.usage |= (VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+    }
+    // Verify that GPU supports this format
+    TINY_RENDERER_DECLARE_ZERO(VkFormatProperties, format_props);
+    vkGetPhysicalDeviceFormatProperties(p_renderer->vk_active_gpu, create_info.format, &format_props);
+    VkFormatFeatureFlags format_features = tr_util_vk_image_usage_to_format_features(create_info.usage);
+    if (p_texture->host_visible) {
+        VkFormatFeatureFlags flags = format_props.linearTilingFeatures & format_features;
+        assert((0 != flags) && "Format is not supported for host visible images");
+    }
+    else {
+        VkFormatFeatureFlags flags = format_props.optimalTilingFeatures & format_features;
+        assert((0 != flags) && "Format is not supported for GPU local images (i.e. not host visible images)");
+    }
+    // Apply some bounds to the image
+    TINY_RENDERER_DECLARE_ZERO(VkImageFormatProperties, image_format_props);
+    VkResult vk_res = vkGetPhysicalDeviceImageFormatProperties(p_renderer->vk_active_gpu, create_info.format,
+        create_info.imageType, create_info.tiling, create_info.usage, create_info.flags, &image_format_props);
+    assert(VK_SUCCESS == vk_res);
+    if (create_info.mipLevels > 1) {
+        p_texture->mip_levels = tr_min(p_texture->mip_levels, image_format_props.maxMipLevels);
+        create_info.mipLevels = p_texture->mip_levels;
+    }
+    // Create image
+    vk_res = vkCreateImage(p_renderer->vk_device, &create_info, NULL, &(p_texture->vk_image));
+    assert(VK_SUCCESS == vk_res);
+
+    if (allocate_memory) {
+        TINY_RENDERER_DECLARE_ZERO(VkMemoryRequirements, mem_reqs);
+        vkGetImageMemoryRequirements(p_renderer->vk_device, p_texture->vk_image, &mem_reqs);
+
+        VkMemoryPropertyFlags mem_flags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        if (p_texture->host_visible) {
+            mem_flags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        }
+
+        // Host visible images use linear tiling and share blocks with buffers
+        bool linear = (VK_IMAGE_TILING_LINEAR == create_info.tiling);
+        tr_internal_vk_allocate_memory(p_renderer, &mem_reqs, mem_flags, linear, &(p_texture->vk_allocation));
+        p_texture->vk_memory = p_texture->vk_allocation.block->vk_memory;
+
+        vk_res = vkBindImageMemory(p_renderer->vk_device, p_texture->vk_image, p_texture->vk_memory, p_texture->vk_allocation.offset);
+        assert(VK_SUCCESS == vk_res);
+
+        if (p_texture->host_visible) {
+            assert(NULL != p_texture->vk_allocation.block->cpu_mapped_address);
+            p_texture->cpu_mapped_address = (uint8_t*)p_texture->vk_allocation.block->cpu_mapped_address + p_texture->vk_allocation.offset;
+        }
+    }
+
+    p_texture->owns_image = true;
+}
+
+void tr_internal_vk_create_texture(tr_renderer* p_renderer, tr_texture* p_texture)
+{
+    assert(VK_NULL_HANDLE != p_renderer->vk_device);
+
+    p_texture->renderer = p_renderer;
+
+    if (VK_NULL_HANDLE == p_texture->vk_image) {
+        tr_internal_vk_create_texture_image(p_renderer, p_texture, true);
+    }
+
+    // Create image view
+    {
+        VkImageViewType view_type = VK_IMAGE_VIEW_TYPE_2D;
+        switch (p_texture->type) {
+            case tr_texture_type_1d   : view_type = VK_IMAGE_VIEW_TYPE_1D;   break;
+            case tr_texture_type_2d   : view_type = VK_IMAGE_VIEW_TYPE_2D;   break;
+            case tr_texture_type_3d   : view_type = VK_IMAGE_VIEW_TYPE_3D;   break;
+            case tr_texture_type_cube : view_type = VK_IMAGE_VIEW_TYPE_CUBE; break;
+        }
+
+        TINY_RENDERER_DECLARE_ZERO(VkImageViewCreateInfo, create_info);
+        create_info.sType                           = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+        create_info.pNext                           = NULL;
+        create_info.flags                           = 0;
+        create_info.image                           = p_texture->vk_image;
+        create_info.viewType                        = view_type;
+        create_info.format                          = tr_util_to_vk_format(p_texture->format);
+        create_info.components.r                    = VK_COMPONENT_SWIZZLE_R;
+        create_info.components.g                    = VK_COMPONENT_SWIZZLE_G;
+        create_info.components.b                    = VK_COMPONENT_SWIZZLE_B;
+        create_info.components.a                    = VK_COMPONENT_SWIZZLE_A;
+        create_info.subresourceRange.aspectMask     = tr_util_vk_determine_aspect_mask(tr_util_to_vk_format(p_texture->format));
+        create_info.subresourceRange.baseMipLevel   = 0;
+        create_info.subresourceRange.levelCount     = p_texture->mip_levels;
+        create_info.subresourceRange.baseArrayLayer = 0;
+        create_info.subresourceRange.layerCount     = 1;
+        VkResult vk_res = vkCreateImageView(p_renderer->vk_device, &create_info, NULL, &(p_texture->vk_image_view));
+        assert(VK_SUCCESS == vk_res);
+
+        p_texture->vk_aspect_mask = create_info.subresourceRange.aspectMask;
+    }
+
+    p_texture->vk_texture_view.imageView = p_texture->vk_image_view;
+    p_texture->vk_texture_view.imageLayout = (p_texture->usage & tr_texture_usage_storage_image) ? VK_IMAGE_LAYOUT_GENERAL
+                                                                                                 : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    p_texture->serial = ++(p_renderer->resource_serial);
+}
+
+void tr_internal_vk_destroy_texture(tr_renderer* p_renderer, tr_texture* p_texture)
+{
+    assert(VK_NULL_HANDLE != p_renderer->vk_device);
+    assert(VK_NULL_HANDLE != p_texture->vk_image);
+    assert(VK_NULL_HANDLE != p_texture->vk_image_view);
+    if (p_texture->owns_image) {
+        assert(VK_NULL_HANDLE != p_texture->vk_memory);
+    }
+
+    if (VK_NULL_HANDLE != p_texture->vk_image_view) {
+        vkDestroyImageView(p_renderer->vk_device, p_texture->vk_image_view, NULL);
+    }
+
+    if ((VK_NULL_HANDLE != p_texture->vk_image) && (p_texture->owns_image)) {
+        vkDestroyImage(p_renderer->vk_device, p_texture->vk_image, NULL);
+    }
+
+    if (p_texture->owns_image) {
+        tr_internal_vk_free_memory(p_renderer, &(p_texture->vk_allocation));
+        p_texture->vk_memory = VK_NULL_HANDLE;
+    }
+}
+
+void tr_internal_vk_create_sampler(tr_renderer* p_renderer, tr_sampler* p_sampler)
+{
+    assert(VK_NULL_HANDLE != p_renderer->vk_device);
+
+    TINY_RENDERER_DECLARE_ZERO(VkSamplerCreateInfo, create_info);
+    create_info.sType                   = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    create_info.pNext                   = NULL;
+    create_info.flags                   = 0;
+    create_info.magFilter               = VK_FILTER_LINEAR;
+    create_info.minFilter               = VK_FILTER_LINEAR;
+    create_info.mipmapMode              = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    create_info.addressModeU            = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    create_info.addressModeV            = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    create_info.addressModeW            = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    create_info.mipLodBias              = 0.0f;
+    create_info.anisotropyEnable        = VK_FALSE;
+    create_info.maxAnisotropy           = 1.0f;
+    create_info.compareEnable           = VK_FALSE;
+    create_info.compareOp               = VK_COMPARE_OP_NEVER;
+    create_info.minLod                  = 0.0f;
+    create_info.maxLod                  = 0.0f;
+    create_info.borderColor             = VK_BORDER_COLOR_FLOAT_OPAQUE_BLACK;
+    create_info.unnormalizedCoordinates = VK_FALSE;
+    VkResult vk_res = vkCreateSampler(p_renderer->vk_device, &create_info, NULL, &(p_sampler->vk_sampler));
+    assert(VK_SUCCESS == vk_res);
+
+    p_sampler->vk_sampler_view.sampler = p_sampler->vk_sampler;
+    p_sampler->serial = ++(p_renderer->resource_serial);
+}
+
+void tr_internal_vk_destroy_sampler(tr_renderer* p_renderer, tr_sampler* p_sampler)
+{
+    assert(VK_NULL_HANDLE != p_renderer->vk_device);
+    assert(VK_NULL_HANDLE != p_sampler->vk_sampler);
+
+    vkDestroySampler(p_renderer->vk_device, p_sampler->vk_sampler, NULL);
+}
+
+void tr_internal_vk_create_shader_program(tr_renderer* p_renderer, uint32_t vert_size, const void* vert_code, const char* vert_enpt, uint32_t tesc_size, const void* tesc_code, const char* tesc_enpt, uint32_t tese_size, const void* tese_code, const char* tese_enpt, uint32_t geom_size, const void* geom_code, const char* geom_enpt, uint32_t frag_size, const void* frag_code, const char* frag_enpt, uint32_t comp_size, const void* comp_code, const char* comp_enpt, tr_shader_program* p_shader_program)
+{
+    assert(VK_NULL_HANDLE != p_renderer->vk_device);
+
+    for (uint32_t i = 0; i < tr_shader_stage_count; ++i) {
+        tr_shader_stage stage_mask = (tr_shader_stage)(1 << i);
+        if (stage_mask == (p_shader_program->shader_stages & stage_mask)) {
+            TINY_RENDERER_DECLARE_ZERO(VkShaderModuleCreateInfo, create_info);
+            create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+            create_info.pNext = NULL;
+            create_info.flags = 0;  
+            switch(stage_mask) {
+                case tr_shader_stage_vert: {
+                    create_info.codeSize = vert_size;
+                    create_info.pCode = (const uint32_t*)vert_code;                 
+                    VkResult vk_res = vkCreateShaderModule(p_renderer->vk_device, &create_info, NULL, &(p_shader_program->vk_vert));
+                    assert(VK_SUCCESS == vk_res);
+                } break;
+                case tr_shader_stage_tesc: {
+                    create_info.codeSize = tesc_size;
+                    create_info.pCode = (const uint32_t*)tesc_code;
+                    VkResult vk_res = vkCreateShaderModule(p_renderer->vk_device, &create_info, NULL, &(p_shader_program->vk_tesc));
+                    assert(VK_SUCCESS == vk_res);
+                } break;
+                case tr_shader_stage_tese: {
+                    create_info.codeSize = tese_size;
+                    create_info.pCode = (const uint32_t*)tese_code;
+                    VkResult vk_res = vkCreateShaderModule(p_renderer->vk_device, &create_info, NULL, &(p_shader_program->vk_tese));
+                    assert(VK_SUCCESS == vk_res);
+                } break;
+                case tr_shader_stage_geom: {
+                    create_info.codeSize = geom_size;
+                    create_info.pCode = (const uint32_t*)geom_code;
+                    VkResult vk_res = vkCreateShaderModule(p_renderer->vk_device, &create_info, NULL, &(p_shader_program->vk_geom));
+                    assert(VK_SUCCESS == vk_res);
+                } break;
+                case tr_shader_stage_frag: {
+                    create_info.codeSize = frag_size;
+                    create_info.pCode = (const uint32_t*)frag_code;
+                    VkResult vk_res = vkCreateShaderModule(p_renderer->vk_device, &create_info, NULL, &(p_shader_program->vk_frag));
+                    assert(VK_SUCCESS == vk_res);
+                } break;
+                case tr_shader_stage_comp: {
+                    create_info.codeSize = comp_size;
+                    create_info.pCode = (const uint32_t*)comp_code;
+                    VkResult vk_res = vkCreateShaderModule(p_renderer->vk_device, &create_info, NULL, &(p_shader_program->vk_comp));
+                    assert(VK_SUCCESS == vk_res);
+                } break;
+            }
+        }
+    }   
+}
+
+void tr_internal_vk_destroy_shader_program(tr_renderer* p_renderer, tr_shader_program* p_shader_program)
+{
+    assert(VK_NULL_HANDLE != p_renderer->vk_device);
+
+    if (VK_NULL_HANDLE != p_shader_program->vk_vert) {
+        vkDestroyShaderModule(p_renderer->vk_device, p_shader_program->vk_vert, NULL);
+    }
+
+    if (VK_NULL_HANDLE != p_shader_program->vk_tesc) {
+        vkDestroyShaderModule(p_renderer->vk_device, p_shader_program->vk_tesc, NULL);
+    }
+
+    if (VK_NULL_HANDLE != p_shader_program->vk_tese) {
+        vkDestroyShaderModule(p_renderer->vk_device, p_shader_program->vk_tese, NULL);
+    }
+
+    if (VK_NULL_HANDLE != p_shader_program->vk_geom) {
+        vkDestroyShaderModule(p_renderer->vk_device, p_shader_program->vk_geom, NULL);
+    }
+
+    if (VK_NULL_HANDLE != p_shader_program->vk_frag) {
+        vkDestroyShaderModule(p_renderer->vk_device, p_shader_program->vk_frag, NULL);
+    }
+}
+
+void tr_internal_vk_create_pipeline(tr_renderer* p_renderer, tr_shader_program* p_shader_program, const tr_vertex_layout* p_vertex_layout, tr_descriptor_set* p_descriptor_set, tr_render_target* p_render_target, const tr_pipeline_settings* p_pipeline_settings, tr_pipeline* p_pipeline)
+{
+    assert(VK_NULL_HANDLE != p_renderer->vk_device);
+    assert((VK_NULL_HANDLE != p_shader_program->vk_vert) || (VK_NULL_HANDLE != p_shader_program->vk_tesc) || (VK_NULL_HANDLE != p_shader_program->vk_tese) || (VK_NULL_HANDLE != p_shader_program->vk_geom) || (VK_NULL_HANDLE != p_shader_program->vk_frag));
+    assert(VK_NULL_HANDLE != p_render_target->vk_render_pass);
+
+    // Pipeline layout
+    {
+        TINY_RENDERER_DECLARE_ZERO(VkPipelineLayoutCreateInfo, create_info);
+        create_info.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        create_info.pNext                  = NULL;
+        create_info.flags                  = 0;
+        create_info.setLayoutCount         = (NULL != p_descriptor_set) ? 1 : 0;
+        create_info.pSetLayouts            = (NULL != p_descriptor_set) ? &(p_descriptor_set->vk_descriptor_set_layout) : NULL;
+        create_info.pushConstantRangeCount = 0;
+        create_info.pPushConstantRanges    = NULL;
+        VkResult vk_res = vkCreatePipelineLayout(p_renderer->vk_device, &create_info, NULL, &(p_pipeline->vk_pipeline_layout));
+        assert(VK_SUCCESS == vk_res);
+    }
+
+    // Pipeline
+    {
+        uint32_t stage_count = 0;
+        TINY_RENDERER_DECLARE_ZERO(VkPipelineShaderStageCreateInfo, stages[5]);
+        for (uint32_t i = 0; i < 5; ++i) {
+            tr_shader_stage stage_mask = (tr_shader_stage)(1 << i);
+            if (stage_mask == (p_shader_program->shader_stages & stage_mask)) {
+                stages[stage_count].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+                stages[stage_count].pNext = NULL;
+                stages[stage_count].flags = 0;
+                stages[stage_count].pSpecializationInfo = NULL;         
+                switch(stage_mask) {
+                    case tr_shader_stage_vert: {
+                        stages[stage_count].pName  = p_shader_program->vert_entry_point;
+                        stages[stage_count].stage  = VK_SHADER_STAGE_VERTEX_BIT; 
+                        stages[stage_count].module = p_shader_program->vk_vert;
+                    } break;
+                    case tr_shader_stage_tesc: {
+                        stages[stage_count].pName  = p_shader_program->tesc_entry_point;
+                        stages[stage_count].stage = VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT; 
+                        stages[stage_count].module = p_shader_program->vk_tesc;
+                    } break;
+                    case tr_shader_stage_tese: {
+                        stages[stage_count].pName  = p_shader_program->tese_entry_point;
+                        stages[stage_count].stage = VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+                        stages[stage_count].module = p_shader_program->vk_tese;
+                    } break;
+                    case tr_shader_stage_geom: {
+                        stages[stage_count].pName  = p_shader_program->geom_entry_point;
+                        stages[stage_count].stage = VK_SHADER_STAGE_GEOMETRY_BIT; 
+                        stages[stage_count].module = p_shader_program->vk_geom;
+                    } break;
+                    case tr_shader_stage_frag: {
+                        stages[stage_count].pName  = p_shader_program->frag_entry_point;
+                        stages[stage_count].stage = VK_SHADER_STAGE_FRAGMENT_BIT; 
+                        stages[stage_count].module = p_shader_program->vk_frag;
+                    } break;
+                }
+                ++stage_count;
+            }
+        }
+
+        // Make sure there's a shader
+        assert(0 != stage_count);
+        
+        // Make sure there's attributes
+        assert(0 != p_vertex_layout->attrib_count);
+
+        uint32_t input_binding_count = 0;
+        VkVertexInputBindingDescription input_bindings[tr_max_vertex_bindings] = {0};
+        uint32_t input_attribute_count = 0;
+        VkVertexInputAttributeDescription input_attributes[tr_max_vertex_attribs] = {0};
+        // Ignore everything that's beyond tr_max_vertex_attribs
+        uint32_t attrib_count = p_vertex_layout->attrib_count > tr_max_vertex_attribs ? tr_max_vertex_attribs : p_vertex_layout->attrib_count;
+        // Initial values
+        uint32_t binding_value = UINT32_MAX;
+        for (uint32_t i = 0; i < attrib_count; ++i) {
+            const tr_vertex_attrib* attrib = &(p_vertex_layout->attribs[i]);
+            if (binding_value != attrib->binding) {
+                binding_value = attrib->binding;
+                ++input_binding_count;
+            }
+
+            input_bindings[input_binding_count - 1].binding = binding_value;
+            input_bindings[input_binding_count - 1].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+            input_bindings[input_binding_count - 1].stride += tr_util_format_stride(attrib->format);
+            
+            input_attributes[input_attribute_count].location = attrib->location;
+            input_attributes[input_attribute_count].binding  = attrib->binding;
+            input_attributes[input_attribute_count].format   = tr_util_to_vk_format(attrib->format);
+            input_attributes[input_attribute_count].offset   = attrib->offset;
+            ++input_attribute_count;
+        }
+        
+        TINY_RENDERER_DECLARE_ZERO(VkPipelineVertexInputStateCreateInfo, vi);
+        vi.sType                                    = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        vi.pNext                                    = NULL;
+        vi.flags                                    = 0;
+        vi.vertexBindingDescriptionCount            = input_binding_count;
+        vi.pVertexBindingDescriptions               = input_bindings;
+        vi.vertexAttributeDescriptionCount          = input_attribute_count;
+        vi.pVertexAttributeDescriptions             = input_attributes;
+                                                
+        VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        switch(p_pipeline_settings->primitive_topo) {
+            case tr_primitive_topo_point_list : topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST; break;
+            case tr_primitive_topo_line_list  : topology = VK_PRIMITIVE_TOPOLOGY_LINE_LIST; break;
+            case tr_primitive_topo_line_strip : topology = VK_PRIMITIVE_TOPOLOGY_LINE_STRIP; break;
+            case tr_primitive_topo_tri_strip  : topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP; break;
+            case tr_primitive_topo_tri_fan    : topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_FAN; break;
+        }
+        TINY_RENDERER_DECLARE_ZERO(VkPipelineInputAssemblyStateCreateInfo, ia);
+        ia.sType                                    = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+        ia.pNext                                    = NULL;
+        ia.flags                                    = 0;
+        ia.topology                                 = topology;
+        ia.primitiveRestartEnable                   = VK_FALSE;
+
+        TINY_RENDERER_DECLARE_ZERO(VkPipelineTessellationStateCreateInfo, ts);
+        ts.sType                                    = VK_STRUCTURE_TYPE_PIPELINE_TESSELLATION_STATE_CREATE_INFO;
+        ts.pNext                                    = NULL;
+        ts.flags                                    = 0;
+        ts.patchControlPoints                       = 1;
+
+        TINY_RENDERER_DECLARE_ZERO(VkPipelineViewportStateCreateInfo, vs);
+        vs.sType                                    = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+        vs.pNext                                    = NULL;
+        vs.flags                                    = 0;
+        vs.viewportCount                            = 0;
+        vs.pViewports                               = NULL;
+        vs.scissorCount                             = 0;
+        vs.pScissors                                = NULL;
+
+        VkCullModeFlags cull_mode = VK_CULL_MODE_NONE;
+        switch(p_pipeline_settings->cull_mode) {
+            case tr_cull_mode_back  : cull_mode = VK_CULL_MODE_BACK_BIT; break;
+            case tr_cull_mode_front : cull_mode = VK_CULL_MODE_FRONT_BIT; break;
+            case tr_cull_mode_both  : cull_mode = VK_CULL_MODE_FRONT_AND_BACK; break;
+        }
+        VkFrontFace front_face = (tr_fornt_face_cw == p_pipeline_settings->front_face) ? VK_FRONT_FACE_CLOCKWISE : VK_FRONT_FACE_COUNTER_CLOCKWISE;
+        TINY_RENDERER_DECLARE_ZERO(VkPipelineRasterizationStateCreateInfo, rs);
+        rs.sType                                    = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+        rs.pNext                                    = NULL;
+        rs.flags                                    = 0;
+        rs.depthClampEnable                         = VK_FALSE;
+        rs.rasterizerDiscardEnable                  = VK_FALSE;
+        rs.polygonMode                              = VK_POLYGON_MODE_FILL;
+        rs.cullMode                                 = cull_mode;
+        rs.frontFace                                = front_face;
+        rs.depthBiasEnable                          = VK_FALSE;
+        rs.depthBiasConstantFactor                  = 0.0f;
+        rs.depthBiasClamp                           = 0.0f;
+        rs.depthBiasSlopeFactor                     = 0.0f;
+        rs.lineWidth                                = 1.0f;
+
+        TINY_RENDERER_DECLARE_ZERO(VkPipelineMultisampleStateCreateInfo, ms);
+        ms.sType                                    = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+        ms.pNext                                    = NULL;
+        ms.flags                                    = 0;
+        ms.rasterizationSamples                     = tr_util_to_vk_sample_count(p_render_target->sample_count);
+        ms.sampleShadingEnable                      = VK_FALSE;
+        ms.minSampleShading                         = 0.0f;
+        ms.pSampleMask                              = 0;
+        ms.alphaToCoverageEnable                    = VK_FALSE;
+        ms.alphaToOneEnable                         = VK_FALSE;
+
+        TINY_RENDERER_DECLARE_ZERO(VkPipelineDepthStencilStateCreateInfo, ds);
+        ds.sType                                    = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+        ds.pNext                                    = NULL;
+        ds.flags                                    = 0;
+        ds.depthTestEnable                          = p_pipeline_settings->depth_test ? VK_TRUE : VK_FALSE;
+        ds.depthWriteEnable                         = p_pipeline_settings->depth_write ? VK_TRUE : VK_FALSE;
+        ds.depthCompareOp                           = VK_COMPARE_OP_LESS_OR_EQUAL; // @TODO: Add more depth funcs
+        ds.depthBoundsTestEnable                    = VK_FALSE;
+        ds.stencilTestEnable                        = VK_FALSE;
+        ds.front.failOp                             = VK_STENCIL_OP_KEEP;
+        ds.front.passOp                             = VK_STENCIL_OP_KEEP;
+        ds.front.depthFailOp                        = VK_STENCIL_OP_KEEP;
+        ds.front.compareOp                          = VK_COMPARE_OP_NEVER; 
+        ds.front.compareMask                        = 0;
+        ds.front.writeMask                          = 0;
+        ds.front.reference                          = 0;
+        ds.back.failOp                              = VK_STENCIL_OP_KEEP;
+        ds.back.passOp                              = VK_STENCIL_OP_KEEP;
+        ds.back.depthFailOp                         = VK_STENCIL_OP_KEEP;
+        ds.back.compareOp                           = VK_COMPARE_OP_NEVER; 
+        ds.back.compareMask                         = 0;
+        ds.back.writeMask                           = 0;
+        ds.back.reference                           = 0;
+        ds.minDepthBounds                           = 0.0f;
+        ds.maxDepthBounds                           = 0.0;
+
+        TINY_RENDERER_DECLARE_ZERO(VkPipelineColorBlendAttachmentState, cbas);
+        cbas.colorWriteMask                         = 0xf;
+        cbas.blendEnable                            = VK_FALSE;
+        cbas.alphaBlendOp                           = VK_BLEND_OP_ADD;
+        cbas.colorBlendOp                           = VK_BLEND_OP_ADD;
+        cbas.srcColorBlendFactor                    = VK_BLEND_FACTOR_ZERO;
+        cbas.dstColorBlendFactor                    = VK_BLEND_FACTOR_ZERO;
+        cbas.srcAlphaBlendFactor                    = VK_BLEND_FACTOR_ZERO;
+        cbas.dstAlphaBlendFactor                    = VK_BLEND_FACTOR_ZERO;
+        TINY_RENDERER_DECLARE_ZERO(VkPipelineColorBlendStateCreateInfo, cb);
+        cb.sType                                    = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+        cb.pNext                                    = NULL;
+        cb.flags                                    = 0;
+        cb.logicOpEnable                            = VK_FALSE;
+        cb.logicOp                                  = VK_LOGIC_OP_NO_OP;
+        cb.attachmentCount                          = 1;
+        cb.pAttachments                             = &cbas;
+        cb.blendConstants[0]                        = 0.0f;
+        cb.blendConstants[1]                        = 0.0f;
+        cb.blendConstants[2]                        = 0.0f;
+        cb.blendConstants[3]                        = 0.0f;
+
+        TINY_RENDERER_DECLARE_ZERO(VkDynamicState, dyn_states[9]);
+        dyn_states[0]                               = VK_DYNAMIC_STATE_VIEWPORT;
+        dyn_states[1]                               = VK_DYNAMIC_STATE_SCISSOR;
+        dyn_states[2]                               = VK_DYNAMIC_STATE_LINE_WIDTH;
+        dyn_states[3]                               = VK_DYNAMIC_STATE_DEPTH_BIAS;
+        dyn_states[4]                               = VK_DYNAMIC_STATE_BLEND_CONSTANTS;
+        dyn_states[5]                               = VK_DYNAMIC_STATE_DEPTH_BOUNDS;
+        dyn_states[6]                               = VK_DYNAMIC_STATE_STENCIL_COMPARE_MASK;
+        dyn_states[7]                               = VK_DYNAMIC_STATE_STENCIL_WRITE_MASK;
+        dyn_states[8]                               = VK_DYNAMIC_STATE_STENCIL_REFERENCE;
+        TINY_RENDERER_DECLARE_ZERO(VkPipelineDynamicStateCreateInfo, dy);
+        dy.sType                                    = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+        dy.pNext                                    = NULL;
+        dy.flags                                    = 0;
+        dy.dynamicStateCount                        = 9;
+        dy.pDynamicStates                           = dyn_states;
+
+        TINY_RENDERER_DECLARE_ZERO(VkGraphicsPipelineCreateInfo, create_info);
+        create_info.sType                           = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        create_info.pNext                           = NULL;
+        create_info.flags                           = 0;
+        create_info.stageCount                      = stage_count;
+        create_info.pStages                         = stages;
+        create_info.pVertexInputState               = &vi;
+        create_info.pInputAssemblyState             = &ia;
+        create_info.pTessellationState              = &ts;
+        create_info.pViewportState                  = &vs;
+        create_info.pRasterizationState             = &rs;
+        create_info.pMultisampleState               = &ms;
+        create_info.pDepthStencilState              = &ds;
+        create_info.pColorBlendState                = &cb;
+        create_info.pDynamicState                   = &dy;
+        create_info.layout                          = p_pipeline->vk_pipeline_layout;
+        create_info.renderPass                      = p_render_target->vk_render_pass;
+        create_info.subpass                         = 0;
+        create_info.basePipelineHandle              = VK_NULL_HANDLE;
+        create_info.basePipelineIndex               = -1;
+        VkResult vk_res = vkCreateGraphicsPipelines(p_renderer->vk_device, p_renderer->vk_pipeline_cache, 1, &create_info, NULL, &(p_pipeline->vk_pipeline));
+        assert(VK_SUCCESS == vk_res);
+    }
+}
+
+void tr_internal_vk_create_compute_pipeline(tr_renderer* p_renderer, tr_shader_program* p_shader_program, tr_descriptor_set* p_descriptor_set, const tr_pipeline_settings* p_pipeline_settings, tr_pipeline* p_pipeline)
+{
+    assert(p_renderer->vk_device != VK_NULL_HANDLE);
+    assert(p_shader_program->vk_comp != VK_NULL_HANDLE);
+
+    // Pipeline layout
+    {
+        TINY_RENDERER_DECLARE_ZERO(VkPipelineLayoutCreateInfo, create_info);
+        create_info.sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        create_info.pNext                  = NULL;
+        create_info.flags                  = 0;
+        create_info.setLayoutCount         = (NULL != p_descriptor_set) ? 1 : 0;
+        create_info.pSetLayouts            = (NULL != p_descriptor_set) ? &(p_descriptor_set->vk_descriptor_set_layout) : NULL;
+        create_info.pushConstantRangeCount = 0;
+        create_info.pPushConstantRanges    = NULL;
+        VkResult vk_res = vkCreatePipelineLayout(p_renderer->vk_device, &create_info, NULL, &(p_pipeline->vk_pipeline_layout));
+        assert(VK_SUCCESS == vk_res);
+    }
+
+    // Pipeline
+    {
+      TINY_RENDERER_DECLARE_ZERO(VkPipelineShaderStageCreateInfo , stage);
+      stage.sType               = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+      stage.pNext               = NULL;
+      stage.flags               = 0;
+      stage.stage               = VK_SHADER_STAGE_COMPUTE_BIT;
+      stage.module              = p_shader_program->vk_comp;
+      stage.pName               = p_shader_program->comp_entry_point;
+      stage.pSpecializationInfo = NULL;  
+
+      TINY_RENDERER_DECLARE_ZERO(VkComputePipelineCreateInfo, create_info);
+      create_info.sType               = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+      create_info.pNext               = NULL;
+      create_info.flags               = 0;
+      create_info.stage               = stage;
+      create_info.layout              = p_pipeline->vk_pipeline_layout;
+      create_info.basePipelineHandle  = 0;
+      create_info.basePipelineIndex   = 0;
+      VkResult vk_res = vkCreateComputePipelines(p_renderer->vk_device, p_renderer->vk_pipeline_cache, 1, &create_info, NULL, &(p_pipeline->vk_pipeline));
+      assert(VK_SUCCESS == vk_res);
+    }
+}
+
+void tr_internal_vk_destroy_pipeline(tr_renderer* p_renderer, tr_pipeline* p_pipeline)
+{
+    assert(VK_NULL_HANDLE != p_renderer->vk_device);
+    assert(VK_NULL_HANDLE != p_pipeline->vk_pipeline);
+    assert(VK_NULL_HANDLE != p_pipeline->vk_pipeline_layout);
+
+    vkDestroyPipeline(p_renderer->vk_device, p_pipeline->vk_pipeline, NULL);
+    vkDestroyPipelineLayout(p_renderer->vk_device, p_pipeline->vk_pipeline_layout, NULL);
+}
+
+void tr_internal_vk_create_render_pass(tr_renderer* p_renderer, bool is_swapchain, tr_render_target* p_render_target)
+{
+    assert(VK_NULL_HANDLE != p_renderer->vk_device);
+
+    uint32_t color_attachment_count = p_render_target->color_attachment_count;
+    uint32_t depth_stencil_attachment_count = (tr_format_undefined != p_render_target->depth_stencil_format) ? 1 : 0;
+
+    VkAttachmentDescription* attachments = NULL;
+    VkAttachmentReference* color_attachment_refs = NULL;
+    VkAttachmentReference* resolve_attachment_refs = NULL;
+    VkAttachmentReference* depth_stencil_attachment_ref = NULL;
+
+    // Fill out attachment descriptions and references
+    if (p_render_target->sample_count > tr_sample_count_1) {
+        attachments = (VkAttachmentDescription*)calloc((2 * color_attachment_count) + depth_stencil_attachment_count, sizeof(*attachments));
+        assert(NULL != attachments);
+
+        if (color_attachment_count > 0) {
+            color_attachment_refs = (VkAttachmentReference*)calloc(color_attachment_count, sizeof(*color_attachment_refs));
+            assert(NULL != color_attachment_refs);
+            
+            resolve_attachment_refs = (VkAttachmentReference*)calloc(color_attachment_count, sizeof(*resolve_attachment_refs));
+            assert(NULL != resolve_attachment_refs);
+        }
+        if (depth_stencil_attachment_count > 0) {
+            depth_stencil_attachment_ref = (VkAttachmentReference*)calloc(1, sizeof(*depth_stencil_attachment_ref));
+            assert(NULL != depth_stencil_attachment_ref);
+        }
+
+        // Color
+        for (uint32_t i = 0; i < color_attachment_count; ++i) {
+            const uint32_t ssidx = 2*i;
+            const uint32_t msidx = ssidx + 1;
+
+            // descriptions
+            attachments[ssidx].flags          = 0;
+            attachments[ssidx].format         = tr_util_to_vk_format(p_render_target->color_format);
+            attachments[ssidx].samples        = tr_util_to_vk_sample_count(tr_sample_count_1);
+            attachments[ssidx].loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            attachments[ssidx].storeOp        = VK_ATTACHMENT_STORE_OP_STORE;
+            attachments[ssidx].stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            attachments[ssidx].stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
+            attachments[ssidx].initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED;
+            attachments[ssidx].finalLayout    = is_swapchain ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+            attachments[msidx].flags          = 0;
+            attachments[msidx].format         = tr_util_to_vk_format(p_render_target->color_format);
+            attachments[msidx].samples        = tr_util_to_vk_sample_count(p_render_target->sample_count);
+            attachments[msidx].loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            attachments[msidx].storeOp        = VK_ATTACHMENT_STORE_OP_STORE;
+            attachments[msidx].stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            attachments[msidx].stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
+            attachments[msidx].initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED;
+            attachments[msidx].finalLayout    = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+            // references
+            color_attachment_refs[i].attachment   = msidx;
+            color_attachment_refs[i].layout       = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            resolve_attachment_refs[i].attachment = ssidx;
+            resolve_attachment_refs[i].layout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        }
+
+        // Depth stencil
+        if (depth_stencil_attachment_count > 0) {
+            uint32_t idx = (2 * color_attachment_count);
+            attachments[idx].flags          = 0;
+            attachments[idx].format         = tr_util_to_vk_format(p_render_target->depth_stencil_format);
+            attachments[idx].samples        = tr_util_to_vk_sample_count(p_render_target->sample_count);
+            attachments[idx].loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            attachments[idx].storeOp        = VK_ATTACHMENT_STORE_OP_STORE;
+            attachments[idx].stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            attachments[idx].stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
+            attachments[idx].initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED;
+            attachments[idx].finalLayout    = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            depth_stencil_attachment_ref[0].attachment = idx;
+            depth_stencil_attachment_ref[0].layout     = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        }
+    }
+    else {
+        attachments = (VkAttachmentDescription*)calloc(color_attachment_count + depth_stencil_attachment_count, sizeof(*attachments));
+        assert(NULL != attachments);
+        
+        if (color_attachment_count > 0) {
+            color_attachment_refs = (VkAttachmentReference*)calloc(color_attachment_count, sizeof(*color_attachment_refs));
             assert(NULL != color_attachment_refs);
+        }
+        if (depth_stencil_attachment_count > 0) {
+            depth_stencil_attachment_ref = (VkAttachmentReference*)calloc(1, sizeof(*depth_stencil_attachment_ref));
+            assert(NULL != depth_stencil_attachment_ref);
+        }
+
+        // Color
+        for (uint32_t i = 0; i < color_attachment_count; ++i) {
+            const uint32_t ssidx = i;
+
+            // descriptions
+            attachments[ssidx].flags          = 0;
+            attachments[ssidx].format         = tr_util_to_vk_format(p_render_target->color_format);
+            attachments[ssidx].samples        = tr_util_to_vk_sample_count(tr_sample_count_1);
+            attachments[ssidx].loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            attachments[ssidx].storeOp        = VK_ATTACHMENT_STORE_OP_STORE;
+            attachments[ssidx].stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            attachments[ssidx].stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
+            attachments[ssidx].initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED;
+            attachments[ssidx].finalLayout    = is_swapchain ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+            // references
+            color_attachment_refs[i].attachment = ssidx;
+            color_attachment_refs[i].layout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        }
+
+        // Depth stencil
+        if (depth_stencil_attachment_count > 0) {
+            uint32_t idx = color_attachment_count;
+            attachments[idx].flags          = 0;
+            attachments[idx].format         = tr_util_to_vk_format(p_render_target->depth_stencil_format);
+            attachments[idx].samples        = tr_util_to_vk_sample_count(p_render_target->sample_count);
+            attachments[idx].loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            attachments[idx].storeOp        = VK_ATTACHMENT_STORE_OP_STORE;
+            attachments[idx].stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_CLEAR;
+            attachments[idx].stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
+            attachments[idx].initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED;
+            attachments[idx].finalLayout    = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            depth_stencil_attachment_ref[0].attachment = idx;
+            depth_stencil_attachment_ref[0].layout     = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        }
+    }
             
-            resolve_attachment_refs = (VkAttachmentReference*)calloc(color_attachment_count, sizeof(*resolve_attachment_refs));
-            assert(NULL != resolve_attachment_refs);
+    TINY_RENDERER_DECLARE_ZERO(VkSubpassDescription, subpass);
+    subpass.flags                   = 0;
+    subpass.pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.inputAttachmentCount    = 0;
+    subpass.pInputAttachments       = NULL;
+    subpass.colorAttachmentCount    = color_attachment_count;
+    subpass.pColorAttachments       = color_attachment_refs;
+    subpass.pResolveAttachments     = resolve_attachment_refs;
+    subpass.pDepthStencilAttachment = depth_stencil_attachment_ref;
+    subpass.preserveAttachmentCount = 0;
+    subpass.pPreserveAttachments    = NULL;
+
+    // Create self-dependency in case image or memory barrier is issued within subpass
+    TINY_RENDERER_DECLARE_ZERO(VkSubpassDependency, subpass_dependency);
+    subpass_dependency.srcSubpass      = 0;
+    subpass_dependency.dstSubpass      = 0;
+    subpass_dependency.srcStageMask    = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    subpass_dependency.dstStageMask    = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    subpass_dependency.srcAccessMask   = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    subpass_dependency.dstAccessMask   = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    subpass_dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+    uint32_t attachment_count = (p_render_target->sample_count > tr_sample_count_1) ?  (2 * color_attachment_count) : color_attachment_count;
+    attachment_count += depth_stencil_attachment_count;
+
+    TINY_RENDERER_DECLARE_ZERO(VkRenderPassCreateInfo, create_info);
+    create_info.sType           = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    create_info.pNext           = NULL;
+    create_info.flags           = 0;
+    create_info.attachmentCount = attachment_count;
+    create_info.pAttachments    = attachments;
+    create_info.subpassCount    = 1;
+    create_info.pSubpasses      = &subpass;
+    create_info.dependencyCount = 1;
+    create_info.pDependencies   = &subpass_dependency;
+    
+    VkResult vk_res = vkCreateRenderPass(p_renderer->vk_device, &create_info, NULL, &(p_render_target->vk_render_pass));
+    assert(VK_SUCCESS == vk_res);
+
+    TINY_RENDERER_SAFE_FREE(attachments);
+    TINY_RENDERER_SAFE_FREE(color_attachment_refs);
+    TINY_RENDERER_SAFE_FREE(resolve_attachment_refs);
+    TINY_RENDERER_SAFE_FREE(depth_stencil_attachment_ref);
+}
+
+void tr_internal_vk_create_framebuffer(tr_renderer* p_renderer, tr_render_target* p_render_target)
+{
+    assert(VK_NULL_HANDLE != p_renderer->vk_device);
+    assert(VK_NULL_HANDLE != p_render_target->vk_render_pass);
+
+    uint32_t attachment_count = p_render_target->color_attachment_count;
+    if (p_render_target->sample_count > tr_sample_count_1) {
+        attachment_count *= 2;
+    }
+    if (tr_format_undefined != p_render_target->depth_stencil_format) {
+        attachment_count += 1;
+    }
+
+    VkImageView* attachments = (VkImageView*)calloc(attachment_count, sizeof(*attachments));
+    assert(NULL != attachments);
+
+    VkImageView* iter_attachments = attachments;
+    // Color
+    for (uint32_t i = 0; i < p_render_target->color_attachment_count; ++i) {
+        *iter_attachments = p_render_target->color_attachments[i]->vk_image_view;
+        ++iter_attachments;
+        if (p_render_target->sample_count > tr_sample_count_1) {
+            *iter_attachments = p_render_target->color_attachments_multisample[i]->vk_image_view;
+            ++iter_attachments;
+        }
+    }
+    // Depth/stencil
+    if (tr_format_undefined != p_render_target->depth_stencil_format) {
+        *iter_attachments = p_render_target->depth_stencil_attachment->vk_image_view;
+        ++iter_attachments;
+    }
+
+    TINY_RENDERER_DECLARE_ZERO(VkFramebufferCreateInfo, create_info);
+    create_info.sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    create_info.pNext           = NULL;
+    create_info.flags           = 0;
+    create_info.renderPass      = p_render_target->vk_render_pass;
+    create_info.attachmentCount = attachment_count;
+    create_info.pAttachments    = attachments;
+    create_info.width           = p_render_target->width;;
+    create_info.height          = p_render_target->height;
+    create_info.layers          = 1;
+    VkResult vk_res = vkCreateFramebuffer(p_renderer->vk_device, &create_info, NULL, &(p_render_target->vk_framebuffer));
+    assert(VK_SUCCESS == vk_res);
+
+    TINY_RENDERER_SAFE_FREE(attachments);
+}
+
+void tr_internal_vk_create_render_target(tr_renderer* p_renderer, bool is_swapchain, tr_render_target* p_render_target)
+{
+    tr_internal_vk_create_render_pass(p_renderer, is_swapchain, p_render_target);
+    tr_internal_vk_create_framebuffer(p_renderer, p_render_target);
+}
+
+void tr_internal_vk_destroy_render_target(tr_renderer* p_renderer, tr_render_target* p_render_target)
+{
+    assert(VK_NULL_HANDLE != p_renderer->vk_device);
+    assert(VK_NULL_HANDLE != p_render_target->vk_render_pass);
+
+    vkDestroyFramebuffer(p_renderer->vk_device, p_render_target->vk_framebuffer, NULL);
+    vkDestroyRenderPass(p_renderer->vk_device, p_render_target->vk_render_pass, NULL);
+}
+
+// -------------------------------------------------------------------------------------------------
+// Internal descriptor set functions
+// -------------------------------------------------------------------------------------------------
+// Points at the info of the resource currently in the descriptor, NULL if the slot is empty
+static const void* tr_internal_vk_descriptor_source_info(const tr_descriptor* p_descriptor, uint32_t index, uint64_t* p_serial)
+{
+    switch (p_descriptor->type) {
+        case tr_descriptor_type_sampler: {
+            const tr_sampler* p_sampler = p_descriptor->samplers[index];
+            *p_serial = (NULL != p_sampler) ? p_sampler->serial : 0;
+            return (NULL != p_sampler) ? (const void*)&(p_sampler->vk_sampler_view) : NULL;
+        }
+        break;
+
+        case tr_descriptor_type_uniform_buffer_cbv: {
+            const tr_buffer* p_buffer = p_descriptor->uniform_buffers[index];
+            *p_serial = (NULL != p_buffer) ? p_buffer->serial : 0;
+            return (NULL != p_buffer) ? (const void*)&(p_buffer->vk_buffer_info) : NULL;
+        }
+        break;
+
+        case tr_descriptor_type_storage_buffer_srv:
+        case tr_descriptor_type_storage_buffer_uav: {
+            const tr_buffer* p_buffer = p_descriptor->buffers[index];
+            *p_serial = (NULL != p_buffer) ? p_buffer->serial : 0;
+            return (NULL != p_buffer) ? (const void*)&(p_buffer->vk_buffer_info) : NULL;
+        }
+        break;
+
+        case tr_descriptor_type_uniform_texel_buffer_srv:
+        case tr_descriptor_type_storage_texel_buffer_uav: {
+            const tr_buffer* p_buffer = p_descriptor->buffers[index];
+            *p_serial = (NULL != p_buffer) ? p_buffer->serial : 0;
+            return (NULL != p_buffer) ? (const void*)&(p_buffer->vk_buffer_view) : NULL;
+        }
+        break;
+
+        case tr_descriptor_type_texture_srv:
+        case tr_descriptor_type_texture_uav: {
+            const tr_texture* p_texture = p_descriptor->textures[index];
+            *p_serial = (NULL != p_texture) ? p_texture->serial : 0;
+            return (NULL != p_texture) ? (const void*)&(p_texture->vk_texture_view) : NULL;
+        }
+        break;
+
+        default: break;
+    }
+    return NULL;
+}
+
+static bool tr_internal_vk_descriptor_info_is_empty(const uint8_t* p_info, uint32_t size)
+{
+    for (uint32_t i = 0; i < size; ++i) {
+        if (0 != p_info[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Adds a write for elements [first, last] of a binding, the infos come straight from the set's descriptor data
+static void tr_internal_vk_add_descriptor_write(tr_renderer* p_renderer, tr_descriptor_set* p_descriptor_set, uint32_t binding_index, uint32_t first, uint32_t last, VkWriteDescriptorSet* writes, uint32_t* p_write_count)
+{
+    if (tr_max_descriptors == *p_write_count) {
+        vkUpdateDescriptorSets(p_renderer->vk_device, *p_write_count, writes, 0, NULL);
+        *p_write_count = 0;
+    }
+
+    const tr_descriptor_layout* p_layout = p_descriptor_set->layout;
+    const VkDescriptorSetLayoutBinding* p_binding = &(p_layout->bindings[binding_index]);
+    uint32_t info_size = tr_internal_vk_descriptor_info_size(p_binding->descriptorType);
+    const uint8_t* p_infos = p_descriptor_set->descriptor_data + p_layout->binding_data_offsets[binding_index] + (first * info_size);
+
+    VkWriteDescriptorSet* p_write = &(writes[*p_write_count]);
+    memset(p_write, 0, sizeof(*p_write));
+    p_write->sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    p_write->pNext           = NULL;
+    p_write->dstSet          = p_descriptor_set->vk_descriptor_set;
+    p_write->dstBinding      = p_binding->binding;
+    p_write->dstArrayElement = first;
+    p_write->descriptorCount = last - first + 1;
+    p_write->descriptorType  = p_binding->descriptorType;
+    switch (p_binding->descriptorType) {
+        case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER   :
+        case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER   : p_write->pTexelBufferView = (const VkBufferView*)p_infos; break;
+        case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER         :
+        case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER         :
+        case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC :
+        case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC : p_write->pBufferInfo = (const VkDescriptorBufferInfo*)p_infos; break;
+        default                                        : p_write->pImageInfo = (const VkDescriptorImageInfo*)p_infos; break;
+    }
+    *p_write_count += 1;
+}
+
+void tr_internal_vk_update_descriptor_set(tr_renderer* p_renderer, tr_descriptor_set* p_descriptor_set)
+{
+    assert(VK_NULL_HANDLE != p_renderer->vk_device);
+    assert(VK_NULL_HANDLE != p_descriptor_set->vk_descriptor_set);
+    assert(NULL != p_descriptor_set->layout);
+    assert(NULL != p_descriptor_set->descriptor_data);
+
+    const tr_descriptor_layout* p_layout = p_descriptor_set->layout;
+    assert(p_layout->binding_count == p_descriptor_set->descriptor_count);
+
+    // Copy the current infos over the last written ones and write runs of changed elements.
+    // A run can span unchanged elements but ends at one that has never been written.
+    uint32_t write_count = 0;
+    uint32_t element_base = 0;
+    TINY_RENDERER_DECLARE_ZERO(VkWriteDescriptorSet, writes[tr_max_descriptors]);
+    for (uint32_t descriptor_index = 0; descriptor_index < p_descriptor_set->descriptor_count; ++descriptor_index) {
+        const tr_descriptor* descriptor = &(p_descriptor_set->descriptors[descriptor_index]);
+        uint32_t info_size = tr_internal_vk_descriptor_info_size(p_layout->bindings[descriptor_index].descriptorType);
+        uint8_t* p_infos = p_descriptor_set->descriptor_data + p_layout->binding_data_offsets[descriptor_index];
+
+        uint32_t run_first = UINT32_MAX;
+        uint32_t run_last = 0;
+        for (uint32_t i = 0; i < descriptor->count; ++i) {
+            uint8_t* p_info = p_infos + (i * info_size);
+            uint64_t* p_serial = &(p_descriptor_set->descriptor_serials[element_base + i]);
+            uint64_t serial = 0;
+            const void* p_source = tr_internal_vk_descriptor_source_info(descriptor, i, &serial);
+            bool empty = tr_internal_vk_descriptor_info_is_empty(p_info, info_size);
+            // A recreated resource can come back with the same handles, its serial is new though
+            if ((NULL != p_source) && ((serial != *p_serial) || (0 != memcmp(p_info, p_source, info_size)))) {
+                memcpy(p_info, p_source, info_size);
+                *p_serial = serial;
+                if (empty) {
+                    p_descriptor_set->unwritten_count -= 1;
+                    empty = false;
+                }
+                run_first = (UINT32_MAX == run_first) ? i : run_first;
+                run_last = i;
+            }
+            else if (empty && (UINT32_MAX != run_first)) {
+                tr_internal_vk_add_descriptor_write(p_renderer, p_descriptor_set, descriptor_index, run_first, run_last, writes, &write_count);
+                run_first = UINT32_MAX;
+            }
+        }
+        if (UINT32_MAX != run_first) {
+            tr_internal_vk_add_descriptor_write(p_renderer, p_descriptor_set, descriptor_index, run_first, run_last, writes, &write_count);
+        }
+        element_base += descriptor->count;
+    }
+
+    // Bail if there's nothing to write
+    if (0 == write_count) {
+        return;
+    }
+
+    // The template writes every element of the set, it needs all of them to be valid
+    if ((VK_NULL_HANDLE != p_layout->vk_descriptor_update_template) && (0 == p_descriptor_set->unwritten_count)) {
+        p_renderer->vk_update_descriptor_set_with_template(p_renderer->vk_device, p_descriptor_set->vk_descriptor_set, p_layout->vk_descriptor_update_template, p_descriptor_set->descriptor_data);
+    }
+    else {
+        vkUpdateDescriptorSets(p_renderer->vk_device, write_count, writes, 0, NULL);
+    }
+}
+
+// -------------------------------------------------------------------------------------------------
+// Internal command buffer functions
+// -------------------------------------------------------------------------------------------------
+// Statistics every pipeline statistics pool counts, secondaries inherit the same set
+static const VkQueryPipelineStatisticFlags tr_internal_vk_pipeline_statistics =
+    VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT   |
+    VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+void tr_internal_vk_begin_cmd(tr_cmd* p_cmd, tr_render_target* p_render_target)
+{
+    assert(VK_NULL_HANDLE != p_cmd->vk_cmd_buf);
+    assert(p_cmd->secondary || (NULL == p_render_target));
+
+    // Uploads from an earlier recording that was never submitted don't hold the staging ring anymore
+    tr_internal_vk_staging_ring_drop_cmd(p_cmd);
+
+    memset(p_cmd->bound_pipelines, 0, sizeof(p_cmd->bound_pipelines));
+    memset(p_cmd->bound_resolved_pipelines, 0, sizeof(p_cmd->bound_resolved_pipelines));
+
+    // Secondaries always need inheritance info, the render pass only if they continue one.
+    // Leaving the framebuffer out lets them run in any compatible framebuffer.
+    TINY_RENDERER_DECLARE_ZERO(VkCommandBufferInheritanceInfo, inheritance_info);
+    inheritance_info.sType                = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritance_info.pNext                = NULL;
+    inheritance_info.renderPass           = (NULL != p_render_target) ? p_render_target->vk_render_pass : VK_NULL_HANDLE;
+    inheritance_info.subpass              = 0;
+    inheritance_info.framebuffer          = VK_NULL_HANDLE;
+    inheritance_info.occlusionQueryEnable = VK_FALSE;
+    inheritance_info.queryFlags           = 0;
+    inheritance_info.pipelineStatistics   = 0;
+    // Without inheritedQueries secondaries can't run while tr_cmd_begin_query is active
+    if (p_cmd->secondary) {
+        VkPhysicalDeviceFeatures gpu_features = { 0 };
+        vkGetPhysicalDeviceFeatures(p_cmd->cmd_pool->renderer->vk_active_gpu, &gpu_features);
+        if (VK_TRUE == gpu_features.inheritedQueries) {
+            inheritance_info.occlusionQueryEnable = VK_TRUE;
+            inheritance_info.pipelineStatistics   = (VK_TRUE == gpu_features.pipelineStatisticsQuery) ? tr_internal_vk_pipeline_statistics : 0;
+        }
+    }
+
+    TINY_RENDERER_DECLARE_ZERO(VkCommandBufferBeginInfo, begin_info);
+    begin_info.sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;;
+    begin_info.pNext            = NULL;
+    begin_info.flags            = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+    begin_info.pInheritanceInfo = p_cmd->secondary ? &inheritance_info : NULL;
+    if (NULL != p_render_target) {
+        begin_info.flags |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    }
+    VkResult vk_res = vkBeginCommandBuffer(p_cmd->vk_cmd_buf, &begin_info);
+    assert(VK_SUCCESS == vk_res);
+
+    p_cmd->bound_render_target = p_render_target;
+    p_cmd->render_secondary_contents = false;
+    p_cmd->draw_count = 0;
+    p_cmd->dispatch_count = 0;
+    p_cmd->pending_src_stages = 0;
+    p_cmd->pending_dst_stages = 0;
+    p_cmd->pending_buffer_barrier_count = 0;
+    p_cmd->pending_image_barrier_count = 0;
+}
+
+void tr_internal_vk_end_cmd(tr_cmd* p_cmd)
+{
+    assert(VK_NULL_HANDLE != p_cmd->vk_cmd_buf);
+
+    tr_internal_vk_cmd_flush_barriers(p_cmd);
+
+    VkResult vk_res = vkEndCommandBuffer(p_cmd->vk_cmd_buf);
+    assert(VK_SUCCESS == vk_res);
+}
+
+void tr_internal_vk_cmd_begin_render(tr_cmd* p_cmd, tr_render_target* p_render_target, bool secondary_contents)
+{
+    assert(VK_NULL_HANDLE != p_cmd->vk_cmd_buf);
+    assert(VK_NULL_HANDLE != p_render_target->vk_render_pass);
+    assert(VK_NULL_HANDLE != p_render_target->vk_framebuffer);
+
+    TINY_RENDERER_DECLARE_ZERO(VkRect2D, render_area);
+    render_area.offset.x = 0;
+    render_area.offset.y = 0;
+    render_area.extent.width = p_render_target->width;
+    render_area.extent.height = p_render_target->height;
+
+    // Multiply by 2 in case there's multisampling
+    TINY_RENDERER_DECLARE_ZERO(VkClearValue, clear_values[(2 * tr_max_render_target_attachments) + 1]);
+    
+    uint32_t color_count = p_render_target->color_attachment_count;
+    for (uint32_t i = 0; i < color_count; ++i) {
+        clear_values[i].color.float32[0] = p_render_target->color_attachments[i]->clear_value.r;
+        clear_values[i].color.float32[1] = p_render_target->color_attachments[i]->clear_value.g;
+        clear_values[i].color.float32[2] = p_render_target->color_attachments[i]->clear_value.b;
+        clear_values[i].color.float32[3] = p_render_target->color_attachments[i]->clear_value.a;
+        if (p_render_target->sample_count > tr_sample_count_1) {
+            clear_values[i].color.float32[0] = p_render_target->color_attachments_multisample[i]->clear_value.r;
+            clear_values[i].color.float32[1] = p_render_target->color_attachments_multisample[i]->clear_value.g;
+            clear_values[i].color.float32[2] = p_render_target->color_attachments_multisample[i]->clear_value.b;
+            clear_values[i].color.float32[3] = p_render_target->color_attachments_multisample[i]->clear_value.a;
+        }
+    }
+    uint32_t depth_stencil_count = (tr_format_undefined != p_render_target->depth_stencil_format) ? 1 : 0;
+    if (depth_stencil_count > 0) {
+        clear_values[color_count].depthStencil.depth = p_render_target->depth_stencil_attachment->clear_value.depth;
+        clear_values[color_count].depthStencil.stencil = p_render_target->depth_stencil_attachment->clear_value.stencil;
+    }
+
+    uint32_t clear_value_count = color_count;
+    if (p_render_target->sample_count > tr_sample_count_1) {
+        clear_value_count *= 2;
+    }
+    clear_value_count += depth_stencil_count;
+
+    TINY_RENDERER_DECLARE_ZERO(VkRenderPassBeginInfo, begin_info);
+    begin_info.sType           = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    begin_info.pNext           = NULL;
+    begin_info.renderPass      = p_render_target->vk_render_pass;
+    begin_info.framebuffer     = p_render_target->vk_framebuffer;
+    begin_info.renderArea      = render_area;
+    begin_info.clearValueCount = clear_value_count;
+    begin_info.pClearValues    = clear_values;
+
+    tr_internal_vk_cmd_flush_barriers(p_cmd);
+
+    VkSubpassContents contents = secondary_contents ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE;
+    vkCmdBeginRenderPass(p_cmd->vk_cmd_buf, &begin_info, contents);
+}
+
+void tr_internal_vk_cmd_end_render(tr_cmd* p_cmd)
+{
+    assert(VK_NULL_HANDLE != p_cmd->vk_cmd_buf);
+
+    vkCmdEndRenderPass(p_cmd->vk_cmd_buf);
+
+    // The render pass leaves the attachments in their final layouts
+    tr_render_target* p_render_target = p_cmd->bound_render_target;
+    if (NULL == p_render_target) {
+        return;
+    }
+    for (uint32_t i = 0; i < p_render_target->color_attachment_count; ++i) {
+        tr_texture* p_attachment = p_render_target->color_attachments[i];
+        p_attachment->state = (p_attachment->usage & tr_texture_usage_present) ? tr_texture_usage_present : tr_texture_usage_color_attachment;
+        if (p_render_target->sample_count > tr_sample_count_1) {
+            p_render_target->color_attachments_multisample[i]->state = tr_texture_usage_color_attachment;
+        }
+    }
+    if (NULL != p_render_target->depth_stencil_attachment) {
+        p_render_target->depth_stencil_attachment->state = tr_texture_usage_depth_stencil_attachment;
+    }
+}
+
+void tr_internal_vk_cmd_execute_cmds(tr_cmd* p_cmd, uint32_t cmd_count, tr_cmd** pp_cmds)
+{
+    assert(VK_NULL_HANDLE != p_cmd->vk_cmd_buf);
+
+    tr_internal_vk_cmd_flush_barriers(p_cmd);
+
+    // Batches keep the handles on the stack
+    VkCommandBuffer cmds[32];
+    uint32_t batch_count = 0;
+    for (uint32_t i = 0; i < cmd_count; ++i) {
+        tr_cmd* p_secondary = pp_cmds[i];
+        assert(NULL != p_secondary);
+        assert(p_secondary->secondary);
+        assert(VK_NULL_HANDLE != p_secondary->vk_cmd_buf);
+
+        cmds[batch_count++] = p_secondary->vk_cmd_buf;
+        if ((batch_count == (sizeof(cmds) / sizeof(*cmds))) || (i == (cmd_count - 1))) {
+            vkCmdExecuteCommands(p_cmd->vk_cmd_buf, batch_count, cmds);
+            batch_count = 0;
+        }
+
+        p_cmd->draw_count += p_secondary->draw_count;
+        p_cmd->dispatch_count += p_secondary->dispatch_count;
+    }
+}
+
+void tr_internal_vk_cmd_set_viewport(tr_cmd* p_cmd, float x, float y, float width, float height, float min_depth, float max_depth)
+{
+    assert(VK_NULL_HANDLE != p_cmd->vk_cmd_buf);
+
+    TINY_RENDERER_DECLARE_ZERO(VkViewport, viewport);
+
+    // Because some IHVs decide to implement negative viewport height differently
+    if (p_cmd->cmd_pool->renderer->vk_device_ext_VK_AMD_negative_viewport_height) {
+      viewport.x = x;
+      viewport.y = 0;
+      viewport.width = width;
+      viewport.height = -height;
+      viewport.minDepth = min_depth;
+      viewport.maxDepth = max_depth;
+    }
+    else {
+      viewport.x = x;
+      viewport.y = height;
+      viewport.width = width;
+      viewport.height = -height;
+      viewport.minDepth = min_depth;
+      viewport.maxDepth = max_depth;
+    }
+    vkCmdSetViewport(p_cmd->vk_cmd_buf, 0, 1, &viewport);
+}
+
+void tr_internal_vk_cmd_set_scissor(tr_cmd* p_cmd, uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+{
+    assert(VK_NULL_HANDLE != p_cmd->vk_cmd_buf);
+
+    TINY_RENDERER_DECLARE_ZERO(VkRect2D, rect);
+    rect.offset.x = x;
+    rect.offset.x = y;
+    rect.extent.width = width;
+    rect.extent.height = height;
+    vkCmdSetScissor(p_cmd->vk_cmd_buf, 0, 1, &rect);
+}
+
+void tr_cmd_internal_vk_cmd_clear_color_attachment(tr_cmd* p_cmd, uint32_t attachment_index, const tr_clear_value* clear_value)
+{
+    assert(VK_NULL_HANDLE != p_cmd->vk_cmd_buf);
+    assert(NULL != p_cmd->bound_render_target);
+
+    TINY_RENDERER_DECLARE_ZERO(VkClearAttachment, attachment);
+    attachment.aspectMask                  = VK_IMAGE_ASPECT_COLOR_BIT;
+    attachment.colorAttachment             = attachment_index;
+    attachment.clearValue.color.float32[0] = clear_value->r;
+    attachment.clearValue.color.float32[1] = clear_value->g;
+    attachment.clearValue.color.float32[2] = clear_value->b;
+    attachment.clearValue.color.float32[3] = clear_value->a;
+    
+    TINY_RENDERER_DECLARE_ZERO(VkClearRect, rect);
+    rect.baseArrayLayer     = 0;
+    rect.layerCount         = 1;
+    rect.rect.offset.x      = 0;
+    rect.rect.offset.y      = 0;
+    rect.rect.extent.width  = p_cmd->bound_render_target->width;
+    rect.rect.extent.height = p_cmd->bound_render_target->height;
+    
+    vkCmdClearAttachments(p_cmd->vk_cmd_buf, 1, &attachment, 1, &rect);
+}
+
+void tr_internal_vk_cmd_bind_pipeline(tr_cmd* p_cmd, tr_pipeline* p_pipeline)
+{
+    assert(p_cmd != NULL);
+    assert(p_cmd->vk_cmd_buf != VK_NULL_HANDLE);
+    assert(p_pipeline != NULL);
+
+    // Resolved once, descriptor binds for p_pipeline reuse it
+    const uint32_t bind_index = (p_pipeline->type == tr_pipeline_type_compute) ? 1 : 0;
+    p_cmd->bound_pipelines[bind_index]          = p_pipeline;
+    p_cmd->bound_resolved_pipelines[bind_index] = tr_internal_vk_resolve_pipeline(p_pipeline);
+    p_pipeline = p_cmd->bound_resolved_pipelines[bind_index];
+
+    VkPipelineBindPoint pipeline_bind_point 
+        = (p_pipeline->type == tr_pipeline_type_compute) ? VK_PIPELINE_BIND_POINT_COMPUTE
+                                                         : VK_PIPELINE_BIND_POINT_GRAPHICS;
+
+    vkCmdBindPipeline(p_cmd->vk_cmd_buf, pipeline_bind_point, p_pipeline->vk_pipeline);
+
+    //switch (p_pipeline->type) {
+    //  case tr_pipeline_type_compute:
+    //    vkCmdBindPipeline(p_cmd->vk_cmd_buf, VK_PIPELINE_BIND_POINT_COMPUTE, p_pipeline->vk_pipeline);
+    //    break;
+    //  case tr_pipeline_type_graphics:
+    //    vkCmdBindPipeline(p_cmd->vk_cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, p_pipeline->vk_pipeline);
+    //    break;
+    //  default: break;
+    //}
+}
+
+void tr_internal_vk_cmd_bind_descriptor_sets(tr_cmd* p_cmd, tr_pipeline* p_pipeline, tr_descriptor_set* p_descriptor_set)
+{
+    assert(p_cmd != NULL);
+    assert(p_cmd->vk_cmd_buf != VK_NULL_HANDLE);
+    assert(p_pipeline != NULL);
+    assert(p_descriptor_set != NULL);
+
+    // The layout has to match whatever tr_internal_vk_cmd_bind_pipeline bound, resolving again could
+    // pick the real pipeline if its compile finished since
+    const uint32_t bind_index = (p_pipeline->type == tr_pipeline_type_compute) ? 1 : 0;
+    p_pipeline = (p_pipeline == p_cmd->bound_pipelines[bind_index]) ? p_cmd->bound_resolved_pipelines[bind_index] : tr_internal_vk_resolve_pipeline(p_pipeline);
+    assert(p_pipeline->vk_pipeline_layout != VK_NULL_HANDLE);
+    assert(p_descriptor_set->vk_descriptor_set != VK_NULL_HANDLE);
+
+    VkPipelineBindPoint pipeline_bind_point 
+        = (p_pipeline->type == tr_pipeline_type_compute) ? VK_PIPELINE_BIND_POINT_COMPUTE
+                                                         : VK_PIPELINE_BIND_POINT_GRAPHICS;
+
+    // @TODO: Add dynamic offsets support
+    vkCmdBindDescriptorSets(p_cmd->vk_cmd_buf, pipeline_bind_point, 
+                            p_pipeline->vk_pipeline_layout, 0, 
+                            1, &(p_descriptor_set->vk_descriptor_set), 0, NULL);
+}
+
+void tr_internal_vk_cmd_bind_index_buffer(tr_cmd* p_cmd, tr_buffer* p_buffer)
+{
+    assert(VK_NULL_HANDLE != p_cmd->vk_cmd_buf);
+
+    VkIndexType vk_index_type = (tr_index_type_uint16 == p_buffer->index_type) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    vkCmdBindIndexBuffer(p_cmd->vk_cmd_buf, p_buffer->vk_buffer, 0, vk_index_type);
+}
+
+void tr_internal_vk_cmd_bind_vertex_buffers(tr_cmd* p_cmd, uint32_t buffer_count, tr_buffer** pp_buffers)
+{
+    assert(VK_NULL_HANDLE != p_cmd->vk_cmd_buf);
+
+    const uint32_t max_buffers = p_cmd->cmd_pool->renderer->vk_active_gpu_properties.limits.maxVertexInputBindings;
+    uint32_t capped_buffer_count = buffer_count > max_buffers ? max_buffers : buffer_count;
+
+    // No upper bound for this, so use 64 for now
+    assert(capped_buffer_count < 64);
+
+    TINY_RENDERER_DECLARE_ZERO(VkBuffer, buffers[64]);
+    TINY_RENDERER_DECLARE_ZERO(VkDeviceSize, offsets[64]);
+    
+    for (uint32_t i = 0; i < capped_buffer_count; ++i) {
+        buffers[i] = pp_buffers[i]->vk_buffer;
+    }
+
+    vkCmdBindVertexBuffers(p_cmd->vk_cmd_buf, 0, capped_buffer_count, buffers, offsets);
+}
+
+void tr_internal_vk_cmd_draw(tr_cmd* p_cmd, uint32_t vertex_count, uint32_t first_vertex)
+{
+    assert(VK_NULL_HANDLE != p_cmd->vk_cmd_buf);
+
+    vkCmdDraw(p_cmd->vk_cmd_buf, vertex_count, 1, first_vertex, 0);
+    ++p_cmd->draw_count;
+}
+
+void tr_internal_vk_cmd_draw_indexed(tr_cmd* p_cmd, uint32_t index_count, uint32_t first_index)
+{
+    assert(VK_NULL_HANDLE != p_cmd->vk_cmd_buf);
+
+    vkCmdDrawIndexed(p_cmd->vk_cmd_buf, index_count, 1, first_index, 0, 0);
+    ++p_cmd->draw_count;
+}
+
+void tr_internal_vk_cmd_buffer_transition(tr_cmd* p_cmd, tr_buffer* p_buffer, tr_buffer_usage old_usage, tr_buffer_usage new_usage)
+{
+    tr_internal_vk_cmd_buffer_barrier(p_cmd, p_buffer, old_usage, new_usage, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+}
+
+// Any stage a descriptor can be read or written from, tr_internal_vk_cmd_supported_stages
+// narrows it down to what the queue and device have
+static const VkPipelineStageFlags tr_internal_vk_shader_stages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_TESSELLATION_CONTROL_SHADER_BIT |
+                                                                 VK_PIPELINE_STAGE_TESSELLATION_EVALUATION_SHADER_BIT | VK_PIPELINE_STAGE_GEOMETRY_SHADER_BIT |
+                                                                 VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+static const VkAccessFlags tr_internal_vk_write_access_mask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+                                                              VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+// Stages the queue of p_cmd can wait on, transfer-only queues support neither the
+// shader/attachment stages nor their access types. Graphics queues get the shader stages
+// the device has enabled, listed bit by bit since the result is used as a mask.
+static VkPipelineStageFlags tr_internal_vk_cmd_supported_stages(tr_cmd* p_cmd)
+{
+    const tr_queue* p_queue = p_cmd->cmd_pool->queue;
+    const tr_renderer* p_renderer = p_cmd->cmd_pool->renderer;
+    VkPipelineStageFlags result = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_HOST_BIT;
+    if ((NULL == p_queue) || (p_queue->vk_queue_flags & VK_QUEUE_GRAPHICS_BIT)) {
+        result |= VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+                  VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+                  VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | p_renderer->vk_shader_stages;
+    }
+    else if (p_queue->vk_queue_flags & VK_QUEUE_COMPUTE_BIT) {
+        result |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+    }
+    return result;
+}
+
+// Buffer states can be several usages at once, the scope covers all of them
+static void tr_internal_vk_buffer_state_scope(tr_buffer_usage state, VkPipelineStageFlags supported_stages, VkPipelineStageFlags* p_stages, VkAccessFlags* p_access)
+{
+    *p_stages = 0;
+    *p_access = 0;
+    for (uint32_t bit = 1; bit <= tr_buffer_usage_storage_texel_uav; bit <<= 1) {
+        VkPipelineStageFlags stages = 0;
+        VkAccessFlags access = 0;
+        switch (state & bit) {
+            case tr_buffer_usage_index             : stages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT; access = VK_ACCESS_INDEX_READ_BIT; break;
+            case tr_buffer_usage_vertex            : stages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT; access = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT; break;
+            case tr_buffer_usage_indirect          : stages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT; access = VK_ACCESS_INDIRECT_COMMAND_READ_BIT; break;
+            case tr_buffer_usage_transfer_src      : stages = VK_PIPELINE_STAGE_TRANSFER_BIT; access = VK_ACCESS_TRANSFER_READ_BIT; break;
+            case tr_buffer_usage_transfer_dst      : stages = VK_PIPELINE_STAGE_TRANSFER_BIT; access = VK_ACCESS_TRANSFER_WRITE_BIT; break;
+            case tr_buffer_usage_uniform_cbv       : stages = tr_internal_vk_shader_stages; access = VK_ACCESS_UNIFORM_READ_BIT; break;
+            case tr_buffer_usage_storage_srv       : stages = tr_internal_vk_shader_stages; access = VK_ACCESS_SHADER_READ_BIT; break;
+            case tr_buffer_usage_storage_uav       : stages = tr_internal_vk_shader_stages; access = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT; break;
+            case tr_buffer_usage_uniform_texel_srv : stages = tr_internal_vk_shader_stages; access = VK_ACCESS_SHADER_READ_BIT; break;
+            case tr_buffer_usage_storage_texel_uav : stages = tr_internal_vk_shader_stages; access = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT; break;
         }
-        if (depth_stencil_attachment_count > 0) {
-            depth_stencil_attachment_ref = (VkAttachmentReference*)calloc(1, sizeof(*depth_stencil_attachment_ref));
-            assert(NULL != depth_stencil_attachment_ref);
+        // A usage the queue has no stage for can't have touched the buffer on it
+        if (0 != (stages & supported_stages)) {
+            *p_stages |= stages & supported_stages;
+            *p_access |= access;
         }
+    }
+}
 
-        // Color
-        for (uint32_t i = 0; i < color_attachment_count; ++i) {
-            const uint32_t ssidx = 2*i;
-            const uint32_t msidx = ssidx + 1;
+static void tr_internal_vk_texture_state_scope(tr_texture_usage state, VkPipelineStageFlags supported_stages, VkPipelineStageFlags* p_stages, VkAccessFlags* p_access)
+{
+    VkPipelineStageFlags stages = 0;
+    VkAccessFlags access = 0;
+    switch (state) {
+        case tr_texture_usage_transfer_src             : stages = VK_PIPELINE_STAGE_TRANSFER_BIT; access = VK_ACCESS_TRANSFER_READ_BIT; break;
+        case tr_texture_usage_transfer_dst             : stages = VK_PIPELINE_STAGE_TRANSFER_BIT; access = VK_ACCESS_TRANSFER_WRITE_BIT; break;
+        case tr_texture_usage_sampled_image            : stages = tr_internal_vk_shader_stages; access = VK_ACCESS_SHADER_READ_BIT; break;
+        case tr_texture_usage_storage_image            : stages = tr_internal_vk_shader_stages; access = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT; break;
+        case tr_texture_usage_color_attachment         : stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT; access = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT; break;
+        case tr_texture_usage_depth_stencil_attachment : stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+                                                         access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT; break;
+        case tr_texture_usage_resolve_src              : stages = VK_PIPELINE_STAGE_TRANSFER_BIT; access = VK_ACCESS_TRANSFER_READ_BIT; break;
+        case tr_texture_usage_resolve_dst              : stages = VK_PIPELINE_STAGE_TRANSFER_BIT; access = VK_ACCESS_TRANSFER_WRITE_BIT; break;
+        // Undefined has nothing to wait for and present is ordered by semaphores
+        default: break;
+    }
+    *p_stages = stages & supported_stages;
+    *p_access = (0 != *p_stages) ? access : 0;
+}
 
-            // descriptions
-            attachments[ssidx].flags          = 0;
-            attachments[ssidx].format         = tr_util_to_vk_format(p_render_target->color_format);
-            attachments[ssidx].samples        = tr_util_to_vk_sample_count(tr_sample_count_1);
-            attachments[ssidx].loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR;
-            attachments[ssidx].storeOp        = VK_ATTACHMENT_STORE_OP_STORE;
-            attachments[ssidx].stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_CLEAR;
-            attachments[ssidx].stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
-            attachments[ssidx].initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED;
-            attachments[ssidx].finalLayout    = is_swapchain ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+// Textures that can be storage images are sampled through descriptors that say VK_IMAGE_LAYOUT_GENERAL too
+static VkImageLayout tr_internal_vk_texture_state_layout(const tr_texture* p_texture, tr_texture_usage state)
+{
+    if ((p_texture->usage & tr_texture_usage_storage_image) && ((tr_texture_usage_sampled_image == state) || (tr_texture_usage_storage_image == state))) {
+        return VK_IMAGE_LAYOUT_GENERAL;
+    }
+    return tr_util_to_vk_image_layout(state);
+}
 
-            attachments[msidx].flags          = 0;
-            attachments[msidx].format         = tr_util_to_vk_format(p_render_target->color_format);
-            attachments[msidx].samples        = tr_util_to_vk_sample_count(p_render_target->sample_count);
-            attachments[msidx].loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR;
-            attachments[msidx].storeOp        = VK_ATTACHMENT_STORE_OP_STORE;
-            attachments[msidx].stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_CLEAR;
-            attachments[msidx].stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
-            attachments[msidx].initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED;
-            attachments[msidx].finalLayout    = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+// A resource has at most one pending barrier, a later transition is folded into it.
+// Ownership transfers can't be folded, the pending barriers go out first.
+static VkBufferMemoryBarrier* tr_internal_vk_cmd_find_pending_buffer_barrier(tr_cmd* p_cmd, tr_buffer* p_buffer, bool ownership)
+{
+    for (uint32_t i = 0; i < p_cmd->pending_buffer_barrier_count; ++i) {
+        VkBufferMemoryBarrier* p_barrier = &(p_cmd->pending_buffer_barriers[i]);
+        if (p_barrier->buffer != p_buffer->vk_buffer) {
+            continue;
+        }
+        if ((! ownership) && (p_barrier->srcQueueFamilyIndex == p_barrier->dstQueueFamilyIndex)) {
+            return p_barrier;
+        }
+        tr_internal_vk_cmd_flush_barriers(p_cmd);
+        break;
+    }
+    return NULL;
+}
 
-            // references
-            color_attachment_refs[i].attachment   = msidx;
-            color_attachment_refs[i].layout       = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-            resolve_attachment_refs[i].attachment = ssidx;
-            resolve_attachment_refs[i].layout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+static VkBufferMemoryBarrier* tr_internal_vk_cmd_add_pending_buffer_barrier(tr_cmd* p_cmd, tr_buffer* p_buffer, uint32_t src_queue_family_index, uint32_t dst_queue_family_index)
+{
+    if (p_cmd->pending_buffer_barrier_count == p_cmd->pending_buffer_barrier_capacity) {
+        uint32_t capacity = (p_cmd->pending_buffer_barrier_capacity > 0) ? (2 * p_cmd->pending_buffer_barrier_capacity) : 8;
+        p_cmd->pending_buffer_barriers = (VkBufferMemoryBarrier*)realloc(p_cmd->pending_buffer_barriers, capacity * sizeof(*(p_cmd->pending_buffer_barriers)));
+        assert(NULL != p_cmd->pending_buffer_barriers);
+        p_cmd->pending_buffer_barrier_capacity = capacity;
+    }
+
+    VkBufferMemoryBarrier* p_barrier = &(p_cmd->pending_buffer_barriers[p_cmd->pending_buffer_barrier_count++]);
+    memset(p_barrier, 0, sizeof(*p_barrier));
+    p_barrier->sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    p_barrier->pNext               = NULL;
+    p_barrier->srcQueueFamilyIndex = src_queue_family_index;
+    p_barrier->dstQueueFamilyIndex = dst_queue_family_index;
+    p_barrier->buffer              = p_buffer->vk_buffer;
+    p_barrier->offset              = 0;
+    p_barrier->size                = VK_WHOLE_SIZE;
+    return p_barrier;
+}
+
+static VkImageMemoryBarrier* tr_internal_vk_cmd_find_pending_image_barrier(tr_cmd* p_cmd, tr_texture* p_texture, bool ownership)
+{
+    for (uint32_t i = 0; i < p_cmd->pending_image_barrier_count; ++i) {
+        VkImageMemoryBarrier* p_barrier = &(p_cmd->pending_image_barriers[i]);
+        if (p_barrier->image != p_texture->vk_image) {
+            continue;
         }
+        if ((! ownership) && (p_barrier->srcQueueFamilyIndex == p_barrier->dstQueueFamilyIndex)) {
+            return p_barrier;
+        }
+        tr_internal_vk_cmd_flush_barriers(p_cmd);
+        break;
+    }
+    return NULL;
+}
 
-        // Depth stencil
-        if (depth_stencil_attachment_count > 0) {
-            uint32_t idx = (2 * color_attachment_count);
-            attachments[idx].flags          = 0;
-            attachments[idx].format         = tr_util_to_vk_format(p_render_target->depth_stencil_format);
-            attachments[idx].samples        = tr_util_to_vk_sample_count(p_render_target->sample_count);
-            attachments[idx].loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR;
-            attachments[idx].storeOp        = VK_ATTACHMENT_STORE_OP_STORE;
-            attachments[idx].stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_CLEAR;
-            attachments[idx].stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
-            attachments[idx].initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED;
-            attachments[idx].finalLayout    = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-            depth_stencil_attachment_ref[0].attachment = idx;
-            depth_stencil_attachment_ref[0].layout     = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+static VkImageMemoryBarrier* tr_internal_vk_cmd_add_pending_image_barrier(tr_cmd* p_cmd, tr_texture* p_texture, VkImageLayout old_layout, uint32_t src_queue_family_index, uint32_t dst_queue_family_index)
+{
+    if (p_cmd->pending_image_barrier_count == p_cmd->pending_image_barrier_capacity) {
+        uint32_t capacity = (p_cmd->pending_image_barrier_capacity > 0) ? (2 * p_cmd->pending_image_barrier_capacity) : 8;
+        p_cmd->pending_image_barriers = (VkImageMemoryBarrier*)realloc(p_cmd->pending_image_barriers, capacity * sizeof(*(p_cmd->pending_image_barriers)));
+        assert(NULL != p_cmd->pending_image_barriers);
+        p_cmd->pending_image_barrier_capacity = capacity;
+    }
+
+    VkImageMemoryBarrier* p_barrier = &(p_cmd->pending_image_barriers[p_cmd->pending_image_barrier_count++]);
+    memset(p_barrier, 0, sizeof(*p_barrier));
+    p_barrier->sType                           = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    p_barrier->pNext                           = NULL;
+    p_barrier->oldLayout                       = old_layout;
+    p_barrier->srcQueueFamilyIndex             = src_queue_family_index;
+    p_barrier->dstQueueFamilyIndex             = dst_queue_family_index;
+    p_barrier->image                           = p_texture->vk_image;
+    p_barrier->subresourceRange.aspectMask     = p_texture->vk_aspect_mask;
+    p_barrier->subresourceRange.baseMipLevel   = 0;
+    p_barrier->subresourceRange.levelCount     = VK_REMAINING_MIP_LEVELS;
+    p_barrier->subresourceRange.baseArrayLayer = 0;
+    p_barrier->subresourceRange.layerCount     = VK_REMAINING_ARRAY_LAYERS;
+    return p_barrier;
+}
+
+void tr_internal_vk_cmd_buffer_barrier(tr_cmd* p_cmd, tr_buffer* p_buffer, tr_buffer_usage old_usage, tr_buffer_usage new_usage, uint32_t src_queue_family_index, uint32_t dst_queue_family_index)
+{
+    assert(p_cmd != NULL);
+    assert(p_cmd->vk_cmd_buf != VK_NULL_HANDLE);
+    // Barriers inside a render pass need a subpass self-dependency
+    assert(NULL == p_cmd->bound_render_target);
+
+    VkPipelineStageFlags supported_stages = tr_internal_vk_cmd_supported_stages(p_cmd);
+    VkPipelineStageFlags src_stages = 0;
+    VkPipelineStageFlags dst_stages = 0;
+    VkAccessFlags src_access = 0;
+    VkAccessFlags dst_access = 0;
+    tr_internal_vk_buffer_state_scope(old_usage, supported_stages, &src_stages, &src_access);
+    tr_internal_vk_buffer_state_scope(new_usage, supported_stages, &dst_stages, &dst_access);
+    // Only writes have to be made available
+    src_access &= tr_internal_vk_write_access_mask;
+
+    bool ownership = (src_queue_family_index != dst_queue_family_index);
+    VkBufferMemoryBarrier* p_barrier = tr_internal_vk_cmd_find_pending_buffer_barrier(p_cmd, p_buffer, ownership);
+    p_cmd->pending_src_stages |= src_stages;
+    p_cmd->pending_dst_stages |= dst_stages;
+    p_buffer->state = new_usage;
+
+    // Reads after reads need no barrier and write after read is ordered by the stages alone
+    if ((NULL == p_barrier) && (0 == src_access) && (! ownership)) {
+        return;
+    }
+
+    if (NULL == p_barrier) {
+        p_barrier = tr_internal_vk_cmd_add_pending_buffer_barrier(p_cmd, p_buffer, src_queue_family_index, dst_queue_family_index);
+    }
+    p_barrier->srcAccessMask |= src_access;
+    p_barrier->dstAccessMask |= dst_access;
+}
+
+void tr_internal_vk_cmd_image_transition(tr_cmd* p_cmd, tr_texture* p_texture, tr_texture_usage old_usage, tr_texture_usage new_usage)
+{
+    tr_internal_vk_cmd_image_barrier(p_cmd, p_texture, old_usage, new_usage, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+}
+
+void tr_internal_vk_cmd_image_barrier(tr_cmd* p_cmd, tr_texture* p_texture, tr_texture_usage old_usage, tr_texture_usage new_usage, uint32_t src_queue_family_index, uint32_t dst_queue_family_index)
+{
+    assert(VK_NULL_HANDLE != p_cmd->vk_cmd_buf);
+    assert(VK_NULL_HANDLE != p_texture->vk_image);
+    // Barriers inside a render pass need a subpass self-dependency
+    assert(NULL == p_cmd->bound_render_target);
+
+    VkPipelineStageFlags supported_stages = tr_internal_vk_cmd_supported_stages(p_cmd);
+    VkPipelineStageFlags src_stages = 0;
+    VkPipelineStageFlags dst_stages = 0;
+    VkAccessFlags src_access = 0;
+    VkAccessFlags dst_access = 0;
+    tr_internal_vk_texture_state_scope(old_usage, supported_stages, &src_stages, &src_access);
+    tr_internal_vk_texture_state_scope(new_usage, supported_stages, &dst_stages, &dst_access);
+    src_access &= tr_internal_vk_write_access_mask;
+
+    VkImageLayout old_layout = tr_internal_vk_texture_state_layout(p_texture, old_usage);
+    VkImageLayout new_layout = tr_internal_vk_texture_state_layout(p_texture, new_usage);
+
+    bool ownership = (src_queue_family_index != dst_queue_family_index);
+    VkImageMemoryBarrier* p_barrier = tr_internal_vk_cmd_find_pending_image_barrier(p_cmd, p_texture, ownership);
+    p_cmd->pending_src_stages |= src_stages;
+    p_cmd->pending_dst_stages |= dst_stages;
+    p_texture->state = new_usage;
+
+    // Layout transitions are writes of their own, so only reads that stay in the same layout go without a barrier
+    if ((NULL == p_barrier) && (0 == src_access) && (old_layout == new_layout) && (! ownership)) {
+        return;
+    }
+
+    if (NULL == p_barrier) {
+        p_barrier = tr_internal_vk_cmd_add_pending_image_barrier(p_cmd, p_texture, old_layout, src_queue_family_index, dst_queue_family_index);
+    }
+    p_barrier->srcAccessMask |= src_access;
+    p_barrier->dstAccessMask |= dst_access;
+    p_barrier->newLayout      = new_layout;
+}
+
+void tr_internal_vk_cmd_buffer_state(tr_cmd* p_cmd, tr_buffer* p_buffer, tr_buffer_usage new_usage)
+{
+    tr_internal_vk_cmd_buffer_transition(p_cmd, p_buffer, p_buffer->state, new_usage);
+}
+
+void tr_internal_vk_cmd_image_state(tr_cmd* p_cmd, tr_texture* p_texture, tr_texture_usage new_usage)
+{
+    tr_internal_vk_cmd_image_transition(p_cmd, p_texture, p_texture->state, new_usage);
+}
+
+void tr_internal_vk_cmd_flush_barriers(tr_cmd* p_cmd)
+{
+    if ((0 == p_cmd->pending_src_stages) && (0 == p_cmd->pending_dst_stages) &&
+        (0 == p_cmd->pending_buffer_barrier_count) && (0 == p_cmd->pending_image_barrier_count)) {
+        return;
+    }
+
+    VkPipelineStageFlags src_stage_mask = (0 != p_cmd->pending_src_stages) ? p_cmd->pending_src_stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    VkPipelineStageFlags dst_stage_mask = (0 != p_cmd->pending_dst_stages) ? p_cmd->pending_dst_stages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    vkCmdPipelineBarrier(p_cmd->vk_cmd_buf,
+                         src_stage_mask,
+                         dst_stage_mask,
+                         0,
+                         0,
+                         NULL,
+                         p_cmd->pending_buffer_barrier_count,
+                         p_cmd->pending_buffer_barriers,
+                         p_cmd->pending_image_barrier_count,
+                         p_cmd->pending_image_barriers);
+
+    p_cmd->pending_src_stages = 0;
+    p_cmd->pending_dst_stages = 0;
+    p_cmd->pending_buffer_barrier_count = 0;
+    p_cmd->pending_image_barrier_count = 0;
+}
+
+// Transitions from undefined, throwing away the contents. p_texture shares memory with the
+// aliases (which may include itself), their last recorded uses have to be done first.
+void tr_internal_vk_cmd_image_discard(tr_cmd* p_cmd, tr_texture* p_texture, tr_texture_usage new_usage, uint32_t alias_count, tr_texture** pp_aliases)
+{
+    assert(VK_NULL_HANDLE != p_cmd->vk_cmd_buf);
+    assert(VK_NULL_HANDLE != p_texture->vk_image);
+    assert(NULL == p_cmd->bound_render_target);
+
+    VkPipelineStageFlags supported_stages = tr_internal_vk_cmd_supported_stages(p_cmd);
+    VkPipelineStageFlags src_stages = 0;
+    VkPipelineStageFlags dst_stages = 0;
+    VkAccessFlags src_access = 0;
+    VkAccessFlags dst_access = 0;
+    for (uint32_t i = 0; i < alias_count; ++i) {
+        VkPipelineStageFlags stages = 0;
+        VkAccessFlags access = 0;
+        tr_internal_vk_texture_state_scope(pp_aliases[i]->state, supported_stages, &stages, &access);
+        src_stages |= stages;
+        src_access |= access;
+    }
+    tr_internal_vk_texture_state_scope(new_usage, supported_stages, &dst_stages, &dst_access);
+    src_access &= tr_internal_vk_write_access_mask;
+
+    VkImageMemoryBarrier* p_barrier = tr_internal_vk_cmd_find_pending_image_barrier(p_cmd, p_texture, false);
+    if (NULL == p_barrier) {
+        p_barrier = tr_internal_vk_cmd_add_pending_image_barrier(p_cmd, p_texture, VK_IMAGE_LAYOUT_UNDEFINED, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED);
+    }
+    p_cmd->pending_src_stages |= src_stages;
+    p_cmd->pending_dst_stages |= dst_stages;
+    p_texture->state = new_usage;
+
+    p_barrier->oldLayout      = VK_IMAGE_LAYOUT_UNDEFINED;
+    p_barrier->srcAccessMask |= src_access;
+    p_barrier->dstAccessMask |= dst_access;
+    p_barrier->newLayout      = tr_internal_vk_texture_state_layout(p_texture, new_usage);
+}
+
+void tr_internal_vk_cmd_render_target_transition(tr_cmd* p_cmd, tr_render_target* p_render_target, tr_texture_usage old_usage, tr_texture_usage new_usage)
+{
+    assert(NULL != p_cmd->vk_cmd_buf);
+    
+    if (p_render_target->sample_count > tr_sample_count_1) {
+        if (1 == p_render_target->color_attachment_count) {
+            tr_texture* ss_attachment = p_render_target->color_attachments[0];
+            tr_texture* ms_attachment = p_render_target->color_attachments_multisample[0];
+
+            // This means we're dealing with a multisample swapchain
+            if (tr_texture_usage_present == (ss_attachment->usage & tr_texture_usage_present)) {
+                if ((tr_texture_usage_present == old_usage) && (tr_texture_usage_color_attachment == new_usage)) {
+                    tr_internal_vk_cmd_image_transition(p_cmd, ss_attachment, tr_texture_usage_present, tr_texture_usage_color_attachment);
+                }
+
+                if ((tr_texture_usage_color_attachment == old_usage) && (tr_texture_usage_present == new_usage)) {
+                    tr_internal_vk_cmd_image_transition(p_cmd, ss_attachment, tr_texture_usage_color_attachment, tr_texture_usage_present);
+                }
+            }
+        }
+    }
+    else {
+        if (1 == p_render_target->color_attachment_count) {
+            tr_texture* attachment = p_render_target->color_attachments[0];
+            // This means we're dealing with a single sample swapchain
+            if (tr_texture_usage_present == (attachment->usage & tr_texture_usage_present)) {
+                if ((tr_texture_usage_present == old_usage) && (tr_texture_usage_color_attachment == new_usage)) {
+                    tr_internal_vk_cmd_image_transition(p_cmd, attachment, tr_texture_usage_present, tr_texture_usage_color_attachment);
+                }
+
+                if ((tr_texture_usage_color_attachment == old_usage) && (tr_texture_usage_present == new_usage)) {
+                    tr_internal_vk_cmd_image_transition(p_cmd, attachment, tr_texture_usage_color_attachment, tr_texture_usage_present);
+                }
+            }
+        }
+    }
+}
+
+void tr_internal_vk_cmd_dispatch(tr_cmd* p_cmd, uint32_t group_count_x, uint32_t group_count_y, uint32_t group_count_z)
+{
+    assert(p_cmd != NULL);
+    assert(p_cmd->vk_cmd_buf != VK_NULL_HANDLE);
+
+    tr_internal_vk_cmd_flush_barriers(p_cmd);
+    vkCmdDispatch(p_cmd->vk_cmd_buf, group_count_x, group_count_y, group_count_z);
+    ++p_cmd->dispatch_count;
+}
+
+void tr_internal_vk_cmd_copy_buffer_to_texture2d(tr_cmd* p_cmd, uint32_t width, uint32_t height, uint32_t row_pitch, uint64_t buffer_offset, uint32_t mip_level, tr_buffer* p_buffer, tr_texture* p_texture)
+{
+    assert(p_cmd != NULL);
+    assert(p_cmd->vk_cmd_buf != VK_NULL_HANDLE);
+
+    VkBufferImageCopy regions = { 0 };
+    regions.bufferOffset                    = buffer_offset;
+    regions.bufferRowLength                 = width;
+    regions.bufferImageHeight               = height;
+    regions.imageSubresource.aspectMask     = p_texture->vk_aspect_mask;
+    regions.imageSubresource.mipLevel       = mip_level;
+    regions.imageSubresource.baseArrayLayer = 0;
+    regions.imageSubresource.layerCount     = 1;
+    regions.imageOffset.x                   = 0;
+    regions.imageOffset.y                   = 0;
+    regions.imageOffset.z                   = 0;
+    regions.imageExtent.width               = width;
+    regions.imageExtent.height              = height;
+    regions.imageExtent.depth               = 1;
+
+    tr_internal_vk_cmd_flush_barriers(p_cmd);
+    vkCmdCopyBufferToImage(p_cmd->vk_cmd_buf, p_buffer->vk_buffer, p_texture->vk_image,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &regions);
+}
+
+// Each level is blitted from the one above it, so a level goes from transfer dst to transfer
+// src right before it's read. That's one barrier per level, the last one moves them all to
+// new_usage.
+void tr_internal_vk_cmd_generate_mips(tr_cmd* p_cmd, tr_texture* p_texture, tr_texture_usage new_usage)
+{
+    assert(VK_NULL_HANDLE != p_cmd->vk_cmd_buf);
+    assert(VK_NULL_HANDLE != p_texture->vk_image);
+    assert(NULL == p_cmd->bound_render_target);
+    assert(tr_sample_count_1 == p_texture->sample_count);
+    // vkCmdBlitImage is graphics only
+    assert(0 != (tr_internal_vk_cmd_supported_stages(p_cmd) & VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT));
+    // The blits cover one layer of a 2D level. Images are created with a single array layer,
+    // cube maps would need all six faces and 3D textures their depth slices.
+    assert((tr_texture_type_cube != p_texture->type) && (1 == p_texture->depth) && "only single layer 1D/2D textures get GPU mips");
+    const uint32_t layer_count = 1;
+
+    if (p_texture->mip_levels < 2) {
+        tr_internal_vk_cmd_image_state(p_cmd, p_texture, new_usage);
+        return;
+    }
+
+    // Sampled textures are created with both transfer usages
+    assert((0 != (p_texture->usage & tr_texture_usage_sampled_image)) ||
+           ((tr_texture_usage_transfer_src | tr_texture_usage_transfer_dst) == (p_texture->usage & (tr_texture_usage_transfer_src | tr_texture_usage_transfer_dst))));
+
+    VkFilter filter = VK_FILTER_LINEAR;
+    bool blit_supported = tr_internal_vk_format_blit_filter(p_cmd->cmd_pool->renderer, p_texture->format, &filter);
+    assert(blit_supported && "format doesn't support blits");
+    (void)blit_supported;
+
+    // Whatever wrote mip 0 has to be done, the levels below it are overwritten
+    tr_internal_vk_cmd_image_state(p_cmd, p_texture, tr_texture_usage_transfer_dst);
+    tr_internal_vk_cmd_flush_barriers(p_cmd);
+
+    TINY_RENDERER_DECLARE_ZERO(VkImageMemoryBarrier, barrier);
+    barrier.sType                           = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.pNext                           = NULL;
+    barrier.srcAccessMask                   = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask                   = VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.oldLayout                       = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout                       = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.srcQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image                           = p_texture->vk_image;
+    barrier.subresourceRange.aspectMask     = p_texture->vk_aspect_mask;
+    barrier.subresourceRange.levelCount     = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount     = VK_REMAINING_ARRAY_LAYERS;
+
+    uint32_t src_width = p_texture->width;
+    uint32_t src_height = p_texture->height;
+    for (uint32_t mip_level = 1; mip_level < p_texture->mip_levels; ++mip_level) {
+        uint32_t dst_width = tr_max(src_width >> 1, 1);
+        uint32_t dst_height = tr_max(src_height >> 1, 1);
+
+        barrier.subresourceRange.baseMipLevel = mip_level - 1;
+        vkCmdPipelineBarrier(p_cmd->vk_cmd_buf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &barrier);
+
+        TINY_RENDERER_DECLARE_ZERO(VkImageBlit, region);
+        region.srcSubresource.aspectMask     = p_texture->vk_aspect_mask;
+        region.srcSubresource.mipLevel       = mip_level - 1;
+        region.srcSubresource.baseArrayLayer = 0;
+        region.srcSubresource.layerCount     = layer_count;
+        region.srcOffsets[1].x               = (int32_t)src_width;
+        region.srcOffsets[1].y               = (int32_t)src_height;
+        region.srcOffsets[1].z               = 1;
+        region.dstSubresource.aspectMask     = p_texture->vk_aspect_mask;
+        region.dstSubresource.mipLevel       = mip_level;
+        region.dstSubresource.baseArrayLayer = 0;
+        region.dstSubresource.layerCount     = layer_count;
+        region.dstOffsets[1].x               = (int32_t)dst_width;
+        region.dstOffsets[1].y               = (int32_t)dst_height;
+        region.dstOffsets[1].z               = 1;
+        vkCmdBlitImage(p_cmd->vk_cmd_buf,
+                       p_texture->vk_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                       p_texture->vk_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                       1, &region, filter);
+
+        src_width = dst_width;
+        src_height = dst_height;
+    }
+
+    // The levels above the last one were only read since their blit, the last one was written
+    VkPipelineStageFlags dst_stages = 0;
+    VkAccessFlags dst_access = 0;
+    tr_internal_vk_texture_state_scope(new_usage, tr_internal_vk_cmd_supported_stages(p_cmd), &dst_stages, &dst_access);
+    VkImageLayout new_layout = tr_internal_vk_texture_state_layout(p_texture, new_usage);
+
+    VkImageMemoryBarrier barriers[2] = { barrier, barrier };
+    barriers[0].srcAccessMask                 = 0;
+    barriers[0].dstAccessMask                 = dst_access;
+    barriers[0].oldLayout                     = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barriers[0].newLayout                     = new_layout;
+    barriers[0].subresourceRange.baseMipLevel = 0;
+    barriers[0].subresourceRange.levelCount   = p_texture->mip_levels - 1;
+    barriers[1].srcAccessMask                 = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barriers[1].dstAccessMask                 = dst_access;
+    barriers[1].oldLayout                     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barriers[1].newLayout                     = new_layout;
+    barriers[1].subresourceRange.baseMipLevel = p_texture->mip_levels - 1;
+    barriers[1].subresourceRange.levelCount   = 1;
+    VkPipelineStageFlags dst_stage_mask = (0 != dst_stages) ? dst_stages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+    vkCmdPipelineBarrier(p_cmd->vk_cmd_buf, VK_PIPELINE_STAGE_TRANSFER_BIT, dst_stage_mask, 0, 0, NULL, 0, NULL, 2, barriers);
+
+    p_texture->state = new_usage;
+}
+
+// -------------------------------------------------------------------------------------------------
+// Internal queue functions
+// -------------------------------------------------------------------------------------------------
+void tr_internal_vk_acquire_next_image(tr_renderer* p_renderer, tr_semaphore* p_signal_semaphore, tr_fence* p_fence)
+{
+    assert(VK_NULL_HANDLE != p_renderer->vk_device);
+
+    VkSemaphore semaphore = (NULL != p_signal_semaphore) ? p_signal_semaphore->vk_semaphore : VK_NULL_HANDLE;
+    VkFence fence = (NULL != p_fence) ? p_fence->vk_fence : VK_NULL_HANDLE;
+
+    VkResult vk_res = VK_SUCCESS;
+    if (p_renderer->settings.headless) {
+        // Round robin through the offscreen targets. The caller's semaphore and fence
+        // still have to be signaled, an empty submit does that.
+        p_renderer->swapchain_image_index = p_renderer->headless_acquire_count % p_renderer->settings.swapchain.image_count;
+        p_renderer->headless_acquire_count += 1;
+        if ((VK_NULL_HANDLE != semaphore) || (VK_NULL_HANDLE != fence)) {
+            TINY_RENDERER_DECLARE_ZERO(VkSubmitInfo, submit_info);
+            submit_info.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submit_info.signalSemaphoreCount = (VK_NULL_HANDLE != semaphore) ? 1 : 0;
+            submit_info.pSignalSemaphores    = &semaphore;
+            vk_res = vkQueueSubmit(p_renderer->graphics_queue->vk_queue, 1, &submit_info, fence);
+            assert(VK_SUCCESS == vk_res);
         }
     }
-    else {
-        attachments = (VkAttachmentDescription*)calloc(color_attachment_count + depth_stencil_attachment_count, sizeof(*attachments));
-        assert(NULL != attachments);
-        
-        if (color_attachment_count > 0) {
-            color_attachment_refs = (VkAttachmentReference*)calloc(color_attachment_count, sizeof(*color_attachment_refs));
-            assert(NULL != color_attachment_refs);
-        }
-        if (depth_stencil_attachment_count > 0) {
-            depth_stencil_attachment_ref = (VkAttachmentReference*)calloc(1, sizeof(*depth_stencil_attachment_ref));
-            assert(NULL != depth_stencil_attachment_ref);
-        }
+    else {
+        assert(VK_NULL_HANDLE != p_renderer->vk_swapchain);
+
+        vk_res = vkAcquireNextImageKHR(p_renderer->vk_device, 
+                                       p_renderer->vk_swapchain, 
+                                       UINT64_MAX, 
+                                       semaphore, 
+                                       fence, 
+                                       &(p_renderer->swapchain_image_index));
+        assert(VK_SUCCESS == vk_res);
+    }
+
+    // The semaphore is enough to order rendering after the acquire, only block
+    // the CPU when the caller explicitly asked for a fence
+    if (VK_NULL_HANDLE != fence) {
+        TINY_RENDERER_TRACE_NAMED_SCOPE(p_renderer, "vkWaitForFences");
+        vk_res = vkWaitForFences(p_renderer->vk_device, 1, &fence, VK_TRUE, UINT64_MAX);
+        assert(VK_SUCCESS == vk_res);
+
+        vk_res = vkResetFences(p_renderer->vk_device, 1, &fence);
+        assert(VK_SUCCESS == vk_res);
+    }
+}
+
+void tr_internal_vk_queue_submit(
+    tr_queue*      p_queue, 
+    uint32_t       cmd_count,
+    tr_cmd**       pp_cmds,
+    uint32_t       wait_semaphore_count,
+    tr_semaphore** pp_wait_semaphores,
+    uint32_t       signal_semaphore_count,
+    tr_semaphore** pp_signal_semaphores,
+    tr_fence*      p_fence
+)
+{
+    TINY_RENDERER_DECLARE_ZERO(tr_submit_info, submit);
+    submit.cmd_count              = cmd_count;
+    submit.pp_cmds                = pp_cmds;
+    submit.wait_semaphore_count   = wait_semaphore_count;
+    submit.pp_wait_semaphores     = pp_wait_semaphores;
+    submit.signal_semaphore_count = signal_semaphore_count;
+    submit.pp_signal_semaphores   = pp_signal_semaphores;
+    tr_internal_vk_queue_submit_batch(p_queue, 1, &submit, p_fence);
+}
+
+static void tr_internal_vk_grow_submit_scratch(tr_submit_scratch* p_scratch, uint32_t submit_count, uint32_t cmd_count, uint32_t wait_count, uint32_t signal_count)
+{
+    if (submit_count > p_scratch->submit_capacity) {
+        p_scratch->submit_infos = (VkSubmitInfo*)realloc(p_scratch->submit_infos, submit_count * sizeof(*(p_scratch->submit_infos)));
+        p_scratch->timeline_infos = (VkTimelineSemaphoreSubmitInfoKHR*)realloc(p_scratch->timeline_infos, submit_count * sizeof(*(p_scratch->timeline_infos)));
+        assert((NULL != p_scratch->submit_infos) && (NULL != p_scratch->timeline_infos));
+        p_scratch->submit_capacity = submit_count;
+    }
+    if (cmd_count > p_scratch->cmd_capacity) {
+        p_scratch->cmds = (VkCommandBuffer*)realloc(p_scratch->cmds, cmd_count * sizeof(*(p_scratch->cmds)));
+        assert(NULL != p_scratch->cmds);
+        p_scratch->cmd_capacity = cmd_count;
+    }
+    if (wait_count > p_scratch->wait_capacity) {
+        p_scratch->wait_semaphores = (VkSemaphore*)realloc(p_scratch->wait_semaphores, wait_count * sizeof(*(p_scratch->wait_semaphores)));
+        p_scratch->wait_masks = (VkPipelineStageFlags*)realloc(p_scratch->wait_masks, wait_count * sizeof(*(p_scratch->wait_masks)));
+        p_scratch->wait_values = (uint64_t*)realloc(p_scratch->wait_values, wait_count * sizeof(*(p_scratch->wait_values)));
+        assert((NULL != p_scratch->wait_semaphores) && (NULL != p_scratch->wait_masks) && (NULL != p_scratch->wait_values));
+        p_scratch->wait_capacity = wait_count;
+    }
+    if (signal_count > p_scratch->signal_capacity) {
+        p_scratch->signal_semaphores = (VkSemaphore*)realloc(p_scratch->signal_semaphores, signal_count * sizeof(*(p_scratch->signal_semaphores)));
+        p_scratch->signal_values = (uint64_t*)realloc(p_scratch->signal_values, signal_count * sizeof(*(p_scratch->signal_values)));
+        assert((NULL != p_scratch->signal_semaphores) && (NULL != p_scratch->signal_values));
+        p_scratch->signal_capacity = signal_count;
+    }
+}
 
-        // Color
-        for (uint32_t i = 0; i < color_attachment_count; ++i) {
-            const uint32_t ssidx = i;
+void tr_internal_vk_free_submit_scratch(tr_submit_scratch* p_scratch)
+{
+    TINY_RENDERER_SAFE_FREE(p_scratch->submit_infos);
+    TINY_RENDERER_SAFE_FREE(p_scratch->timeline_infos);
+    TINY_RENDERER_SAFE_FREE(p_scratch->cmds);
+    TINY_RENDERER_SAFE_FREE(p_scratch->wait_semaphores);
+    TINY_RENDERER_SAFE_FREE(p_scratch->wait_masks);
+    TINY_RENDERER_SAFE_FREE(p_scratch->wait_values);
+    TINY_RENDERER_SAFE_FREE(p_scratch->signal_semaphores);
+    TINY_RENDERER_SAFE_FREE(p_scratch->signal_values);
+    memset(p_scratch, 0, sizeof(*p_scratch));
+}
 
-            // descriptions
-            attachments[ssidx].flags          = 0;
-            attachments[ssidx].format         = tr_util_to_vk_format(p_render_target->color_format);
-            attachments[ssidx].samples        = tr_util_to_vk_sample_count(tr_sample_count_1);
-            attachments[ssidx].loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR;
-            attachments[ssidx].storeOp        = VK_ATTACHMENT_STORE_OP_STORE;
-            attachments[ssidx].stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_CLEAR;
-            attachments[ssidx].stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
-            attachments[ssidx].initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED;
-            attachments[ssidx].finalLayout    = is_swapchain ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+void tr_internal_vk_queue_submit_batch(tr_queue* p_queue, uint32_t submit_count, const tr_submit_info* p_submits, tr_fence* p_fence)
+{
+    assert(VK_NULL_HANDLE != p_queue->vk_queue);
 
-            // references
-            color_attachment_refs[i].attachment = ssidx;
-            color_attachment_refs[i].layout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    tr_renderer* p_renderer = p_queue->renderer;
+    tr_timeline* p_queue_timeline = p_queue->timeline;
+
+    // Uploads batched in the staging ring go ahead of the caller's submits, in a submit of
+    // their own that also takes the wait for the transfer queue's copies. Later submits are
+    // ordered after its ownership acquires by the barriers themselves.
+    tr_staging_ring* p_ring = tr_internal_vk_find_staging_ring(p_renderer, p_queue->vk_queue_family_index);
+    tr_staging_submit* p_staging_submit = tr_internal_vk_staging_ring_begin_submit(p_ring, p_queue, submit_count, p_submits);
+    bool staging_cmd = (NULL != p_staging_submit) && p_ring->recording;
+    bool transfer_wait = (NULL != p_staging_submit) && p_ring->transfer_wait;
+    uint32_t staging_submit_count = (staging_cmd || transfer_wait) ? 1 : 0;
+
+    // There's always at least one submit to carry the queue timeline signal and the fence
+    uint32_t vk_submit_count = tr_max(staging_submit_count + submit_count, 1U);
+    uint32_t cmd_count = staging_cmd ? 1 : 0;
+    uint32_t wait_count = transfer_wait ? 1 : 0;
+    uint32_t signal_count = (NULL != p_queue_timeline) ? 1 : 0;
+    for (uint32_t i = 0; i < submit_count; ++i) {
+        cmd_count += p_submits[i].cmd_count;
+        wait_count += p_submits[i].wait_semaphore_count + p_submits[i].wait_timeline_count;
+        signal_count += p_submits[i].signal_semaphore_count + p_submits[i].signal_timeline_count;
+    }
+    tr_submit_scratch* p_scratch = &(p_queue->submit_scratch);
+    tr_internal_vk_grow_submit_scratch(p_scratch, vk_submit_count, cmd_count, wait_count, signal_count);
+
+    VkSubmitInfo* submit_infos = p_scratch->submit_infos;
+    VkTimelineSemaphoreSubmitInfoKHR* timeline_infos = p_scratch->timeline_infos;
+    memset(submit_infos, 0, vk_submit_count * sizeof(*submit_infos));
+    memset(timeline_infos, 0, vk_submit_count * sizeof(*timeline_infos));
+    uint32_t cmd_index = 0;
+    uint32_t wait_index = 0;
+    uint32_t signal_index = 0;
+    for (uint32_t i = 0; i < vk_submit_count; ++i) {
+        submit_infos[i].sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_infos[i].pNext              = NULL;
+        submit_infos[i].pCommandBuffers    = &(p_scratch->cmds[cmd_index]);
+        submit_infos[i].pWaitSemaphores    = &(p_scratch->wait_semaphores[wait_index]);
+        submit_infos[i].pWaitDstStageMask  = &(p_scratch->wait_masks[wait_index]);
+        submit_infos[i].pSignalSemaphores  = &(p_scratch->signal_semaphores[signal_index]);
+        timeline_infos[i].sType                  = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+        timeline_infos[i].pNext                  = NULL;
+        timeline_infos[i].pWaitSemaphoreValues   = &(p_scratch->wait_values[wait_index]);
+        timeline_infos[i].pSignalSemaphoreValues = &(p_scratch->signal_values[signal_index]);
+
+        if (i < staging_submit_count) {
+            if (staging_cmd) {
+                tr_internal_vk_end_cmd(p_staging_submit->cmd);
+                p_scratch->cmds[cmd_index++] = p_staging_submit->cmd->vk_cmd_buf;
+            }
+            if (transfer_wait) {
+                tr_staging_ring* p_transfer_ring = p_renderer->transfer_staging_ring;
+                if (NULL != p_transfer_ring->queue->timeline) {
+                    tr_internal_vk_staging_ring_flush(p_transfer_ring);
+                    p_scratch->wait_semaphores[wait_index] = p_transfer_ring->queue->timeline->vk_semaphore;
+                    p_scratch->wait_values[wait_index] = p_transfer_ring->queue->submit_value;
+                }
+                else {
+                    tr_internal_vk_staging_ring_signal_transfer(p_renderer, p_staging_submit->semaphore);
+                    p_scratch->wait_semaphores[wait_index] = p_staging_submit->semaphore->vk_semaphore;
+                    p_scratch->wait_values[wait_index] = 0;
+                }
+                p_scratch->wait_masks[wait_index] = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+                ++wait_index;
+            }
         }
-
-        // Depth stencil
-        if (depth_stencil_attachment_count > 0) {
-            uint32_t idx = color_attachment_count;
-            attachments[idx].flags          = 0;
-            attachments[idx].format         = tr_util_to_vk_format(p_render_target->depth_stencil_format);
-            attachments[idx].samples        = tr_util_to_vk_sample_count(p_render_target->sample_count);
-            attachments[idx].loadOp         = VK_ATTACHMENT_LOAD_OP_CLEAR;
-            attachments[idx].storeOp        = VK_ATTACHMENT_STORE_OP_STORE;
-            attachments[idx].stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_CLEAR;
-            attachments[idx].stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
-            attachments[idx].initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED;
-            attachments[idx].finalLayout    = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-            depth_stencil_attachment_ref[0].attachment = idx;
-            depth_stencil_attachment_ref[0].layout     = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        else if ((i - staging_submit_count) < submit_count) {
+            // Binary semaphores go first, then timelines. The value arrays cover every
+            // semaphore, the values for binary semaphores are ignored.
+            const tr_submit_info* p_submit = &(p_submits[i - staging_submit_count]);
+            for (uint32_t j = 0; j < p_submit->cmd_count; ++j) {
+                p_scratch->cmds[cmd_index++] = p_submit->pp_cmds[j]->vk_cmd_buf;
+            }
+            for (uint32_t j = 0; j < p_submit->wait_semaphore_count; ++j, ++wait_index) {
+                p_scratch->wait_semaphores[wait_index] = p_submit->pp_wait_semaphores[j]->vk_semaphore;
+                p_scratch->wait_masks[wait_index] = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+                p_scratch->wait_values[wait_index] = 0;
+            }
+            for (uint32_t j = 0; j < p_submit->wait_timeline_count; ++j, ++wait_index) {
+                p_scratch->wait_semaphores[wait_index] = p_submit->pp_wait_timelines[j]->vk_semaphore;
+                p_scratch->wait_masks[wait_index] = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+                p_scratch->wait_values[wait_index] = p_submit->p_wait_values[j];
+            }
+            for (uint32_t j = 0; j < p_submit->signal_semaphore_count; ++j, ++signal_index) {
+                p_scratch->signal_semaphores[signal_index] = p_submit->pp_signal_semaphores[j]->vk_semaphore;
+                p_scratch->signal_values[signal_index] = 0;
+            }
+            for (uint32_t j = 0; j < p_submit->signal_timeline_count; ++j, ++signal_index) {
+                p_scratch->signal_semaphores[signal_index] = p_submit->pp_signal_timelines[j]->vk_semaphore;
+                p_scratch->signal_values[signal_index] = p_submit->p_signal_values[j];
+            }
         }
-    }
-            
-    TINY_RENDERER_DECLARE_ZERO(VkSubpassDescription, subpass);
-    subpass.flags                   = 0;
-    subpass.pipelineBindPoint       = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpass.inputAttachmentCount    = 0;
-    subpass.pInputAttachments       = NULL;
-    subpass.colorAttachmentCount    = color_attachment_count;
-    subpass.pColorAttachments       = color_attachment_refs;
-    subpass.pResolveAttachments     = resolve_attachment_refs;
-    subpass.pDepthStencilAttachment = depth_stencil_attachment_ref;
-    subpass.preserveAttachmentCount = 0;
-    subpass.pPreserveAttachments    = NULL;
 
-    // Create self-dependency in case image or memory barrier is issued within subpass
-    TINY_RENDERER_DECLARE_ZERO(VkSubpassDependency, subpass_dependency);
-    subpass_dependency.srcSubpass      = 0;
-    subpass_dependency.dstSubpass      = 0;
-    subpass_dependency.srcStageMask    = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    subpass_dependency.dstStageMask    = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    subpass_dependency.srcAccessMask   = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    subpass_dependency.dstAccessMask   = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    subpass_dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+        // The queue's own timeline is signaled last, which covers every submit before it
+        if ((i == (vk_submit_count - 1)) && (NULL != p_queue_timeline)) {
+            p_scratch->signal_semaphores[signal_index] = p_queue_timeline->vk_semaphore;
+            p_scratch->signal_values[signal_index] = p_queue->submit_value + 1;
+            ++signal_index;
+        }
 
-    uint32_t attachment_count = (p_render_target->sample_count > tr_sample_count_1) ?  (2 * color_attachment_count) : color_attachment_count;
-    attachment_count += depth_stencil_attachment_count;
+        submit_infos[i].commandBufferCount   = (uint32_t)(&(p_scratch->cmds[cmd_index]) - submit_infos[i].pCommandBuffers);
+        submit_infos[i].waitSemaphoreCount   = (uint32_t)(&(p_scratch->wait_semaphores[wait_index]) - submit_infos[i].pWaitSemaphores);
+        submit_infos[i].signalSemaphoreCount = (uint32_t)(&(p_scratch->signal_semaphores[signal_index]) - submit_infos[i].pSignalSemaphores);
+        if (NULL != p_queue_timeline) {
+            timeline_infos[i].waitSemaphoreValueCount   = submit_infos[i].waitSemaphoreCount;
+            timeline_infos[i].signalSemaphoreValueCount = submit_infos[i].signalSemaphoreCount;
+            submit_infos[i].pNext = &(timeline_infos[i]);
+        }
+    }
 
-    TINY_RENDERER_DECLARE_ZERO(VkRenderPassCreateInfo, create_info);
-    create_info.sType           = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    create_info.pNext           = NULL;
-    create_info.flags           = 0;
-    create_info.attachmentCount = attachment_count;
-    create_info.pAttachments    = attachments;
-    create_info.subpassCount    = 1;
-    create_info.pSubpasses      = &subpass;
-    create_info.dependencyCount = 1;
-    create_info.pDependencies   = &subpass_dependency;
-    
-    VkResult vk_res = vkCreateRenderPass(p_renderer->vk_device, &create_info, NULL, &(p_render_target->vk_render_pass));
+    // Without a queue timeline the staging slot needs the submit's fence
+    bool staging_fence = (NULL != p_staging_submit) && (NULL == p_queue_timeline);
+    VkFence fence = staging_fence ? p_staging_submit->fence->vk_fence :
+                    ((NULL != p_fence) ? p_fence->vk_fence : VK_NULL_HANDLE);
+    VkResult vk_res = vkQueueSubmit(p_queue->vk_queue, vk_submit_count, submit_infos, fence);
     assert(VK_SUCCESS == vk_res);
+    p_queue->submit_value += 1;
 
-    TINY_RENDERER_SAFE_FREE(attachments);
-    TINY_RENDERER_SAFE_FREE(color_attachment_refs);
-    TINY_RENDERER_SAFE_FREE(resolve_attachment_refs);
-    TINY_RENDERER_SAFE_FREE(depth_stencil_attachment_ref);
+    // The staging slot took the submit's fence, the caller's fence goes on an
+    // empty submit which signals once everything before it has completed
+    if (staging_fence && (NULL != p_fence)) {
+        vk_res = vkQueueSubmit(p_queue->vk_queue, 0, NULL, p_fence->vk_fence);
+        assert(VK_SUCCESS == vk_res);
+    }
+
+    if (NULL != p_staging_submit) {
+        p_staging_submit->queue_value = p_queue->submit_value;
+        tr_internal_vk_staging_ring_end_submit(p_ring, p_staging_submit, submit_count, p_submits);
+    }
 }
 
-void tr_internal_vk_create_framebuffer(tr_renderer* p_renderer, tr_render_target* p_render_target)
+void tr_internal_vk_queue_present(tr_queue* p_queue, uint32_t wait_semaphore_count, tr_semaphore** pp_wait_semaphores)
 {
-    assert(VK_NULL_HANDLE != p_renderer->vk_device);
-    assert(VK_NULL_HANDLE != p_render_target->vk_render_pass);
+    assert(VK_NULL_HANDLE != p_queue->vk_queue);
 
-    uint32_t attachment_count = p_render_target->color_attachment_count;
-    if (p_render_target->sample_count > tr_sample_count_1) {
-        attachment_count *= 2;
-    }
-    if (tr_format_undefined != p_render_target->depth_stencil_format) {
-        attachment_count += 1;
+    tr_renderer* renderer = p_queue->renderer;
+
+    TINY_RENDERER_DECLARE_ZERO(VkSemaphore, wait_semaphores[tr_max_present_wait_semaphores]);
+    wait_semaphore_count = wait_semaphore_count > tr_max_present_wait_semaphores ? wait_semaphore_count : wait_semaphore_count;
+    for (uint32_t i = 0; i < wait_semaphore_count; ++i) {
+        wait_semaphores[i] = pp_wait_semaphores[i]->vk_semaphore;
     }
 
-    VkImageView* attachments = (VkImageView*)calloc(attachment_count, sizeof(*attachments));
-    assert(NULL != attachments);
+    // Nothing to present, but the wait semaphores still have to be consumed
+    // so they can be signaled again
+    if (renderer->settings.headless) {
+        if (wait_semaphore_count > 0) {
+            TINY_RENDERER_DECLARE_ZERO(VkPipelineStageFlags, wait_dst_stage_masks[tr_max_present_wait_semaphores]);
+            for (uint32_t i = 0; i < wait_semaphore_count; ++i) {
+                wait_dst_stage_masks[i] = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+            }
 
-    VkImageView* iter_attachments = attachments;
-    // Color
-    for (uint32_t i = 0; i < p_render_target->color_attachment_count; ++i) {
-        *iter_attachments = p_render_target->color_attachments[i]->vk_image_view;
-        ++iter_attachments;
-        if (p_render_target->sample_count > tr_sample_count_1) {
-            *iter_attachments = p_render_target->color_attachments_multisample[i]->vk_image_view;
-            ++iter_attachments;
+            TINY_RENDERER_DECLARE_ZERO(VkSubmitInfo, submit_info);
+            submit_info.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submit_info.waitSemaphoreCount = wait_semaphore_count;
+            submit_info.pWaitSemaphores    = wait_semaphores;
+            submit_info.pWaitDstStageMask  = wait_dst_stage_masks;
+            VkResult vk_res = vkQueueSubmit(p_queue->vk_queue, 1, &submit_info, VK_NULL_HANDLE);
+            assert(VK_SUCCESS == vk_res);
         }
-    }
-    // Depth/stencil
-    if (tr_format_undefined != p_render_target->depth_stencil_format) {
-        *iter_attachments = p_render_target->depth_stencil_attachment->vk_image_view;
-        ++iter_attachments;
+        return;
     }
 
-    TINY_RENDERER_DECLARE_ZERO(VkFramebufferCreateInfo, create_info);
-    create_info.sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-    create_info.pNext           = NULL;
-    create_info.flags           = 0;
-    create_info.renderPass      = p_render_target->vk_render_pass;
-    create_info.attachmentCount = attachment_count;
-    create_info.pAttachments    = attachments;
-    create_info.width           = p_render_target->width;;
-    create_info.height          = p_render_target->height;
-    create_info.layers          = 1;
-    VkResult vk_res = vkCreateFramebuffer(p_renderer->vk_device, &create_info, NULL, &(p_render_target->vk_framebuffer));
-    assert(VK_SUCCESS == vk_res);
+    TINY_RENDERER_DECLARE_ZERO(VkPresentInfoKHR, present_info);
+    present_info.sType              = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+    present_info.pNext              = NULL;
+    present_info.waitSemaphoreCount = wait_semaphore_count;
+    present_info.pWaitSemaphores    = wait_semaphores;
+    present_info.swapchainCount     = 1;
+    present_info.pSwapchains        = &(renderer->vk_swapchain);
+    present_info.pImageIndices      = &(renderer->swapchain_image_index);
+    present_info.pResults           = NULL;
 
-    TINY_RENDERER_SAFE_FREE(attachments);
+    VkResult vk_res = vkQueuePresentKHR(s_tr_internal->renderer->present_queue->vk_queue, &present_info);
+    assert(VK_SUCCESS == vk_res);
 }
 
-void tr_internal_vk_create_render_target(tr_renderer* p_renderer, bool is_swapchain, tr_render_target* p_render_target)
+static void tr_internal_vk_queue_wait(tr_queue* p_queue, bool idle)
 {
-    tr_internal_vk_create_render_pass(p_renderer, is_swapchain, p_render_target);
-    tr_internal_vk_create_framebuffer(p_renderer, p_render_target);
+    assert(VK_NULL_HANDLE != p_queue->vk_queue);
+
+    // Batched uploads are part of the work the caller is waiting for
+    tr_staging_ring* p_ring = tr_internal_vk_find_staging_ring(p_queue->renderer, p_queue->vk_queue_family_index);
+    if ((NULL != p_ring) && p_ring->recording) {
+        tr_internal_vk_queue_submit(p_queue, 0, NULL, 0, NULL, 0, NULL, NULL);
+    }
+
+    // The queue timeline covers everything submitted through tr_internal_vk_queue_submit,
+    // but not the raw submits of the headless acquire and present
+    if ((! idle) && (NULL != p_queue->timeline)) {
+        TINY_RENDERER_TRACE_NAMED_SCOPE(p_queue, "vkWaitSemaphores");
+        tr_internal_vk_timeline_wait(p_queue->timeline, p_queue->submit_value, UINT64_MAX);
+    }
+    else {
+        TINY_RENDERER_TRACE_NAMED_SCOPE(p_queue, "vkQueueWaitIdle");
+        VkResult vk_res = vkQueueWaitIdle(p_queue->vk_queue);
+        assert(VK_SUCCESS == vk_res);
+    }
+
+    // Everything submitted to the queue is done, hand the staging space back
+    if (NULL != p_ring) {
+        tr_internal_vk_staging_ring_retire(p_ring, false);
+    }
 }
 
-void tr_internal_vk_destroy_render_target(tr_renderer* p_renderer, tr_render_target* p_render_target)
+void tr_internal_vk_queue_wait_idle(tr_queue* p_queue)
 {
-    assert(VK_NULL_HANDLE != p_renderer->vk_device);
-    assert(VK_NULL_HANDLE != p_render_target->vk_render_pass);
+    tr_internal_vk_queue_wait(p_queue, true);
+}
 
-    vkDestroyFramebuffer(p_renderer->vk_device, p_render_target->vk_framebuffer, NULL);
-    vkDestroyRenderPass(p_renderer->vk_device, p_render_target->vk_render_pass, NULL);
+// Waits for the queue's submits only, which is cheaper than draining the queue
+void tr_internal_vk_queue_wait_submits(tr_queue* p_queue)
+{
+    tr_internal_vk_queue_wait(p_queue, false);
 }
 
 // -------------------------------------------------------------------------------------------------
-// Internal descriptor set functions
+// Internal frame functions
 // -------------------------------------------------------------------------------------------------
-void tr_internal_vk_update_descriptor_set(tr_renderer* p_renderer, tr_descriptor_set* p_descriptor_set)
+// Frames wait on the graphics queue timeline for their submit, the fence is only used without it
+static void tr_internal_vk_wait_frame(tr_renderer* p_renderer, tr_frame* p_frame)
 {
-    assert(VK_NULL_HANDLE != p_renderer->vk_device);
-    assert(VK_NULL_HANDLE != p_descriptor_set->vk_descriptor_set);
+    tr_timeline* p_timeline = p_renderer->graphics_queue->timeline;
+    if ((NULL != p_timeline) && (p_frame->submit_value > 0)) {
+        TINY_RENDERER_TRACE_NAMED_SCOPE(p_renderer, "vkWaitSemaphores");
+        tr_internal_vk_timeline_wait(p_timeline, p_frame->submit_value, UINT64_MAX);
+        p_frame->submit_value = 0;
+    }
 
-    // Not really efficient, just write less frequently ;)
-    uint32_t write_count = 0;
-    uint32_t sampler_view_count = 0;
-    uint32_t image_view_count = 0;
-    uint32_t buffer_view_count = 0;
-    for (uint32_t descriptor_index = 0; descriptor_index < p_descriptor_set->descriptor_count; ++descriptor_index) {
-        tr_descriptor* descriptor = &(p_descriptor_set->descriptors[descriptor_index]);
-        switch (descriptor->type) {
-            case tr_descriptor_type_sampler: {
-                sampler_view_count += descriptor->count;
-                ++write_count;
-            }
-            break;
+    if (p_frame->fence_pending) {
+        TINY_RENDERER_TRACE_NAMED_SCOPE(p_renderer, "vkWaitForFences");
+        VkResult vk_res = vkWaitForFences(p_renderer->vk_device, 1, &(p_frame->fence->vk_fence), VK_TRUE, UINT64_MAX);
+        assert(VK_SUCCESS == vk_res);
 
-            case tr_descriptor_type_uniform_buffer_cbv:
-            case tr_descriptor_type_storage_buffer_srv:
-            case tr_descriptor_type_storage_buffer_uav:
-            case tr_descriptor_type_uniform_texel_buffer_srv:
-            case tr_descriptor_type_storage_texel_buffer_uav: {
-                buffer_view_count += descriptor->count;
-                ++write_count;
-            }
-            break;
+        vk_res = vkResetFences(p_renderer->vk_device, 1, &(p_frame->fence->vk_fence));
+        assert(VK_SUCCESS == vk_res);
+
+        p_frame->fence_pending = false;
+    }
+}
+
+void tr_internal_vk_create_frames(tr_renderer* p_renderer)
+{
+    uint32_t frame_count = p_renderer->settings.frames_in_flight;
+    if (0 == frame_count) {
+        frame_count = TINY_RENDERER_DEFAULT_FRAMES_IN_FLIGHT;
+    }
+    frame_count = frame_count > tr_max_frames_in_flight ? tr_max_frames_in_flight : frame_count;
+    // Headless images are handed out round robin without waiting, waiting on the frame slot
+    // only keeps an image from being reused while in flight if there are no more frames than images
+    if (p_renderer->settings.headless) {
+        frame_count = tr_min(frame_count, tr_max(p_renderer->settings.swapchain.image_count, 1));
+    }
+
+    p_renderer->frames = (tr_frame*)calloc(frame_count, sizeof(*(p_renderer->frames)));
+    assert(NULL != p_renderer->frames);
+
+    // Each frame gets its own pool so a slot's command buffer can be reset
+    // while the other frames are still in flight
+    for (uint32_t i = 0; i < frame_count; ++i) {
+        tr_frame* p_frame = &(p_renderer->frames[i]);
+        p_frame->index = i;
+        tr_create_cmd_pool(p_renderer, p_renderer->graphics_queue, true, &(p_frame->cmd_pool));
+        tr_create_cmd(p_frame->cmd_pool, false, &(p_frame->cmd));
+        tr_create_fence(p_renderer, &(p_frame->fence));
+        tr_create_semaphore(p_renderer, &(p_frame->image_acquired_semaphore));
+        tr_create_semaphore(p_renderer, &(p_frame->render_complete_semaphore));
 
-            case tr_descriptor_type_texture_srv:
-            case tr_descriptor_type_texture_uav: {
-                image_view_count += descriptor->count;
-                ++write_count;
+        // Pools for the recording threads are created up front, creating them on first use
+        // would have the threads racing on the frame
+        uint32_t thread_count = tr_min(p_renderer->settings.recording_thread_count, (uint32_t)tr_max_recording_threads);
+        if (thread_count > 0) {
+            p_frame->threads = (tr_frame_thread*)calloc(thread_count, sizeof(*(p_frame->threads)));
+            assert(NULL != p_frame->threads);
+            for (uint32_t j = 0; j < thread_count; ++j) {
+                tr_create_cmd_pool(p_renderer, p_renderer->graphics_queue, true, &(p_frame->threads[j].cmd_pool));
             }
-            break;
+            p_frame->thread_count = thread_count;
         }
     }
-    // Bail if there's nothing to write
-    if (0 == write_count) {
+
+    p_renderer->frame_count = frame_count;
+    p_renderer->frame_index = 0;
+}
+
+void tr_internal_vk_destroy_frames(tr_renderer* p_renderer)
+{
+    if (NULL == p_renderer->frames) {
         return;
     }
 
-    VkWriteDescriptorSet* writes = (VkWriteDescriptorSet*)calloc(write_count, sizeof(*writes));
-    assert(NULL != writes);
-    VkDescriptorImageInfo* sampler_views = (VkDescriptorImageInfo*)calloc(sampler_view_count, sizeof(*sampler_views));
-    assert(NULL != sampler_views);
-    VkDescriptorImageInfo* image_views = (VkDescriptorImageInfo*)calloc(image_view_count, sizeof(*image_views));
-    assert(NULL != image_views);
-    VkDescriptorBufferInfo* buffer_views = (VkDescriptorBufferInfo*)calloc(buffer_view_count, sizeof(*buffer_views));
-    assert(NULL != buffer_views);
-
-    uint32_t write_index = 0;
-    uint32_t sampler_view_index = 0;
-    uint32_t texture_view_index = 0;
-    uint32_t buffer_view_index = 0;
-    for (uint32_t descriptor_index = 0; descriptor_index < p_descriptor_set->descriptor_count; ++descriptor_index) {
-        tr_descriptor* descriptor = &(p_descriptor_set->descriptors[descriptor_index]);
-        if ((NULL == descriptor->samplers) && (NULL == descriptor->textures) && (NULL == descriptor->uniform_buffers)) {
-            continue;
-        }
+    for (uint32_t i = 0; i < p_renderer->frame_count; ++i) {
+        tr_frame* p_frame = &(p_renderer->frames[i]);
+        tr_internal_vk_wait_frame(p_renderer, p_frame);
+        tr_destroy_semaphore(p_renderer, p_frame->render_complete_semaphore);
+        tr_destroy_semaphore(p_renderer, p_frame->image_acquired_semaphore);
+        tr_destroy_fence(p_renderer, p_frame->fence);
+        tr_destroy_cmd(p_frame->cmd_pool, p_frame->cmd);
+        tr_destroy_cmd_pool(p_renderer, p_frame->cmd_pool);
 
-        writes[write_index].sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        writes[write_index].pNext           = NULL;
-        writes[write_index].dstSet          = p_descriptor_set->vk_descriptor_set;
-        writes[write_index].dstBinding      = descriptor->binding;
-        writes[write_index].dstArrayElement = 0;
-        writes[write_index].descriptorCount = descriptor->count;
-        switch (descriptor->type) {
-            case tr_descriptor_type_sampler: {
-                assert(NULL != descriptor->samplers);
-
-                writes[write_index].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
-                writes[write_index].pImageInfo = &(sampler_views[sampler_view_index]);
-                for (uint32_t i = 0; i < descriptor->count; ++i) {
-                    memcpy(&(sampler_views[sampler_view_index]), 
-                           &(descriptor->samplers[i]->vk_sampler_view),
-                           sizeof(descriptor->samplers[i]->vk_sampler_view));
-                    ++sampler_view_index;
-                }
+        for (uint32_t j = 0; j < p_frame->thread_count; ++j) {
+            tr_frame_thread* p_thread = &(p_frame->threads[j]);
+            for (uint32_t k = 0; k < p_thread->cmd_count; ++k) {
+                tr_destroy_cmd(p_thread->cmd_pool, p_thread->cmds[k]);
             }
-            break;
+            tr_destroy_cmd_pool(p_renderer, p_thread->cmd_pool);
+            TINY_RENDERER_SAFE_FREE(p_thread->cmds);
+        }
+        TINY_RENDERER_SAFE_FREE(p_frame->threads);
+        TINY_RENDERER_SAFE_FREE(p_frame->submit_cmds);
+    }
 
-            case tr_descriptor_type_uniform_buffer_cbv: {
-                assert(NULL != descriptor->uniform_buffers);
+    TINY_RENDERER_SAFE_FREE(p_renderer->frames);
+    p_renderer->frame_count = 0;
+}
 
-                writes[write_index].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-                writes[write_index].pBufferInfo = &(buffer_views[buffer_view_index]);
-                for (uint32_t i = 0; i < descriptor->count; ++i) {
-                    memcpy(&(buffer_views[buffer_view_index]), 
-                           &(descriptor->uniform_buffers[i]->vk_buffer_info),
-                           sizeof(descriptor->uniform_buffers[i]->vk_buffer_info));
-                    ++buffer_view_index;
-                }
-            }
-            break;
+void tr_internal_vk_begin_frame(tr_renderer* p_renderer, tr_frame** pp_frame)
+{
+    assert(VK_NULL_HANDLE != p_renderer->vk_device);
+    assert(NULL != p_renderer->frames);
 
-            case tr_descriptor_type_storage_buffer_srv: {
-                assert(NULL != descriptor->buffers);
+    tr_frame* p_frame = &(p_renderer->frames[p_renderer->frame_index]);
 
-                writes[write_index].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-                writes[write_index].pBufferInfo = &(buffer_views[buffer_view_index]);
-                for (uint32_t i = 0; i < descriptor->count; ++i) {
-                    memcpy(&(buffer_views[buffer_view_index]), 
-                           &(descriptor->buffers[i]->vk_buffer_info),
-                           sizeof(descriptor->buffers[i]->vk_buffer_info));
-                    ++buffer_view_index;
-                }
-            }
-            break;
+    // Only the frame that last used this slot has to be done before its
+    // command buffer and semaphores can be reused
+    tr_internal_vk_wait_frame(p_renderer, p_frame);
 
-            case tr_descriptor_type_storage_buffer_uav: {
-                assert(NULL != descriptor->buffers);
+    // One reset per recording thread covers every command buffer it took last time
+    for (uint32_t i = 0; i < p_frame->thread_count; ++i) {
+        tr_frame_thread* p_thread = &(p_frame->threads[i]);
+        if (p_thread->used_count > 0) {
+            VkResult vk_res = vkResetCommandPool(p_renderer->vk_device, p_thread->cmd_pool->vk_cmd_pool, 0);
+            assert(VK_SUCCESS == vk_res);
+            p_thread->used_count = 0;
+        }
+    }
 
-                writes[write_index].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-                writes[write_index].pBufferInfo = &(buffer_views[buffer_view_index]);
-                for (uint32_t i = 0; i < descriptor->count; ++i) {
-                    memcpy(&(buffer_views[buffer_view_index]), 
-                           &(descriptor->buffers[i]->vk_buffer_info),
-                           sizeof(descriptor->buffers[i]->vk_buffer_info));
-                    ++buffer_view_index;
-                }
-            }
-            break;
+    // Headless frames don't wait on an acquire, so don't pay for the empty submit
+    tr_semaphore* p_acquire_semaphore = p_renderer->settings.headless ? NULL : p_frame->image_acquired_semaphore;
+    tr_internal_vk_acquire_next_image(p_renderer, p_acquire_semaphore, NULL);
+    p_frame->swapchain_image_index = p_renderer->swapchain_image_index;
+    p_frame->render_target = p_renderer->swapchain_render_targets[p_frame->swapchain_image_index];
 
-            case tr_descriptor_type_uniform_texel_buffer_srv: {
-                assert(NULL != descriptor->buffers);
+    tr_internal_vk_begin_cmd(p_frame->cmd, NULL);
 
-                writes[write_index].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
-                writes[write_index].pBufferInfo = &(buffer_views[buffer_view_index]);
-                for (uint32_t i = 0; i < descriptor->count; ++i) {
-                    memcpy(&(buffer_views[buffer_view_index]), 
-                           &(descriptor->buffers[i]->vk_buffer_info),
-                           sizeof(descriptor->buffers[i]->vk_buffer_info));
-                    ++buffer_view_index;
-                }
-            }
-            break;
+    *pp_frame = p_frame;
+}
 
-            case tr_descriptor_type_storage_texel_buffer_uav: {
-                assert(NULL != descriptor->buffers);
+void tr_internal_vk_end_frame(tr_renderer* p_renderer, tr_frame* p_frame)
+{
+    tr_internal_vk_end_cmd(p_frame->cmd);
 
-                writes[write_index].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER;
-                writes[write_index].pBufferInfo = &(buffer_views[buffer_view_index]);
-                for (uint32_t i = 0; i < descriptor->count; ++i) {
-                    memcpy(&(buffer_views[buffer_view_index]), 
-                           &(descriptor->buffers[i]->vk_buffer_info),
-                           sizeof(descriptor->buffers[i]->vk_buffer_info));
-                    ++buffer_view_index;
-                }
+    // Everything goes into one submit so waiting on the frame covers the thread command buffers too
+    uint32_t cmd_count = 1;
+    for (uint32_t i = 0; i < p_frame->thread_count; ++i) {
+        cmd_count += p_frame->threads[i].used_count;
+    }
+    if (cmd_count > p_frame->submit_cmd_capacity) {
+        p_frame->submit_cmds = (tr_cmd**)realloc(p_frame->submit_cmds, cmd_count * sizeof(*(p_frame->submit_cmds)));
+        assert(NULL != p_frame->submit_cmds);
+        p_frame->submit_cmd_capacity = cmd_count;
+    }
+    cmd_count = 0;
+    for (uint32_t i = 0; i < p_frame->thread_count; ++i) {
+        tr_frame_thread* p_thread = &(p_frame->threads[i]);
+        for (uint32_t j = 0; j < p_thread->used_count; ++j) {
+            if (! p_thread->cmds[j]->secondary) {
+                p_frame->submit_cmds[cmd_count++] = p_thread->cmds[j];
             }
-            break;
+        }
+    }
+    p_frame->submit_cmds[cmd_count++] = p_frame->cmd;
 
-            case tr_descriptor_type_texture_srv: {
-                assert(NULL != descriptor->textures);
+    tr_queue* p_queue = p_renderer->graphics_queue;
+    tr_fence* p_fence = (NULL != p_queue->timeline) ? NULL : p_frame->fence;
+    if (p_renderer->settings.headless) {
+        // Waiting on the frame is all the synchronization an offscreen frame needs
+        tr_internal_vk_queue_submit(p_queue, cmd_count, p_frame->submit_cmds, 0, NULL, 0, NULL, p_fence);
+    }
+    else {
+        tr_internal_vk_queue_submit(p_queue, 
+                                    cmd_count, p_frame->submit_cmds, 
+                                    1, &(p_frame->image_acquired_semaphore), 
+                                    1, &(p_frame->render_complete_semaphore), 
+                                    p_fence);
 
-                writes[write_index].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
-                writes[write_index].pImageInfo = &(image_views[texture_view_index]);
-                for (uint32_t i = 0; i < descriptor->count; ++i) {
-                    memcpy(&(image_views[texture_view_index]), 
-                           &(descriptor->textures[i]->vk_texture_view),
-                           sizeof(descriptor->textures[i]->vk_texture_view));
-                    ++texture_view_index;
-                }
-            }
-            break;
+        tr_internal_vk_queue_present(p_renderer->present_queue, 1, &(p_frame->render_complete_semaphore));
+    }
+    p_frame->fence_pending = (NULL != p_fence);
+    p_frame->submit_value = p_queue->submit_value;
 
-            case tr_descriptor_type_texture_uav: {
-                assert(NULL != descriptor->textures);
+    p_renderer->frame_index = (p_renderer->frame_index + 1) % p_renderer->frame_count;
+}
 
-                writes[write_index].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-                writes[write_index].pImageInfo = &(image_views[texture_view_index]);
-                for (uint32_t i = 0; i < descriptor->count; ++i) {
-                    memcpy(&(image_views[texture_view_index]), 
-                           &(descriptor->textures[i]->vk_texture_view),
-                           sizeof(descriptor->textures[i]->vk_texture_view));
-                    ++texture_view_index;
-                }
-            }
-            break;
+void tr_internal_vk_frame_get_thread_cmd(tr_frame* p_frame, uint32_t thread_index, bool secondary, tr_cmd** pp_cmd)
+{
+    tr_frame_thread* p_thread = &(p_frame->threads[thread_index]);
 
+    // Reuse a left over command buffer of the same level, or make a new one
+    uint32_t index = p_thread->used_count;
+    while ((index < p_thread->cmd_count) && (p_thread->cmds[index]->secondary != secondary)) {
+        ++index;
+    }
+    if (index == p_thread->cmd_count) {
+        if (p_thread->cmd_count == p_thread->cmd_capacity) {
+            uint32_t capacity = (p_thread->cmd_capacity > 0) ? (2 * p_thread->cmd_capacity) : 4;
+            p_thread->cmds = (tr_cmd**)realloc(p_thread->cmds, capacity * sizeof(*(p_thread->cmds)));
+            assert(NULL != p_thread->cmds);
+            p_thread->cmd_capacity = capacity;
         }
-
-        ++write_index;
+        tr_create_cmd(p_thread->cmd_pool, secondary, &(p_thread->cmds[index]));
+        ++p_thread->cmd_count;
     }
 
-    uint32_t copy_count = 0;
-    VkCopyDescriptorSet* copies = NULL;
-
-    vkUpdateDescriptorSets(p_renderer->vk_device, write_count, writes, copy_count, copies);
+    // Keep cmds[0, used_count) in the order they were handed out
+    tr_cmd* p_cmd = p_thread->cmds[index];
+    p_thread->cmds[index] = p_thread->cmds[p_thread->used_count];
+    p_thread->cmds[p_thread->used_count] = p_cmd;
+    ++p_thread->used_count;
 
-    TINY_RENDERER_SAFE_FREE(sampler_views);
-    TINY_RENDERER_SAFE_FREE(image_views);
-    TINY_RENDERER_SAFE_FREE(buffer_views);
-    TINY_RENDERER_SAFE_FREE(writes);
+    *pp_cmd = p_cmd;
 }
 
 // -------------------------------------------------------------------------------------------------
-// Internal command buffer functions
+// Internal query functions
 // -------------------------------------------------------------------------------------------------
-void tr_internal_vk_begin_cmd(tr_cmd* p_cmd)
+void tr_internal_vk_create_query_pool(tr_renderer* p_renderer, tr_query_pool* p_query_pool)
 {
-    assert(VK_NULL_HANDLE != p_cmd->vk_cmd_buf);
+    assert(VK_NULL_HANDLE != p_renderer->vk_device);
 
-    TINY_RENDERER_DECLARE_ZERO(VkCommandBufferBeginInfo, begin_info);
-    begin_info.sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;;
-    begin_info.pNext            = NULL;
-    begin_info.flags            = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
-    begin_info.pInheritanceInfo = NULL;
-    VkResult vk_res = vkBeginCommandBuffer(p_cmd->vk_cmd_buf, &begin_info);
-    assert(VK_SUCCESS == vk_res);
-}
+    // One slot more than the frames in flight, see tr_query_pool
+    uint32_t frame_count = (p_renderer->frame_count > 0) ? p_renderer->frame_count : TINY_RENDERER_DEFAULT_FRAMES_IN_FLIGHT;
+    p_query_pool->slot_count = frame_count + 1;
+    p_query_pool->slot_index = p_query_pool->slot_count - 1;
 
-void tr_internal_vk_end_cmd(tr_cmd* p_cmd)
-{
-    assert(VK_NULL_HANDLE != p_cmd->vk_cmd_buf);
+    VkPhysicalDeviceFeatures gpu_features = { 0 };
+    vkGetPhysicalDeviceFeatures(p_renderer->vk_active_gpu, &gpu_features);
 
-    VkResult vk_res = vkEndCommandBuffer(p_cmd->vk_cmd_buf);
-    assert(VK_SUCCESS == vk_res);
-}
+    // Pools the device can't back record nothing and never resolve
+    bool supported = true;
+    VkQueryType vk_query_type = VK_QUERY_TYPE_TIMESTAMP;
+    VkQueryPipelineStatisticFlags vk_pipeline_statistics = 0;
+    switch (p_query_pool->type) {
+        case tr_query_type_timestamp: {
+            p_query_pool->slot_query_count = 2 * p_query_pool->query_count;
+            p_query_pool->result_stride    = 1;
 
-void tr_internal_vk_cmd_begin_render(tr_cmd* p_cmd, tr_render_target* p_render_target)
-{
-    assert(VK_NULL_HANDLE != p_cmd->vk_cmd_buf);
-    assert(VK_NULL_HANDLE != p_render_target->vk_render_pass);
-    assert(VK_NULL_HANDLE != p_render_target->vk_framebuffer);
+            uint32_t valid_bits = p_renderer->graphics_queue->vk_timestamp_valid_bits;
+            supported = (valid_bits > 0);
+            p_query_pool->timestamp_mask   = (valid_bits >= 64) ? UINT64_MAX : ((1ULL << valid_bits) - 1);
+            p_query_pool->timestamp_period = p_renderer->vk_active_gpu_properties.limits.timestampPeriod;
+        }
+        break;
 
-    TINY_RENDERER_DECLARE_ZERO(VkRect2D, render_area);
-    render_area.offset.x = 0;
-    render_area.offset.y = 0;
-    render_area.extent.width = p_render_target->width;
-    render_area.extent.height = p_render_target->height;
+        case tr_query_type_pipeline_statistics: {
+            p_query_pool->slot_query_count = p_query_pool->query_count;
+            p_query_pool->result_stride    = 4;
 
-    // Multiply by 2 in case there's multisampling
-    TINY_RENDERER_DECLARE_ZERO(VkClearValue, clear_values[(2 * tr_max_render_target_attachments) + 1]);
-    
-    uint32_t color_count = p_render_target->color_attachment_count;
-    for (uint32_t i = 0; i < color_count; ++i) {
-        clear_values[i].color.float32[0] = p_render_target->color_attachments[i]->clear_value.r;
-        clear_values[i].color.float32[1] = p_render_target->color_attachments[i]->clear_value.g;
-        clear_values[i].color.float32[2] = p_render_target->color_attachments[i]->clear_value.b;
-        clear_values[i].color.float32[3] = p_render_target->color_attachments[i]->clear_value.a;
-        if (p_render_target->sample_count > tr_sample_count_1) {
-            clear_values[i].color.float32[0] = p_render_target->color_attachments_multisample[i]->clear_value.r;
-            clear_values[i].color.float32[1] = p_render_target->color_attachments_multisample[i]->clear_value.g;
-            clear_values[i].color.float32[2] = p_render_target->color_attachments_multisample[i]->clear_value.b;
-            clear_values[i].color.float32[3] = p_render_target->color_attachments_multisample[i]->clear_value.a;
+            supported = (VK_TRUE == gpu_features.pipelineStatisticsQuery);
+            vk_query_type = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+            vk_pipeline_statistics = tr_internal_vk_pipeline_statistics;
         }
+        break;
+
+        case tr_query_type_occlusion: {
+            p_query_pool->slot_query_count = p_query_pool->query_count;
+            p_query_pool->result_stride    = 2;
+
+            vk_query_type = VK_QUERY_TYPE_OCCLUSION;
+        }
+        break;
     }
-    uint32_t depth_stencil_count = (tr_format_undefined != p_render_target->depth_stencil_format) ? 1 : 0;
-    if (depth_stencil_count > 0) {
-        clear_values[color_count].depthStencil.depth = p_render_target->depth_stencil_attachment->clear_value.depth;
-        clear_values[color_count].depthStencil.stencil = p_render_target->depth_stencil_attachment->clear_value.stencil;
+
+    p_query_pool->slot_used_counts = (uint32_t*)calloc(p_query_pool->slot_count, sizeof(*(p_query_pool->slot_used_counts)));
+    assert(NULL != p_query_pool->slot_used_counts);
+    p_query_pool->slot_frame_numbers = (uint64_t*)calloc(p_query_pool->slot_count, sizeof(*(p_query_pool->slot_frame_numbers)));
+    assert(NULL != p_query_pool->slot_frame_numbers);
+
+    if (tr_query_type_timestamp == p_query_pool->type) {
+        p_query_pool->query_data = (uint64_t*)calloc(p_query_pool->slot_query_count, sizeof(*(p_query_pool->query_data)));
+        assert(NULL != p_query_pool->query_data);
+        p_query_pool->resolved_timer_ms = (double*)calloc(p_query_pool->query_count, sizeof(*(p_query_pool->resolved_timer_ms)));
+        assert(NULL != p_query_pool->resolved_timer_ms);
+        p_query_pool->timer_names = (const char**)calloc(p_query_pool->slot_count * p_query_pool->query_count, sizeof(*(p_query_pool->timer_names)));
+        assert(NULL != p_query_pool->timer_names);
+    }
+    else {
+        p_query_pool->resolved_results = (uint64_t*)calloc(p_query_pool->query_count * (p_query_pool->result_stride - 1), sizeof(*(p_query_pool->resolved_results)));
+        assert(NULL != p_query_pool->resolved_results);
     }
 
-    uint32_t clear_value_count = color_count;
-    if (p_render_target->sample_count > tr_sample_count_1) {
-        clear_value_count *= 2;
+    if (! supported) {
+        return;
     }
-    clear_value_count += depth_stencil_count;
 
-    TINY_RENDERER_DECLARE_ZERO(VkRenderPassBeginInfo, begin_info);
-    begin_info.sType           = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-    begin_info.pNext           = NULL;
-    begin_info.renderPass      = p_render_target->vk_render_pass;
-    begin_info.framebuffer     = p_render_target->vk_framebuffer;
-    begin_info.renderArea      = render_area;
-    begin_info.clearValueCount = clear_value_count;
-    begin_info.pClearValues    = clear_values;
+    TINY_RENDERER_DECLARE_ZERO(VkQueryPoolCreateInfo, create_info);
+    create_info.sType              = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    create_info.pNext              = NULL;
+    create_info.flags              = 0;
+    create_info.queryType          = vk_query_type;
+    create_info.queryCount         = p_query_pool->slot_count * p_query_pool->slot_query_count;
+    create_info.pipelineStatistics = vk_pipeline_statistics;
+    VkResult vk_res = vkCreateQueryPool(p_renderer->vk_device, &create_info, NULL, &(p_query_pool->vk_query_pool));
+    assert(VK_SUCCESS == vk_res);
 
-    vkCmdBeginRenderPass(p_cmd->vk_cmd_buf, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
+    if (tr_query_type_timestamp != p_query_pool->type) {
+        uint64_t size = (uint64_t)p_query_pool->slot_count * p_query_pool->slot_query_count * p_query_pool->result_stride * sizeof(uint64_t);
+        tr_create_buffer(p_renderer, tr_buffer_usage_storage_srv, size, true, &(p_query_pool->results_buffer));
+        // Zeroed availability words are what mark a query as not resolved yet
+        memset(p_query_pool->results_buffer->cpu_mapped_address, 0, (size_t)size);
+    }
 }
 
-void tr_internal_vk_cmd_end_render(tr_cmd* p_cmd)
+void tr_internal_vk_destroy_query_pool(tr_renderer* p_renderer, tr_query_pool* p_query_pool)
 {
-    assert(VK_NULL_HANDLE != p_cmd->vk_cmd_buf);
+    assert(VK_NULL_HANDLE != p_renderer->vk_device);
 
-    vkCmdEndRenderPass(p_cmd->vk_cmd_buf);
+    if (VK_NULL_HANDLE != p_query_pool->vk_query_pool) {
+        vkDestroyQueryPool(p_renderer->vk_device, p_query_pool->vk_query_pool, NULL);
+    }
 }
 
-void tr_internal_vk_cmd_set_viewport(tr_cmd* p_cmd, float x, float y, float width, float height, float min_depth, float max_depth)
+// Resolves a slot's timestamps with vkGetQueryPoolResults - no VK_QUERY_RESULT_WAIT_BIT, so this
+// returns VK_NOT_READY instead of stalling if the GPU hasn't gotten to it
+static bool tr_internal_vk_read_timers(tr_query_pool* p_query_pool, uint32_t slot_index, uint32_t used_count)
 {
-    assert(VK_NULL_HANDLE != p_cmd->vk_cmd_buf);
+    uint32_t query_count = 2 * used_count;
+    VkResult vk_res = vkGetQueryPoolResults(p_query_pool->renderer->vk_device,
+                                            p_query_pool->vk_query_pool,
+                                            slot_index * p_query_pool->slot_query_count,
+                                            query_count,
+                                            query_count * sizeof(*(p_query_pool->query_data)),
+                                            p_query_pool->query_data,
+                                            sizeof(*(p_query_pool->query_data)),
+                                            VK_QUERY_RESULT_64_BIT);
+    if (VK_SUCCESS != vk_res) {
+        return false;
+    }
 
-    TINY_RENDERER_DECLARE_ZERO(VkViewport, viewport);
+    tr_tracer* p_tracer = p_query_pool->renderer->tracer;
+    for (uint32_t i = 0; i < used_count; ++i) {
+        uint64_t ticks = (p_query_pool->query_data[2 * i + 1] - p_query_pool->query_data[2 * i]) & p_query_pool->timestamp_mask;
+        p_query_pool->resolved_timer_ms[i] = (double)ticks * p_query_pool->timestamp_period / 1000000.0;
 
-    // Because some IHVs decide to implement negative viewport height differently
-    if (p_cmd->cmd_pool->renderer->vk_device_ext_VK_AMD_negative_viewport_height) {
-      viewport.x = x;
-      viewport.y = 0;
-      viewport.width = width;
-      viewport.height = -height;
-      viewport.minDepth = min_depth;
-      viewport.maxDepth = max_depth;
-    }
-    else {
-      viewport.x = x;
-      viewport.y = height;
-      viewport.width = width;
-      viewport.height = -height;
-      viewport.minDepth = min_depth;
-      viewport.maxDepth = max_depth;
+        if (NULL != p_tracer) {
+            const char* name = p_query_pool->timer_names[slot_index * p_query_pool->query_count + i];
+            tr_internal_trace_add_gpu_event(p_tracer, name, p_query_pool->query_data[2 * i], p_query_pool->query_data[2 * i + 1]);
+        }
     }
-    vkCmdSetViewport(p_cmd->vk_cmd_buf, 0, 1, &viewport);
+    return true;
 }
 
-void tr_internal_vk_cmd_set_scissor(tr_cmd* p_cmd, uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+// Resolves a slot's results from what tr_cmd_resolve_queries copied into the results buffer
+static bool tr_internal_vk_read_results(tr_query_pool* p_query_pool, uint32_t slot_index, uint32_t used_count)
 {
-    assert(VK_NULL_HANDLE != p_cmd->vk_cmd_buf);
+    uint32_t stride = p_query_pool->result_stride;
+    uint64_t* p_slot = (uint64_t*)p_query_pool->results_buffer->cpu_mapped_address + slot_index * p_query_pool->slot_query_count * stride;
+    for (uint32_t i = 0; i < used_count; ++i) {
+        if (0 == p_slot[i * stride + stride - 1]) {
+            return false;
+        }
+    }
 
-    TINY_RENDERER_DECLARE_ZERO(VkRect2D, rect);
-    rect.offset.x = x;
-    rect.offset.x = y;
-    rect.extent.width = width;
-    rect.extent.height = height;
-    vkCmdSetScissor(p_cmd->vk_cmd_buf, 0, 1, &rect);
+    for (uint32_t i = 0; i < used_count; ++i) {
+        memcpy(p_query_pool->resolved_results + i * (stride - 1), p_slot + i * stride, (stride - 1) * sizeof(uint64_t));
+    }
+    return true;
 }
 
-void tr_cmd_internal_vk_cmd_clear_color_attachment(tr_cmd* p_cmd, uint32_t attachment_index, const tr_clear_value* clear_value)
+void tr_internal_vk_cmd_begin_query_frame(tr_cmd* p_cmd, tr_query_pool* p_query_pool)
 {
     assert(VK_NULL_HANDLE != p_cmd->vk_cmd_buf);
-    assert(NULL != s_tr_internal->bound_render_target);
 
-    TINY_RENDERER_DECLARE_ZERO(VkClearAttachment, attachment);
-    attachment.aspectMask                  = VK_IMAGE_ASPECT_COLOR_BIT;
-    attachment.colorAttachment             = attachment_index;
-    attachment.clearValue.color.float32[0] = clear_value->r;
-    attachment.clearValue.color.float32[1] = clear_value->g;
-    attachment.clearValue.color.float32[2] = clear_value->b;
-    attachment.clearValue.color.float32[3] = clear_value->a;
-    
-    TINY_RENDERER_DECLARE_ZERO(VkClearRect, rect);
-    rect.baseArrayLayer     = 0;
-    rect.layerCount         = 1;
-    rect.rect.offset.x      = 0;
-    rect.rect.offset.y      = 0;
-    rect.rect.extent.width  = s_tr_internal->bound_render_target->width;
-    rect.rect.extent.height = s_tr_internal->bound_render_target->height;
-    
-    vkCmdClearAttachments(p_cmd->vk_cmd_buf, 1, &attachment, 1, &rect);
-}
+    p_query_pool->slot_index = (p_query_pool->slot_index + 1) % p_query_pool->slot_count;
+    uint32_t slot_index = p_query_pool->slot_index;
 
-void tr_internal_vk_cmd_bind_pipeline(tr_cmd* p_cmd, tr_pipeline* p_pipeline)
-{
-    assert(p_cmd != NULL);
-    assert(p_cmd->vk_cmd_buf != VK_NULL_HANDLE);
-    assert(p_pipeline != NULL);
+    if (VK_NULL_HANDLE == p_query_pool->vk_query_pool) {
+        p_query_pool->slot_used_counts[slot_index] = 0;
+        return;
+    }
 
-    VkPipelineBindPoint pipeline_bind_point 
-        = (p_pipeline->type == tr_pipeline_type_compute) ? VK_PIPELINE_BIND_POINT_COMPUTE
-                                                         : VK_PIPELINE_BIND_POINT_GRAPHICS;
+    // Pick up what the slot recorded last time around
+    uint32_t used_count = p_query_pool->slot_used_counts[slot_index];
+    if (used_count > 0) {
+        bool resolved = (tr_query_type_timestamp == p_query_pool->type)
+                      ? tr_internal_vk_read_timers(p_query_pool, slot_index, used_count)
+                      : tr_internal_vk_read_results(p_query_pool, slot_index, used_count);
+        if (resolved) {
+            p_query_pool->resolved_query_count  = used_count;
+            p_query_pool->resolved_frame_number = p_query_pool->slot_frame_numbers[slot_index];
+        }
+    }
 
-    vkCmdBindPipeline(p_cmd->vk_cmd_buf, pipeline_bind_point, p_pipeline->vk_pipeline);
+    p_query_pool->slot_used_counts[slot_index] = 0;
+    p_query_pool->slot_frame_numbers[slot_index] = ++p_query_pool->frame_number;
 
-    //switch (p_pipeline->type) {
-    //  case tr_pipeline_type_compute:
-    //    vkCmdBindPipeline(p_cmd->vk_cmd_buf, VK_PIPELINE_BIND_POINT_COMPUTE, p_pipeline->vk_pipeline);
-    //    break;
-    //  case tr_pipeline_type_graphics:
-    //    vkCmdBindPipeline(p_cmd->vk_cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, p_pipeline->vk_pipeline);
-    //    break;
-    //  default: break;
-    //}
+    vkCmdResetQueryPool(p_cmd->vk_cmd_buf, p_query_pool->vk_query_pool, slot_index * p_query_pool->slot_query_count, p_query_pool->slot_query_count);
+
+    // Availability words left over from an earlier round, e.g. one that was never read back,
+    // would pass stale results off as this round's. Zero the slot ahead of this round's copy.
+    if (tr_query_type_timestamp != p_query_pool->type) {
+        VkDeviceSize stride = p_query_pool->result_stride * sizeof(uint64_t);
+        VkDeviceSize offset = slot_index * p_query_pool->slot_query_count * stride;
+        VkDeviceSize size   = p_query_pool->slot_query_count * stride;
+
+        VkPipelineStageFlags src_stage_mask = VK_PIPELINE_STAGE_TRANSFER_BIT | (tr_internal_vk_cmd_supported_stages(p_cmd) & tr_internal_vk_shader_stages);
+
+        TINY_RENDERER_DECLARE_ZERO(VkBufferMemoryBarrier, barrier);
+        barrier.sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.pNext               = NULL;
+        barrier.srcAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer              = p_query_pool->results_buffer->vk_buffer;
+        barrier.offset              = offset;
+        barrier.size                = size;
+
+        // Earlier copies and shader reads of the slot finish first, this round's copy waits for the fill
+        tr_internal_vk_cmd_flush_barriers(p_cmd);
+        vkCmdPipelineBarrier(p_cmd->vk_cmd_buf, src_stage_mask, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 1, &barrier, 0, NULL);
+        vkCmdFillBuffer(p_cmd->vk_cmd_buf, p_query_pool->results_buffer->vk_buffer, offset, size, 0);
+        vkCmdPipelineBarrier(p_cmd->vk_cmd_buf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 1, &barrier, 0, NULL);
+    }
 }
 
-void tr_internal_vk_cmd_bind_descriptor_sets(tr_cmd* p_cmd, tr_pipeline* p_pipeline, tr_descriptor_set* p_descriptor_set)
+uint32_t tr_internal_vk_cmd_begin_timer(tr_cmd* p_cmd, tr_query_pool* p_query_pool, const char* name)
 {
-    assert(p_cmd != NULL);
-    assert(p_cmd->vk_cmd_buf != VK_NULL_HANDLE);
-    assert(p_pipeline != NULL);
-    assert(p_pipeline->vk_pipeline_layout != VK_NULL_HANDLE);
-    assert(p_descriptor_set != NULL);
-    assert(p_descriptor_set->vk_descriptor_set != VK_NULL_HANDLE);
+    assert(VK_NULL_HANDLE != p_cmd->vk_cmd_buf);
 
-    VkPipelineBindPoint pipeline_bind_point 
-        = (p_pipeline->type == tr_pipeline_type_compute) ? VK_PIPELINE_BIND_POINT_COMPUTE
-                                                         : VK_PIPELINE_BIND_POINT_GRAPHICS;
+    uint32_t slot_index = p_query_pool->slot_index;
+    uint32_t timer = p_query_pool->slot_used_counts[slot_index];
+    assert(timer < p_query_pool->query_count);
+    ++p_query_pool->slot_used_counts[slot_index];
+    p_query_pool->timer_names[slot_index * p_query_pool->query_count + timer] = name;
 
-    // @TODO: Add dynamic offsets support
-    vkCmdBindDescriptorSets(p_cmd->vk_cmd_buf, pipeline_bind_point, 
-                            p_pipeline->vk_pipeline_layout, 0, 
-                            1, &(p_descriptor_set->vk_descriptor_set), 0, NULL);
+    if (VK_NULL_HANDLE != p_query_pool->vk_query_pool) {
+        uint32_t query = slot_index * p_query_pool->slot_query_count + 2 * timer;
+        vkCmdWriteTimestamp(p_cmd->vk_cmd_buf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, p_query_pool->vk_query_pool, query);
+    }
+
+    return timer;
 }
 
-void tr_internal_vk_cmd_bind_index_buffer(tr_cmd* p_cmd, tr_buffer* p_buffer)
+void tr_internal_vk_cmd_end_timer(tr_cmd* p_cmd, tr_query_pool* p_query_pool, uint32_t timer)
 {
     assert(VK_NULL_HANDLE != p_cmd->vk_cmd_buf);
 
-    VkIndexType vk_index_type = (tr_index_type_uint16 == p_buffer->index_type) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
-    vkCmdBindIndexBuffer(p_cmd->vk_cmd_buf, p_buffer->vk_buffer, 0, vk_index_type);
+    if (VK_NULL_HANDLE != p_query_pool->vk_query_pool) {
+        uint32_t query = p_query_pool->slot_index * p_query_pool->slot_query_count + 2 * timer + 1;
+        vkCmdWriteTimestamp(p_cmd->vk_cmd_buf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, p_query_pool->vk_query_pool, query);
+    }
 }
 
-void tr_internal_vk_cmd_bind_vertex_buffers(tr_cmd* p_cmd, uint32_t buffer_count, tr_buffer** pp_buffers)
+uint32_t tr_internal_vk_cmd_begin_query(tr_cmd* p_cmd, tr_query_pool* p_query_pool)
 {
     assert(VK_NULL_HANDLE != p_cmd->vk_cmd_buf);
 
-    const uint32_t max_buffers = p_cmd->cmd_pool->renderer->vk_active_gpu_properties.limits.maxVertexInputBindings;
-    uint32_t capped_buffer_count = buffer_count > max_buffers ? max_buffers : buffer_count;
-
-    // No upper bound for this, so use 64 for now
-    assert(capped_buffer_count < 64);
+    uint32_t slot_index = p_query_pool->slot_index;
+    uint32_t query = p_query_pool->slot_used_counts[slot_index];
+    assert(query < p_query_pool->query_count);
+    ++p_query_pool->slot_used_counts[slot_index];
 
-    TINY_RENDERER_DECLARE_ZERO(VkBuffer, buffers[64]);
-    TINY_RENDERER_DECLARE_ZERO(VkDeviceSize, offsets[64]);
-    
-    for (uint32_t i = 0; i < capped_buffer_count; ++i) {
-        buffers[i] = pp_buffers[i]->vk_buffer;
+    if (VK_NULL_HANDLE != p_query_pool->vk_query_pool) {
+        vkCmdBeginQuery(p_cmd->vk_cmd_buf, p_query_pool->vk_query_pool, slot_index * p_query_pool->slot_query_count + query, 0);
     }
 
-    vkCmdBindVertexBuffers(p_cmd->vk_cmd_buf, 0, capped_buffer_count, buffers, offsets);
+    return query;
 }
 
-void tr_internal_vk_cmd_draw(tr_cmd* p_cmd, uint32_t vertex_count, uint32_t first_vertex)
+void tr_internal_vk_cmd_end_query(tr_cmd* p_cmd, tr_query_pool* p_query_pool, uint32_t query)
 {
     assert(VK_NULL_HANDLE != p_cmd->vk_cmd_buf);
 
-    vkCmdDraw(p_cmd->vk_cmd_buf, vertex_count, 1, first_vertex, 0);
+    if (VK_NULL_HANDLE != p_query_pool->vk_query_pool) {
+        vkCmdEndQuery(p_cmd->vk_cmd_buf, p_query_pool->vk_query_pool, p_query_pool->slot_index * p_query_pool->slot_query_count + query);
+    }
 }
 
-void tr_internal_vk_cmd_draw_indexed(tr_cmd* p_cmd, uint32_t index_count, uint32_t first_index)
+void tr_internal_vk_cmd_resolve_queries(tr_cmd* p_cmd, tr_query_pool* p_query_pool)
 {
     assert(VK_NULL_HANDLE != p_cmd->vk_cmd_buf);
 
-    vkCmdDrawIndexed(p_cmd->vk_cmd_buf, index_count, 1, first_index, 0, 0);
-}
-
-void tr_internal_vk_cmd_buffer_transition(tr_cmd* p_cmd, tr_buffer* p_buffer, tr_buffer_usage old_usage, tr_buffer_usage new_usage)
-{
-    assert(p_cmd != NULL);
-    assert(p_cmd->vk_cmd_buf != VK_NULL_HANDLE);
+    uint32_t slot_index = p_query_pool->slot_index;
+    uint32_t used_count = p_query_pool->slot_used_counts[slot_index];
+    if ((VK_NULL_HANDLE == p_query_pool->vk_query_pool) || (0 == used_count)) {
+        return;
+    }
 
-    VkPipelineStageFlags src_stage_mask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-    VkPipelineStageFlags dst_stage_mask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-    VkDependencyFlags dependency_flags = 0;
-    TINY_RENDERER_DECLARE_ZERO(VkBufferMemoryBarrier , barrier);
+    // The wait bit only holds up the copy on the GPU until the queries are done, the CPU
+    // picks the results up frames later
+    VkDeviceSize stride = p_query_pool->result_stride * sizeof(uint64_t);
+    tr_internal_vk_cmd_flush_barriers(p_cmd);
+    vkCmdCopyQueryPoolResults(p_cmd->vk_cmd_buf,
+                              p_query_pool->vk_query_pool,
+                              slot_index * p_query_pool->slot_query_count,
+                              used_count,
+                              p_query_pool->results_buffer->vk_buffer,
+                              slot_index * p_query_pool->slot_query_count * stride,
+                              stride,
+                              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+    TINY_RENDERER_DECLARE_ZERO(VkBufferMemoryBarrier, barrier);
     barrier.sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
     barrier.pNext               = NULL;
-    barrier.srcQueueFamilyIndex = 0;
-    barrier.dstQueueFamilyIndex = 0;
-    barrier.buffer              = p_buffer->vk_buffer;
-    barrier.offset              = 0;
-    barrier.size                = VK_WHOLE_SIZE;
+    barrier.srcAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask       = VK_ACCESS_HOST_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer              = p_query_pool->results_buffer->vk_buffer;
+    barrier.offset              = slot_index * p_query_pool->slot_query_count * stride;
+    barrier.size                = used_count * stride;
 
-    switch (old_usage) {
-        case tr_buffer_usage_transfer_src: {
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-        }
-        break;
-
-        case tr_buffer_usage_transfer_dst: {
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        }
-        break;
-
-        case tr_buffer_usage_uniform_texel_srv: {
-            barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-        }
-        break;
-
-        case tr_buffer_usage_storage_texel_uav: {
-            barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
-        }
-        break;
-
-        case tr_buffer_usage_uniform_cbv: {
-            barrier.srcAccessMask = VK_ACCESS_UNIFORM_READ_BIT;
-        }
-        break;
-
-        case tr_buffer_usage_storage_srv: {
-            barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
-        }
-        break;
+    VkPipelineStageFlags dst_stage_mask = VK_PIPELINE_STAGE_HOST_BIT | (tr_internal_vk_cmd_supported_stages(p_cmd) & tr_internal_vk_shader_stages);
+    vkCmdPipelineBarrier(p_cmd->vk_cmd_buf, VK_PIPELINE_STAGE_TRANSFER_BIT, dst_stage_mask, 0, 0, NULL, 1, &barrier, 0, NULL);
+}
 
-        case tr_buffer_usage_storage_uav: {
-            barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
-        }
-        break;
+// -------------------------------------------------------------------------------------------------
+// Internal render graph functions
+// -------------------------------------------------------------------------------------------------
+uint32_t tr_internal_vk_render_graph_add_resource(tr_render_graph* p_render_graph, tr_render_graph_resource_type type, bool transient)
+{
+    if (p_render_graph->resource_count == p_render_graph->resource_capacity) {
+        uint32_t capacity = (p_render_graph->resource_capacity > 0) ? (2 * p_render_graph->resource_capacity) : 16;
+        p_render_graph->resources = (tr_render_graph_resource*)realloc(p_render_graph->resources, capacity * sizeof(*(p_render_graph->resources)));
+        assert(NULL != p_render_graph->resources);
+        p_render_graph->resource_capacity = capacity;
+    }
 
-        case tr_buffer_usage_index: {
-            barrier.srcAccessMask = VK_ACCESS_INDEX_READ_BIT;
-        }
-        break;
+    uint32_t resource = p_render_graph->resource_count++;
+    tr_render_graph_resource* p_resource = &(p_render_graph->resources[resource]);
+    memset(p_resource, 0, sizeof(*p_resource));
+    p_resource->type      = type;
+    p_resource->transient = transient;
+    p_resource->first_use = UINT32_MAX;
+    p_resource->last_use  = UINT32_MAX;
 
-        case tr_buffer_usage_vertex: {
-            barrier.srcAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
-        }
-        break;
+    p_render_graph->compiled = false;
+    return resource;
+}
 
-        case tr_buffer_usage_indirect: {
-            barrier.srcAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+void tr_internal_vk_render_graph_add_access(tr_render_graph* p_render_graph, uint32_t pass, uint32_t resource, bool write, uint32_t usage)
+{
+    tr_render_graph_pass* p_pass = &(p_render_graph->passes[pass]);
+    // Attachments can't be sampled by the pass that renders to them
+    if (tr_render_graph_resource_type_render_target == p_render_graph->resources[resource].type) {
+        for (uint32_t i = 0; i < p_pass->access_count; ++i) {
+            assert((p_pass->accesses[i].resource != resource) && "Render target is read and rendered to by the same pass");
         }
-        break;
     }
 
-    switch (new_usage) {
-        case tr_buffer_usage_transfer_src: {
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-        }
-        break;
+    if (p_pass->access_count == p_pass->access_capacity) {
+        uint32_t capacity = (p_pass->access_capacity > 0) ? (2 * p_pass->access_capacity) : 8;
+        p_pass->accesses = (tr_render_graph_access*)realloc(p_pass->accesses, capacity * sizeof(*(p_pass->accesses)));
+        assert(NULL != p_pass->accesses);
+        p_pass->access_capacity = capacity;
+    }
 
-        case tr_buffer_usage_transfer_dst: {
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        }
-        break;
+    tr_render_graph_access* p_access = &(p_pass->accesses[p_pass->access_count++]);
+    p_access->resource = resource;
+    p_access->write    = write;
+    p_access->usage    = usage;
 
-        case tr_buffer_usage_uniform_texel_srv: {
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-        }
-        break;
+    p_render_graph->compiled = false;
+}
 
-        case tr_buffer_usage_storage_texel_uav: {
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+// Lists the attachments of a render target with the usage rendering puts them in, multisample
+// color attachments are left out unless include_multisample is set
+static uint32_t tr_internal_vk_render_graph_attachments(tr_render_target* p_render_target, bool include_multisample, tr_texture** pp_textures, tr_texture_usage* p_usages)
+{
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < p_render_target->color_attachment_count; ++i) {
+        pp_textures[count] = p_render_target->color_attachments[i];
+        p_usages[count++] = tr_texture_usage_color_attachment;
+        if (include_multisample && (NULL != p_render_target->color_attachments_multisample[i])) {
+            pp_textures[count] = p_render_target->color_attachments_multisample[i];
+            p_usages[count++] = tr_texture_usage_color_attachment;
         }
-        break;
+    }
+    if (NULL != p_render_target->depth_stencil_attachment) {
+        pp_textures[count] = p_render_target->depth_stencil_attachment;
+        p_usages[count++] = tr_texture_usage_depth_stencil_attachment;
+    }
+    return count;
+}
 
-        case tr_buffer_usage_uniform_cbv: {
-            barrier.dstAccessMask = VK_ACCESS_UNIFORM_READ_BIT;
-        }
-        break;
+// Same setup as tr_create_texture_2d, the image is left without memory
+static tr_texture* tr_internal_vk_render_graph_create_attachment(tr_renderer* p_renderer, const tr_render_graph_resource* p_resource, tr_sample_count sample_count, tr_format format, const tr_clear_value* p_clear_value, tr_texture_usage_flags usage)
+{
+    tr_texture* p_texture = (tr_texture*)calloc(1, sizeof(*p_texture));
+    assert(NULL != p_texture);
 
-        case tr_buffer_usage_storage_srv: {
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-        }
-        break;
+    p_texture->renderer     = p_renderer;
+    p_texture->type         = tr_texture_type_2d;
+    p_texture->usage        = usage;
+    p_texture->width        = p_resource->width;
+    p_texture->height       = p_resource->height;
+    p_texture->depth        = 1;
+    p_texture->format       = format;
+    p_texture->mip_levels   = 1;
+    p_texture->sample_count = sample_count;
+    p_texture->host_visible = false;
+    p_texture->clear_value  = *p_clear_value;
 
-        case tr_buffer_usage_storage_uav: {
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
-        }
-        break;
+    tr_internal_vk_create_texture_image(p_renderer, p_texture, false);
+    return p_texture;
+}
 
-        case tr_buffer_usage_index: {
-            barrier.dstAccessMask = VK_ACCESS_INDEX_READ_BIT;
-        }
-        break;
+static tr_render_target* tr_internal_vk_render_graph_create_transient(tr_renderer* p_renderer, const tr_render_graph_resource* p_resource)
+{
+    tr_render_target* p_render_target = (tr_render_target*)calloc(1, sizeof(*p_render_target));
+    assert(NULL != p_render_target);
 
-        case tr_buffer_usage_vertex: {
-            barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+    p_render_target->renderer               = p_renderer;
+    p_render_target->width                  = p_resource->width;
+    p_render_target->height                 = p_resource->height;
+    p_render_target->sample_count           = p_resource->sample_count;
+    p_render_target->color_format           = p_resource->color_format;
+    p_render_target->color_attachment_count = p_resource->color_attachment_count;
+    p_render_target->depth_stencil_format   = p_resource->depth_stencil_format;
+
+    tr_texture_usage_flags color_usage = tr_texture_usage_color_attachment | tr_texture_usage_sampled_image;
+    for (uint32_t i = 0; i < p_render_target->color_attachment_count; ++i) {
+        const tr_clear_value* p_clear_value = &(p_resource->color_clear_values[i]);
+        p_render_target->color_attachments[i] = tr_internal_vk_render_graph_create_attachment(p_renderer, p_resource, tr_sample_count_1, p_resource->color_format, p_clear_value, color_usage);
+        if (p_render_target->sample_count > tr_sample_count_1) {
+            p_render_target->color_attachments_multisample[i] = tr_internal_vk_render_graph_create_attachment(p_renderer, p_resource, p_resource->sample_count, p_resource->color_format, p_clear_value, color_usage);
         }
-        break;
+    }
 
-        case tr_buffer_usage_indirect: {
-            barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
-        }
-        break;
+    if (tr_format_undefined != p_render_target->depth_stencil_format) {
+        tr_texture_usage_flags depth_usage = tr_texture_usage_depth_stencil_attachment | tr_texture_usage_sampled_image;
+        p_render_target->depth_stencil_attachment = tr_internal_vk_render_graph_create_attachment(p_renderer, p_resource, p_resource->sample_count, p_resource->depth_stencil_format, &(p_resource->depth_stencil_clear_value), depth_usage);
     }
 
-    vkCmdPipelineBarrier(p_cmd->vk_cmd_buf,
-                         src_stage_mask,
-                         dst_stage_mask,
-                         dependency_flags,
-                         0,
-                         NULL,
-                         1,
-                         &barrier,
-                         0,
-                         NULL);
+    return p_render_target;
 }
 
-void tr_internal_vk_cmd_image_transition(tr_cmd* p_cmd, tr_texture* p_texture, tr_texture_usage old_usage, tr_texture_usage new_usage)
+static bool tr_internal_vk_render_graph_lifetimes_overlap(const tr_render_graph_resource* p_a, const tr_render_graph_resource* p_b)
 {
-    assert(VK_NULL_HANDLE != p_cmd->vk_cmd_buf);
-    assert(VK_NULL_HANDLE != p_texture->vk_image);
-
-    VkPipelineStageFlags src_stage_mask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-    VkPipelineStageFlags dst_stage_mask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-    VkDependencyFlags dependency_flags = 0;
-    TINY_RENDERER_DECLARE_ZERO(VkImageMemoryBarrier, barrier);
-
-    barrier.oldLayout = tr_util_to_vk_image_layout(old_usage);
-    barrier.newLayout = tr_util_to_vk_image_layout(new_usage);
-
-    barrier.sType                           = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    barrier.pNext                           = NULL;
-    barrier.oldLayout                       = tr_util_to_vk_image_layout(old_usage);
-    barrier.newLayout                       = tr_util_to_vk_image_layout(new_usage);
-    barrier.srcQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex             = VK_QUEUE_FAMILY_IGNORED;
-    barrier.image                           = p_texture->vk_image;
-    barrier.subresourceRange.aspectMask     = p_texture->vk_aspect_mask;
-    barrier.subresourceRange.baseMipLevel   = 0;
-    barrier.subresourceRange.levelCount     = p_texture->mip_levels;
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount     = 1;
+    return (p_a->first_use <= p_b->last_use) && (p_b->first_use <= p_a->last_use);
+}
 
-    // oldLayout
-    switch (barrier.oldLayout) 
-    {
-        case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL: {
-            barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-        }
-        break;
+static bool tr_internal_vk_render_graph_ranges_overlap(const tr_render_graph_resource* p_a, const tr_render_graph_resource* p_b)
+{
+    return (p_a->heap_index == p_b->heap_index) &&
+           (p_a->heap_offset < (p_b->heap_offset + p_b->size)) &&
+           (p_b->heap_offset < (p_a->heap_offset + p_a->size));
+}
 
-        case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL: {
-            barrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-        }
-        break;
+// Culls, schedules and places transients. The pass count is small, so the dependencies are
+// kept as a pass_count x pass_count matrix and placement simply tries every candidate offset.
+void tr_internal_vk_render_graph_compile(tr_render_graph* p_render_graph)
+{
+    tr_internal_vk_render_graph_release_transients(p_render_graph);
 
-        case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL: {
-            barrier.srcAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
-        }
-        break;
+    tr_renderer* p_renderer = p_render_graph->renderer;
+    uint32_t pass_count = p_render_graph->pass_count;
+    uint32_t resource_count = p_render_graph->resource_count;
 
-        case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL: {
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    // Cull - walking back from the last pass, a pass is live if it writes an imported resource or
+    // a transient that a live pass after it reads. Passes that don't write anything are kept,
+    // whatever they do is outside of what the graph can see.
+    bool* needed = (bool*)calloc(tr_max(resource_count, 1), sizeof(*needed));
+    assert(NULL != needed);
+    p_render_graph->culled_pass_count = 0;
+    for (uint32_t i = pass_count; i > 0; --i) {
+        tr_render_graph_pass* p_pass = &(p_render_graph->passes[i - 1]);
+        bool writes = false;
+        bool live = false;
+        for (uint32_t j = 0; j < p_pass->access_count; ++j) {
+            const tr_render_graph_access* p_access = &(p_pass->accesses[j]);
+            if (p_access->write) {
+                writes = true;
+                live |= (! p_render_graph->resources[p_access->resource].transient) || needed[p_access->resource];
+            }
         }
-        break;
-
-        case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:  {
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        p_pass->culled = writes && (! live);
+        if (p_pass->culled) {
+            ++p_render_graph->culled_pass_count;
+            continue;
         }
-        break;
-
-        case VK_IMAGE_LAYOUT_PREINITIALIZED: {
-            barrier.srcAccessMask = VK_ACCESS_HOST_WRITE_BIT;
+        // The render pass clears the target, so readers after this pass don't see earlier writes
+        if (UINT32_MAX != p_pass->render_target) {
+            needed[p_pass->render_target] = false;
         }
-        break;
-
-        case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR: {
-            barrier.srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        for (uint32_t j = 0; j < p_pass->access_count; ++j) {
+            if (! p_pass->accesses[j].write) {
+                needed[p_pass->accesses[j].resource] = true;
+            }
         }
-        break;  
     }
+    TINY_RENDERER_SAFE_FREE(needed);
 
-    // newImageLayout
-    switch (barrier.newLayout) 
-    {
-        case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL: {
-            barrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    // Dependencies - depends[j * pass_count + i] is set if pass j has to run after pass i
+    bool* depends = (bool*)calloc(tr_max(pass_count * pass_count, 1), sizeof(*depends));
+    uint32_t* dependency_counts = (uint32_t*)calloc(tr_max(pass_count, 1), sizeof(*dependency_counts));
+    bool* scheduled = (bool*)calloc(tr_max(pass_count, 1), sizeof(*scheduled));
+    assert((NULL != depends) && (NULL != dependency_counts) && (NULL != scheduled));
+    for (uint32_t j = 0; j < pass_count; ++j) {
+        const tr_render_graph_pass* p_later = &(p_render_graph->passes[j]);
+        if (p_later->culled) {
+            continue;
         }
-        break;
-
-        case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL: {
-            barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        for (uint32_t i = 0; i < j; ++i) {
+            const tr_render_graph_pass* p_earlier = &(p_render_graph->passes[i]);
+            if (p_earlier->culled) {
+                continue;
+            }
+            bool dependent = false;
+            for (uint32_t a = 0; (a < p_later->access_count) && (! dependent); ++a) {
+                for (uint32_t b = 0; (b < p_earlier->access_count) && (! dependent); ++b) {
+                    const tr_render_graph_access* p_a = &(p_later->accesses[a]);
+                    const tr_render_graph_access* p_b = &(p_earlier->accesses[b]);
+                    dependent = (p_a->resource == p_b->resource) && (p_a->write || p_b->write);
+                }
+            }
+            if (dependent) {
+                depends[j * pass_count + i] = true;
+                ++dependency_counts[j];
+            }
         }
-        break;
+    }
 
-        case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL: {
-            barrier.dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+    // Schedule - the first ready pass in declaration order that doesn't depend on the pass
+    // scheduled last, or the first ready pass if they all do
+    p_render_graph->schedule = (uint32_t*)realloc(p_render_graph->schedule, tr_max(pass_count, 1) * sizeof(*(p_render_graph->schedule)));
+    assert(NULL != p_render_graph->schedule);
+    p_render_graph->schedule_count = 0;
+    uint32_t live_count = pass_count - p_render_graph->culled_pass_count;
+    uint32_t last = UINT32_MAX;
+    while (p_render_graph->schedule_count < live_count) {
+        uint32_t first_ready = UINT32_MAX;
+        uint32_t pick = UINT32_MAX;
+        for (uint32_t j = 0; j < pass_count; ++j) {
+            if (p_render_graph->passes[j].culled || scheduled[j] || (dependency_counts[j] > 0)) {
+                continue;
+            }
+            if (UINT32_MAX == first_ready) {
+                first_ready = j;
+            }
+            if ((UINT32_MAX == last) || (! depends[j * pass_count + last])) {
+                pick = j;
+                break;
+            }
         }
-        break;
-
-        case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL: {
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        if (UINT32_MAX == pick) {
+            pick = first_ready;
         }
+        // Dependencies only point back in declaration order, so there's always a ready pass
+        assert(UINT32_MAX != pick);
 
-        case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL: {
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        p_render_graph->schedule[p_render_graph->schedule_count++] = pick;
+        scheduled[pick] = true;
+        last = pick;
+        for (uint32_t j = pick + 1; j < pass_count; ++j) {
+            if (depends[j * pass_count + pick]) {
+                --dependency_counts[j];
+            }
         }
-        break;
+    }
+    TINY_RENDERER_SAFE_FREE(depends);
+    TINY_RENDERER_SAFE_FREE(dependency_counts);
+    TINY_RENDERER_SAFE_FREE(scheduled);
 
-        case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR: {
-            barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    // Lifetimes
+    for (uint32_t i = 0; i < resource_count; ++i) {
+        p_render_graph->resources[i].first_use = UINT32_MAX;
+        p_render_graph->resources[i].last_use  = UINT32_MAX;
+    }
+    for (uint32_t s = 0; s < p_render_graph->schedule_count; ++s) {
+        const tr_render_graph_pass* p_pass = &(p_render_graph->passes[p_render_graph->schedule[s]]);
+        for (uint32_t j = 0; j < p_pass->access_count; ++j) {
+            tr_render_graph_resource* p_resource = &(p_render_graph->resources[p_pass->accesses[j].resource]);
+            if (UINT32_MAX == p_resource->first_use) {
+                p_resource->first_use = s;
+            }
+            p_resource->last_use = s;
         }
-        break;                                            
     }
 
-    vkCmdPipelineBarrier(p_cmd->vk_cmd_buf,
-                         src_stage_mask,
-                         dst_stage_mask,
-                         dependency_flags,
-                         0,
-                         NULL,
-                         0,
-                         NULL,
-                         1,
-                         &barrier);
-}
-
-void tr_internal_vk_cmd_render_target_transition(tr_cmd* p_cmd, tr_render_target* p_render_target, tr_texture_usage old_usage, tr_texture_usage new_usage)
-{
-    assert(NULL != p_cmd->vk_cmd_buf);
-    
-    if (p_render_target->sample_count > tr_sample_count_1) {
-        if (1 == p_render_target->color_attachment_count) {
-            tr_texture* ss_attachment = p_render_target->color_attachments[0];
-            tr_texture* ms_attachment = p_render_target->color_attachments_multisample[0];
-
-            // This means we're dealing with a multisample swapchain
-            if (tr_texture_usage_present == (ss_attachment->usage & tr_texture_usage_present)) {
-                if ((tr_texture_usage_present == old_usage) && (tr_texture_usage_color_attachment == new_usage)) {
-                    tr_internal_vk_cmd_image_transition(p_cmd, ss_attachment, tr_texture_usage_present, tr_texture_usage_color_attachment);
-                }
+    // Create the transients that are used, the images still need memory. Each transient takes
+    // one range with all of its attachments in it.
+    uint32_t* order = (uint32_t*)calloc(tr_max(resource_count, 1), sizeof(*order));
+    assert(NULL != order);
+    uint32_t transient_count = 0;
+    for (uint32_t i = 0; i < resource_count; ++i) {
+        tr_render_graph_resource* p_resource = &(p_render_graph->resources[i]);
+        if ((! p_resource->transient) || (UINT32_MAX == p_resource->first_use)) {
+            continue;
+        }
 
-                if ((tr_texture_usage_color_attachment == old_usage) && (tr_texture_usage_present == new_usage)) {
-                    tr_internal_vk_cmd_image_transition(p_cmd, ss_attachment, tr_texture_usage_color_attachment, tr_texture_usage_present);
+        p_resource->render_target = tr_internal_vk_render_graph_create_transient(p_renderer, p_resource);
+
+        tr_texture* textures[(2 * tr_max_render_target_attachments) + 1];
+        tr_texture_usage usages[(2 * tr_max_render_target_attachments) + 1];
+        uint32_t texture_count = tr_internal_vk_render_graph_attachments(p_resource->render_target, true, textures, usages);
+        p_resource->size             = 0;
+        p_resource->alignment        = 1;
+        p_resource->memory_type_bits = UINT32_MAX;
+        for (uint32_t j = 0; j < texture_count; ++j) {
+            TINY_RENDERER_DECLARE_ZERO(VkMemoryRequirements, mem_reqs);
+            vkGetImageMemoryRequirements(p_renderer->vk_device, textures[j]->vk_image, &mem_reqs);
+            p_resource->size              = tr_round_up_64(p_resource->size, tr_max_64(mem_reqs.alignment, 1)) + mem_reqs.size;
+            p_resource->alignment         = tr_max_64(p_resource->alignment, mem_reqs.alignment);
+            p_resource->memory_type_bits &= mem_reqs.memoryTypeBits;
+        }
+        assert(0 != p_resource->memory_type_bits);
+
+        // Largest first, smaller transients then fill the gaps next to them
+        uint32_t k = transient_count++;
+        while ((k > 0) && (p_render_graph->resources[order[k - 1]].size < p_resource->size)) {
+            order[k] = order[k - 1];
+            --k;
+        }
+        order[k] = i;
+        p_render_graph->transient_unaliased_size += p_resource->size;
+    }
+
+    // Place each transient in the first heap it can share, at the lowest offset that doesn't
+    // overlap a transient that's alive at the same time
+    p_render_graph->heaps = (tr_render_graph_heap*)calloc(tr_max(transient_count, 1), sizeof(*(p_render_graph->heaps)));
+    assert(NULL != p_render_graph->heaps);
+    for (uint32_t i = 0; i < transient_count; ++i) {
+        tr_render_graph_resource* p_resource = &(p_render_graph->resources[order[i]]);
+
+        uint32_t heap_index = 0;
+        while ((heap_index < p_render_graph->heap_count) && (0 == (p_render_graph->heaps[heap_index].memory_type_bits & p_resource->memory_type_bits))) {
+            ++heap_index;
+        }
+        if (heap_index == p_render_graph->heap_count) {
+            p_render_graph->heaps[heap_index].memory_type_bits = p_resource->memory_type_bits;
+            p_render_graph->heaps[heap_index].alignment = 1;
+            ++p_render_graph->heap_count;
+        }
+        tr_render_graph_heap* p_heap = &(p_render_graph->heaps[heap_index]);
+        p_heap->memory_type_bits &= p_resource->memory_type_bits;
+        p_heap->alignment = tr_max_64(p_heap->alignment, p_resource->alignment);
+
+        // Candidates are the start of the heap and the end of every range that's in the way
+        p_resource->heap_index = heap_index;
+        uint64_t best_offset = UINT64_MAX;
+        for (uint32_t c = 0; c <= i; ++c) {
+            uint64_t offset = 0;
+            if (c < i) {
+                const tr_render_graph_resource* p_other = &(p_render_graph->resources[order[c]]);
+                if ((p_other->heap_index != heap_index) || (! tr_internal_vk_render_graph_lifetimes_overlap(p_resource, p_other))) {
+                    continue;
                 }
+                offset = tr_round_up_64(p_other->heap_offset + p_other->size, p_resource->alignment);
+            }
+            if (offset >= best_offset) {
+                continue;
             }
-        }
-    }
-    else {
-        if (1 == p_render_target->color_attachment_count) {
-            tr_texture* attachment = p_render_target->color_attachments[0];
-            // This means we're dealing with a single sample swapchain
-            if (tr_texture_usage_present == (attachment->usage & tr_texture_usage_present)) {
-                if ((tr_texture_usage_present == old_usage) && (tr_texture_usage_color_attachment == new_usage)) {
-                    tr_internal_vk_cmd_image_transition(p_cmd, attachment, tr_texture_usage_present, tr_texture_usage_color_attachment);
-                }
 
-                if ((tr_texture_usage_color_attachment == old_usage) && (tr_texture_usage_present == new_usage)) {
-                    tr_internal_vk_cmd_image_transition(p_cmd, attachment, tr_texture_usage_color_attachment, tr_texture_usage_present);
-                }
+            p_resource->heap_offset = offset;
+            bool fits = true;
+            for (uint32_t j = 0; (j < i) && fits; ++j) {
+                const tr_render_graph_resource* p_other = &(p_render_graph->resources[order[j]]);
+                fits = (! tr_internal_vk_render_graph_lifetimes_overlap(p_resource, p_other)) || (! tr_internal_vk_render_graph_ranges_overlap(p_resource, p_other));
+            }
+            if (fits) {
+                best_offset = offset;
             }
         }
-    }
-}
+        assert(UINT64_MAX != best_offset);
 
-void tr_internal_vk_cmd_dispatch(tr_cmd* p_cmd, uint32_t group_count_x, uint32_t group_count_y, uint32_t group_count_z)
-{
-    assert(p_cmd != NULL);
-    assert(p_cmd->vk_cmd_buf != VK_NULL_HANDLE);
+        p_resource->heap_offset = best_offset;
+        p_heap->size = tr_max_64(p_heap->size, best_offset + p_resource->size);
+    }
+    TINY_RENDERER_SAFE_FREE(order);
 
-    vkCmdDispatch(p_cmd->vk_cmd_buf, group_count_x, group_count_y, group_count_z);
-}
+    for (uint32_t i = 0; i < p_render_graph->heap_count; ++i) {
+        tr_render_graph_heap* p_heap = &(p_render_graph->heaps[i]);
 
-void tr_internal_vk_cmd_copy_buffer_to_texture2d(tr_cmd* p_cmd, uint32_t width, uint32_t height, uint32_t row_pitch, uint64_t buffer_offset, uint32_t mip_level, tr_buffer* p_buffer, tr_texture* p_texture)
-{
-    assert(p_cmd != NULL);
-    assert(p_cmd->vk_cmd_buf != VK_NULL_HANDLE);
+        TINY_RENDERER_DECLARE_ZERO(VkMemoryRequirements, mem_reqs);
+        mem_reqs.size           = p_heap->size;
+        mem_reqs.alignment      = p_heap->alignment;
+        mem_reqs.memoryTypeBits = p_heap->memory_type_bits;
+        tr_internal_vk_allocate_memory(p_renderer, &mem_reqs, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false, &(p_heap->vk_allocation));
+        p_render_graph->transient_memory_size += p_heap->size;
+    }
 
-    VkBufferImageCopy regions = { 0 };
-    regions.bufferOffset                    = buffer_offset;
-    regions.bufferRowLength                 = width;
-    regions.bufferImageHeight               = height;
-    regions.imageSubresource.aspectMask     = p_texture->vk_aspect_mask;
-    regions.imageSubresource.mipLevel       = mip_level;
-    regions.imageSubresource.baseArrayLayer = 0;
-    regions.imageSubresource.layerCount     = 1;
-    regions.imageOffset.x                   = 0;
-    regions.imageOffset.y                   = 0;
-    regions.imageOffset.z                   = 0;
-    regions.imageExtent.width               = width;
-    regions.imageExtent.height              = height;
-    regions.imageExtent.depth               = 1;
+    // Bind the attachments in the same order their sizes were added up in
+    for (uint32_t i = 0; i < resource_count; ++i) {
+        tr_render_graph_resource* p_resource = &(p_render_graph->resources[i]);
+        if ((! p_resource->transient) || (NULL == p_resource->render_target)) {
+            continue;
+        }
 
-    vkCmdCopyBufferToImage(p_cmd->vk_cmd_buf, p_buffer->vk_buffer, p_texture->vk_image,
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &regions);
-}
+        const tr_memory_allocation* p_allocation = &(p_render_graph->heaps[p_resource->heap_index].vk_allocation);
+        tr_texture* textures[(2 * tr_max_render_target_attachments) + 1];
+        tr_texture_usage usages[(2 * tr_max_render_target_attachments) + 1];
+        uint32_t texture_count = tr_internal_vk_render_graph_attachments(p_resource->render_target, true, textures, usages);
+        uint64_t offset = 0;
+        for (uint32_t j = 0; j < texture_count; ++j) {
+            tr_texture* p_texture = textures[j];
 
-// -------------------------------------------------------------------------------------------------
-// Internal queue functions
-// -------------------------------------------------------------------------------------------------
-void tr_internal_vk_acquire_next_image(tr_renderer* p_renderer, tr_semaphore* p_signal_semaphore, tr_fence* p_fence)
-{
-    assert(VK_NULL_HANDLE != p_renderer->vk_device);
-    assert(VK_NULL_HANDLE != p_renderer->vk_swapchain);
+            TINY_RENDERER_DECLARE_ZERO(VkMemoryRequirements, mem_reqs);
+            vkGetImageMemoryRequirements(p_renderer->vk_device, p_texture->vk_image, &mem_reqs);
+            offset = tr_round_up_64(offset, tr_max_64(mem_reqs.alignment, 1));
 
-    VkSemaphore semaphore = (NULL != p_signal_semaphore) ? p_signal_semaphore->vk_semaphore : VK_NULL_HANDLE;
-    VkFence fence = (NULL != p_fence) ? p_fence->vk_fence : VK_NULL_HANDLE;
+            p_texture->vk_memory = p_allocation->block->vk_memory;
+            VkResult vk_res = vkBindImageMemory(p_renderer->vk_device, p_texture->vk_image, p_texture->vk_memory, p_allocation->offset + p_resource->heap_offset + offset);
+            assert(VK_SUCCESS == vk_res);
+            offset += mem_reqs.size;
 
-    VkResult vk_res = vkAcquireNextImageKHR(p_renderer->vk_device, 
-                                            p_renderer->vk_swapchain, 
-                                            UINT64_MAX, 
-                                            semaphore, 
-                                            fence, 
-                                            &(p_renderer->swapchain_image_index));
-    assert(VK_SUCCESS == vk_res);
+            // The image is there, this only creates the view
+            tr_internal_vk_create_texture(p_renderer, p_texture);
+        }
 
-    vk_res = vkWaitForFences(p_renderer->vk_device, 1, &fence, VK_TRUE, UINT64_MAX);
-    assert(VK_SUCCESS == vk_res);
+        tr_internal_vk_create_render_target(p_renderer, false, p_resource->render_target);
+    }
 
-    vk_res = vkResetFences(p_renderer->vk_device, 1, &fence);
-    assert(VK_SUCCESS == vk_res);
+    p_render_graph->compiled = true;
 }
 
-void tr_internal_vk_queue_submit(
-    tr_queue*      p_queue, 
-    uint32_t       cmd_count,
-    tr_cmd**       pp_cmds,
-    uint32_t       wait_semaphore_count,
-    tr_semaphore** pp_wait_semaphores,
-    uint32_t       signal_semaphore_count,
-    tr_semaphore** pp_signal_semaphores
-)
+void tr_internal_vk_render_graph_release_transients(tr_render_graph* p_render_graph)
 {
-    assert(VK_NULL_HANDLE != p_queue->vk_queue);
-
-    TINY_RENDERER_DECLARE_ZERO(VkCommandBuffer, cmds[tr_max_submit_cmds]);
-    cmd_count = cmd_count > tr_max_submit_cmds ? tr_max_submit_cmds : cmd_count;
-    for (uint32_t i = 0; i < cmd_count; ++i) {
-        cmds[i] = pp_cmds[i]->vk_cmd_buf;
-    }
-
-    TINY_RENDERER_DECLARE_ZERO(VkSemaphore, wait_semaphores[tr_max_submit_wait_semaphores]);
-    TINY_RENDERER_DECLARE_ZERO(VkPipelineStageFlags, wait_masks[tr_max_submit_wait_semaphores]);
-    wait_semaphore_count = wait_semaphore_count > tr_max_submit_wait_semaphores ? tr_max_submit_wait_semaphores : wait_semaphore_count;
-    for (uint32_t i = 0; i < wait_semaphore_count; ++i) {
-        wait_semaphores[i] = pp_wait_semaphores[i]->vk_semaphore;
-        wait_masks[i] = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    tr_renderer* p_renderer = p_render_graph->renderer;
+    for (uint32_t i = 0; i < p_render_graph->resource_count; ++i) {
+        tr_render_graph_resource* p_resource = &(p_render_graph->resources[i]);
+        if (p_resource->transient && (NULL != p_resource->render_target)) {
+            // The attachments don't own their memory, the heaps are freed below
+            tr_destroy_render_target(p_renderer, p_resource->render_target);
+            p_resource->render_target = NULL;
+        }
     }
 
-    TINY_RENDERER_DECLARE_ZERO(VkSemaphore, signal_semaphores[tr_max_submit_signal_semaphores]);
-    signal_semaphore_count = signal_semaphore_count > tr_max_submit_signal_semaphores ? tr_max_submit_signal_semaphores : signal_semaphore_count;
-    for (uint32_t i = 0; i < wait_semaphore_count; ++i) {
-        signal_semaphores[i] = pp_signal_semaphores[i]->vk_semaphore;
+    for (uint32_t i = 0; i < p_render_graph->heap_count; ++i) {
+        tr_internal_vk_free_memory(p_renderer, &(p_render_graph->heaps[i].vk_allocation));
     }
-
-    TINY_RENDERER_DECLARE_ZERO(VkSubmitInfo, submit_info);
-    submit_info.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submit_info.pNext                = NULL;
-    submit_info.waitSemaphoreCount   = wait_semaphore_count;
-    submit_info.pWaitSemaphores      = wait_semaphores;
-    submit_info.pWaitDstStageMask    = wait_masks;
-    submit_info.commandBufferCount   = cmd_count;
-    submit_info.pCommandBuffers      = cmds;
-    submit_info.signalSemaphoreCount = signal_semaphore_count;
-    submit_info.pSignalSemaphores    = signal_semaphores;
-    VkResult vk_res = vkQueueSubmit(p_queue->vk_queue, 1, &submit_info, VK_NULL_HANDLE);
-    assert(VK_SUCCESS == vk_res);
+    TINY_RENDERER_SAFE_FREE(p_render_graph->heaps);
+    p_render_graph->heap_count               = 0;
+    p_render_graph->transient_memory_size    = 0;
+    p_render_graph->transient_unaliased_size = 0;
+    p_render_graph->compiled                 = false;
 }
 
-void tr_internal_vk_queue_present(tr_queue* p_queue, uint32_t wait_semaphore_count, tr_semaphore** pp_wait_semaphores)
+// Puts the attachments of a render target into the state a pass needs. The first pass that uses
+// a transient discards it, waiting on everything that last used the same memory.
+static void tr_internal_vk_render_graph_render_target_state(tr_render_graph* p_render_graph, tr_cmd* p_cmd, uint32_t resource, bool write, uint32_t position)
 {
-    assert(VK_NULL_HANDLE != p_queue->vk_queue);
+    const tr_render_graph_resource* p_resource = &(p_render_graph->resources[resource]);
+    assert(NULL != p_resource->render_target);
 
-    tr_renderer* renderer = p_queue->renderer;
+    uint32_t alias_count = 0;
+    bool discard = p_resource->transient && (position == p_resource->first_use);
+    for (uint32_t i = 0; (i < p_render_graph->resource_count) && discard; ++i) {
+        const tr_render_graph_resource* p_other = &(p_render_graph->resources[i]);
+        if ((! p_other->transient) || (NULL == p_other->render_target) || (! tr_internal_vk_render_graph_ranges_overlap(p_resource, p_other))) {
+            continue;
+        }
 
-    TINY_RENDERER_DECLARE_ZERO(VkSemaphore, wait_semaphores[tr_max_present_wait_semaphores]);
-    wait_semaphore_count = wait_semaphore_count > tr_max_present_wait_semaphores ? wait_semaphore_count : wait_semaphore_count;
-    for (uint32_t i = 0; i < wait_semaphore_count; ++i) {
-        wait_semaphores[i] = pp_wait_semaphores[i]->vk_semaphore;
+        uint32_t capacity = alias_count + (2 * tr_max_render_target_attachments) + 1;
+        if (capacity > p_render_graph->alias_capacity) {
+            capacity = tr_max(capacity, 2 * p_render_graph->alias_capacity);
+            p_render_graph->aliases = (tr_texture**)realloc(p_render_graph->aliases, capacity * sizeof(*(p_render_graph->aliases)));
+            assert(NULL != p_render_graph->aliases);
+            p_render_graph->alias_capacity = capacity;
+        }
+        tr_texture_usage usages[(2 * tr_max_render_target_attachments) + 1];
+        alias_count += tr_internal_vk_render_graph_attachments(p_other->render_target, true, p_render_graph->aliases + alias_count, usages);
     }
 
-    TINY_RENDERER_DECLARE_ZERO(VkPresentInfoKHR, present_info);
-    present_info.sType              = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-    present_info.pNext              = NULL;
-    present_info.waitSemaphoreCount = wait_semaphore_count;
-    present_info.pWaitSemaphores    = wait_semaphores;
-    present_info.swapchainCount     = 1;
-    present_info.pSwapchains        = &(renderer->vk_swapchain);
-    present_info.pImageIndices      = &(renderer->swapchain_image_index);
-    present_info.pResults           = NULL;
+    // Sampling reads the resolved color attachments, rendering writes all of them
+    tr_texture* textures[(2 * tr_max_render_target_attachments) + 1];
+    tr_texture_usage usages[(2 * tr_max_render_target_attachments) + 1];
+    uint32_t texture_count = tr_internal_vk_render_graph_attachments(p_resource->render_target, write || discard, textures, usages);
+    for (uint32_t i = 0; i < texture_count; ++i) {
+        tr_texture_usage usage = write ? usages[i] : tr_texture_usage_sampled_image;
+        if (discard) {
+            tr_internal_vk_cmd_image_discard(p_cmd, textures[i], usage, alias_count, p_render_graph->aliases);
+        }
+        else {
+            tr_internal_vk_cmd_image_state(p_cmd, textures[i], usage);
+        }
+    }
+}
+
+void tr_internal_vk_render_graph_execute(tr_render_graph* p_render_graph, tr_cmd* p_cmd)
+{
+    for (uint32_t s = 0; s < p_render_graph->schedule_count; ++s) {
+        const tr_render_graph_pass* p_pass = &(p_render_graph->passes[p_render_graph->schedule[s]]);
+        TINY_RENDERER_TRACE_NAMED_SCOPE(p_render_graph, p_pass->name);
+
+        for (uint32_t i = 0; i < p_pass->access_count; ++i) {
+            const tr_render_graph_access* p_access = &(p_pass->accesses[i]);
+            const tr_render_graph_resource* p_resource = &(p_render_graph->resources[p_access->resource]);
+            switch (p_resource->type) {
+                case tr_render_graph_resource_type_buffer: {
+                    assert(NULL != p_resource->buffer);
+                    // Buffer states can hold several usages, so a buffer the pass declares more
+                    // than once goes into all of them with one transition
+                    bool first = true;
+                    uint32_t usage = p_access->usage;
+                    for (uint32_t j = 0; j < p_pass->access_count; ++j) {
+                        if (p_pass->accesses[j].resource == p_access->resource) {
+                            first &= (j >= i);
+                            usage |= p_pass->accesses[j].usage;
+                        }
+                    }
+                    if (first) {
+                        tr_internal_vk_cmd_buffer_state(p_cmd, p_resource->buffer, (tr_buffer_usage)usage);
+                    }
+                }
+                break;
 
-    VkResult vk_res = vkQueuePresentKHR(s_tr_internal->renderer->present_queue->vk_queue, &present_info);
-    assert(VK_SUCCESS == vk_res);
-}
+                case tr_render_graph_resource_type_texture: {
+                    assert(NULL != p_resource->texture);
+                    tr_internal_vk_cmd_image_state(p_cmd, p_resource->texture, (tr_texture_usage)p_access->usage);
+                }
+                break;
 
-void tr_internal_vk_queue_wait_idle(tr_queue* p_queue)
-{
-    assert(VK_NULL_HANDLE != p_queue->vk_queue);
+                case tr_render_graph_resource_type_render_target: {
+                    tr_internal_vk_render_graph_render_target_state(p_render_graph, p_cmd, p_access->resource, p_access->write, s);
+                }
+                break;
+            }
+        }
+        tr_internal_vk_cmd_flush_barriers(p_cmd);
 
-    VkResult vk_res = vkQueueWaitIdle(p_queue->vk_queue);
-    assert(VK_SUCCESS == vk_res);
+        if (UINT32_MAX != p_pass->render_target) {
+            tr_cmd_begin_render(p_cmd, p_render_graph->resources[p_pass->render_target].render_target);
+            p_pass->execute_fn(p_cmd, p_pass->user_data);
+            tr_cmd_end_render(p_cmd);
+        }
+        else {
+            p_pass->execute_fn(p_cmd, p_pass->user_data);
+        }
+    }
 }
 
 #endif // TINY_RENDERER_IMPLEMENTATION